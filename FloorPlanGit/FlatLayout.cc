@@ -0,0 +1,277 @@
+/* -*- Mode: C++ ; indent-tabs-mode: nil ; c-file-style: "stroustrup" -*-
+
+   Rapid Prototyping Floorplanner Project
+   Author: Greg Faust
+
+   File:   FlatLayout.cc     Freeze a layout into flat arrays, and write the output files from them.
+
+*/
+
+#include <cmath>
+#include <sstream>
+#include "MathUtil.hh"
+#include "Floorplan.hh"
+#include "FlatLayout.hh"
+
+FPFlatLayout::FPFlatLayout(FPObject * root) {
+    leafIndexBuilt = false;
+    // The mirror context is only used while we walk the tree.
+    root->freeze(*this, 0.0, 0.0, -1);
+    pinStart.push_back(0);
+    FPContainer * cont = dynamic_cast<FPContainer *>(root);
+    if (cont) cont->freezeNets(*this);
+    placePins();
+}
+
+int FPFlatLayout::findName(string name) {
+    map<string, int>::iterator it = nameLookup.find(name);
+    if (it != nameLookup.end()) return it->second;
+    int index = names.size();
+    names.push_back(name);
+    nameLookup[name] = index;
+    return index;
+}
+
+int FPFlatLayout::addRecord(FPObject * obj, RecordKind recordKind, double absX, double absY, int parentRecord) {
+    FPContext& ctx = currentContext();
+    int record = size();
+    x.push_back(absX);
+    y.push_back(absY);
+    width.push_back(obj->getWidth());
+    height.push_back(obj->getHeight());
+    area.push_back(obj->getArea());
+    nameIndex.push_back(findName(obj->getName()));
+    parent.push_back(parentRecord);
+    end.push_back(record + 1);
+    kind.push_back(recordKind);
+    mirror.push_back((ctx.xReflect ? 1 : 0) | (ctx.yReflect ? 2 : 0));
+    xCount.push_back(0);
+    yCount.push_back(0);
+    recordObject.push_back(obj);
+    return record;
+}
+
+void FPFlatLayout::addNet(FPNet * net) {
+    for (int i = 0; i < net->getItemCount(); i++) {
+        FPObject * comp = net->getComponent(i);
+        pinObject.push_back(comp);
+        pinName.push_back(findName(comp->getName()));
+    }
+    pinStart.push_back(pinObject.size());
+}
+
+void FPFlatLayout::placePins() {
+    int pinCount = pinObject.size();
+
+    // Find every copy of each pin's component.
+    map<FPObject *, vector<int> > copies;
+    for (int r = 0; r < size(); r++) copies[recordObject[r]].push_back(r);
+    termStart.assign(1, 0);
+    termRecord.clear();
+    for (int i = 0; i < pinCount; i++) {
+        map<FPObject *, vector<int> >::iterator it = copies.find(pinObject[i]);
+        if (it != copies.end()) termRecord.insert(termRecord.end(), it->second.begin(), it->second.end());
+        termStart.push_back(termRecord.size());
+    }
+}
+
+// Unique names are handed out as we write, just as FPObject::getUniqueName does.
+static string uniqueName(string& name) {
+    if (name == " " || name == "") return name;
+    return name + getStringFromInt(Name2Count(name));
+}
+
+FPRectIndex& FPFlatLayout::getLeafIndex() {
+    if (!leafIndexBuilt) {
+        for (int r = 0; r < size(); r++) {
+            if (kind[r] == FlatLeaf) leafIndex.insert(r, x[r], y[r], width[r], height[r]);
+        }
+        leafIndexBuilt = true;
+    }
+    return leafIndex;
+}
+
+int FPFlatLayout::findOverlaps(vector<int>& first, vector<int>& second) {
+    FPRectIndex& index = getLeafIndex();
+    double d = 0.00001; //for rounding error, as in the overlap detection of the layout
+    int found = 0;
+    vector<int> near;
+    for (int r = 0; r < size(); r++) {
+        if (kind[r] != FlatLeaf) continue;
+        near.clear();
+        index.query(x[r], y[r], width[r], height[r], near);
+        for (unsigned int i = 0; i < near.size(); i++) {
+            int n = near[i];
+            if (n <= r) continue;
+            double widthOver = MIN(x[r] + width[r], x[n] + width[n]) - MAX(x[r], x[n]);
+            double heightOver = MIN(y[r] + height[r], y[n] + height[n]) - MAX(y[r], y[n]);
+            if (widthOver <= d || heightOver <= d) continue;
+            first.push_back(r);
+            second.push_back(n);
+            found += 1;
+        }
+    }
+    return found;
+}
+
+void FPFlatLayout::outputHotSpotLayout(ostream& o) {
+    FPContext& ctx = currentContext();
+    // HotSpot assumes the units do not overlap, so say so if they do.
+    vector<int> first, second;
+    int overlaps = findOverlaps(first, second);
+    if (overlaps > 0) {
+        int a = first[0], b = second[0];
+        cerr << "Warning: " << overlaps << " pair(s) of units overlap in the floorplan, the first being "
+             << names[nameIndex[a]] << " at (" << x[a] << "," << y[a] << ") and "
+             << names[nameIndex[b]] << " at (" << x[b] << "," << y[b] << ").\n";
+    }
+    // The containers we are inside of, and the names they got.
+    vector<int>    open;
+    vector<string> openNames;
+    for (int r = 0; r <= size(); r++) {
+        // Close off any containers that end here.
+        while (!open.empty() && end[open.back()] <= r) {
+            int c = open.back();
+            if (kind[c] != FlatQuiet) o << "# End of " << openNames.back() << " Layout.\n";
+            open.pop_back();
+            openNames.pop_back();
+        }
+        if (r == size()) break;
+
+        if (kind[r] == FlatLeaf) {
+            string uname = (ctx.printNames) ? uniqueName(names[nameIndex[r]]) : " ";
+            o << uname << "\t" << width[r] / 1000 << "\t" << height[r] / 1000
+              << "\t" << x[r] / 1000 << "\t" << y[r] / 1000 << "\n";
+            continue;
+        }
+
+        string contName;
+        if (kind[r] == FlatGrid) {
+            contName = uniqueName(names[nameIndex[r]]);
+            o << "# Start of " << contName << " Layout.  There are " << xCount[r] * yCount[r] << " components in a "
+              << xCount[r] << " by " << yCount[r] << " grid.\n";
+            o << "# Total Grid Stats: X=" << x[r] << " Y=" << y[r] << " W=" << width[r]
+              << "mm H=" << height[r] << "mm Area=" << area[r] << "mm^2\n";
+        } else if (kind[r] == FlatGroup) {
+            contName = uniqueName(names[nameIndex[r]]);
+            o << "# Start of " << contName << " layout.\n";
+            o << "# Total Group Stats: X=" << x[r] << " Y=" << y[r] << " W=" << width[r]
+              << "mm H=" << height[r] << "mm Area=" << area[r] << "mm^2\n";
+        } else if (kind[r] == FlatCluster) {
+            contName = uniqueName(names[nameIndex[r]]);
+            o << "# Start of " << contName << " Layout.\n";
+            o << "# Total Cluster Stats: X=" << x[r] << " Y=" << y[r] << " W=" << width[r]
+              << "mm H=" << height[r] << "mm Area=" << area[r] << "mm^2\n";
+        }
+        open.push_back(r);
+        openNames.push_back(contName);
+    }
+}
+
+// Make a name safe to put in SVG text.
+static string xmlEscape(string& name) {
+    string escaped;
+    for (unsigned int i = 0; i < name.size(); i++) {
+        switch (name[i]) {
+        case '&':  escaped += "&amp;";  break;
+        case '<':  escaped += "&lt;";   break;
+        case '>':  escaped += "&gt;";   break;
+        case '"':  escaped += "&quot;"; break;
+        default:   escaped += name[i];
+        }
+    }
+    return escaped;
+}
+
+// Pale enough that the black labels stay readable.
+static const char * svgColors[] = {
+    "#8dd3c7", "#ffffb3", "#bebada", "#fb8072", "#80b1d3", "#fdb462",
+    "#b3de69", "#fccde5", "#d9d9d9", "#bc80bd", "#ccebc5", "#ffed6f"
+};
+#define svgColorCount 12
+// The longer side of the picture, in pixels.
+#define svgPixels 1000.0
+// As in tofig.pl, labels of units at least this much taller than wide run vertically.
+#define svgSkinny 3
+
+void FPFlatLayout::outputSVG(ostream& o) {
+    FPContext& ctx = currentContext();
+    if (size() == 0) return;
+
+    // SVG puts y = 0 at the top, so everything gets flipped about the top of the root.
+    double top = y[0] + height[0];
+    double margin = MAX(width[0], height[0]) / 50;
+    double scale = svgPixels / (MAX(width[0], height[0]) + 2 * margin);
+    double lineWidth = MAX(width[0], height[0]) / 1000;
+    o << "<svg xmlns=\"http://www.w3.org/2000/svg\" version=\"1.1\""
+      << " width=\"" << (width[0] + 2 * margin) * scale << "\" height=\"" << (height[0] + 2 * margin) * scale << "\""
+      << " viewBox=\"" << x[0] - margin << " " << -margin << " "
+      << width[0] + 2 * margin << " " << height[0] + 2 * margin << "\">\n";
+    o << "<rect x=\"" << x[0] - margin << "\" y=\"" << -margin << "\" width=\"" << width[0] + 2 * margin
+      << "\" height=\"" << height[0] + 2 * margin << "\" fill=\"white\"/>\n";
+
+    // The labels go on top of everything, so gather them up as we go.
+    ostringstream labels;
+    for (int r = 0; r < size(); r++) {
+        double left = x[r];
+        double bottom = top - y[r] - height[r];
+
+        if (kind[r] != FlatLeaf) {
+            if (kind[r] == FlatQuiet) continue;
+            // Use up the name just as the .flp file does, so the leaves get the same numbers.
+            uniqueName(names[nameIndex[r]]);
+            o << "<rect x=\"" << left << "\" y=\"" << bottom << "\" width=\"" << width[r] << "\" height=\"" << height[r]
+              << "\" fill=\"none\" stroke=\"gray\" stroke-width=\"" << 2 * lineWidth
+              << "\" stroke-dasharray=\"" << 8 * lineWidth << "\"/>\n";
+            continue;
+        }
+
+        string& name = names[nameIndex[r]];
+        unsigned int hash = 0;
+        for (unsigned int i = 0; i < name.size(); i++) hash = hash * 31 + (unsigned char) name[i];
+        string label = (ctx.printNames) ? uniqueName(name) : " ";
+        label = xmlEscape(label);
+        o << "<rect x=\"" << left << "\" y=\"" << bottom << "\" width=\"" << width[r] << "\" height=\"" << height[r]
+          << "\" fill=\"" << svgColors[hash % svgColorCount] << "\" stroke=\"black\" stroke-width=\"" << lineWidth
+          << "\"><title>" << ((ctx.printNames) ? label : xmlEscape(name)) << " " << width[r] << " x " << height[r] << "</title></rect>\n";
+
+        if (label == " " || label == "") continue;
+        // Fit the label into the unit, running it along the longer side of skinny ones.
+        bool vertical = (height[r] > svgSkinny * width[r]);
+        double along = vertical ? height[r] : width[r];
+        double across = vertical ? width[r] : height[r];
+        double fontSize = MIN(0.9 * along / (0.6 * label.size()), 0.5 * across);
+        double cX = left + width[r] / 2;
+        double cY = bottom + height[r] / 2;
+        labels << "<text x=\"" << cX << "\" y=\"" << cY << "\" font-size=\"" << fontSize << "\"";
+        if (vertical) labels << " transform=\"rotate(-90 " << cX << " " << cY << ")\"";
+        labels << ">" << label << "</text>\n";
+    }
+    o << "<g font-family=\"sans-serif\" text-anchor=\"middle\" dominant-baseline=\"central\">\n";
+    o << labels.str();
+    o << "</g>\n";
+    o << "</svg>\n";
+}
+
+//@todo
+void FPFlatLayout::outputNetsFile(ostream& o) {
+    int totalNetsCount = 0;
+    for (int i = 0; i < netCount(); i++) {
+        int curNetsCount = pinStart[i + 1] - pinStart[i];
+        totalNetsCount += curNetsCount * (curNetsCount - 1) / 2;
+    }
+
+    o << "NumNets : " << totalNetsCount << "\n";
+    o << "NumPins : " << totalNetsCount * 2 << "\n\n"; //@todo: assume always bi-directional
+
+    for (int i = 0; i < netCount(); i++) {
+        for (int j = pinStart[i]; j < pinStart[i + 1]; j++) {
+            for (int k = j + 1; k < pinStart[i + 1]; k++) {
+                o << "NetDegree : 2\n";
+                o << names[pinName[j]] << " B\n";
+                o << names[pinName[k]] << " B\n";
+            }
+            o << "\n";
+        }
+    }
+}
@@ -0,0 +1,103 @@
+/* -*- Mode: C++ ; indent-tabs-mode: nil ; c-file-style: "stroustrup" -*-
+
+   Rapid Prototyping Floorplanner Project
+   Author: Greg Faust
+
+   File:   FlatLayout.hh     C++ Header file for the frozen, flattened form of a layout.
+
+   Include this after Floorplan.hh.
+
+*/
+
+#include <string>
+#include <iostream>
+#include <vector>
+#include <map>
+using namespace std;
+
+// Once a floorplan is layed out, all the output wants is where everything ended up.
+// Walking the tree of FPObjects for that means virtual calls at every node,
+//    and keeping the mirror context up to date all the way down.
+// So instead we "freeze" the tree once into flat arrays, one entry per record,
+//    with the absolute coordinates already worked out, and do the output from those.
+//
+// The records are in the same pre-order that the output uses.
+// A grid produces a copy of its component for every cell.
+// A container record is followed by the records of everything inside it, up to its end.
+//
+// Only freeze a tree once it has been layed out, as the coordinates are meaningless before that.
+// The blocks file describes the tree before layout, so it is written from the tree itself.
+
+class FPObject;
+class FPContainer;
+class FPNet;
+
+class FPFlatLayout {
+public:
+    enum RecordKind {FlatLeaf, FlatGrid, FlatGroup, FlatCluster, FlatQuiet};
+
+    // One entry per record.
+    // Coordinates are absolute, in mm, with any mirroring already done.
+    vector<double>        x;
+    vector<double>        y;
+    vector<double>        width;
+    vector<double>        height;
+    vector<double>        area;
+    vector<int>           nameIndex;    // Into names.
+    vector<int>           parent;       // The enclosing container record, or -1.
+    vector<int>           end;          // One past the last record inside this one.
+    vector<unsigned char> kind;         // A RecordKind.
+    vector<unsigned char> mirror;       // 1 if mirrored in x, 2 if in y, 3 for both.
+
+    // Only the grids use these.
+    vector<int>           xCount;
+    vector<int>           yCount;
+
+    // The names used by the records and pins, each only once.
+    vector<string>        names;
+
+    // The nets of the root, in compressed form.
+    // The pins of net i are pinStart[i] up to pinStart[i + 1].
+    vector<int>           pinStart;
+    vector<int>           pinName;      // Into names.
+
+    // Every placed copy of the component of each pin.
+    // The records for pin j are termRecord[termStart[j]] up to termRecord[termStart[j + 1]].
+    vector<int>           termStart;
+    vector<int>           termRecord;
+
+    FPFlatLayout(FPObject * root);
+
+    int    size()     { return x.size(); }
+    int    netCount() { return pinStart.size() - 1; }
+
+    // Used by the FPObject freeze methods as they walk the tree.
+    int    addRecord(FPObject * obj, RecordKind recordKind, double absX, double absY, int parentRecord);
+    void   closeRecord(int record) { end[record] = size(); }
+    void   addNet(FPNet * net);
+
+    void   outputHotSpotLayout(ostream& o);
+    void   outputNetsFile(ostream& o);
+    // A picture of the layout, with the units labelled as in the .flp file.
+    // Units with the same name get the same color, and containers are outlined.
+    void   outputSVG(ostream& o);
+
+    // A spatial index of the leaf records, for neighbour queries.  It is built the first time it is asked for.
+    FPRectIndex& getLeafIndex();
+    // Call this after moving or resizing records, so the index is built again when next asked for.
+    void   coordinatesChanged() { leafIndex.clear(); leafIndexBuilt = false; }
+    // Find the pairs of leaf records that overlap by more than rounding error, and return how many there are.
+    // The records of pair i are first[i] and second[i], with first[i] < second[i].
+    int    findOverlaps(vector<int>& first, vector<int>& second);
+
+private:
+    map<string, int>      nameLookup;
+    vector<FPObject *>    pinObject;
+    vector<FPObject *>    recordObject;
+
+    FPRectIndex           leafIndex;
+    bool                  leafIndexBuilt;
+
+    int    findName(string name);
+    void   placePins();
+};
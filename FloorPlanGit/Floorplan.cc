@@ -13,115 +13,170 @@
 #include <fstream>
 #include <cmath>
 #include <stdexcept>
-#include <exception>
+#include <chrono>
+#include <algorithm>
+#include <typeinfo>
 #include "MathUtil.hh"
 #include "Floorplan.hh"
+#include "FlatLayout.hh"
+#include "NetLength.hh"
 
 
-// This will be used to keep track of user's request for more output during layout.
-bool verbose = true;
- 
-// Flag for legalization
-bool legalizing = true;
-
-// This is used to turn on/off whether we need to keep the same area after legalizing the layout.
-bool changeArea = true; 
-
-// Once an item is placed at right or top, mark = false;
-bool rightMark = true;
-bool topMark = true; 
-
-// TopBottom items can be inverted to BottomTop order
-bool topBottomInversion = false; 
-
-// Overlap detection to allow legalization
-bool checkOverlap = true; 
-
-// Overlap area expansion
-double expandHeight = 0, expandWidth = 0; 
-
-// Wire length calculation
-bool wiring = true; 
-
-// Temporary local for crazy mirror reflection stuff.
-#define maxMirrorDepth 50
-static bool xReflect = false;
-static double xLeft[maxMirrorDepth];
-static double xRight[maxMirrorDepth];
-static int xMirrorDepth = 0;
-static bool yReflect = false;
-static double yBottom[maxMirrorDepth];
-static double yTop[maxMirrorDepth];
-static int yMirrorDepth = 0;
-static bool printNames = true;
-
 // Charles Maximum layout retries
 #define maxRetry 100
 
-struct OverlapException: public exception
-{
-  const char * what () const throw ()
-  {
-    return "Components overlapped";
-  }
-};
-
-struct AreaException : public exception
-{
-  const char * what () const throw ()
-  {
-    return "Components need more area for layout";
-  }
-};
+// Maximum tries at repairing an overlap in place at one depth of a geographic layout before starting over.
+#define maxRepair 10
 
+// Used to time the legalization.
+static double secondsSince(chrono::steady_clock::time_point start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
 
 void setNameMode(bool flag) {
-    printNames = flag;
+    FPContext& ctx = currentContext();
+    ctx.printNames = flag;
 }
 
 void FPContainer::pushMirrorContext(double startX, double startY) {
+    FPContext& ctx = currentContext();
     if (xMirror) {
-        if (xMirrorDepth == maxMirrorDepth) throw out_of_range("X Mirror Depth exceeds maximum allowed.");
-        xReflect = !xReflect;
-        xLeft[xMirrorDepth] = startX + x;
-        xRight[xMirrorDepth] = startX + x + width;
-        xMirrorDepth += 1;
+        if (ctx.xMirrorDepth == maxMirrorDepth) throw out_of_range("X Mirror Depth exceeds maximum allowed.");
+        ctx.xReflect = !ctx.xReflect;
+        ctx.xLeft[ctx.xMirrorDepth] = startX + x;
+        ctx.xRight[ctx.xMirrorDepth] = startX + x + width;
+        ctx.xMirrorDepth += 1;
     }
     if (yMirror) {
-        if (xMirrorDepth == maxMirrorDepth) throw out_of_range("Y Mirror Depth exceeds maximum allowed.");
-        yReflect = !yReflect;
-        yBottom[yMirrorDepth] = startY + y;
-        yTop[yMirrorDepth] = startY + y + height;
-        yMirrorDepth += 1;
+        if (ctx.xMirrorDepth == maxMirrorDepth) throw out_of_range("Y Mirror Depth exceeds maximum allowed.");
+        ctx.yReflect = !ctx.yReflect;
+        ctx.yBottom[ctx.yMirrorDepth] = startY + y;
+        ctx.yTop[ctx.yMirrorDepth] = startY + y + height;
+        ctx.yMirrorDepth += 1;
     }
 }
 
 void FPContainer::popMirrorContext() {
+    FPContext& ctx = currentContext();
     if (xMirror) {
-        xReflect = !xReflect;
-        xMirrorDepth -= 1;
+        ctx.xReflect = !ctx.xReflect;
+        ctx.xMirrorDepth -= 1;
     }
     if (yMirror) {
-        yReflect = !yReflect;
-        yMirrorDepth -= 1;
+        ctx.yReflect = !ctx.yReflect;
+        ctx.yMirrorDepth -= 1;
     }
 }
 
 inline double FPObject::calcX(double startX) {
-    if (xReflect) {
-        return xLeft[xMirrorDepth - 1] - (startX + x - xRight[xMirrorDepth - 1] + width);
+    FPContext& ctx = currentContext();
+    if (ctx.xReflect) {
+        return ctx.xLeft[ctx.xMirrorDepth - 1] - (startX + x - ctx.xRight[ctx.xMirrorDepth - 1] + width);
     } else return startX + x;
 }
 
 inline double FPObject::calcY(double startY) {
-    if (yReflect) {
-        return yTop[yMirrorDepth - 1] - (startY + y - yBottom[yMirrorDepth - 1] + height);
+    FPContext& ctx = currentContext();
+    if (ctx.yReflect) {
+        return ctx.yTop[ctx.yMirrorDepth - 1] - (startY + y - ctx.yBottom[ctx.yMirrorDepth - 1] + height);
     } else return startY + y;
 }
 
 // Map component types to names.
 string TypeNames [] = {"Unknown", "Core", "Cache", "ICache", "DCache", "L1_", "L2_", "L3_", "RF", "FPRF", "ALU", "NoC", "Control", "CrossBar", "MemCtrl", "Grid", "Group", "Cluster"};
-map<string, int> NameCounts;
+
+// Methods for the layout context.
+
+FPContext::FPContext() {
+    verbose = true;
+    legalizing = true;
+    changeArea = true;
+    topBottomInversion = false;
+    checkOverlap = true;
+    wiring = true;
+    printNames = true;
+    layoutCaching = false;
+    svgOutput = false;
+    resetState();
+    resetStats();
+}
+
+void FPContext::resetState() {
+    rightMark = true;
+    topMark = true;
+    expandHeight = 0;
+    expandWidth = 0;
+    legalizeFailed = false;
+    xReflect = false;
+    xMirrorDepth = 0;
+    yReflect = false;
+    yMirrorDepth = 0;
+    for (int i = 0; i < ComponentTypeCount; i++) TypeCounts[i] = 0;
+    NameCounts.clear();
+}
+
+void FPContext::resetStats() {
+    legalizeRepairs = 0;
+    legalizeRestarts = 0;
+    legalizeRepairTime = 0;
+    legalizeSavedTime = 0;
+    layoutCacheHits = 0;
+    layoutCacheMisses = 0;
+}
+
+void FPContext::addStats(FPContext& other) {
+    legalizeRepairs += other.legalizeRepairs;
+    legalizeRestarts += other.legalizeRestarts;
+    legalizeRepairTime += other.legalizeRepairTime;
+    legalizeSavedTime += other.legalizeSavedTime;
+    layoutCacheHits += other.layoutCacheHits;
+    layoutCacheMisses += other.layoutCacheMisses;
+}
+
+void FPContext::outputStats(ostream& o) {
+    o << "Legalization: " << legalizeRepairs << " overlap(s) repaired in place (full relayouts avoided), "
+      << legalizeRestarts << " full relayout(s) needed.\n";
+    o << "Legalization: " << legalizeRepairTime << " s spent on repairs, an estimated " << legalizeSavedTime << " s saved.\n";
+    if (layoutCaching) o << "Layout cache: " << layoutCacheHits << " container layout(s) reused, " << layoutCacheMisses << " done.\n";
+}
+
+// Methods for the layout cache.
+
+void FPLayoutCache::clear() {
+    for (map<string, FPCachedLayout *>::iterator it = entries.begin(); it != entries.end(); it++) {
+        delete it->second->root;
+        delete it->second;
+    }
+    entries.clear();
+}
+
+FPCachedLayout * FPLayoutCache::find(string& key) {
+    map<string, FPCachedLayout *>::iterator it = entries.find(key);
+    if (it == entries.end()) return 0;
+    return it->second;
+}
+
+void FPLayoutCache::store(string& key, FPCachedLayout * entry) {
+    if (size() >= maxCachedLayouts || find(key)) {
+        delete entry->root;
+        delete entry;
+        return;
+    }
+    entries[key] = entry;
+}
+
+// Each thread starts out using its own default context.
+static thread_local FPContext   defaultContext;
+static thread_local FPContext * activeContext = 0;
+
+FPContext& currentContext() {
+    if (activeContext) return *activeContext;
+    return defaultContext;
+}
+
+void setCurrentContext(FPContext * context) {
+    activeContext = context;
+}
 
 // Methods for the dummy component class to help with some IO.
 
@@ -165,6 +220,49 @@ FPObject::FPObject() {
     count = 1;
     refCount = 0;
     state = false;
+    shapeValid = false;
+}
+
+FPShapeCurve& FPObject::getShapeCurve() {
+    if (!shapeValid) {
+        shape.clear();
+        calcShapeCurve();
+        shapeValid = true;
+    }
+    return shape;
+}
+
+void FPObject::calcShapeCurve() {
+    shape.add(0, HUGE_VAL);
+}
+
+bool FPObject::addSignature(ostream& sig, map<FPObject *, int>& seen, bool& usesContext) {
+    map<FPObject *, int>::iterator it = seen.find(this);
+    if (it != seen.end()) {
+        sig << "@" << it->second << ";";
+        return false;
+    }
+    int index = seen.size();
+    seen[this] = index;
+    // Where the last layout put us does not matter, as the next one puts us again.
+    // So copies of a subtree laid out in different places still match.
+    sig << typeid(*this).name() << " " << name.size() << ":" << name << " " << type << " " << count << " " << hint << " " << state << ";";
+    return true;
+}
+
+void FPObject::copyLayoutFrom(FPObject * from) {
+    x = from->x;
+    y = from->y;
+    xc = from->xc;
+    yc = from->yc;
+    width = from->width;
+    height = from->height;
+    area = from->area;
+    type = from->type;
+    name = from->name;
+    hint = from->hint;
+    count = from->count;
+    state = from->state;
 }
 
 void FPObject::setSize(double widthArg, double heightArg) {
@@ -183,6 +281,44 @@ void FPObject::setCenter(double xcArg, double ycArg) {
     yc = ycArg;
 }
 
+// Methods for the shape curves.
+
+void FPShapeCurve::add(double lowAR, double highAR) {
+    if (lowAR > highAR) return;
+    // Find where it goes, then swallow any intervals it overlaps.
+    unsigned int i = 0;
+    while (i < low.size() && high[i] < lowAR) i++;
+    while (i < low.size() && low[i] <= highAR) {
+        lowAR = MIN(lowAR, low[i]);
+        highAR = MAX(highAR, high[i]);
+        low.erase(low.begin() + i);
+        high.erase(high.begin() + i);
+    }
+    low.insert(low.begin() + i, lowAR);
+    high.insert(high.begin() + i, highAR);
+}
+
+void FPShapeCurve::addScaled(FPShapeCurve& other, double factor) {
+    for (int i = 0; i < other.size(); i++) add(other.low[i] * factor, other.high[i] * factor);
+}
+
+bool FPShapeCurve::contains(double AR) {
+    return distance(AR) == 1;
+}
+
+double FPShapeCurve::distance(double AR) {
+    // Allow for the rounding in working out the AR we are asked about.
+    const double slop = 1e-9;
+    if (AR <= 0) return HUGE_VAL;
+    double best = HUGE_VAL;
+    for (unsigned int i = 0; i < low.size(); i++) {
+        if (AR >= low[i] * (1 - slop) && AR <= high[i] * (1 + slop)) return 1;
+        double dist = (AR < low[i]) ? low[i] / AR : AR / high[i];
+        best = MIN(best, dist);
+    }
+    return best;
+}
+
 int FPNet::maxItemCount = 50;
 
 FPNet::FPNet() {
@@ -193,13 +329,8 @@ FPNet::FPNet() {
 }
 
 FPNet::~FPNet() {
-    // It's very important to only delete items when their refcount hits zero.
-    // cout << "deleting container.\n";
-    for (int i = 0; i < itemCount; i++) {
-        FPObject * item = items[i];
-        int newCount = item->decRefCount();
-        if (newCount == 0) delete item;
-    }
+    // A net does not hold a reference to the components it connects.
+    // Those belong to their containers, so only free our own list.
     delete [] items;
 }
 
@@ -242,67 +373,50 @@ FPObject * FPNet::removeWireTo(int index) {
     return removeWireToAtIndex(index);
 }
 
-void FPObject::outputHotSpotLayout(ostream& o, double startX, double startY) {
-    string uname = (printNames) ? getUniqueName() : " ";
+void FPObject::freeze(FPFlatLayout& flat, double startX, double startY, int parentRecord) {
+    flat.addRecord(this, FPFlatLayout::FlatLeaf, calcX(startX), calcY(startY), parentRecord);
+}
+
+void FPObject::outputHotSpotLayout(ostream& o) {
+    FPFlatLayout flat(this);
+    flat.outputHotSpotLayout(o);
+}
 
-    o << uname << "\t" << getWidth() / 1000 << "\t" << getHeight() / 1000
-            << "\t" << calcX(startX) / 1000 << "\t" << calcY(startY) / 1000 << "\n";
+void FPObject::outputSVGLayout(ostream& o) {
+    FPFlatLayout flat(this);
+    flat.outputSVG(o);
 }
 
+void FPContainer::freezeNets(FPFlatLayout& flat) {
+    for (int i = 0; i < getNetCount(); i++) flat.addNet(getNet(i));
+}
+
+// The blocks file describes the components before they are layed out, so it comes from the tree rather than a flat layout.
 //@todo This seems to only allow 2 levels of FPObject Components
 //      We might need to add a recursive component count
 void FPContainer::outputBlockFile(ostream& o) {
-    
     int totalCount = 0;
     for (int i = 0; i < getComponentCount(); i++) {
         totalCount += getComponent(i)->getCount();
     }
-    
+
     o << "NumSoftRectangularBlocks : " << totalCount << "\n";
     o << "NumHardRectilinearBlocks : 0\n";
     o << "NumTerminals : 0\n\n";
-    
+
     for (int i = 0; i < getComponentCount(); i++) {
         FPObject * obj = getComponent(i);
-        
         for (int j = 0; j < obj->getCount(); j++) {
-            o << obj->getUniqueName() << "\t" << "softrectangular" << "\t" 
+            o << obj->getUniqueName() << "\t" << "softrectangular" << "\t"
               << obj->getArea() << "\t" << obj->getMaxAR() << "\t" << obj->getMinAR()
               << "\n";
         }
     }
-    
 }
-//@todo
+
 void FPContainer::outputNetsFile(ostream& o) {
-    
-    int totalNetsCount = 0;
-    for (int i = 0; i < getNetCount(); i++) {
-        int curNetsCount = getNet(i)->getItemCount();
-        totalNetsCount += curNetsCount * (curNetsCount - 1) / 2;
-    }
-    
-    
-    
-    o << "NumNets : " << totalNetsCount << "\n";
-    o << "NumPins : " << totalNetsCount * 2 << "\n\n"; //@todo: assume always bi-directional
-    
-    for (int i = 0; i < getNetCount(); i++) {
-        FPNet * net = getNet(i);
-        
-        for (int j = 0; j < net->getItemCount(); j++) {            
-            for (int k = j+1; k < net->getItemCount(); k++) {
-                o << "NetDegree : 2\n";
-                
-                
-                o << net->getComponent(j)->getName() << " B\n";
-                o << net->getComponent(k)->getName() << " B\n";
-            }
-            o << "\n";
-        }
-    }
-        
-    
+    FPFlatLayout flat(this);
+    flat.outputNetsFile(o);
 }
 
 // Methods for the FPWrapper class.
@@ -336,6 +450,7 @@ FPCompWrapper::~FPCompWrapper() {
 //==================================================//
 
 double FPCompWrapper::ARInRange(double AR) {
+    FPContext& ctx = currentContext();
     double maxAR = getMaxAR();
     if ((AR < 1 && maxAR > 1) || (AR > 1 && maxAR < 1)) flip();
     maxAR = getMaxAR();
@@ -349,7 +464,7 @@ double FPCompWrapper::ARInRange(double AR) {
         retval = MAX(retval, minAR);
         retval = MIN(retval, maxAR);
     }
-    if (verbose)
+    if (ctx.verbose)
         cout << "Target AR=" << AR << " minAR=" << minAR << " maxAR=" << maxAR << " returnAR=" << retval << "\n";
     return retval; //retval has to be in the range between minAR and maxAR
 }
@@ -378,6 +493,149 @@ bool FPCompWrapper::layout(FPOptimization opt, double ratio) {
     return true;
 }
 
+bool FPCompWrapper::addSignature(ostream& sig, map<FPObject *, int>& seen, bool& usesContext) {
+    if (!FPObject::addSignature(sig, seen, usesContext)) return false;
+    // The area and AR limits are all that our layout looks at.
+    // The container areas are summed from these, so they need not go in themselves.
+    sig << area << " " << minAspectRatio << " " << maxAspectRatio << ";";
+    return true;
+}
+
+FPObject * FPCompWrapper::newCopy() {
+    FPCompWrapper * copy = new FPCompWrapper(new dummyComponent(*component), minAspectRatio, maxAspectRatio, area, count);
+    copy->copyLayoutFrom(this);
+    return copy;
+}
+
+// ARInRange flips us, so the AR limits are part of the layout too.
+void FPCompWrapper::copyLayoutFrom(FPObject * from) {
+    FPObject::copyLayoutFrom(from);
+    FPCompWrapper * comp = (FPCompWrapper *) from;
+    minAspectRatio = comp->minAspectRatio;
+    maxAspectRatio = comp->maxAspectRatio;
+}
+
+// This has to agree with ARInRange.
+// That flips us so that the max AR is on the same side of 1 as the request, and then clamps.
+void FPCompWrapper::calcShapeCurve() {
+    double maxAR = getMaxAR();
+    double minAR = getMinAR();
+    if (maxAR < 1) {
+        maxAR = 1 / maxAR;
+        minAR = 1 / minAR;
+    }
+    // With the min above the max, the clamp always gives the max.
+    minAR = MIN(minAR, maxAR);
+    shape.add(MAX(minAR, 1.0), maxAR);
+    // A max AR of exactly 1 is never flipped.
+    if (maxAR > 1)         shape.add(1 / maxAR, MIN(1 / minAR, 1.0));
+    else if (minAR < 1)    shape.add(minAR, 1.0);
+}
+
+// Methods for the spatial index of placed rectangles.
+
+FPRectIndex::FPRectIndex() {
+    count = 0;
+}
+
+void FPRectIndex::clear() {
+    byWidth.clear();
+    where.clear();
+    count = 0;
+}
+
+// Every width in class k is below 2^k.
+int FPRectIndex::widthClass(double width) {
+    int exponent;
+    frexp(width, &exponent);
+    return exponent;
+}
+
+FPRectIndex::rectMap::iterator FPRectIndex::add(rect& r) {
+    count += 1;
+    return byWidth[widthClass(r.width)].insert(make_pair(r.x, r));
+}
+
+void FPRectIndex::insert(FPObject * obj) {
+    if (contains(obj)) remove(obj);
+    rect r;
+    r.x = obj->getX();
+    r.y = obj->getY();
+    r.width = obj->getWidth();
+    r.height = obj->getHeight();
+    r.obj = obj;
+    r.record = -1;
+    where[obj] = make_pair(widthClass(r.width), add(r));
+}
+
+void FPRectIndex::insert(int record, double x, double y, double width, double height) {
+    rect r;
+    r.x = x;
+    r.y = y;
+    r.width = width;
+    r.height = height;
+    r.obj = 0;
+    r.record = record;
+    add(r);
+}
+
+void FPRectIndex::remove(FPObject * obj) {
+    map<FPObject *, pair<int, rectMap::iterator> >::iterator it = where.find(obj);
+    if (it == where.end()) return;
+    map<int, rectMap>::iterator lot = byWidth.find(it->second.first);
+    lot->second.erase(it->second.second);
+    if (lot->second.empty()) byWidth.erase(lot);
+    where.erase(it);
+    count -= 1;
+}
+
+void FPRectIndex::update(FPObject * obj) {
+    insert(obj);
+}
+
+void FPRectIndex::collect(double x, double y, double width, double height, double margin, vector<rect *>& hits) {
+    double left = x - margin, right = x + width + margin;
+    double bottom = y - margin, top = y + height + margin;
+    for (map<int, rectMap>::iterator lot = byWidth.begin(); lot != byWidth.end(); lot++) {
+        // Only rectangles starting less than their widest to our left can reach us.
+        double maxWidth = ldexp(1.0, lot->first);
+        rectMap& rects = lot->second;
+        rectMap::iterator end = rects.upper_bound(right);
+        for (rectMap::iterator it = rects.lower_bound(left - maxWidth); it != end; it++) {
+            rect& r = it->second;
+            if (r.x + r.width < left || r.y > top || r.y + r.height < bottom) continue;
+            hits.push_back(&r);
+        }
+    }
+}
+
+int FPRectIndex::query(double x, double y, double width, double height, vector<FPObject *>& found, double margin) {
+    vector<rect *> hits;
+    collect(x, y, width, height, margin, hits);
+    for (unsigned int i = 0; i < hits.size(); i++) found.push_back(hits[i]->obj);
+    return hits.size();
+}
+
+int FPRectIndex::query(double x, double y, double width, double height, vector<int>& found, double margin) {
+    vector<rect *> hits;
+    collect(x, y, width, height, margin, hits);
+    for (unsigned int i = 0; i < hits.size(); i++) found.push_back(hits[i]->record);
+    return hits.size();
+}
+
+int FPRectIndex::neighbours(FPObject * obj, vector<FPObject *>& found, double margin) {
+    int start = found.size();
+    query(obj->getX(), obj->getY(), obj->getWidth(), obj->getHeight(), found, margin);
+    // Take ourselves back out.
+    for (unsigned int i = start; i < found.size(); i++) {
+        if (found[i] == obj) {
+            found.erase(found.begin() + i);
+            break;
+        }
+    }
+    return found.size() - start;
+}
+
 // Methods for the FPcontainer class.
 int FPContainer::maxItemCount = 50;
 int FPContainer::maxNetCount = 50;
@@ -386,6 +644,8 @@ int FPContainer::maxNetCount = 50;
 
 FPContainer::FPContainer() {
     itemCount = 0;
+    netCount = 0;
+    totalNetsLength = 0.0;
     items = new FPObject*[maxItemCount];
     nets = new FPNet*[maxNetCount];
     count = 1;
@@ -405,6 +665,7 @@ FPContainer::~FPContainer() {
         if (newCount == 0) delete item;
     }
     delete [] items;
+    delete [] nets;
 }
 
 // To properly handle refCount, we will only allow one method to actually add (or remove) items from the item list.
@@ -417,6 +678,7 @@ void FPContainer::addComponentAtIndex(FPObject * comp, int index) {
     items[index] = comp;
     itemCount += 1;
     comp->incRefCount();
+    shapeValid = false;
 }
 
 FPObject * FPContainer::removeComponentAtIndex(int index) {
@@ -429,12 +691,17 @@ FPObject * FPContainer::removeComponentAtIndex(int index) {
     // So, if the refCount is now zero, don't handle it here.
     // If the caller doesn't put it somewhere else, they will have to delete it themselves.
     comp->decRefCount();
+    shapeValid = false;
     return comp;
 }
 
+// This is used to wrap a component in a grid, which can take on the same shapes.
+// So our shape curve is still good.
 void FPContainer::replaceComponent(FPObject * comp, int index) {
+    bool valid = shapeValid;
     removeComponentAtIndex(index);
     addComponentAtIndex(comp, index);
+    shapeValid = valid;
 }
 
 void FPContainer::addComponent(FPObject * comp) {
@@ -586,14 +853,177 @@ double FPContainer::totalArea() {
     return area;
 }
 
+bool FPContainer::layout(FPOptimization opt, double targetAR) {
+    FPContext& ctx = currentContext();
+    // Whether legalization failed is kept for each subtree, so that the container we are in can give up as soon as we do.
+    // Something left over from an unrelated layout must not count against us.
+    bool failedBefore = ctx.legalizeFailed;
+    ctx.legalizeFailed = false;
+    bool result = ctx.layoutCaching ? layoutCached(opt, targetAR) : layoutComponents(opt, targetAR);
+    ctx.legalizeFailed = ctx.legalizeFailed || failedBefore;
+    return result;
+}
+
+// Many floorplans have identical subtrees, and the geographic layout splits things into identical halves.
+// So before doing a layout, we look for one already done on a subtree with the same signature.
+// If there is one, we just take on its result rather than working it out again.
+// Otherwise, we do the layout, and keep a private copy of the result for next time.
+// The signature covers everything the layout looks at, so taking on the result gives the same layout
+//    that doing the work would have.
+bool FPContainer::layoutCached(FPOptimization opt, double targetAR) {
+    FPContext& ctx = currentContext();
+
+    // Doubles go in exactly, so only an identical layout can match.
+    ostringstream sig;
+    sig << hexfloat;
+    map<FPObject *, int> seen;
+    bool usesContext = false;
+    addSignature(sig, seen, usesContext);
+    sig << "|" << opt << " " << targetAR << " " << ctx.legalizing << ctx.changeArea << ctx.topBottomInversion << ctx.checkOverlap << ctx.wiring;
+    if (usesContext) sig << " " << ctx.rightMark << ctx.topMark << " " << ctx.expandHeight << " " << ctx.expandWidth;
+    string key = sig.str();
+
+    // Our objects, in the order they went into the signature.
+    vector<FPObject *> order(seen.size());
+    for (map<FPObject *, int>::iterator it = seen.begin(); it != seen.end(); it++) order[it->second] = it->first;
+
+    FPCachedLayout * cached = ctx.layoutCache.find(key);
+    if (cached) {
+        // Our objects take the place of the ones that were there before, so nets and the like still find them.
+        map<FPObject *, FPObject *> targets;
+        map<FPObject *, bool> done;
+        for (unsigned int i = 0; i < order.size(); i++) {
+            if (cached->originals[i]) targets[cached->originals[i]] = order[i];
+        }
+        vector<FPObject *> replaced;
+        stampLayout(cached->root, targets, done, replaced);
+        // Whatever did not go back in anywhere is left over from an earlier layout, and nothing else refers to it.
+        // Find all of them before deleting any, as deleting one can take the count of another to zero.
+        vector<FPObject *> unused;
+        for (unsigned int i = 0; i < replaced.size(); i++) {
+            FPObject * item = replaced[i];
+            if (item->getRefCount() == 0 && find(unused.begin(), unused.end(), item) == unused.end()) unused.push_back(item);
+        }
+        for (unsigned int i = 0; i < unused.size(); i++) delete unused[i];
+        if (usesContext) {
+            ctx.rightMark = cached->rightMark;
+            ctx.topMark = cached->topMark;
+            ctx.expandHeight = cached->expandHeight;
+            ctx.expandWidth = cached->expandWidth;
+        }
+        ctx.legalizeFailed = cached->legalizeFailed;
+        ctx.layoutCacheHits += 1;
+        if (ctx.verbose) cout << "Reusing the layout of an identical " << name << " at AR=" << targetAR << "\n";
+        return cached->result;
+    }
+
+    ctx.layoutCacheMisses += 1;
+    bool result = layoutComponents(opt, targetAR);
+
+    FPCachedLayout * entry = new FPCachedLayout();
+    map<FPObject *, FPObject *> copies;
+    map<FPObject *, bool> done;
+    vector<FPObject *> replaced;
+    entry->root = stampLayout(this, copies, done, replaced);
+    for (unsigned int i = 0; i < order.size(); i++) {
+        map<FPObject *, FPObject *>::iterator it = copies.find(order[i]);
+        entry->originals.push_back((it == copies.end()) ? 0 : it->second);
+    }
+    entry->result = result;
+    entry->rightMark = ctx.rightMark;
+    entry->topMark = ctx.topMark;
+    entry->expandHeight = ctx.expandHeight;
+    entry->expandWidth = ctx.expandWidth;
+    entry->legalizeFailed = ctx.legalizeFailed;
+    ctx.layoutCache.store(key, entry);
+    return result;
+}
+
+FPObject * FPContainer::stampLayout(FPObject * from, map<FPObject *, FPObject *>& targets, map<FPObject *, bool>& done,
+                                    vector<FPObject *>& replaced) {
+    if (done.find(from) != done.end()) return targets[from];
+    done[from] = true;
+
+    FPObject * to;
+    map<FPObject *, FPObject *>::iterator it = targets.find(from);
+    if (it != targets.end()) {
+        to = it->second;
+        to->copyLayoutFrom(from);
+    } else {
+        to = from->newCopy();
+        targets[from] = to;
+    }
+
+    // Replace whatever is inside us with the stamped copies of what is inside from.
+    FPContainer * fromCont = dynamic_cast<FPContainer *>(from);
+    if (fromCont) {
+        FPContainer * toCont = (FPContainer *) to;
+        while (toCont->itemCount > 0) replaced.push_back(toCont->removeComponentAtIndex(toCont->itemCount - 1));
+        for (int i = 0; i < fromCont->itemCount; i++) {
+            FPObject * item = stampLayout(fromCont->items[i], targets, done, replaced);
+            toCont->addComponentAtIndex(item, toCont->itemCount);
+        }
+    }
+    return to;
+}
+
+bool FPContainer::addSignature(ostream& sig, map<FPObject *, int>& seen, bool& usesContext) {
+    if (!FPObject::addSignature(sig, seen, usesContext)) return false;
+    sig << "(";
+    for (int i = 0; i < itemCount; i++) items[i]->addSignature(sig, seen, usesContext);
+    sig << ")";
+    return true;
+}
+
+// Mirroring only matters for output, so it is not part of the signature, and our own is kept.
+void FPContainer::copyLayoutFrom(FPObject * from) {
+    FPObject::copyLayoutFrom(from);
+}
+
 // Methods for the GridLayout class.
 
 gridLayout::gridLayout() : FPContainer() {
     type = Grid;
     name = Type2Name(type);
+    xCount = 0;
+    yCount = 0;
 }
 
-bool gridLayout::layout(FPOptimization opt, double targetAR) {
+// Every way of factoring the count gives a grid that can take on the shapes of the component,
+//    stretched by the grid's own ratio.
+static void gridShapeCurve(FPObject * obj, FPShapeCurve& curve) {
+    int total = obj->getCount();
+    FPShapeCurve& compCurve = obj->getShapeCurve();
+    vector<int> divs;
+    getDivisors(total, divs);
+    for (unsigned int i = 0; i < divs.size(); i++) {
+        int xc = divs[i];
+        curve.addScaled(compCurve, ((double) xc) / (total / xc));
+    }
+}
+
+void gridLayout::calcShapeCurve() {
+    if (getComponentCount() != 1) FPObject::calcShapeCurve();
+    else                          gridShapeCurve(getComponent(0), shape);
+}
+
+FPObject * gridLayout::newCopy() {
+    gridLayout * copy = new gridLayout();
+    copy->xMirror = xMirror;
+    copy->yMirror = yMirror;
+    copy->copyLayoutFrom(this);
+    return copy;
+}
+
+void gridLayout::copyLayoutFrom(FPObject * from) {
+    FPContainer::copyLayoutFrom(from);
+    gridLayout * grid = (gridLayout *) from;
+    xCount = grid->xCount;
+    yCount = grid->yCount;
+}
+
+bool gridLayout::layoutComponents(FPOptimization opt, double targetAR) {
+    FPContext& ctx = currentContext();
     // We assume that a grid is a repeating unit of a single object.
     // However, that object can be either a leaf component or a container.
     if (getComponentCount() != 1) {
@@ -603,7 +1033,7 @@ bool gridLayout::layout(FPOptimization opt, double targetAR) {
     double tarea = totalArea();
     double theight = sqrt(tarea / targetAR);
     double twidth = tarea / theight;
-    if (verbose)
+    if (ctx.verbose)
         cout << "Begin Grid Layout, TargetAR=" << targetAR << " My area=" << tarea << " Implied W=" << twidth << " H=" << theight << "\n";
 
     FPObject * obj = getComponent(0);
@@ -612,12 +1042,33 @@ bool gridLayout::layout(FPOptimization opt, double targetAR) {
     // Calculate the grid size closest to the target AR.
     xCount = balanceFactors(total, targetAR);
     yCount = total / xCount;
+
+    // If the component can not take on the shape that grid needs, see if some other grid does better.
+    FPShapeCurve& compCurve = obj->getShapeCurve();
+    double bestDistance = compCurve.distance(targetAR * yCount / xCount);
+    if (bestDistance > 1) {
+        int bestX = xCount;
+        vector<int> divs;
+        getDivisors(total, divs);
+        for (unsigned int i = 0; i < divs.size(); i++) {
+            int xc = divs[i];
+            double dist = compCurve.distance(targetAR * (total / xc) / xc);
+            if (dist < bestDistance) {
+                bestDistance = dist;
+                bestX = xc;
+            }
+        }
+        if (ctx.verbose && bestX != xCount)
+            cout << "In Grid Layout, component can not take on AR=" << targetAR * yCount / xCount << ", using xCount=" << bestX << " instead\n";
+        xCount = bestX;
+        yCount = total / xCount;
+    }
     // We want the gridRatio to express the actual width to height.
     double gridRatio = ((double) xCount) / yCount;
     // Now see what we want as the component ratio.
     double ratio = targetAR / gridRatio;
 
-    if (verbose) {
+    if (ctx.verbose) {
         cout << "In Grid Layout, xCount=" << xCount << " yCount=" << yCount << "\n";
         cout << "In Grid Layout, Asking my inferior for AR=" << ratio << "\n";
     }
@@ -634,41 +1085,35 @@ bool gridLayout::layout(FPOptimization opt, double targetAR) {
     width = compWidth * xCount;
     height = compHeight * yCount;
     area = width * height;
-    if (verbose)
+    if (ctx.verbose)
         cout << "At End Grid Layout, TargetAR=" << targetAR << " actualAR=" << width / height << "\n";
 
-    if (legalizing) return isGoodAR;
+    if (ctx.legalizing) return isGoodAR;
     else            return true;
 }
 
-void gridLayout::outputHotSpotLayout(ostream& o, double startX, double startY) {
+void gridLayout::freeze(FPFlatLayout& flat, double startX, double startY, int parentRecord) {
     if (getComponentCount() != 1) {
         cerr << "Attempt to output a grid with other than one component.\n";
         return;
     }
 
     double compWidth, compHeight;
-    string compName;
     FPObject * obj = getComponent(0);
     compWidth = obj->getWidth();
     compHeight = obj->getHeight();
-    compName = obj->getName();
-
-    int compCount = xCount*yCount;
-    string GridName = getUniqueName();
-    o << "# Start of " << GridName << " Layout.  There are " << compCount << " components in a " << xCount << " by " << yCount << " grid.\n";
-    o << "# Total Grid Stats: X=" << calcX(startX) << " Y=" << calcY(startY) << " W=" << width
-            << "mm H=" << height << "mm Area=" << area << "mm^2\n";
-    int compNum = 1;
+
+    int record = flat.addRecord(this, FPFlatLayout::FlatGrid, calcX(startX), calcY(startY), parentRecord);
+    flat.xCount[record] = xCount;
+    flat.yCount[record] = yCount;
     for (int i = 0; i < yCount; i++) {
         double cy = (i * compHeight) + y + startY;
         for (int j = 0; j < xCount; j++) {
             double cx = (j * compWidth) + x + startX;
-            obj->outputHotSpotLayout(o, cx, cy);
-            compNum += 1;
+            obj->freeze(flat, cx, cy, record);
         }
     }
-    o << "# End of " << GridName << " Layout.\n";
+    flat.closeRecord(record);
 }
 
 // Methods for Baglayout Class
@@ -679,7 +1124,144 @@ bagLayout::bagLayout() : FPContainer() {
     locked = false;
 }
 
-bool bagLayout::layout(FPOptimization opt, double targetAR) {
+// A bag cuts each component off the remaining space in turn.
+// The component either takes all the remaining height, and eats into the width,
+//    or takes all the remaining width, and eats into the height.
+// Normally we cut across the longer side, but the last component gets whatever is left.
+// Returns true for the first, and the AR the component needs to be in AR.
+static bool bagDirection(double remWidth, double remHeight, double compArea, bool last, bool switching, FPShapeCurve& curve, double& AR) {
+    bool alongWidth = (remWidth > remHeight || last);
+    double widthAR = (compArea / remHeight) / remHeight;
+    double heightAR = remWidth / (compArea / remWidth);
+    AR = alongWidth ? widthAR : heightAR;
+    // If the component can not take on that shape, but can cut the other way, maybe do that.
+    if (switching && !last && !curve.contains(AR)) {
+        double otherAR = alongWidth ? heightAR : widthAR;
+        if (curve.contains(otherAR)) {
+            alongWidth = !alongWidth;
+            AR = otherAR;
+        }
+    }
+    return alongWidth;
+}
+
+// See if every component would get a shape it can take on if we layed out at the target AR.
+// The components are in layout order.
+// Switching directions only helps if it is done for the whole bag, as it leaves different space for the rest.
+static bool bagFits(double targetAR, double area, vector<double>& compAreas, vector<FPShapeCurve>& curves, bool switching) {
+    double remHeight = sqrt(area / targetAR);
+    double remWidth = area / remHeight;
+    int count = compAreas.size();
+    for (int i = 0; i < count; i++) {
+        double AR;
+        bool alongWidth = bagDirection(remWidth, remHeight, compAreas[i], i == count - 1, switching, curves[i], AR);
+        if (!curves[i].contains(AR)) return false;
+        if (alongWidth) remWidth -= compAreas[i] / remHeight;
+        else            remHeight -= compAreas[i] / remWidth;
+    }
+    return true;
+}
+
+// Get the areas and shape curves of our components, in the order sortByArea will put them.
+void bagLayout::componentShapes(vector<double>& compAreas, vector<FPShapeCurve>& curves) {
+    int count = getComponentCount();
+    vector<FPObject *> order;
+    for (int i = 0; i < count; i++) order.push_back(getComponent(i));
+    for (int i = 0; i < count; i++) {
+        int maxIndex = i;
+        for (int j = i + 1; j < count; j++) {
+            if (order[j]->getArea() * order[j]->getCount() > order[maxIndex]->getArea() * order[maxIndex]->getCount()) maxIndex = j;
+        }
+        swap(order[i], order[maxIndex]);
+    }
+    compAreas.assign(count, 0.0);
+    curves.assign(count, FPShapeCurve());
+    for (int i = 0; i < count; i++) {
+        compAreas[i] = order[i]->totalArea();
+        // Anything with a count will be put in a grid.
+        if (order[i]->getCount() > 1) gridShapeCurve(order[i], curves[i]);
+        else                          curves[i] = order[i]->getShapeCurve();
+    }
+}
+
+static bool bagFits(double targetAR, double area, vector<double>& compAreas, vector<FPShapeCurve>& curves) {
+    return bagFits(targetAR, area, compAreas, curves, false) || bagFits(targetAR, area, compAreas, curves, true);
+}
+
+// There is no closed form for what a bag can do, so we try it at a spread of ARs,
+//    and then narrow down the edges of each run that fits.
+void bagLayout::calcShapeCurve() {
+    // A fixed layout can be stretched to anything.
+    if (locked || getComponentCount() == 0) {
+        FPObject::calcShapeCurve();
+        return;
+    }
+
+    vector<double> compAreas;
+    vector<FPShapeCurve> curves;
+    componentShapes(compAreas, curves);
+    double area = 0;
+    for (unsigned int i = 0; i < compAreas.size(); i++) area += compAreas[i];
+
+    const int    samples = 129;
+    const double lowest = 1.0 / 32;
+    const double step = pow(32.0 * 32.0, 1.0 / (samples - 1));
+    double runStart = 0;
+    double lastAR = 0;
+    bool lastFits = false;
+    for (int i = 0; i < samples; i++) {
+        double AR = lowest * pow(step, i);
+        bool fits = bagFits(AR, area, compAreas, curves);
+        if (fits != lastFits && i > 0) {
+            // Find the edge between the two samples.
+            double in = fits ? AR : lastAR;
+            double out = fits ? lastAR : AR;
+            for (int j = 0; j < 20; j++) {
+                double mid = sqrt(in * out);
+                if (bagFits(mid, area, compAreas, curves)) in = mid;
+                else                                       out = mid;
+            }
+            if (fits) runStart = in;
+            else      shape.add(runStart, in);
+        }
+        // A run at either end is assumed to carry on.
+        if (fits && i == 0) runStart = 0;
+        if (fits && i == samples - 1) shape.add(runStart, HUGE_VAL);
+        lastFits = fits;
+        lastAR = AR;
+    }
+}
+
+bool bagLayout::addSignature(ostream& sig, map<FPObject *, int>& seen, bool& usesContext) {
+    if (!FPContainer::addSignature(sig, seen, usesContext)) return false;
+    sig << locked << ";";
+    // A locked bag keeps what it has, and a fixed layout stretches it, so here the sizes and places do matter.
+    if (locked) {
+        sig << width << " " << height << "[";
+        for (int i = 0; i < getComponentCount(); i++) {
+            FPObject * item = getComponent(i);
+            sig << item->getX() << " " << item->getY() << " " << item->getWidth() << " " << item->getHeight() << ";";
+        }
+        sig << "]";
+    }
+    return true;
+}
+
+FPObject * bagLayout::newCopy() {
+    bagLayout * copy = new bagLayout();
+    copy->xMirror = xMirror;
+    copy->yMirror = yMirror;
+    copy->copyLayoutFrom(this);
+    return copy;
+}
+
+void bagLayout::copyLayoutFrom(FPObject * from) {
+    FPContainer::copyLayoutFrom(from);
+    locked = ((bagLayout *) from)->locked;
+}
+
+bool bagLayout::layoutComponents(FPOptimization opt, double targetAR) {
+    FPContext& ctx = currentContext();
     // If we are locked, don't layout.
     if (locked) return true;
 
@@ -690,11 +1272,18 @@ bool bagLayout::layout(FPOptimization opt, double targetAR) {
     double nextX = 0;
     double nextY = 0;
 
-    if (verbose) {
+    if (ctx.verbose) {
         cout << "In BagLayout, Area=" << area << " Width= " << remWidth << " Height="
                 << remHeight << " Target AR=" << targetAR << "\n";
     }
 
+    // Only cut components the other way if that lets all of them have the shape they need.
+    vector<double> compAreas;
+    vector<FPShapeCurve> curves;
+    componentShapes(compAreas, curves);
+    bool switching = !bagFits(targetAR, area, compAreas, curves, false) && bagFits(targetAR, area, compAreas, curves, true);
+    if (ctx.verbose && switching) cout << "In BagLayout, cutting components the other way to keep their shapes\n";
+
     // Sort the components, placing them in decreasing order of size.
     sortByArea();
     int itemCount = getComponentCount();
@@ -702,11 +1291,6 @@ bool bagLayout::layout(FPOptimization opt, double targetAR) {
     for (int i = 0; i < itemCount; i++) {
         FPObject * comp = getComponent(i);
         double compArea = comp->totalArea();
-
-        // Take the largest component, place it in the min dimension.
-        // Except for the last component which gets places in the max dimension.
-        // First calculate the AR, and the rest fill follow.
-        double AR = (remWidth > remHeight || i == itemCount - 1) ? (compArea / remHeight) / remHeight : remWidth / (compArea / remWidth);
         if (comp->getCount() > 1) {
             // We have more than one component of the same type, so let the grid layout do the work.
             gridLayout * GL = new gridLayout();
@@ -714,6 +1298,12 @@ bool bagLayout::layout(FPOptimization opt, double targetAR) {
             replaceComponent(GL, i);
             comp = GL;
         }
+
+        // Take the largest component, place it in the min dimension.
+        // Except for the last component which gets places in the max dimension.
+        // First calculate the AR, and the rest fill follow.
+        double AR;
+        bool alongWidth = bagDirection(remWidth, remHeight, compArea, i == itemCount - 1, switching, comp->getShapeCurve(), AR);
         isGoodAR = comp->layout(AspectRatio, AR);
         
         // Now we have the final component, we can set the location.
@@ -731,7 +1321,7 @@ bool bagLayout::layout(FPOptimization opt, double targetAR) {
         }
         */
         
-        if (remWidth > remHeight || i == itemCount - 1) {
+        if (alongWidth) {
             double compWidth = comp->getWidth();            
             remWidth = remWidth - compWidth;// + diffWidth;
             nextX += compWidth;
@@ -741,18 +1331,18 @@ bool bagLayout::layout(FPOptimization opt, double targetAR) {
             nextY += compHeight;
         }
 
-        if (verbose)
+        if (ctx.verbose)
             cout << " remWidth=" << remWidth << " remHeight=" << remHeight << " AR=" << AR << "\n";
     }
 
     recalcSize();
 
-    if (verbose) {
+    if (ctx.verbose) {
         cout << "Total Container Width=" << width << " Height=" << height << " Area="
                 << width * height << " AR=" << width / height << "\n";
     }
     
-    if (legalizing) return isGoodAR;
+    if (ctx.legalizing) return isGoodAR;
     else            return true;
 }
 
@@ -768,21 +1358,16 @@ void bagLayout::recalcSize() {
     area = width * height;
 }
 
-void bagLayout::outputHotSpotLayout(ostream& o, double startX, double startY) {
+void bagLayout::freeze(FPFlatLayout& flat, double startX, double startY, int parentRecord) {
     pushMirrorContext(startX, startY);
-    int itemCount = getComponentCount();
-    string groupName;
-    if (itemCount != 1) {
-        groupName = getUniqueName();
-        o << "# Start of " << groupName << " layout.\n";
-        o << "# Total Group Stats: X=" << calcX(startX) << " Y=" << calcY(startY) << " W=" << width
-                << "mm H=" << height << "mm Area=" << area << "mm^2\n";
-    }
+    // A bag of one thing does not show up in the output.
+    FPFlatLayout::RecordKind kind = (getComponentCount() != 1) ? FPFlatLayout::FlatGroup : FPFlatLayout::FlatQuiet;
+    int record = flat.addRecord(this, kind, calcX(startX), calcY(startY), parentRecord);
     for (int i = 0; i < getComponentCount(); i++) {
         FPObject * obj = getComponent(i);
-        obj->outputHotSpotLayout(o, x + startX, y + startY);
+        obj->freeze(flat, x + startX, y + startY, record);
     }
-    if (itemCount != 1) o << "# End of " << groupName << " Layout.\n";
+    flat.closeRecord(record);
     popMirrorContext();
 }
 
@@ -858,7 +1443,15 @@ fixedLayout::fixedLayout(const char * filename, double scalingFactor) : bagLayou
     recalcSize();
 }
 
-bool fixedLayout::layout(FPOptimization opt, double targetAR) {
+FPObject * fixedLayout::newCopy() {
+    fixedLayout * copy = new fixedLayout();
+    copy->xMirror = xMirror;
+    copy->yMirror = yMirror;
+    copy->copyLayoutFrom(this);
+    return copy;
+}
+
+bool fixedLayout::layoutComponents(FPOptimization opt, double targetAR) {
     // Compare targetAR to our originalAR to calculate x and y scaling factors.
     double currentAR = width / height;
     double xFactor = sqrt(targetAR / currentAR);
@@ -917,7 +1510,22 @@ FPObject * geogLayout::addComponentCluster(string name, int count, double area,
     return comp;
 }
 
-bool geogLayout::layout(FPOptimization opt, double targetAR) {
+// The geographic layout also works from the legalization state in the context.
+bool geogLayout::addSignature(ostream& sig, map<FPObject *, int>& seen, bool& usesContext) {
+    usesContext = true;
+    return FPContainer::addSignature(sig, seen, usesContext);
+}
+
+FPObject * geogLayout::newCopy() {
+    geogLayout * copy = new geogLayout();
+    copy->xMirror = xMirror;
+    copy->yMirror = yMirror;
+    copy->copyLayoutFrom(this);
+    return copy;
+}
+
+bool geogLayout::layoutComponents(FPOptimization opt, double targetAR) {
+    FPContext& ctx = currentContext();
     // All this routine does is set up some data structures,
     //   and then call the helper to recursively do the layout work.
     // We will keep track of containers we make in a "stack".
@@ -937,7 +1545,7 @@ bool geogLayout::layout(FPOptimization opt, double targetAR) {
     for (int i = 0; i < itemCount; i++) backupItems[i] = getComponent(i);
 
     // Create a counter to exit loop
-    bool retval = true;
+    LayoutStatus status = LayoutDone;
     int retryCount = 0;
 
     do {
@@ -946,21 +1554,44 @@ bool geogLayout::layout(FPOptimization opt, double targetAR) {
         double remHeight = sqrt(area / targetAR);
         double remWidth = area / remHeight;
         
-        if (checkOverlap && legalizing) {
-            remHeight += expandHeight;
-            remWidth += expandWidth;
+        if (ctx.checkOverlap && ctx.legalizing) {
+            remHeight += ctx.expandHeight;
+            remWidth += ctx.expandWidth;
             area = remHeight * remWidth;
         }
 
-        if (verbose)
+        if (ctx.verbose)
             cout << "In geogLayout.  A=" << area << " W=" << remWidth << " H=" << remHeight << "\n";
 
         // Now do the real work.
-        try {
-            retval = layoutHelper(remWidth, remHeight, 0, 0, layoutStack, 0, centerItems, 0);
-        } catch (OverlapException& e) { //Triggered if components overlap
-            if (verbose) cout << e.what() << endl;
-            
+        // Most overlaps are repaired in place by the helper, so we only come around again when that fails.
+        repairCount = 0;
+        repairTime = 0;
+        repairWidth = 0;
+        repairHeight = 0;
+        placed.clear();
+        chrono::steady_clock::time_point passStart = chrono::steady_clock::now();
+        status = layoutHelper(remWidth, remHeight, 0, 0, layoutStack, 0, centerItems, 0);
+        if (status == LayoutDone && ctx.checkOverlap && unitsOverlap(layoutStack, maxArraySize)) {
+            if (ctx.verbose) cout << "Units still overlap once placed\n";
+            status = LayoutFailed;
+        }
+        double passTime = secondsSince(passStart);
+
+        // Each repair would have cost us a full pass without the repairs in it.
+        // A pass that still failed saved nothing, though, and a short pass can take less time than its repairs.
+        ctx.legalizeRepairs += repairCount;
+        ctx.legalizeRepairTime += repairTime;
+        if (repairCount > 0 && status == LayoutDone) ctx.legalizeSavedTime += MAX(0.0, repairCount * (passTime - repairTime) - repairTime);
+
+        if (status != LayoutDone) {
+            if (ctx.verbose) {
+                if      (status == LayoutOverlap)   cout << "Components overlapped\n";
+                else if (status == LayoutNeedsArea) cout << "Components need more area for layout\n";
+                else                                cout << "A nested layout could not be legalized\n";
+            }
+            ctx.legalizeRestarts += 1;
+
             //Clean up erroneous layout components
             for (int i = 0; i < maxArraySize; i++) layoutStack[i] = 0;
             for (int i = 0; i < maxItemCount; i++) centerItems[i] = 0;
@@ -969,50 +1600,48 @@ bool geogLayout::layout(FPOptimization opt, double targetAR) {
             for (int i = getComponentCount(); i > 0; i--) removeComponent(0);
             for (int i = itemCount; i > 0; i--) {
                 GeographyHint compHint = backupItems[i-1]->getHint();
-                if (compHint == LeftRight || compHint == TopBottom || compHint == LeftRightMirror || compHint == TopBottomMirror || compHint == LeftRight180 || compHint == TopBottom180) {                  
+                if (status == LayoutOverlap && (compHint == LeftRight || compHint == TopBottom || compHint == LeftRightMirror || compHint == TopBottomMirror || compHint == LeftRight180 || compHint == TopBottom180)) {
                     if (backupItems[i-1]->getState()) backupItems[i-1]->setCount(2*backupItems[i-1]->getCount());
                 }
                 addComponentToFront(backupItems[i-1]);
             }
             
             //Reset legalizing helpers
-            rightMark = true;
-            topMark = true;
-            retval = false;            
-            
-            //Method 1: Sort by decreasing area
-            //sortByArea();
-            //checkOverlap = false;
-            
-        } catch (AreaException& e) { //Triggered if fixed area is desired
-            if (verbose) cout << e.what() << endl;
-            
-            for (int i = 0; i < maxArraySize; i++) layoutStack[i] = 0;
-            for (int i = 0; i < maxItemCount; i++) centerItems[i] = 0;
-            for (int i = getComponentCount(); i > 0; i--) removeComponent(0);
-            for (int i = itemCount; i > 0; i--) addComponentToFront(backupItems[i-1]);
-            
-            //Reset legalizing helpers
-            rightMark = true;
-            topMark = true;
-            retval = false;
-            
+            ctx.rightMark = true;
+            ctx.topMark = true;
+
             //Re-defined targetAR based on geogHint and reset item list.
-            targetAR = newAR;
-            
+            if (status == LayoutNeedsArea) targetAR = newAR;
         }
         
         retryCount++;
   
-    } while (!retval && retryCount < maxRetry);
+    } while (status != LayoutDone && status != LayoutFailed && retryCount < maxRetry);
+    bool retval = (status == LayoutDone);
+
+    if (ctx.verbose && ctx.legalizing) cout << "retryCount = " << retryCount << " time(s) repairCount = " << repairCount << "\n";
+    ctx.expandHeight = 0; ctx.expandWidth = 0;
+
+    // On failure, our items were put back as they came, so there is nothing to install.
+    // Let whatever we are nested in know that it can not be legalized either.
+    // Only the innermost layout to fail says so, as the ones around it fail because of it.
+    if (!retval) {
+        if (!ctx.legalizeFailed) cerr << "Unable to legalize geographic layout " << name << " after " << retryCount << " tries.\n";
+        ctx.legalizeFailed = true;
+        free(centerItems);
+        free(layoutStack);
+        free(backupItems);
+        return false;
+    }
 
-    if (verbose && legalizing) cout << "retryCount = " << retryCount << " time(s)\n";
-    
     // By now, the item list should be empty.
     if (getComponentCount() != 0) {
         cerr << "Non empty item list after recursive layout in geographic layout.\n";
         cerr << "Remaining Component count=" << getComponentCount() << "\n";
         for (int i = 0; i < getComponentCount(); i++) cerr << "Component " << i << " is of type " << getComponent(i)->getName() << "\n";
+        free(centerItems);
+        free(layoutStack);
+        free(backupItems);
         return false;
     }
 
@@ -1028,23 +1657,62 @@ bool geogLayout::layout(FPOptimization opt, double targetAR) {
         height = MAX(height, comp->getY() + comp->getHeight());
     }
     area = width * height;
-    expandHeight = 0; expandWidth = 0;
     
     // Now calculate the wire length
     /*
-    if (wiring) calcNetLength(layoutStack, maxArraySize);
-    if (verbose && wiring) cout << "totalWireLength = " << getNetLength() << " mm\n";
+    if (ctx.wiring) calcNetLength(layoutStack, maxArraySize);
+    if (ctx.verbose && ctx.wiring) cout << "totalWireLength = " << getNetLength() << " mm\n";
     */
     free(centerItems);
     free(layoutStack);
     free(backupItems);
-    return retval;
+    return true;
 }
 
-bool geogLayout::layoutHelper(double remWidth, double remHeight, double curX, double curY, FPObject ** layoutStack, int curDepth, FPObject ** centerItems, int centerItemsCount) {
+// The halves of a split item share one object, so laying out the second half can change the first after it was placed.
+// The items we overlap check as we go do not see that, so once everything is placed, we look at where the units really ended up.
+// Growing does not help here, as the same halves are laid out the same way again, so the caller gives up instead.
+// A unit left without a real size, as happens when the center items are asked for an aspect ratio that is not positive, counts as overlapping too.
+bool geogLayout::unitsOverlap(FPObject ** layoutStack, int maxArraySize) {
+    double d = 0.00001; //for rounding error
+    FPRectIndex index;
+    vector<double> unitX, unitY, unitWidth, unitHeight;
+    for (int i = 0; i < maxArraySize && layoutStack[i]; i++) {
+        // The item's own place is taken into account when it is frozen.
+        FPFlatLayout flat(layoutStack[i]);
+        for (int r = 0; r < flat.size(); r++) {
+            if (flat.kind[r] != FPFlatLayout::FlatLeaf) continue;
+            if (!(flat.width[r] > 0 && flat.width[r] < HUGE_VAL && flat.height[r] > 0 && flat.height[r] < HUGE_VAL)) return true;
+            if (!(fabs(flat.x[r]) < HUGE_VAL && fabs(flat.y[r]) < HUGE_VAL)) return true;
+            int unit = unitX.size();
+            unitX.push_back(flat.x[r]);
+            unitY.push_back(flat.y[r]);
+            unitWidth.push_back(flat.width[r]);
+            unitHeight.push_back(flat.height[r]);
+            index.insert(unit, unitX[unit], unitY[unit], unitWidth[unit], unitHeight[unit]);
+        }
+    }
+
+    vector<int> near;
+    for (int a = 0; a < (int) unitX.size(); a++) {
+        near.clear();
+        index.query(unitX[a], unitY[a], unitWidth[a], unitHeight[a], near);
+        for (unsigned int j = 0; j < near.size(); j++) {
+            int b = near[j];
+            if (b <= a) continue;
+            double widthOver = MIN(unitX[a] + unitWidth[a], unitX[b] + unitWidth[b]) - MAX(unitX[a], unitX[b]);
+            double heightOver = MIN(unitY[a] + unitHeight[a], unitY[b] + unitHeight[b]) - MAX(unitY[a], unitY[b]);
+            if (widthOver > d && heightOver > d) return true;
+        }
+    }
+    return false;
+}
+
+LayoutStatus geogLayout::layoutHelper(double remWidth, double remHeight, double curX, double curY, FPObject ** layoutStack, int curDepth, FPObject ** centerItems, int centerItemsCount) {
+    FPContext& ctx = currentContext();
     int itemCount = getComponentCount();
     // Check for the end of the recursion.
-    if (itemCount == 0 && centerItemsCount == 0) return true;
+    if (itemCount == 0 && centerItemsCount == 0) return LayoutDone;
 
     // Check if it time to layout the center items.
     // For now we will just stick them in a bag layout, and then use all remaining area to lay it out.
@@ -1059,11 +1727,9 @@ bool geogLayout::layoutHelper(double remWidth, double remHeight, double curX, do
             BL->addComponent(item, item->getCount() / gcd);
         }
 
-        if (verbose)
+        if (ctx.verbose)
             cout << "Laying out Center items.  Count=" << centerItemsCount << " GCD=" << gcd << "\n";
 
-        // Use all remaining area.
-        double targetAR = remWidth / remHeight;
         FPContainer * FPLayout = BL;
         if (gcd > 1) {
             // Put the bag container into a grid container and lay it out.
@@ -1073,17 +1739,44 @@ bool geogLayout::layoutHelper(double remWidth, double remHeight, double curX, do
         }
         // Not sure if we need to set the hint, but when I missed this for the grid below, it was a bug.
         FPLayout->setHint(Center);
-        FPLayout->layout(AspectRatio, targetAR);
-        if (verbose)
-            cout << "Laying out Center item(s).  Current x and y are(" << curX << "," << curY << ")\n";
-        FPLayout->setLocation(curX, curY);
-        // Put the layout on the stack.
-        // DO we really need to do this????
-        layoutStack[curDepth] = FPLayout;
-        
-        if (legalizing && checkOverlap) detectOverlap(layoutStack, curDepth, FPLayout);
-        
-        return true;
+        double rightEdge = curX + remWidth;
+        double topEdge = curY + remHeight;
+        chrono::steady_clock::time_point repairStart;
+        for (int attempt = 0; ; attempt++) {
+            // Use all remaining area.
+            double targetAR = remWidth / remHeight;
+            FPLayout->layout(AspectRatio, targetAR);
+            if (ctx.legalizeFailed) return LayoutFailed;
+            if (ctx.verbose)
+                cout << "Laying out Center item(s).  Current x and y are(" << curX << "," << curY << ")\n";
+            FPLayout->setLocation(curX, curY);
+            // Put the layout on the stack.
+            // DO we really need to do this????
+            layoutStack[curDepth] = FPLayout;
+
+            if (!ctx.legalizing || !ctx.checkOverlap) break;
+            double growWidth, growHeight;
+            bool overlap = detectOverlap(layoutStack, curDepth, FPLayout, growWidth, growHeight);
+            if (attempt > 0) repairTime += secondsSince(repairStart);
+            if (!overlap) {
+                // Each try that got us here would have been a full relayout.
+                repairCount += attempt;
+                break;
+            }
+            repairStart = chrono::steady_clock::now();
+            // The bag keeps its area whatever shape we ask for.
+            // So if the remaining area grows to take in all of it, laying it out again gives it the same shape, and it fits.
+            growWidth = MAX(0.0, FPLayout->getWidth() - remWidth);
+            growHeight = MAX(0.0, FPLayout->getHeight() - remHeight);
+            if (!repairOverlap(layoutStack, curDepth, FPLayout, rightEdge, topEdge, growWidth, growHeight, attempt)) return LayoutOverlap;
+            remWidth += growWidth;
+            remHeight += growHeight;
+            rightEdge += growWidth;
+            topEdge += growHeight;
+        }
+        placed.insert(FPLayout);
+
+        return LayoutDone;
     }
 
     // Start by pealing off the first component cluster.
@@ -1095,7 +1788,7 @@ bool geogLayout::layoutHelper(double remWidth, double remHeight, double curX, do
     if (compHint == Center) {
         centerItems[centerItemsCount] = comp;
         centerItemsCount += 1;
-        layoutHelper(remWidth, remHeight, curX, curY, layoutStack, curDepth, centerItems, centerItemsCount);
+        return layoutHelper(remWidth, remHeight, curX, curY, layoutStack, curDepth, centerItems, centerItemsCount);
     }
 
     if (compHint == LeftRight || compHint == TopBottom || compHint == LeftRightMirror || compHint == TopBottomMirror || compHint == LeftRight180 || compHint == TopBottom180) {
@@ -1122,7 +1815,7 @@ bool geogLayout::layoutHelper(double remWidth, double remHeight, double curX, do
                 
                 //Legalization feature: Inverts Top/Bottom order to Bottom/Top to always start on Bottom or Left.
                 //                      Prevents some legalizing issues.
-                if (topBottomInversion) {
+                if (ctx.topBottomInversion) {
                     BL1->setHint(Bottom);
                     BL2->setHint(Top);
                 } else {
@@ -1142,7 +1835,7 @@ bool geogLayout::layoutHelper(double remWidth, double remHeight, double curX, do
             if (compHint == LeftRight || compHint == LeftRightMirror || compHint == LeftRight180) {
                 comp->setHint(Left);
             } else { //TopBottom and TBMirror and TB180
-                if (topBottomInversion) comp->setHint(Bottom);
+                if (ctx.topBottomInversion) comp->setHint(Bottom);
                 else                    comp->setHint(Top);
             }
         }
@@ -1157,35 +1850,9 @@ bool geogLayout::layoutHelper(double remWidth, double remHeight, double curX, do
         // TODO TODO This assumes a component has an area.  For a container, it will not have an area until it gets layed out.
         double totalArea = comp->totalArea();
         
-        // Legalizing: outOfBound is guaranteed if the component's area is greater than remaining area
-        if (legalizing) {
-            outOfBound = totalArea > remWidth*remHeight;
-        } else {
-            outOfBound = false;
-        }
-
-        if (verbose)
+        if (ctx.verbose)
             cout << "In geog, for component " << comp->getName() << " total component area=" << totalArea << "\n";
 
-        double targetWidth, targetHeight;
-        newX = curX;
-        newY = curY;
-        if (compHint == Left || compHint == Right) {
-            targetHeight = remHeight;
-            targetWidth = totalArea / targetHeight;
-        } else // if (compHint == Top || compHint == Bottom)
-        {
-            targetWidth = remWidth;
-            targetHeight = totalArea / targetWidth;
-        }
-        //if (compHint == Left) newX += targetWidth;
-        //if (compHint == Right) curX = curX + (remWidth - targetWidth);
-        //if (compHint == Top) curY = curY + (remHeight - targetHeight);
-        //if (compHint == Bottom) newY += targetHeight;
-
-        // Charles TODO: Here can be a potential spot to check the sign of newX/Y and curX/Y (cannot be negative)
-
-        double targetAR = targetWidth / targetHeight;
         FPObject * FPLayout = comp;
         if (comp->getCount() > 1) {
             gridLayout * grid = new gridLayout();
@@ -1194,96 +1861,146 @@ bool geogLayout::layoutHelper(double remWidth, double remHeight, double curX, do
             FPLayout = grid;
         }
 
+        // If the component overlaps something already placed, we will grow the remaining area and place it again.
+        // So remember where we started.
+        double startX = curX, startY = curY, startWidth = remWidth, startHeight = remHeight;
+        bool startRightMark = ctx.rightMark, startTopMark = ctx.topMark;
+        chrono::steady_clock::time_point repairStart;
+        for (int attempt = 0; ; attempt++) {
+            curX = startX;
+            curY = startY;
+            remWidth = startWidth;
+            remHeight = startHeight;
+            ctx.rightMark = startRightMark;
+            ctx.topMark = startTopMark;
+
+            // Legalizing: outOfBound is guaranteed if the component's area is greater than remaining area
+            if (ctx.legalizing) {
+                outOfBound = totalArea > remWidth*remHeight;
+            } else {
+                outOfBound = false;
+            }
 
-        // Charles Start of Add-on Feature
-        // One may choose to re-layout if the targetAR cannot be respected due to constraints.
-        isGoodAR = FPLayout->layout(AspectRatio, targetAR);
-        double diffWidth = 0; double diffHeight = 0;
-        
-        if (!isGoodAR && legalizing) {
+            double targetWidth, targetHeight;
+            newX = curX;
+            newY = curY;
             if (compHint == Left || compHint == Right) {
-                diffWidth = FPLayout->getWidth() - targetWidth;
-                double newHeight = FPLayout->getHeight();
-
-                //This getArea() returns the total area of all the components in this container.
-                newAR = getArea() / pow(newHeight, 2);
-            }
-            else //(compHint == Top || compHint == Bottom)
+                targetHeight = remHeight;
+                targetWidth = totalArea / targetHeight;
+            } else // if (compHint == Top || compHint == Bottom)
             {
-                diffHeight = FPLayout->getHeight() - targetHeight;
-                double newWidth = FPLayout->getWidth();
-                newAR = pow(newWidth, 2) / getArea();
+                targetWidth = remWidth;
+                targetHeight = totalArea / targetWidth;
             }
+            //if (compHint == Left) newX += targetWidth;
+            //if (compHint == Right) curX = curX + (remWidth - targetWidth);
+            //if (compHint == Top) curY = curY + (remHeight - targetHeight);
+            //if (compHint == Bottom) newY += targetHeight;
 
-            // Skip it if we want to increase the total area without re-layout
-            if (!changeArea && legalizing) throw AreaException();
-        }
+            // Charles TODO: Here can be a potential spot to check the sign of newX/Y and curX/Y (cannot be negative)
 
-        // TODO: Need to figure out a way to deal with Left/Bottom outOfBound issues
-        // TODO: Another case to check is when we have bad AR with Left/Bottom and TopRightMarked.
-        if (compHint == Left) {
-            newX += FPLayout->getWidth();
-            remWidth -= FPLayout->getWidth();
-        }
+            double targetAR = targetWidth / targetHeight;
+
+            // Charles Start of Add-on Feature
+            // One may choose to re-layout if the targetAR cannot be respected due to constraints.
+            isGoodAR = FPLayout->layout(AspectRatio, targetAR);
+            if (ctx.legalizeFailed) return LayoutFailed;
+            double diffWidth = 0; double diffHeight = 0;
         
-        if (compHint == Bottom) {
-            newY += FPLayout->getHeight();
-            remHeight -= FPLayout->getHeight();
-        }
+            if (!isGoodAR && ctx.legalizing) {
+                if (compHint == Left || compHint == Right) {
+                    diffWidth = FPLayout->getWidth() - targetWidth;
+                    double newHeight = FPLayout->getHeight();
 
-        //Allow the component to cross the original boundary.
-        //targetWidth can be different than FPLayout->getWidth() if AR is limited by constraints.
-        //We may choose to not cross the boundary by changing the - targetWidth to - getWidth().
-        if (compHint == Right) {
-            if (rightMark && legalizing) {
-                if (!outOfBound) curX = curX + (remWidth - targetWidth);
-                //remWidth -= targetWidth;
-                remWidth = remWidth - FPLayout->getWidth() + diffWidth;
-                rightMark = false;
-            } else {
-                if (!outOfBound) curX = curX + (remWidth - FPLayout->getWidth());
+                    //This getArea() returns the total area of all the components in this container.
+                    newAR = getArea() / pow(newHeight, 2);
+                }
+                else //(compHint == Top || compHint == Bottom)
+                {
+                    diffHeight = FPLayout->getHeight() - targetHeight;
+                    double newWidth = FPLayout->getWidth();
+                    newAR = pow(newWidth, 2) / getArea();
+                }
+
+                // Skip it if we want to increase the total area without re-layout
+                if (!ctx.changeArea && ctx.legalizing) return LayoutNeedsArea;
+            }
+
+            // TODO: Need to figure out a way to deal with Left/Bottom outOfBound issues
+            // TODO: Another case to check is when we have bad AR with Left/Bottom and TopRightMarked.
+            if (compHint == Left) {
+                newX += FPLayout->getWidth();
                 remWidth -= FPLayout->getWidth();
             }
+        
+            if (compHint == Bottom) {
+                newY += FPLayout->getHeight();
+                remHeight -= FPLayout->getHeight();
+            }
 
-        }
+            //Allow the component to cross the original boundary.
+            //targetWidth can be different than FPLayout->getWidth() if AR is limited by constraints.
+            //We may choose to not cross the boundary by changing the - targetWidth to - getWidth().
+            if (compHint == Right) {
+                if (ctx.rightMark && ctx.legalizing) {
+                    if (!outOfBound) curX = curX + (remWidth - targetWidth);
+                    //remWidth -= targetWidth;
+                    remWidth = remWidth - FPLayout->getWidth() + diffWidth;
+                    ctx.rightMark = false;
+                } else {
+                    if (!outOfBound) curX = curX + (remWidth - FPLayout->getWidth());
+                    remWidth -= FPLayout->getWidth();
+                }
 
-        if (compHint == Top) {
-            if (topMark && legalizing) {
-                if (!outOfBound) curY = curY + (remHeight - targetHeight);
-                //remHeight -= targetHeight; 
-                remHeight = remHeight - FPLayout->getHeight() + diffHeight; 
-                topMark = false;
-            } else {
-                if (!outOfBound) curY = curY + (remHeight - FPLayout->getHeight()); 
-                remHeight -= FPLayout->getHeight();
             }
-        }
 
-        FPLayout->setLocation(curX, curY);
-        if (wiring) FPLayout->setCenter(curX + (FPLayout->getWidth()/2), curY + (FPLayout->getHeight()/2));
-        // Put the layout on the stack.
-        layoutStack[curDepth] = FPLayout;
+            if (compHint == Top) {
+                if (ctx.topMark && ctx.legalizing) {
+                    if (!outOfBound) curY = curY + (remHeight - targetHeight);
+                    //remHeight -= targetHeight; 
+                    remHeight = remHeight - FPLayout->getHeight() + diffHeight; 
+                    ctx.topMark = false;
+                } else {
+                    if (!outOfBound) curY = curY + (remHeight - FPLayout->getHeight()); 
+                    remHeight -= FPLayout->getHeight();
+                }
+            }
 
-        
-        // Charles TODO: Q: Should we be able to detect overlapping components?
-        // This is where Charles thinks to add an overlapping detection.
-        // Let's start with something that's O(N^2), from the last (most recently added) layoutStack component.
-        // Compare this last component's coordinate and size to all others in the layoutStack.
-        // If overlap is detected, we have two options:
-        // 1. Re-layout in different orders
-        // 2. Look for deadspace and try to fit in (if can't find anything fit, we re-layout.
-               
-        // Overlap detection O(N^2) for now
-        if (legalizing && checkOverlap && curDepth > 0) detectOverlap(layoutStack, curDepth, FPLayout);
-        
-        try {
-            layoutHelper(remWidth, remHeight, newX, newY, layoutStack, curDepth + 1, centerItems, centerItemsCount);
-            //if (!retval) return false;
-        } catch (OverlapException e) {
-            throw e;
-        } catch (AreaException e) {
-            throw e;
+            FPLayout->setLocation(curX, curY);
+            if (ctx.wiring) FPLayout->setCenter(curX + (FPLayout->getWidth()/2), curY + (FPLayout->getHeight()/2));
+            // Put the layout on the stack.
+            layoutStack[curDepth] = FPLayout;
+
+            // Charles TODO: Q: Should we be able to detect overlapping components?
+            // This is where Charles thinks to add an overlapping detection.
+            // Let's start with something that's O(N^2), from the last (most recently added) layoutStack component.
+            // Compare this last component's coordinate and size to all others in the layoutStack.
+            // If overlap is detected, we have two options:
+            // 1. Re-layout in different orders
+            // 2. Look for deadspace and try to fit in (if can't find anything fit, we re-layout.
+            // We do the second, by making room where the component was supposed to go.
+            // Only if that fails does the whole layout start over.
+
+            // Overlap detection O(N^2) for now
+            if (!ctx.legalizing || !ctx.checkOverlap || curDepth == 0) break;
+            double growWidth, growHeight;
+            bool overlap = detectOverlap(layoutStack, curDepth, FPLayout, growWidth, growHeight);
+            if (attempt > 0) repairTime += secondsSince(repairStart);
+            if (!overlap) {
+                // Each try that got us here would have been a full relayout.
+                repairCount += attempt;
+                break;
+            }
+            repairStart = chrono::steady_clock::now();
+            growWidth = 0;
+            growHeight = 0;
+            if (!repairOverlap(layoutStack, curDepth, FPLayout, startX + startWidth, startY + startHeight, growWidth, growHeight, attempt)) return LayoutOverlap;
+            startWidth += growWidth;
+            startHeight += growHeight;
         }
+        placed.insert(FPLayout);
+
+        return layoutHelper(remWidth, remHeight, newX, newY, layoutStack, curDepth + 1, centerItems, centerItemsCount);
     } else if (compHint != Center) {
         cerr << "Hint is not any of the recognized hints.  Hint=" << compHint << "\n";
         cerr << "Component is of type " << comp->getType() << "\n";
@@ -1293,89 +2010,193 @@ bool geogLayout::layoutHelper(double remWidth, double remHeight, double curX, do
     // For now the only recourse is to try more AR flex in components and relayout.
 
 
-    return true;
+    return LayoutDone;
 }
 
-
-bool FPContainer::detectOverlap(FPObject ** layoutStack, int curDepth, FPObject * FPLayout)
+// Find out whether two placed items overlap, and by how much in each direction.
+static bool overlapAmount(FPObject * stackFPLayout, FPObject * FPLayout, double& widthOver, double& heightOver)
 {
     double x1, x2, y1, y2, h1, h2, w1, w2, d;
     x2 = FPLayout->getX();
     y2 = FPLayout->getY();
     h2 = FPLayout->getHeight();
     w2 = FPLayout->getWidth();
-    
-    for (int i = curDepth - 1; i >= 0; i--) {
-
-    // Only compare to the one before itself, O(N) now.
-    //if (curDepth > 0) {        
-        double widthOver = 0, heightOver = 0;
-        bool isHeightOverlap = false, isWidthOverlap = false;
-        FPObject * stackFPLayout = layoutStack[i]; //curDepth - 1
-
-        x1 = stackFPLayout->getX(); 
-        y1 = stackFPLayout->getY();
-        h1 = stackFPLayout->getHeight();
-        w1 = stackFPLayout->getWidth();
-        d = 0.00001; //for rounding error
-
-        if (x2 > x1 && w1 - (x2 - x1) > d) {
-            widthOver = w1 - (x2 - x1);
-            isWidthOverlap = true;
-        }               
-        if (x2 < x1 && w2 - (x1 - x2) > d) {
-            widthOver = w2 - (x1 - x2);
-            isWidthOverlap = true;
-        }
+
+    widthOver = 0;
+    heightOver = 0;
+    bool isHeightOverlap = false, isWidthOverlap = false;
+
+    x1 = stackFPLayout->getX(); 
+    y1 = stackFPLayout->getY();
+    h1 = stackFPLayout->getHeight();
+    w1 = stackFPLayout->getWidth();
+    d = 0.00001; //for rounding error
+
+    if (x2 > x1 && w1 - (x2 - x1) > d) {
+        widthOver = w1 - (x2 - x1);
+        isWidthOverlap = true;
+    }               
+    if (x2 < x1 && w2 - (x1 - x2) > d) {
+        widthOver = w2 - (x1 - x2);
+        isWidthOverlap = true;
+    }
         
-        if (x2 == x1) {
-            isWidthOverlap = true;
-            if (w2 >= w1) {
-                widthOver = w1;
-            } else {
-                widthOver = w2;
-            }
+    if (x2 == x1) {
+        isWidthOverlap = true;
+        if (w2 >= w1) {
+            widthOver = w1;
+        } else {
+            widthOver = w2;
         }
+    }
         
         
-        if (y2 > y1 && h1 - (y2 - y1) > d) {
-            heightOver = h1 - (y2 - y1);
-            isHeightOverlap = true;
+    if (y2 > y1 && h1 - (y2 - y1) > d) {
+        heightOver = h1 - (y2 - y1);
+        isHeightOverlap = true;
+    }
+    if (y2 < y1 && h2 - (y1 - y2) > d) {
+        heightOver = h2 - (y1 - y2);
+        isHeightOverlap = true;
+    }
+        
+    if (y2 == y1) {
+        isHeightOverlap = true;
+        if (h2 >= h1) {
+            heightOver = h1;
+        } else {
+            heightOver = h2;
         }
-        if (y2 < y1 && h2 - (y1 - y2) > d) {
-            heightOver = h2 - (y1 - y2);
-            isHeightOverlap = true;
+    }
+
+    return isHeightOverlap && isWidthOverlap;
+}
+
+// Make room in place for the item at curDepth, which overlaps items placed before it.
+// growWidth and growHeight come in as the least growth the caller needs, and go out as the growth made.
+// Everything already placed at or beyond the right (top) edge of the remaining area is moved out by growWidth (growHeight),
+//    so that the caller can grow the remaining area by the same amount and place the item again.
+// This avoids laying out the whole container again, which is what we used to do for every overlap.
+// If moving things would make them overlap what stays put, or we have tried too many times,
+//    nothing is moved, all the growth of this pass is added to the expansion for the next full layout, and false is returned.
+bool geogLayout::repairOverlap(FPObject ** layoutStack, int curDepth, FPObject * FPLayout, double rightEdge, double topEdge,
+                               double& growWidth, double& growHeight, int attempt) {
+    FPContext& ctx = currentContext();
+    double d = 0.00001; //for rounding error
+
+    // The overlap detection only knows how big the overlaps are.
+    // Here we also know where the remaining area is, so grow toward whatever is in the way, if we can.
+    vector<FPObject *> candidates;
+    placed.query(FPLayout->getX(), FPLayout->getY(), FPLayout->getWidth(), FPLayout->getHeight(), candidates);
+    for (unsigned int i = 0; i < candidates.size(); i++) {
+        double widthOver, heightOver;
+        FPObject * comp = candidates[i];
+        if (!overlapAmount(comp, FPLayout, widthOver, heightOver)) continue;
+        bool isRight = comp->getX() >= rightEdge - d;
+        bool isAbove = comp->getY() >= topEdge - d;
+        if      (isRight && !isAbove) growWidth = MAX(growWidth, widthOver);
+        else if (isAbove && !isRight) growHeight = MAX(growHeight, heightOver);
+        else if (widthOver > heightOver) growHeight = MAX(growHeight, heightOver);
+        else    growWidth = MAX(growWidth, widthOver);
+    }
+
+    bool repaired = false;
+    if (attempt < maxRepair) {
+        double * shiftX = new double[curDepth];
+        double * shiftY = new double[curDepth];
+        map<FPObject *, bool> moved;
+        for (int i = 0; i < curDepth; i++) {
+            FPObject * comp = layoutStack[i];
+            shiftX[i] = (growWidth > 0 && comp->getX() >= rightEdge - d) ? growWidth : 0;
+            shiftY[i] = (growHeight > 0 && comp->getY() >= topEdge - d) ? growHeight : 0;
+            if (shiftX[i] == 0 && shiftY[i] == 0) continue;
+            comp->setLocation(comp->getX() + shiftX[i], comp->getY() + shiftY[i]);
+            placed.update(comp);
+            moved[comp] = true;
         }
-        
-        if (y2 == y1) {
-            isHeightOverlap = true;
-            if (h2 >= h1) {
-                heightOver = h1;
-            } else {
-                heightOver = h2;
+
+        // Things that moved together can not overlap each other, so just check them against the rest.
+        repaired = true;
+        for (int i = 0; i < curDepth && repaired; i++) {
+            if (shiftX[i] == 0 && shiftY[i] == 0) continue;
+            FPObject * comp = layoutStack[i];
+            vector<FPObject *> near;
+            placed.neighbours(comp, near);
+            for (unsigned int j = 0; j < near.size(); j++) {
+                double widthOver, heightOver;
+                if (moved.find(near[j]) == moved.end() && overlapAmount(near[j], comp, widthOver, heightOver)) {
+                    repaired = false;
+                    break;
+                }
             }
         }
 
-        if (isHeightOverlap && isWidthOverlap) {
-            if (widthOver > heightOver) {
-                expandHeight += heightOver;                       
-            } else {
-                expandWidth += widthOver;
+        // Either keep the moves, or put everything back the way it was.
+        for (int i = 0; i < curDepth; i++) {
+            if (shiftX[i] == 0 && shiftY[i] == 0) continue;
+            FPObject * comp = layoutStack[i];
+            if (!repaired) {
+                comp->setLocation(comp->getX() - shiftX[i], comp->getY() - shiftY[i]);
+                placed.update(comp);
             }
+            else if (ctx.wiring) comp->setCenter(comp->getX() + (comp->getWidth()/2), comp->getY() + (comp->getHeight()/2));
+        }
+        delete [] shiftX;
+        delete [] shiftY;
+    }
 
-            if (verbose)
+    if (repaired) {
+        repairWidth += growWidth;
+        repairHeight += growHeight;
+        if (ctx.verbose)
+            cout << "In geog, repaired overlap for component " << FPLayout->getName()
+                 << " growWidth = " << growWidth << " growHeight = " << growHeight << "\n";
+    } else {
+        // The next pass starts from scratch, so it needs room for the repairs already made as well.
+        ctx.expandHeight += repairHeight + growHeight;
+        ctx.expandWidth += repairWidth + growWidth;
+        if (ctx.verbose)
             cout << "In geog, detected overlap for component " << FPLayout->getName() 
-                 << " expandHeight = " << expandHeight << "\n" << " expandWidth = " << expandWidth << "\n" ;
-            throw OverlapException();
+                 << " expandHeight = " << ctx.expandHeight << "\n" << " expandWidth = " << ctx.expandWidth << "\n" ;
+    }
+    return repaired;
+}
+
+
+bool FPContainer::detectOverlap(FPObject ** layoutStack, int curDepth, FPObject * FPLayout, double& growWidth, double& growHeight)
+{
+    // Only look at what is near the new layout, if the index knows what has been placed.
+    // Otherwise, fall back to comparing against the whole stack.
+    vector<FPObject *> candidates;
+    if (placed.size() == curDepth && !placed.contains(FPLayout)) {
+        placed.query(FPLayout->getX(), FPLayout->getY(), FPLayout->getWidth(), FPLayout->getHeight(), candidates);
+    } else {
+        for (int i = curDepth - 1; i >= 0; i--) candidates.push_back(layoutStack[i]);
+    }
+
+    // Rather than stopping at the first overlap, find out how much we need to grow to clear all of them at once.
+    growWidth = 0;
+    growHeight = 0;
+    bool overlap = false;
+    for (unsigned int i = 0; i < candidates.size(); i++) {
+        double widthOver, heightOver;
+        if (overlapAmount(candidates[i], FPLayout, widthOver, heightOver)) {
+            if (widthOver > heightOver) {
+                growHeight = MAX(growHeight, heightOver);
+            } else {
+                growWidth = MAX(growWidth, widthOver);
+            }
+            overlap = true;
         } 
     }
     
-    return true;
+    return overlap;
 }
 
 // @todo At the moment, this is the only way to get the net length.
 // We don't actively update netLength, call this method to refresh the actual value.
 void FPNet::calcNetLength() {    
+    FPContext& ctx = currentContext();
     double totalWireLength = 0;
     double thisWireLength = 0;
     
@@ -1385,7 +2206,7 @@ void FPNet::calcNetLength() {
         if (!comp1 || !comp2) break;
         thisWireLength = abs(comp1->getXc() - comp2->getXc()) + abs(comp1->getYc() - comp2->getYc());
         totalWireLength += thisWireLength;
-        if (verbose) cout << comp1->getUniqueName() << " is connected to " << comp2->getUniqueName()
+        if (ctx.verbose) cout << comp1->getUniqueName() << " is connected to " << comp2->getUniqueName()
                           << " from (" << comp1->getXc() << ", " << comp1->getYc() << ") to ("
                           << comp2->getXc() << ", " << comp2->getYc() << ")"
                           << " with the distance = " << thisWireLength << " mm\n";
@@ -1416,17 +2237,14 @@ void FPNet::calcNetLength() {
     */
 
 
-void geogLayout::outputHotSpotLayout(ostream& o, double startX, double startY) {
+void geogLayout::freeze(FPFlatLayout& flat, double startX, double startY, int parentRecord) {
     pushMirrorContext(startX, startY);
-    string layoutName = getUniqueName();
-    o << "# Start of " << layoutName << " Layout.\n";
-    o << "# Total Cluster Stats: X=" << calcX(startX) << " Y=" << calcY(startY) << " W=" << width
-            << "mm H=" << height << "mm Area=" << area << "mm^2\n";
+    int record = flat.addRecord(this, FPFlatLayout::FlatCluster, calcX(startX), calcY(startY), parentRecord);
     for (int i = 0; i < getComponentCount(); i++) {
         FPObject * obj = getComponent(i);
-        obj->outputHotSpotLayout(o, x + startX, y + startY);
+        obj->freeze(flat, x + startX, y + startY, record);
     }
-    o << "# End of " << layoutName << " Layout.\n";
+    flat.closeRecord(record);
     popMirrorContext();
 }
 
@@ -1443,14 +2261,11 @@ Legalize::Legalize() {
 */
 
 
-void FPContainer::calcNetLength() {
-    FPNet * net = new FPNet();
-    for (int i = 0; i < net->getMaxItemCount(); i++) {
-        net = nets[i];
-        if (!net) break;
-        net->calcNetLength();
-        totalNetsLength += net->getNetLength();        
-    }
+void FPContainer::calcNetLength(NetModel model) {
+    FPFlatLayout flat(this);
+    FPNetLength lengths(flat, model);
+    for (int i = 0; i < getNetCount(); i++) getNet(i)->setNetLength(lengths.netLength(i));
+    totalNetsLength = lengths.totalLength();
 }
 
 void FPNet::outputNetLength(ostream& o) {
@@ -1459,10 +2274,11 @@ void FPNet::outputNetLength(ostream& o) {
 // Output Helpers.
 
 ostream& outputHotSpotHeader(const char * filename) {
+    FPContext& ctx = currentContext();
     cout << "Outputing floorplan to: " << filename << "\n";
 
     // Reset the name to counts map for this output.
-    NameCounts.clear();
+    ctx.NameCounts.clear();
 
     ofstream& out = *(new ofstream(filename));
     out << "# FloorPlan output from ArchFP: UVA's Rapid Prototyping FloorPlanner.\n";
@@ -1488,10 +2304,11 @@ string getStringFromInt(int in) {
 }
 
 ostream& outputBlockFileHeader(const char * filename) {
+    FPContext& ctx = currentContext();
     cout << "Outputing .blocks file to: " << filename << "\n";
     
     // Reset the name to counts map for this output.
-    NameCounts.clear();
+    ctx.NameCounts.clear();
 
     ofstream& out = *(new ofstream(filename));
     out << "UCSC blocks  1.0\n\n";
@@ -1504,10 +2321,11 @@ void outputBlockFileFooter(ostream& o) {
 }
 
 ostream& outputNetsFileHeader(const char * filename) {
+    FPContext& ctx = currentContext();
     cout << "Outputing .nets file to: " << filename << "\n";
     
     // Reset the name to counts map for this output.
-    NameCounts.clear();
+    ctx.NameCounts.clear();
 
     ofstream& out = *(new ofstream(filename));
     out << "UCLA nets  1.0\n\n";
@@ -1518,6 +2336,24 @@ ostream& outputNetsFileHeader(const char * filename) {
 void outputNetsFileFooter(ostream& o) {
     delete(&o);
 }
+
+ostream& outputSVGHeader(const char * filename) {
+    FPContext& ctx = currentContext();
+    cout << "Outputing SVG to: " << filename << "\n";
+
+    // Reset the name to counts map for this output, so the labels match the .flp file.
+    ctx.NameCounts.clear();
+
+    ofstream& out = *(new ofstream(filename));
+    out << "<?xml version=\"1.0\" standalone=\"no\"?>\n";
+    out << "<!-- FloorPlan output from ArchFP: UVA's Rapid Prototyping FloorPlanner. -->\n";
+
+    return out;
+}
+
+void outputSVGFooter(ostream& o) {
+    delete(&o);
+}
 /*
 // Returns the difference between targetWidth/targetHeight and actual ones due to AR constraint
 // TODO: Evaluate the newAR as well.
@@ -10,11 +10,9 @@
 #include <string>
 #include <iostream>
 #include <map>
+#include <vector>
 using namespace std;
 
-// This will be used to keep track of user's request for more output during layout.
-extern bool verbose;
-
 // This is an emum for the types of components that can be included in a floorplan.
 // In particular, the various layout managers will want to find various components
 //     they expect to be in their layout.
@@ -27,7 +25,106 @@ extern bool verbose;
 // Each component type is now assigned from 0 to 17.
 enum ComponentType {UnknownType = 0, Core, Cache, ICache, DCache, L1, L2, L3, RF, FPRF, ALU, NoC, Control, CrossBar, MemController, Grid, Group, Cluster};
 extern string TypeNames[];
-extern map<string, int> NameCounts;
+
+// Deepest nesting of mirrored containers we can output.
+#define maxMirrorDepth 50
+
+class FPObject;
+
+// A layout that has already been done, kept so an identical subtree can just be stamped out.
+struct FPCachedLayout {
+    FPObject *         root;            // A private copy of the laid out subtree.
+    vector<FPObject *> originals;       // The copy of each object that was in the subtree before the layout,
+                                        //    in signature order, or 0 if the layout dropped it.
+    bool               result;          // What layout returned.
+    // The legalization state the layout left behind.
+    bool               rightMark;
+    bool               topMark;
+    double             expandHeight;
+    double             expandWidth;
+    bool               legalizeFailed;
+};
+
+// Layouts already done, keyed by the structure of the subtree and everything else its layout depends on.
+// See FPContainer::layout.
+// Each context has a cache of its own, so copying a context gives an empty one.
+#define maxCachedLayouts 1000
+class FPLayoutCache {
+    map<string, FPCachedLayout *> entries;
+
+public:
+    FPLayoutCache() {}
+    FPLayoutCache(const FPLayoutCache& other) {}
+    FPLayoutCache& operator=(const FPLayoutCache& other) { clear(); return *this; }
+    ~FPLayoutCache() { clear(); }
+
+    void             clear();
+    int              size()     { return entries.size(); }
+    FPCachedLayout * find(string& key);
+    // The cache takes over the entry.  Once it is full, new entries are just thrown away.
+    void             store(string& key, FPCachedLayout * entry);
+};
+
+// This holds all the state that a layout and its output need beyond the floorplan objects themselves.
+// Each thread works in its own current context, so independent floorplans can be laid out in parallel.
+// A new context copied from an existing one keeps the options, but should have resetState called on it.
+class FPContext {
+public:
+    // Options.
+    bool   verbose;             // This will be used to keep track of user's request for more output during layout.
+    bool   legalizing;          // Flag for legalization.
+    bool   changeArea;          // This is used to turn on/off whether we need to keep the same area after legalizing the layout.
+    bool   topBottomInversion;  // TopBottom items can be inverted to BottomTop order.
+    bool   checkOverlap;        // Overlap detection to allow legalization.
+    bool   wiring;              // Wire length calculation.
+    bool   printNames;          // Enable/Disable name printing at void FPFlatLayout::outputHotSpotLayout.
+    bool   layoutCaching;       // Stamp out identical subtrees from the layout cache, rather than laying them out again.
+    bool   svgOutput;           // Render every floorplan in a spec as an SVG, as well as the .flp.
+
+    // Legalization state.
+    bool   rightMark;           // Once an item is placed at right or top, mark = false.
+    bool   topMark;
+    double expandHeight;        // Overlap area expansion.
+    double expandWidth;
+    bool   legalizeFailed;      // Some geographic layout gave up on legalizing, so the floorplan has overlaps.
+
+    // Legalization statistics.  These are not cleared by resetState.
+    int    legalizeRepairs;     // Overlaps repaired in place, each of which used to cost a full relayout.
+    int    legalizeRestarts;    // Full relayouts that were still needed.
+    double legalizeRepairTime;  // Seconds spent doing the repairs.
+    double legalizeSavedTime;   // Estimated seconds saved by not doing a full relayout for each repair.
+    int    layoutCacheHits;     // Container layouts stamped out of the layout cache.
+    int    layoutCacheMisses;   // And the ones that had to be done.
+
+    // Layouts done so far.  This is not cleared by resetState either, as nothing in it belongs to a floorplan.
+    FPLayoutCache layoutCache;
+
+    // Output state for the crazy mirror reflection stuff.
+    bool   xReflect;
+    double xLeft[maxMirrorDepth];
+    double xRight[maxMirrorDepth];
+    int    xMirrorDepth;
+    bool   yReflect;
+    double yBottom[maxMirrorDepth];
+    double yTop[maxMirrorDepth];
+    int    yMirrorDepth;
+
+    // Used to make unique names on output.
+    int              TypeCounts[ComponentTypeCount];
+    map<string, int> NameCounts;
+
+    FPContext();
+    void resetState();
+    void resetStats();
+    void addStats(FPContext& other);
+    void outputStats(ostream& o);
+};
+
+// The context for the calling thread.
+// Unless one is set, each thread has a default context of its own.
+FPContext& currentContext();
+// Make the given context current for the calling thread.  Passing 0 restores the default.
+void       setCurrentContext(FPContext * context);
 
 // Non-class function: input ComponentType to output in String format.
 inline string Type2Name (ComponentType compType)
@@ -35,24 +132,22 @@ inline string Type2Name (ComponentType compType)
     return TypeNames[compType];
 }
 
-extern int TypeCounts[];
-
 // Count up the amount of type with input ComponentType. Return the count.
 inline int Type2Count (ComponentType compType)
 {
-    return ++TypeCounts[compType];
+    return ++currentContext().TypeCounts[compType];
 }
 
 // Count up the amount of type with input String. Return the count.
 inline int Name2Count (string arg)
 {
-    return ++NameCounts[arg];
+    return ++currentContext().NameCounts[arg];
 }
 
 // Q: why twice?
 string getStringFromInt(int in);
 
-// Enable/Disable name printing at void FPObject::outputHotSpotLayout in Floorplan.cc
+// Enable/Disable name printing at void FPFlatLayout::outputHotSpotLayout in FlatLayout.cc
 void setNameMode(bool);
 
 // Here is an enumeration for the optimazation goals for a layout manager.
@@ -63,6 +158,16 @@ enum FPOptimization {Area, AspectRatio};
 // Here is the enumeration for layout hints for the geographic layout.
 enum GeographyHint {UnknownGeography, Left, Right, Top, Bottom, Center, LeftRight, LeftRightMirror, LeftRight180, TopBottom, TopBottomMirror, TopBottom180, Periphery};
 
+// The outcome of a pass of the recursive geographic layout.
+// Overlaps that can not be repaired in place, and layouts that need more area, make the layout start over.
+// A nested layout that could not be legalized fails the whole layout, as starting over would not help it.
+enum LayoutStatus {LayoutDone, LayoutOverlap, LayoutNeedsArea, LayoutFailed};
+
+// The ways to estimate the wire length of a net from where its components ended up.
+// ChainNet runs from component to component in the order they were added to the net.
+// See NetLength.hh for the others.
+enum NetModel {ChainNet, HPWLNet, StarNet, CliqueNet};
+
 // This class is meant to be a standin for a real component from M5 or whatever this eventually merge into.
 class dummyComponent {
     ComponentType type;
@@ -87,7 +192,33 @@ extern ostream& operator<< (ostream& s, dummyComponent& c);
 // And will keep all the information needed to participate in a floor plan.
 // For starters, the floorplan will ONLY need to operate on these wrappers.
 
+// The shapes a component can take on, for the parent to choose from before it asks.
+// Layouts here keep their area, so a shape is just an aspect ratio,
+//    and the curve is the set of aspect ratios the layout can reach without clamping.
+// It is kept as disjoint intervals in increasing order.
+class FPShapeCurve {
+    vector<double> low;
+    vector<double> high;
+
+public:
+    void   clear()          { low.clear(); high.clear(); }
+    int    size()           { return low.size(); }
+    double getLow(int i)    { return low[i]; }
+    double getHigh(int i)   { return high[i]; }
+
+    // Add the interval from lowAR to highAR, merging it with any it touches.
+    void   add(double lowAR, double highAR);
+    // Add every interval of the other curve, multiplied by the factor.
+    void   addScaled(FPShapeCurve& other, double factor);
+    bool   contains(double AR);
+    // How far AR is from the nearest shape on the curve, as a ratio.
+    // This is 1 for a shape on the curve, and the same measure that balanceFactors uses.
+    double distance(double AR);
+};
+
 // We will pull out the basic variables into a base class.
+class FPFlatLayout;
+
 class FPObject {
     int refCount;
     
@@ -109,6 +240,13 @@ protected:
                                 // This makes it easier to add, say, 8 identical cores as one object.
     bool   state;               // Legalization specific field.
 
+    // The shapes we can take on, worked out the first time someone asks.
+    // Anything added below us after that is not noticed, so build the tree before laying it out.
+    FPShapeCurve shape;
+    bool         shapeValid;
+    // By default, assume we can take on any shape.
+    virtual void calcShapeCurve();
+
 public:
     FPObject();
     virtual ~FPObject() {}
@@ -117,6 +255,7 @@ public:
     // No one should call these except for the container add/remove component methods.
              int          incRefCount()       { return refCount += 1; }
              int          decRefCount()       { return refCount -= 1; }
+             int          getRefCount()       { return refCount; }
 
     // Allow anyone to get the values of things.
     virtual double        getX()      { return x; }
@@ -152,7 +291,25 @@ public:
     virtual void          setCenter(double xcArg, double ycArg);
     
     virtual bool          layout (FPOptimization opt, double targetAR =  1.0) = 0;
-    virtual void          outputHotSpotLayout(ostream& o, double startX = 0.0, double startY = 0.0);
+            FPShapeCurve& getShapeCurve();
+
+    // For the layout cache.
+    // Write out everything about us, and anything inside us, that a layout depends on.
+    // Objects already seen are written as a reference to their index in seen.
+    // Returns false for those, so subclasses know not to add anything.
+    // usesContext is set if the layout also depends on the legalization state in the context.
+    virtual bool          addSignature(ostream& sig, map<FPObject *, int>& seen, bool& usesContext);
+    // A new object of our class with our values, but nothing inside it.
+    virtual FPObject *    newCopy() = 0;
+    // Take on everything a layout can change from another object of our class.
+    virtual void          copyLayoutFrom(FPObject * from);
+
+    // Add our records, and those of anything inside us, to a flat layout.  See FlatLayout.hh.
+    // The start position is that of our container, and parentRecord is its record.
+    virtual void          freeze(FPFlatLayout& flat, double startX, double startY, int parentRecord);
+    // Write ourselves out in HotSpot format, by way of a flat layout.
+            void          outputHotSpotLayout(ostream& o);
+            void          outputSVGLayout(ostream& o);
 
 };
 
@@ -180,6 +337,7 @@ public:
     void           outputNetLength(ostream& o); //@todo why this?
     int            getItemCount() { return itemCount; } //@todo why here?
     double         getNetLength() { return netLength; } //@todo why not calculated at the end?
+    void           setNetLength(double length) { netLength = length; }
     double         getMaxItemCount() { return maxItemCount; } 
     FPObject *     getComponent(int index) { return items[index]; }
     void           calcNetLength();
@@ -211,9 +369,59 @@ public:
 
     double           getMinAR() { return minAspectRatio; }
     double           getMaxAR() { return maxAspectRatio; }
+    void             calcShapeCurve();
     dummyComponent * getComp()  { return component; }
 
     virtual bool     layout (FPOptimization opt, double targetAR =  1.0);
+    bool             addSignature(ostream& sig, map<FPObject *, int>& seen, bool& usesContext);
+    FPObject *       newCopy();
+    void             copyLayoutFrom(FPObject * from);
+};
+
+
+// A spatial index of placed rectangles, so we can find what is near a rectangle
+//    without looking at everything that has been placed.
+// The rectangles are split up by width, in powers of two, and each lot is kept sorted by left edge.
+// Only rectangles whose left edge is at most their width class to the left of a query can reach it.
+// So a few very wide rectangles, like a Top or Bottom item of a geographic layout, only cost a few extra
+//    candidates, rather than making every query look at everything.
+// The index keeps its own copy of each rectangle, so call update after moving an object.
+// An index holds either placed objects, or the records of a flat layout (see FlatLayout.hh).
+class FPRectIndex {
+    struct rect {
+        double     x, y, width, height;
+        FPObject * obj;
+        int        record;
+    };
+    typedef multimap<double, rect> rectMap;
+
+    map<int, rectMap>                                  byWidth;    // By the exponent of the width.
+    map<FPObject *, pair<int, rectMap::iterator> >     where;
+    int                                                count;
+
+    static int widthClass(double width);
+    rectMap::iterator add(rect& r);
+    // The rectangles that intersect or touch the given one, grown by margin on each side.
+    void       collect(double x, double y, double width, double height, double margin, vector<rect *>& hits);
+
+public:
+    FPRectIndex();
+
+    void clear();
+    void insert(FPObject * obj);
+    void insert(int record, double x, double y, double width, double height);
+    void remove(FPObject * obj);
+    void update(FPObject * obj);
+    bool contains(FPObject * obj) { return where.find(obj) != where.end(); }
+    int  size()                   { return count; }
+
+    // Find the objects whose rectangles intersect or touch the given one, grown by margin on each side.
+    // Returns the number found.
+    int  query(double x, double y, double width, double height, vector<FPObject *>& found, double margin = 0.0);
+    // The same for an index of records.
+    int  query(double x, double y, double width, double height, vector<int>& found, double margin = 0.0);
+    // The same, but around an object that has been placed.  The object itself is not included.
+    int  neighbours(FPObject * obj, vector<FPObject *>& found, double margin = 0.0);
 };
 
 
@@ -248,6 +456,8 @@ protected:
     static int maxItemCount;
     static int maxNetCount;
 
+    FPRectIndex placed;         // Where our components have been placed so far, while we are being layed out.
+
     // These allow safe access to the item list.
     int        getComponentCount()          { return itemCount; }
     int        getNetCount()                { return netCount; }
@@ -260,6 +470,17 @@ protected:
     void       sortByArea();
     //TODO: removeNet
 
+    // The real work of layout, without the cache.
+    virtual bool layoutComponents (FPOptimization opt, double targetAR) = 0;
+    // Layout through the cache.
+    bool         layoutCached (FPOptimization opt, double targetAR);
+    // Give from's layout to the object that stands in for it in targets, or to a new copy if nothing does.
+    // Anything inside from is handled the same way.
+    // Anything already handled is in done.
+    // Items taken out of the containers being stamped are added to replaced, as some of them may go back in elsewhere.
+    static FPObject * stampLayout (FPObject * from, map<FPObject *, FPObject *>& targets, map<FPObject *, bool>& done,
+                                   vector<FPObject *>& replaced);
+
 public:
     FPContainer();
     ~FPContainer();
@@ -277,8 +498,12 @@ public:
 
     // Give the command for this container to lay itself out.
     // return a bool to indicate success or failure.
-    virtual bool           layout (FPOptimization opt, double targetAR =  1.0) = 0;
-    virtual void           outputHotSpotLayout(ostream& o, double startX = 0.0, double startY = 0.0) = 0;
+    // If an identical subtree has already been layed out at this AR, its layout is reused.
+    virtual bool           layout (FPOptimization opt, double targetAR =  1.0);
+    virtual bool           addSignature(ostream& sig, map<FPObject *, int>& seen, bool& usesContext);
+    virtual void           copyLayoutFrom(FPObject * from);
+    virtual void           freeze(FPFlatLayout& flat, double startX, double startY, int parentRecord) = 0;
+            void           freezeNets(FPFlatLayout& flat);
             void           outputBlockFile(ostream& o);
             void           outputNetsFile(ostream& o);
 
@@ -296,8 +521,14 @@ public:
     
     virtual void           addNet (FPNet * net);
     
-    virtual bool           detectOverlap(FPObject ** layoutStack, int curDepth, FPObject * FPLayout);
-    void                   calcNetLength();
+    // Check FPLayout against the first curDepth items of the layoutStack.
+    // If they overlap, returns true, and how much the layout would need to grow to make them fit.
+    // The items are looked up in the placement index when it holds exactly those items.
+    virtual bool           detectOverlap(FPObject ** layoutStack, int curDepth, FPObject * FPLayout, double& growWidth, double& growHeight);
+
+    // Work out the length of each of our nets, and their total, from a flat layout of us.
+    void                   calcNetLength(NetModel model = HPWLNet);
+    double                 getTotalNetsLength()         { return totalNetsLength; }
 };
 
 // This will just be a collection of components to lay out in the given aspect ratio.
@@ -306,20 +537,28 @@ class bagLayout : public FPContainer {
 protected:
     bool locked;
     void recalcSize();
+    void calcShapeCurve();
+    void componentShapes(vector<double>& compAreas, vector<FPShapeCurve>& curves);
+    bool layoutComponents(FPOptimization opt, double targetAR);
 
 public:
     bagLayout ();
 
-    bool layout(FPOptimization opt, double targetAR = 1.0);
-    void outputHotSpotLayout(ostream& o, double startX = 0.0, double startY = 0.0);
+    bool       addSignature(ostream& sig, map<FPObject *, int>& seen, bool& usesContext);
+    FPObject * newCopy();
+    void       copyLayoutFrom(FPObject * from);
+    void freeze(FPFlatLayout& flat, double startX, double startY, int parentRecord);
 };
 
 class fixedLayout : public bagLayout {
     void morph(double xFactor, double yFactor);
+    bool layoutComponents(FPOptimization opt, double targetAR);
+    // Only used to make copies.
+    fixedLayout () : bagLayout() { locked = true; }
 
 public:
-    bool layout(FPOptimization opt, double targetAR = 1.0);
     fixedLayout (const char * filename, double scalingFactor = 1.0);
+    FPObject * newCopy();
 };
 
 // Here is the simplest possible layout manager.
@@ -332,12 +571,15 @@ class gridLayout : public FPContainer {
     // Store the calculated x and y counts of components in the grid.
     int xCount;
     int yCount;
+    void calcShapeCurve();
+    bool layoutComponents(FPOptimization opt, double targetAR);
 
 public:
     gridLayout ();
 
-    bool layout(FPOptimization opt, double targetAR = 1.0);
-    void outputHotSpotLayout(ostream& o, double startX = 0.0, double startY = 0.0);
+    FPObject * newCopy();
+    void       copyLayoutFrom(FPObject * from);
+    void freeze(FPFlatLayout& flat, double startX, double startY, int parentRecord);
 
     // A grid handles its counts different than other components?
 
@@ -355,16 +597,26 @@ class geogLayout : public FPContainer {
 
     // FPObject** centerItems;    // During layout, we will store up the center items, stick them in a bag, and lay them out last.
     // int        centerItemsCount;
-    bool layoutHelper (double targetWidth, double targetHeight, double curX, double curY, FPObject ** layoutStack, int curDepth, FPObject ** centerItems, int centerItemsCount);
+    LayoutStatus layoutHelper (double targetWidth, double targetHeight, double curX, double curY, FPObject ** layoutStack, int curDepth, FPObject ** centerItems, int centerItemsCount);
+    bool         repairOverlap (FPObject ** layoutStack, int curDepth, FPObject * FPLayout, double rightEdge, double topEdge,
+                                double& growWidth, double& growHeight, int attempt);
+    bool         unitsOverlap (FPObject ** layoutStack, int maxArraySize);
     
     // Added for legalization. TODO: Protect this value
     double newAR;
+    int    repairCount;         // Overlaps repaired in place during the current layout pass.
+    double repairTime;          // And the time it took to do so.
+    double repairWidth;         // How much the repairs during the current pass grew the layout.
+    double repairHeight;
+
+    bool         layoutComponents (FPOptimization opt, double targetAR);
     
 public:
     geogLayout ();
 
-    virtual bool       layout (FPOptimization opt, double targetAR =  1.0);
-    virtual void       outputHotSpotLayout(ostream& o, double startX = 0.0, double startY = 0.0);
+    virtual bool       addSignature(ostream& sig, map<FPObject *, int>& seen, bool& usesContext);
+    virtual FPObject * newCopy();
+    virtual void       freeze(FPFlatLayout& flat, double startX, double startY, int parentRecord);
     virtual FPObject * addComponentCluster (ComponentType type, int count, double area, double maxARArg, double minARArg, GeographyHint hint);
     virtual FPObject * addComponentCluster (ComponentType type, int count, double area, double maxARArg, double minARArg, GeographyHint hint, FPNet * net);
     virtual FPObject * addComponentCluster (ComponentType type, int count, double area, double maxARArg, double minARArg, GeographyHint hint, FPNet ** netList);    
@@ -407,4 +659,7 @@ ostream& outputBlockFileHeader(const char * filename);
 void outputBlockFileFooter(ostream& o);
 
 ostream& outputNetsFileHeader(const char * filename);
-void outputNetsFileFooter(ostream& o);
\ No newline at end of file
+void outputNetsFileFooter(ostream& o);
+
+ostream& outputSVGHeader(const char * filename);
+void outputSVGFooter(ostream& o);
\ No newline at end of file
@@ -10,8 +10,15 @@
 #include <iostream>
 #include <cstdlib>
 #include <cmath>
+#include <fstream>
+#include <vector>
+#include <stdexcept>
+#include <thread>
+#include <atomic>
+#include <mutex>
 #include "MathUtil.hh"
 #include "Floorplan.hh"
+#include "Spec.hh"
 
 
 
@@ -25,68 +32,69 @@ void generate_4x4_tile()
         basic->addNet(ns[i]);
     }
     
-    FPNet ** n1 = (FPNet **) malloc(sizeof (FPNet *) * 2); 
-    for (int i = 0; i < 2; ++i) n1[i] = 0;  
+    // The net lists are null terminated.
+    FPNet ** n1 = (FPNet **) malloc(sizeof (FPNet *) * 3); 
+    for (int i = 0; i < 3; ++i) n1[i] = 0;  
     n1[0] = ns[0]; n1[1] = ns[12];
         
-    FPNet ** n2 = (FPNet **) malloc(sizeof (FPNet *) * 3); 
-    for (int i = 0; i < 3; ++i) n2[i] = 0;
+    FPNet ** n2 = (FPNet **) malloc(sizeof (FPNet *) * 4); 
+    for (int i = 0; i < 4; ++i) n2[i] = 0;
     n2[0] = ns[0]; n2[1] = ns[1]; n2[2] = ns[15];
         
-    FPNet ** n3 = (FPNet **) malloc(sizeof (FPNet *) * 3); 
-    for (int i = 0; i < 3; ++i) n3[i] = 0;
+    FPNet ** n3 = (FPNet **) malloc(sizeof (FPNet *) * 4); 
+    for (int i = 0; i < 4; ++i) n3[i] = 0;
     n3[0] = ns[1]; n3[1] = ns[2]; n3[2] = ns[18];
     
-    FPNet ** n4 = (FPNet **) malloc(sizeof (FPNet *) * 2);
-    for (int i = 0; i < 2; ++i) n4[i] = 0;
+    FPNet ** n4 = (FPNet **) malloc(sizeof (FPNet *) * 3);
+    for (int i = 0; i < 3; ++i) n4[i] = 0;
     n4[0] = ns[2]; n4[1] = ns[21];
     
-    FPNet ** n5 = (FPNet **) malloc(sizeof (FPNet *) * 3);
-    for (int i = 0; i < 3; ++i) n5[i] = 0;
+    FPNet ** n5 = (FPNet **) malloc(sizeof (FPNet *) * 4);
+    for (int i = 0; i < 4; ++i) n5[i] = 0;
     n5[0] = ns[3]; n5[1] = ns[12]; n5[2] = ns[13];
        
-    FPNet ** n6 = (FPNet **) malloc(sizeof (FPNet *) * 4);
-    for (int i = 0; i < 4; ++i) n6[i] = 0;
+    FPNet ** n6 = (FPNet **) malloc(sizeof (FPNet *) * 5);
+    for (int i = 0; i < 5; ++i) n6[i] = 0;
     n6[0] = ns[3]; n6[1] = ns[4]; n6[2] = ns[15]; n6[3] = ns[16];
     
-    FPNet ** n7 = (FPNet **) malloc(sizeof (FPNet *) * 4);
-    for (int i = 0; i < 4; ++i) n7[i] = 0;
+    FPNet ** n7 = (FPNet **) malloc(sizeof (FPNet *) * 5);
+    for (int i = 0; i < 5; ++i) n7[i] = 0;
     n7[0] = ns[4]; n7[1] = ns[5]; n7[2] = ns[18]; n7[3] = ns[19];
     
-    FPNet ** n8 = (FPNet **) malloc(sizeof (FPNet *) * 3); 
-    for (int i = 0; i < 3; ++i) n8[i] = 0;
+    FPNet ** n8 = (FPNet **) malloc(sizeof (FPNet *) * 4); 
+    for (int i = 0; i < 4; ++i) n8[i] = 0;
     n8[0] = ns[5]; n8[1] = ns[21]; n8[2] = ns[22];
      
-    FPNet ** n9 = (FPNet **) malloc(sizeof (FPNet *) * 3);
-    for (int i = 0; i < 3; ++i) n9[i] = 0;
+    FPNet ** n9 = (FPNet **) malloc(sizeof (FPNet *) * 4);
+    for (int i = 0; i < 4; ++i) n9[i] = 0;
     n9[0] = ns[6]; n9[1] = ns[13]; n9[2] = ns[14];
        
-    FPNet ** n10 = (FPNet **) malloc(sizeof (FPNet *) * 4); 
-    for (int i = 0; i < 4; ++i) n10[i] = 0;
+    FPNet ** n10 = (FPNet **) malloc(sizeof (FPNet *) * 5); 
+    for (int i = 0; i < 5; ++i) n10[i] = 0;
     n10[0] = ns[6]; n10[1] = ns[7]; n10[2] = ns[16]; n10[3] = ns[17];
        
-    FPNet ** n11 = (FPNet **) malloc(sizeof (FPNet *) * 4); 
-    for (int i = 0; i < 4; ++i) n11[i] = 0;
+    FPNet ** n11 = (FPNet **) malloc(sizeof (FPNet *) * 5); 
+    for (int i = 0; i < 5; ++i) n11[i] = 0;
     n11[0] = ns[7]; n11[1] = ns[8]; n11[2] = ns[19]; n11[3] = ns[20];
     
-    FPNet ** n12 = (FPNet **) malloc(sizeof (FPNet *) * 3); 
-    for (int i = 0; i < 3; ++i) n12[i] = 0;
+    FPNet ** n12 = (FPNet **) malloc(sizeof (FPNet *) * 4); 
+    for (int i = 0; i < 4; ++i) n12[i] = 0;
     n12[0] = ns[8]; n12[1] = ns[22]; n12[2] = ns[23];
         
-    FPNet ** n13 = (FPNet **) malloc(sizeof (FPNet *) * 2);
-    for (int i = 0; i < 2; ++i) n13[i] = 0;
+    FPNet ** n13 = (FPNet **) malloc(sizeof (FPNet *) * 3);
+    for (int i = 0; i < 3; ++i) n13[i] = 0;
     n13[0] = ns[9]; n13[1] = ns[14];
        
-    FPNet ** n14 = (FPNet **) malloc(sizeof (FPNet *) * 3); 
-    for (int i = 0; i < 3; ++i) n14[i] = 0;
+    FPNet ** n14 = (FPNet **) malloc(sizeof (FPNet *) * 4); 
+    for (int i = 0; i < 4; ++i) n14[i] = 0;
     n14[0] = ns[9]; n14[1] = ns[10]; n14[2] = ns[17];
     
-    FPNet ** n15 = (FPNet **) malloc(sizeof (FPNet *) * 3); 
-    for (int i = 0; i < 3; ++i) n15[i] = 0;
+    FPNet ** n15 = (FPNet **) malloc(sizeof (FPNet *) * 4); 
+    for (int i = 0; i < 4; ++i) n15[i] = 0;
     n15[0] = ns[10]; n15[1] = ns[11]; n15[2] = ns[20];
     
-    FPNet ** n16 = (FPNet **) malloc(sizeof (FPNet *) * 3); 
-    for (int i = 0; i < 3; ++i) n16[i] = 0;
+    FPNet ** n16 = (FPNet **) malloc(sizeof (FPNet *) * 4); 
+    for (int i = 0; i < 4; ++i) n16[i] = 0;
     n16[0] = ns[11]; n16[1] = ns[23];
     
     basic->addComponentCluster("B1", 1, 1, 1, 1, Bottom, n1);
@@ -808,13 +816,81 @@ void callSetupExamples () {
   generate8corePenrynCMP();
 }
 
+// Layout a batch of spec files, using up to threadCount threads.
+// Each spec is layed out in a context of its own, so they can not interfere with each other.
+// The results are reported in the order the specs were given, once they are all done.
+// Returns the number of specs that failed.
+int layoutSpecBatch(vector<string>& specFiles, int threadCount)
+{
+  int specCount = specFiles.size();
+  vector<int>    counts(specCount, 0);
+  vector<string> errors(specCount);
+  vector<bool>   failed(specCount, false);
+  atomic<int>    nextSpec(0);
+  FPContext&     mainContext = currentContext();
+  mutex          statsMutex;
+
+  auto worker = [&] ()
+    {
+      FPContext context = mainContext;
+      context.resetStats();
+      for (int i = nextSpec++; i < specCount; i = nextSpec++)
+        {
+          context.resetState();
+          setCurrentContext(&context);
+          try
+            {
+              counts[i] = layoutSpecFile(specFiles[i].c_str());
+            }
+          catch (exception& e)
+            {
+              errors[i] = e.what();
+              failed[i] = true;
+            }
+          setCurrentContext(0);
+        }
+      lock_guard<mutex> statsLock(statsMutex);
+      mainContext.addStats(context);
+    };
+
+  if (threadCount > specCount) threadCount = specCount;
+  if (threadCount <= 1) worker();
+  else
+    {
+      vector<thread> threads;
+      for (int t = 0; t < threadCount; t++) threads.push_back(thread(worker));
+      for (int t = 0; t < threadCount; t++) threads[t].join();
+    }
+
+  int failures = 0;
+  for (int i = 0; i < specCount; i++)
+    {
+      if (failed[i])
+        {
+          cerr << errors[i] << "\n";
+          failures += 1;
+        }
+      else cout << "Produced " << counts[i] << " floorplan(s) from " << specFiles[i] << "\n";
+    }
+  return failures;
+}
+
 int main(int argc, char* argv[])
 {
-  string usageString = "Usage:\nArchFP [-h] [-v]\n-h     Print out this help information.\n-v     Output verbose layout information to stdout.\n"
-    "ArchFP does not take in declarative specifications for floorplans.\n"
-    "To produce a different floorplan, please edit Main.cc and recompile.\n";
+  string usageString = "Usage:\nArchFP [-h] [-v] [-s] [-c] [-g] [-j threads] [-l list-file] [spec-file ...]\n-h     Print out this help information.\n-v     Output verbose layout information to stdout.\n"
+    "-s     Output legalization and layout cache statistics when done.\n"
+    "-c     Reuse the layouts of identical subtrees, rather than laying out every one.\n"
+    "-g     Also draw every floorplan into an .svg file next to its .flp file.\n"
+    "-j     Number of specs to layout in parallel (default is the number of hardware threads).\n"
+    "-l     Read spec file names from list-file, one per line.  May be repeated.\n"
+    "spec-file  A declarative floorplan specification to layout (- reads from stdin).\n"
+    "           See Spec.hh for the format.  Any number of specs can be given.\n"
+    "With no spec files, ArchFP lays out the built in example in Main.cc.\n";
   string copyrightString = "ArchFP: A pre-RTL rapid prototyping floorplanner.\nAuthor: Greg Faust (gf4ea@virginia.edu).\n";
 
+  vector<string> specFiles;
+  bool stats = false;
+  int threadCount = thread::hardware_concurrency();
   for (int x = 1; x < argc; x++)
     {
       string arg = string(argv[x]);
@@ -826,7 +902,50 @@ int main(int argc, char* argv[])
         }
       else if (arg == "-v")
         {
-          verbose = true;
+          currentContext().verbose = true;
+        }
+      else if (arg == "-s")
+        {
+          stats = true;
+        }
+      else if (arg == "-c")
+        {
+          currentContext().layoutCaching = true;
+        }
+      else if (arg == "-g")
+        {
+          currentContext().svgOutput = true;
+        }
+      else if (arg == "-j" && x + 1 < argc)
+        {
+          threadCount = atoi(argv[++x]);
+          if (threadCount < 1)
+            {
+              cerr << "The thread count must be at least 1.\n";
+              return 1;
+            }
+        }
+      else if (arg == "-l" && x + 1 < argc)
+        {
+          ifstream list(argv[++x]);
+          if (!list)
+            {
+              cerr << "Unable to open spec list file " << argv[x] << "\n";
+              return 1;
+            }
+          string line;
+          while (getline(list, line))
+            {
+              // Skip blank lines and comments.
+              size_t first = line.find_first_not_of(" \t\r");
+              if (first == string::npos || line[first] == '#') continue;
+              size_t last = line.find_last_not_of(" \t\r");
+              specFiles.push_back(line.substr(first, last - first + 1));
+            }
+        }
+      else if (arg == "-" || arg[0] != '-')
+        {
+          specFiles.push_back(arg);
         }
       else
         {
@@ -837,6 +956,13 @@ int main(int argc, char* argv[])
     }
   cout << copyrightString;
 
+  if (!specFiles.empty())
+    {
+      int failures = layoutSpecBatch(specFiles, threadCount);
+      if (stats) currentContext().outputStats(cout);
+      return (failures == 0) ? 0 : 1;
+    }
+
   ///////////////////////////////////////////////////////
   // Look at these subroutines above for examples of how to build floorplans using this tool.
   //////////////////////////////////////////////////////
@@ -847,6 +973,6 @@ int main(int argc, char* argv[])
   //generateTRIPS_Examples();
   generate_4x4_tile();
 
+  if (stats) currentContext().outputStats(cout);
   return 0;
 }
-
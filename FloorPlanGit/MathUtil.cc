@@ -10,6 +10,7 @@
 #include <cmath>
 #include <climits>
 #include <cstdlib>
+#include <mutex>
 #include "MathUtil.hh"
 
 /*
@@ -32,6 +33,9 @@
  
 static bool primesInitialized = false;
 
+// The prime cache and its iterator are shared by every thread, so only one factorization can walk it at a time.
+static mutex primesMutex;
+
 // If I make this static, it will be magically called when any other member is called.
 // However, then I can't send it any arguments.  Unclear what is best here.
 // Indicate we are now initialized.
@@ -93,7 +97,11 @@ int Primes::findNextPrime ()
 // These next two usually just go through the prime array unless a larger prime than currently known is needed.
 void Primes::resetPrimes()
 {
-    if (!primesInitialized)initPrimes();
+    if (!primesInitialized)
+    {
+        initPrimes();
+        primesInitialized = true;
+    }
     currPrimeInx = 0;
 }
 
@@ -126,6 +134,7 @@ primeFactorization::primeFactorization(int num)
 
     // Now find a prime factor and add to its exponent.
     int p;
+    lock_guard<mutex> primesLock(primesMutex);
     Primes::resetPrimes();
     while ((p=Primes::getNextPrime()) <= sqrtnum)
     {
@@ -206,36 +215,17 @@ void incrementBoolArray (bool * arr, int len)
     }
 }
 
-// This takes in a number that is hopefully composite.
-// And returns a number that divides the number, and is close to the requested
-//    ratio between the two factors.
-// The second factor is easily derived from the return value by composite/retval.
-// Ratio greater than 1 will return the max of the two factors.
-// Ratio less than or equal to 1 will return the min of the two factors.
-// Given the small number of factors likely to be used, try ALL combinations to find one closest to ratio.
-// Given that the new "distance" calculation works better for ratios > 1, we will flip and flip back if needed.
-int balanceFactors(int composite, double targetRatio)
+// List the larger factor of each way to split the number into two factors.
+// They come out in the order the power set of its prime factors first reaches them.
+// balanceFactors keeps the first of any equally good splits, so this order must not change.
+static void listBalanceCandidates(int * factArray, int len, vector<int>& candidates)
 {
-    // First get the prime factorization for the number.
-    primeFactorization pf = primeFactorization(composite);
-
-    // Get an array of the factors of the number.
-    int len = pf.countFactors();
-    int * factArray = (int*)malloc(sizeof(int)*len);
-    pf.expandFactors(factArray);
-    
+    candidates.clear();
     // Allocate an array of booleans to dictate which factor combination we are about to try.
     // Initializing to false is the equivalent of "zero".
     bool * boolArr = (bool *)malloc(sizeof(bool)*len);
     for (int i=0; i<len; i++) boolArr[i] = false;
 
-    bool flip = (targetRatio < 1);
-    double ratio = flip ? 1/targetRatio : targetRatio;
-
-    // Dummy value to make sure first combo will set new curRatio.
-    double curMetric = 1000000000;
-    int curf1 = 1;
-    int curf2 = 1;
     // We are dealing with the power set of the number of factors.
     int combos = 1 << len;
     for (int i=0; i<combos; i++)
@@ -248,8 +238,122 @@ int balanceFactors(int composite, double targetRatio)
             else            f2 *= factArray[j];
         }
         incrementBoolArray(boolArr, len);
+        if (f1 < f2) continue;
+        // Different subsets of repeated primes give the same split.
+        bool seen = false;
+        for (unsigned int k=0; k<candidates.size(); k++)
+            if (candidates[k] == f1) { seen = true; break; }
+        if (!seen) candidates.push_back(f1);
+    }
+    free(boolArr);
+}
+
+// The table of candidates for every count up to maxFactorTable.
+// The candidates for n are balanceList[balanceStart[n]] up to balanceList[balanceStart[n+1]].
+// The divisors are kept the same way, smallest first.
+// Once built, the table is only read, so any number of threads can share it.
+static vector<int> balanceStart;
+static vector<int> balanceList;
+static vector<int> squarestFactor;
+static vector<int> divisorStart;
+static vector<int> divisorList;
+static once_flag   factorTableBuilt;
+
+static void buildFactorTable()
+{
+    // Sieve out the smallest prime factor of every count.
+    // Dividing that out repeatedly gives the primes smallest first, just as primeFactorization does.
+    vector<int> smallestPrime(maxFactorTable + 1, 0);
+    for (int i=2; i<=maxFactorTable; i++)
+    {
+        if (smallestPrime[i] != 0) continue;
+        for (int j=i; j<=maxFactorTable; j+=i)
+            if (smallestPrime[j] == 0) smallestPrime[j] = i;
+    }
+
+    // Enough room for the most prime factors of any count in the table.
+    int factArray[32];
+    vector<int> candidates;
+    balanceStart.assign(2, 0);
+    squarestFactor.assign(1, 1);
+    divisorStart.assign(2, 0);
+    for (int n=1; n<=maxFactorTable; n++)
+    {
+        int len = 0;
+        for (int rest=n; rest>1; rest/=smallestPrime[rest]) factArray[len++] = smallestPrime[rest];
+        listBalanceCandidates(factArray, len, candidates);
+        balanceList.insert(balanceList.end(), candidates.begin(), candidates.end());
+        balanceStart.push_back(balanceList.size());
+
+        // For a ratio of 1, the best split is the one with the smallest larger factor.
+        int squarest = n;
+        for (unsigned int k=0; k<candidates.size(); k++) squarest = MIN(squarest, candidates[k]);
+        squarestFactor.push_back(squarest);
+    }
+
+    // Hand each divisor to all its multiples, so each list comes out smallest first.
+    vector<int> divisorCount(maxFactorTable + 1, 0);
+    for (int d=1; d<=maxFactorTable; d++)
+        for (int m=d; m<=maxFactorTable; m+=d) divisorCount[m] += 1;
+    for (int n=1; n<=maxFactorTable; n++) divisorStart.push_back(divisorStart[n] + divisorCount[n]);
+    divisorList.assign(divisorStart[maxFactorTable + 1], 0);
+    vector<int> fill(divisorStart.begin(), divisorStart.end() - 1);
+    for (int d=1; d<=maxFactorTable; d++)
+        for (int m=d; m<=maxFactorTable; m+=d) divisorList[fill[m]++] = d;
+}
+
+static bool inFactorTable(int composite)
+{
+    if (composite < 1 || composite > maxFactorTable) return false;
+    call_once(factorTableBuilt, buildFactorTable);
+    return true;
+}
+
+// This takes in a number that is hopefully composite.
+// And returns a number that divides the number, and is close to the requested
+//    ratio between the two factors.
+// The second factor is easily derived from the return value by composite/retval.
+// Ratio greater than 1 will return the max of the two factors.
+// Ratio less than or equal to 1 will return the min of the two factors.
+// Given the small number of factors likely to be used, try ALL combinations to find one closest to ratio.
+// Given that the new "distance" calculation works better for ratios > 1, we will flip and flip back if needed.
+int balanceFactors(int composite, double targetRatio)
+{
+    bool flip = (targetRatio < 1);
+    double ratio = flip ? 1/targetRatio : targetRatio;
+
+    // Small counts come straight out of the table.
+    // Otherwise, get the prime factorization for the number, and try all its splits.
+    const int * candidates;
+    int candidateCount;
+    vector<int> computed;
+    if (inFactorTable(composite))
+    {
+        if (ratio == 1) return squarestFactor[composite];
+        candidates = &balanceList[balanceStart[composite]];
+        candidateCount = balanceStart[composite + 1] - balanceStart[composite];
+    }
+    else
+    {
+        primeFactorization pf = primeFactorization(composite);
+        int len = pf.countFactors();
+        int * factArray = (int*)malloc(sizeof(int)*len);
+        pf.expandFactors(factArray);
+        listBalanceCandidates(factArray, len, computed);
+        free(factArray);
+        candidates = &computed[0];
+        candidateCount = computed.size();
+    }
+
+    // Dummy value to make sure first combo will set new curRatio.
+    double curMetric = 1000000000;
+    int curf1 = 1;
+    int curf2 = 1;
+    for (int i=0; i<candidateCount; i++)
+    {
+        int f1 = candidates[i];
+        int f2 = composite/f1;
         double newRatio = ((double)f1)/f2;
-        if (newRatio < 1) continue;
 
         // Is this better than best so far?
         double newMetric = (newRatio > ratio) ? newRatio/ratio : ratio/newRatio;
@@ -260,14 +364,24 @@ int balanceFactors(int composite, double targetRatio)
             curf2 = f2;
         }
     }
-    free(factArray);
-    free(boolArr);
 
     int retval = flip ? curf2 : curf1;
     // cout << "Composite=" << composite << " ratio=" << targetRatio << " retval=" << retval << " other=" << composite/retval << " actual=" << retval/((double)composite/retval) << "\n";
     return retval;
 }
 
+void getDivisors(int composite, vector<int>& divs)
+{
+    divs.clear();
+    if (inFactorTable(composite))
+    {
+        divs.assign(divisorList.begin() + divisorStart[composite], divisorList.begin() + divisorStart[composite + 1]);
+        return;
+    }
+    for (int d=1; d<=composite; d++)
+        if (composite % d == 0) divs.push_back(d);
+}
+
 // Calculate GCD using Euclid's algorithm
 // This seems faster than getting the prime factorization and doing it that way.
 int GCD(int x, int y)
@@ -8,6 +8,7 @@
 */
 
 #include <iostream>
+#include <vector>
 using namespace std;
 
 // Apparently, we need to define min and max !!
@@ -85,5 +86,13 @@ public:
 
 };       // End primeFactorization.
     
+// Counts up to this have their divisors worked out once, the first time any are needed.
+// Larger counts are factored on every call, as they always were.
+#ifndef maxFactorTable
+#define maxFactorTable 4096
+#endif
+
 int balanceFactors(int composite, double ratio=1.0);
+// Fill divs with the divisors of a positive number, smallest first.
+void getDivisors(int composite, vector<int>& divs);
 
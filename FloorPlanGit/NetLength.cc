@@ -0,0 +1,253 @@
+/* -*- Mode: C++ ; indent-tabs-mode: nil ; c-file-style: "stroustrup" -*-
+
+   Rapid Prototyping Floorplanner Project
+   Author: Greg Faust
+
+   File:   NetLength.cc     Wire length estimation over a flat layout.
+
+*/
+
+#include <cmath>
+#include <algorithm>
+#include "MathUtil.hh"
+#include "Floorplan.hh"
+#include "FlatLayout.hh"
+#include "NetLength.hh"
+
+FPNetLength::FPNetLength(FPFlatLayout& flatArg, NetModel modelArg) : flat(flatArg) {
+    model = modelArg;
+
+    // Gather up the terminals of each net from the terminals of its pins.
+    // The last net to claim a record tells us whether it is already in this one.
+    int records = flat.size();
+    vector<int> lastNet(records, -1);
+    vector<int> recordCount(records, 0);
+    netStart.push_back(0);
+    for (int i = 0; i < flat.netCount(); i++) {
+        for (int j = flat.pinStart[i]; j < flat.pinStart[i + 1]; j++) {
+            for (int k = flat.termStart[j]; k < flat.termStart[j + 1]; k++) {
+                int r = flat.termRecord[k];
+                if (lastNet[r] == i) continue;
+                lastNet[r] = i;
+                termRecord.push_back(r);
+                termNet.push_back(i);
+                recordCount[r] += 1;
+            }
+        }
+        netStart.push_back(termRecord.size());
+    }
+
+    // Now invert that to get the terminals of each record.
+    int terms = termRecord.size();
+    recordStart.assign(records + 1, 0);
+    for (int r = 0; r < records; r++) recordStart[r + 1] = recordStart[r] + recordCount[r];
+    recordTerm.assign(terms, 0);
+    vector<int> fill(recordStart.begin(), recordStart.end() - 1);
+    for (int t = 0; t < terms; t++) recordTerm[fill[termRecord[t]]++] = t;
+
+    termX.assign(terms, 0.0);
+    termY.assign(terms, 0.0);
+    for (int t = 0; t < terms; t++) {
+        int r = termRecord[t];
+        termX[t] = flat.x[r] + flat.width[r] / 2;
+        termY[t] = flat.y[r] + flat.height[r] / 2;
+    }
+
+    length.assign(flat.netCount(), 0.0);
+    dirty.assign(flat.netCount(), false);
+    evaluate();
+}
+
+const char * FPNetLength::modelName(NetModel modelArg) {
+    switch (modelArg) {
+    case ChainNet:  return "chain";
+    case HPWLNet:   return "hpwl";
+    case StarNet:   return "star";
+    case CliqueNet: return "clique";
+    }
+    return "unknown";
+}
+
+bool FPNetLength::parseModel(string name, NetModel& modelArg) {
+    NetModel models[] = {ChainNet, HPWLNet, StarNet, CliqueNet};
+    for (int i = 0; i < 4; i++) {
+        if (name == modelName(models[i])) {
+            modelArg = models[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+void FPNetLength::setModel(NetModel modelArg) {
+    if (modelArg == model) return;
+    model = modelArg;
+    evaluate();
+}
+
+double FPNetLength::calcNet(int net) {
+    int first = netStart[net];
+    int last = netStart[net + 1];
+    int n = last - first;
+    if (n < 2) return 0;
+    const double * xs = &termX[first];
+    const double * ys = &termY[first];
+
+    double len = 0;
+    switch (model) {
+    case ChainNet:
+        for (int i = 1; i < n; i++) len += fabs(xs[i] - xs[i - 1]) + fabs(ys[i] - ys[i - 1]);
+        break;
+    case HPWLNet: {
+        double minX = xs[0], maxX = xs[0], minY = ys[0], maxY = ys[0];
+        for (int i = 1; i < n; i++) {
+            minX = MIN(minX, xs[i]);
+            maxX = MAX(maxX, xs[i]);
+            minY = MIN(minY, ys[i]);
+            maxY = MAX(maxY, ys[i]);
+        }
+        len = (maxX - minX) + (maxY - minY);
+        break;
+    }
+    case StarNet: {
+        double sumX = 0, sumY = 0;
+        for (int i = 0; i < n; i++) {
+            sumX += xs[i];
+            sumY += ys[i];
+        }
+        double cX = sumX / n, cY = sumY / n;
+        for (int i = 0; i < n; i++) len += fabs(xs[i] - cX) + fabs(ys[i] - cY);
+        break;
+    }
+    case CliqueNet: {
+        // Once sorted, the i-th of n values is subtracted from the n-1-i above it,
+        //    and has the i below it subtracted from it.
+        // So the sum over all pairs is linear after the sort, rather than quadratic.
+        scratch.assign(xs, xs + n);
+        sort(scratch.begin(), scratch.end());
+        for (int i = 0; i < n; i++) len += (2 * i - n + 1) * scratch[i];
+        scratch.assign(ys, ys + n);
+        sort(scratch.begin(), scratch.end());
+        for (int i = 0; i < n; i++) len += (2 * i - n + 1) * scratch[i];
+        len /= n - 1;
+        break;
+    }
+    }
+    return len;
+}
+
+void FPNetLength::evaluate() {
+    for (int i = 0; i < netCount(); i++) {
+        length[i] = calcNet(i);
+        dirty[i] = false;
+    }
+    dirtyNets.clear();
+}
+
+double FPNetLength::totalLength() {
+    double total = 0;
+    for (int i = 0; i < netCount(); i++) total += length[i];
+    return total;
+}
+
+double FPNetLength::overlapArea() {
+    vector<int> first, second;
+    flat.findOverlaps(first, second);
+    double area = 0;
+    for (unsigned int i = 0; i < first.size(); i++) {
+        int a = first[i], b = second[i];
+        double widthOver = MIN(flat.x[a] + flat.width[a], flat.x[b] + flat.width[b]) - MAX(flat.x[a], flat.x[b]);
+        double heightOver = MIN(flat.y[a] + flat.height[a], flat.y[b] + flat.height[b]) - MAX(flat.y[a], flat.y[b]);
+        area += widthOver * heightOver;
+    }
+    return area;
+}
+
+void FPNetLength::placeTerminals(int record) {
+    double cX = flat.x[record] + flat.width[record] / 2;
+    double cY = flat.y[record] + flat.height[record] / 2;
+    for (int i = recordStart[record]; i < recordStart[record + 1]; i++) {
+        int t = recordTerm[i];
+        termX[t] = cX;
+        termY[t] = cY;
+        int net = termNet[t];
+        if (!dirty[net]) {
+            dirty[net] = true;
+            dirtyNets.push_back(net);
+        }
+    }
+}
+
+double FPNetLength::updateDirty() {
+    double change = 0;
+    for (unsigned int i = 0; i < dirtyNets.size(); i++) {
+        int net = dirtyNets[i];
+        double len = calcNet(net);
+        change += len - length[net];
+        length[net] = len;
+        dirty[net] = false;
+    }
+    dirtyNets.clear();
+    return change;
+}
+
+double FPNetLength::moveRecord(int record, double dx, double dy) {
+    for (int r = record; r < flat.end[record]; r++) {
+        flat.x[r] += dx;
+        flat.y[r] += dy;
+        placeTerminals(r);
+    }
+    flat.coordinatesChanged();
+    return updateDirty();
+}
+
+double FPNetLength::resizeRecord(int record, double newWidth, double newHeight) {
+    flat.width[record] = newWidth;
+    flat.height[record] = newHeight;
+    flat.area[record] = newWidth * newHeight;
+    placeTerminals(record);
+    flat.coordinatesChanged();
+    return updateDirty();
+}
+
+// Put each record where the other one was.
+// Leaves that only match once turned are turned, and anything else has to be the same size.
+double FPNetLength::swapRecords(int first, int second) {
+    double firstX = flat.x[first], firstY = flat.y[first];
+    double firstWidth = flat.width[first], firstHeight = flat.height[first];
+    double secondX = flat.x[second], secondY = flat.y[second];
+    double secondWidth = flat.width[second], secondHeight = flat.height[second];
+    double change = 0;
+    change += resizeRecord(first, secondWidth, secondHeight);
+    change += resizeRecord(second, firstWidth, firstHeight);
+    change += moveRecord(first, secondX - firstX, secondY - firstY);
+    change += moveRecord(second, firstX - secondX, firstY - secondY);
+    return change;
+}
+
+int FPNetLength::swapSiblings() {
+    double d = 0.00001; //for rounding error, as in the overlap detection of the layout
+    int swaps = 0;
+    bool improved = true;
+    while (improved) {
+        improved = false;
+        for (int a = 1; a < flat.size(); a++) {
+            int p = flat.parent[a];
+            // The copies in a grid are all alike, so there is nothing to gain there.
+            if (p < 0 || flat.kind[p] == FPFlatLayout::FlatGrid) continue;
+            for (int b = flat.end[a]; b < flat.end[p]; b = flat.end[b]) {
+                if (flat.nameIndex[a] == flat.nameIndex[b]) continue;
+                bool same = (fabs(flat.width[a] - flat.width[b]) <= d && fabs(flat.height[a] - flat.height[b]) <= d);
+                bool turned = (flat.kind[a] == FPFlatLayout::FlatLeaf && flat.kind[b] == FPFlatLayout::FlatLeaf &&
+                               fabs(flat.width[a] - flat.height[b]) <= d && fabs(flat.height[a] - flat.width[b]) <= d);
+                if (!same && !turned) continue;
+                // Keep the swap only if it helps by more than rounding error, else put it back.
+                if (swapRecords(a, b) < -d) {
+                    swaps += 1;
+                    improved = true;
+                } else swapRecords(a, b);
+            }
+        }
+    }
+    return swaps;
+}
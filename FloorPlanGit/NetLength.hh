@@ -0,0 +1,100 @@
+/* -*- Mode: C++ ; indent-tabs-mode: nil ; c-file-style: "stroustrup" -*-
+
+   Rapid Prototyping Floorplanner Project
+   Author: Greg Faust
+
+   File:   NetLength.hh     C++ Header file for the wire length estimator over a flat layout.
+
+   Include this after FlatLayout.hh.
+
+*/
+
+#include <vector>
+using namespace std;
+
+// FPNet::calcNetLength only measures from each component to the next one in the net,
+//    and only knows about one copy of each component.
+// This works from a frozen layout instead, where every placed copy of a component
+//    is its own terminal, located at the center of that copy.
+// A component that went into a grid of 16 cells is 16 terminals on each of its nets.
+//
+// The models (see NetModel in Floorplan.hh) are:
+//   ChainNet   From terminal to terminal, in the order of the net.
+//   HPWLNet    Half the perimeter of the bounding box of the terminals.
+//   StarNet    From every terminal to the center of gravity of the terminals.
+//   CliqueNet  Between every pair of terminals, weighted by 1/(terminals - 1).
+// All of them give the Manhattan distance for a two terminal net.
+//
+// The terminals of all the nets are kept together in flat arrays, so a full evaluation
+//    is one pass over them.
+// Once evaluated, moving or resizing a record only recomputes the nets that touch it.
+// This is what makes it cheap enough to use as the cost function of an inner loop,
+//    such as swapSiblings below.
+// The total is summed from the nets each time it is asked for, so it never drifts from them.
+
+class FPNetLength {
+public:
+    FPNetLength(FPFlatLayout& flatArg, NetModel modelArg = HPWLNet);
+
+    int      netCount()             { return length.size(); }
+    double   netLength(int net)     { return length[net]; }
+    double   totalLength();
+    NetModel getModel()             { return model; }
+    void     setModel(NetModel modelArg);
+
+    // Recompute every net from scratch.
+    void     evaluate();
+
+    // The total area, in mm^2, by which units of the layout overlap each other.
+    // Overlapping units make the wires look shorter than they can really be,
+    //    so a cost function should add this as a penalty to the wire length.
+    double   overlapArea();
+
+    // Move a record, and everything inside it, by (dx, dy).
+    // The flat layout is updated along with the affected nets.
+    // Returns the change in the total wire length.
+    double   moveRecord(int record, double dx, double dy);
+    // Change the size of a record, keeping its lower left corner where it is.
+    // Anything inside it stays put.
+    // Returns the change in the total wire length.
+    double   resizeRecord(int record, double newWidth, double newHeight);
+
+    // Swap the places of sibling records wherever that makes the wires shorter.
+    // Only siblings of the same size are swapped, or leaves that are the same size once turned,
+    //    so the layout stays legal.
+    // Returns the number of swaps made.
+    int      swapSiblings();
+
+    // The names of the models, for output and for reading them in.
+    static const char * modelName(NetModel modelArg);
+    static bool         parseModel(string name, NetModel& modelArg);
+
+private:
+    FPFlatLayout& flat;
+    NetModel      model;
+
+    // The terminals of net i are netStart[i] up to netStart[i + 1].
+    // A record is only a terminal of a net once, no matter how many of its pins name it.
+    vector<int>    netStart;
+    vector<int>    termRecord;
+    vector<double> termX;
+    vector<double> termY;
+
+    // The terminals of each record, so a change can find the nets to redo.
+    vector<int>    recordStart;
+    vector<int>    recordTerm;
+    vector<int>    termNet;
+
+    vector<double> length;
+
+    // The nets that need recomputing after a change.
+    vector<int>    dirtyNets;
+    vector<bool>   dirty;
+    // Room to sort the terminals of a net for the clique model.
+    vector<double> scratch;
+
+    double   calcNet(int net);
+    void     placeTerminals(int record);
+    double   updateDirty();
+    double   swapRecords(int first, int second);
+};
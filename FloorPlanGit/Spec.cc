@@ -0,0 +1,333 @@
+/* -*- Mode: C++ ; indent-tabs-mode: nil ; c-file-style: "stroustrup" -*-
+
+   Rapid Prototyping Floorplanner Project
+   Author: Greg Faust
+
+   File:   Spec.cc     Read declarative floorplan specifications, and lay them out.
+
+*/
+
+#include <stdlib.h>
+#include <limits.h>
+#include <math.h>
+#include <iostream>
+#include <sstream>
+#include <fstream>
+#include <vector>
+#include <stdexcept>
+#include "MathUtil.hh"
+#include "Floorplan.hh"
+#include "Spec.hh"
+#include "FlatLayout.hh"
+#include "NetLength.hh"
+
+// The spellings of the ComponentType enum, in enum order.
+// These are the C++ names, not the names in TypeNames that end up in the output.
+static const char * typeSpellings [] = {"UnknownType", "Core", "Cache", "ICache", "DCache", "L1", "L2", "L3", "RF", "FPRF", "ALU",
+                                        "NoC", "Control", "CrossBar", "MemController", "Grid", "Group", "Cluster"};
+
+// The spellings of the GeographyHint enum, in enum order.
+#define hintCount 13
+static const char * hintSpellings [] = {"UnknownGeography", "Left", "Right", "Top", "Bottom", "Center", "LeftRight", "LeftRightMirror",
+                                        "LeftRight180", "TopBottom", "TopBottomMirror", "TopBottom180", "Periphery"};
+
+static int findSpelling(const char ** spellings, int count, string& word) {
+    for (int i = 0; i < count; i++)
+        if (word == spellings[i]) return i;
+    return -1;
+}
+
+FPSpec::FPSpec(const char * filename) {
+    fileName = filename;
+    lineNum = 0;
+    floorplanCount = 0;
+    curContainer = 0;
+    curKind = NoContainer;
+}
+
+FPSpec::~FPSpec() {
+    // We hold a reference to every container we defined.
+    // Containers that are also inside other containers will be deleted by whichever lets go last.
+    for (map<string, FPContainer *>::iterator it = containers.begin(); it != containers.end(); it++) {
+        FPContainer * cont = it->second;
+        if (cont->decRefCount() <= 0) delete cont;
+    }
+    // Nets do not own their components, so they can go last.
+    for (map<string, FPNet *>::iterator it = nets.begin(); it != nets.end(); it++) delete it->second;
+}
+
+void FPSpec::error(string message) {
+    throw invalid_argument(fileName + ":" + getStringFromInt(lineNum) + ": " + message);
+}
+
+static double parseNumber(string& word, const char * what) {
+    char * end;
+    double value = strtod(word.c_str(), &end);
+    if (word.empty() || *end != 0) throw invalid_argument(string("Bad ") + what + " '" + word + "'");
+    return value;
+}
+
+// Counts have to be whole numbers, and at least one, rather than whatever a cast would make of them.
+static int parseCount(string& word) {
+    double value = parseNumber(word, "count");
+    if (!(value >= 1 && value <= INT_MAX && value == floor(value)))
+        throw invalid_argument("Bad count '" + word + "', it must be a whole number of at least 1");
+    return (int) value;
+}
+
+FPContainer * FPSpec::findContainer(string& name) {
+    map<string, FPContainer *>::iterator it = containers.find(name);
+    if (it == containers.end()) error("Unknown container '" + name + "'.");
+    return it->second;
+}
+
+FPNet * FPSpec::findNet(string& name) {
+    map<string, FPNet *>::iterator it = nets.find(name);
+    if (it == nets.end()) error("Unknown net '" + name + "'.");
+    return it->second;
+}
+
+FPNet * FPSpec::defineNet(string& name) {
+    map<string, FPNet *>::iterator it = nets.find(name);
+    if (it != nets.end()) return it->second;
+    FPNet * net = new FPNet();
+    nets[name] = net;
+    return net;
+}
+
+void FPSpec::defineContainer(string& name, FPContainer * cont) {
+    if (containers.find(name) != containers.end()) {
+        delete cont;
+        error("Container '" + name + "' is already defined.");
+    }
+    // Hold our own reference so that adding it to other containers does not give it away.
+    cont->incRefCount();
+    containers[name] = cont;
+}
+
+void FPSpec::addCluster(string * tokens, int tokenCount) {
+    if (tokenCount < 6) error("Usage: cluster <component> <count> <area> <maxAR> <minAR> [<hint>] [nets <net> ...]");
+    int    count;
+    double area, maxAR, minAR;
+    try {
+        count = parseCount(tokens[2]);
+        area  = parseNumber(tokens[3], "area");
+        maxAR = parseNumber(tokens[4], "maxAR");
+        minAR = parseNumber(tokens[5], "minAR");
+    } catch (invalid_argument& e) {
+        error(e.what());
+    }
+
+    int next = 6;
+    GeographyHint hint = UnknownGeography;
+    if (next < tokenCount && tokens[next] != "nets") {
+        int hintIndex = findSpelling(hintSpellings, hintCount, tokens[next]);
+        if (hintIndex <= 0) error("Unknown hint '" + tokens[next] + "'.");
+        hint = (GeographyHint) hintIndex;
+        next += 1;
+    }
+    if (curKind == GeogContainer && hint == UnknownGeography) error("Components of a geog container need a hint.");
+    if (curKind != GeogContainer && hint != UnknownGeography) error("Hints are only allowed in geog containers.");
+
+    // Gather up the nets before we create anything.
+    vector<FPNet *> netList;
+    if (next < tokenCount) {
+        if (tokens[next] != "nets") error("Expected 'nets' but found '" + tokens[next] + "'.");
+        for (next += 1; next < tokenCount; next++) netList.push_back(findNet(tokens[next]));
+    }
+
+    FPObject * comp;
+    int typeIndex = findSpelling(typeSpellings, ComponentTypeCount, tokens[1]);
+    if (curKind == GeogContainer) {
+        geogLayout * geog = (geogLayout *) curContainer;
+        if (typeIndex > 0) comp = geog->addComponentCluster((ComponentType) typeIndex, count, area, maxAR, minAR, hint);
+        else               comp = geog->addComponentCluster(tokens[1], count, area, maxAR, minAR, hint);
+    } else {
+        if (typeIndex > 0) comp = curContainer->addComponentCluster((ComponentType) typeIndex, count, area, maxAR, minAR);
+        else               comp = curContainer->addComponentCluster(tokens[1], count, area, maxAR, minAR);
+    }
+    for (unsigned int i = 0; i < netList.size(); i++) netList[i]->addWireTo(comp);
+}
+
+void FPSpec::addContainer(string * tokens, int tokenCount) {
+    if (tokenCount < 3 || tokenCount > 4) error("Usage: add <container> <count> [<hint>]");
+    FPContainer * comp = findContainer(tokens[1]);
+    if (comp == curContainer) error("A container can not be added to itself.");
+    int count = 1;
+    try {
+        count = parseCount(tokens[2]);
+    } catch (invalid_argument& e) {
+        error(e.what());
+    }
+
+    if (curKind == GeogContainer) {
+        if (tokenCount < 4) error("Containers added to a geog container need a hint.");
+        int hintIndex = findSpelling(hintSpellings, hintCount, tokens[3]);
+        if (hintIndex <= 0) error("Unknown hint '" + tokens[3] + "'.");
+        ((geogLayout *) curContainer)->addComponent(comp, count, (GeographyHint) hintIndex);
+    } else {
+        if (tokenCount == 4) error("Hints are only allowed in geog containers.");
+        curContainer->addComponent(comp, count);
+    }
+}
+
+void FPSpec::produceFloorplan(string * tokens, int tokenCount) {
+    if (tokenCount < 4) error("Usage: floorplan <container> <targetAR> <output basename> [blocks] [nets] [nonames] [svg] [wirelength [<model>]] [swap]");
+    FPContainer * cont = findContainer(tokens[1]);
+    double targetAR = 1.0;
+    try {
+        targetAR = parseNumber(tokens[2], "aspect ratio");
+    } catch (invalid_argument& e) {
+        error(e.what());
+    }
+    if (targetAR <= 0) error("Aspect ratio must be positive.");
+
+    FPContext& ctx = currentContext();
+    bool blocks = false, netsOut = false, names = true, wires = false, swap = false, svg = ctx.svgOutput;
+    NetModel model = HPWLNet;
+    for (int i = 4; i < tokenCount; i++) {
+        if      (tokens[i] == "blocks")  blocks = true;
+        else if (tokens[i] == "nets")    netsOut = true;
+        else if (tokens[i] == "nonames") names = false;
+        else if (tokens[i] == "svg")     svg = true;
+        else if (tokens[i] == "wirelength") {
+            wires = true;
+            if (i + 1 < tokenCount && FPNetLength::parseModel(tokens[i + 1], model)) i += 1;
+        }
+        else if (tokens[i] == "swap")    swap = true;
+        else error("Unknown floorplan option '" + tokens[i] + "'.");
+    }
+    string baseName = tokens[3];
+
+    // The .blocks file describes the components before they are rearranged by the layout.
+    if (blocks) {
+        ostream& PFPOut = outputBlockFileHeader((baseName + ".blocks").c_str());
+        cont->outputBlockFile(PFPOut);
+        outputBlockFileFooter(PFPOut);
+    }
+
+    bool success = cont->layout(AspectRatio, targetAR);
+    if (!success) {
+        cerr << fileName << ":" << lineNum << ": Unable to layout specified configuration " << tokens[1] << ".\n";
+        return;
+    }
+
+    // Freeze the layout once, and write everything else from that.
+    FPFlatLayout flat(cont);
+    if (netsOut) {
+        ostream& PFPNetsOut = outputNetsFileHeader((baseName + ".nets").c_str());
+        flat.outputNetsFile(PFPNetsOut);
+        outputNetsFileFooter(PFPNetsOut);
+    }
+
+    if (wires || swap) {
+        FPNetLength lengths(flat, model);
+        if (wires) {
+            cout << "Wire length of " << baseName << " (" << FPNetLength::modelName(model) << "): "
+                 << lengths.totalLength() << " mm over " << lengths.netCount() << " net(s)";
+            double overlap = lengths.overlapArea();
+            if (overlap > 0) cout << ", with " << overlap << " mm^2 of overlapping units";
+            cout << "\n";
+        }
+        if (swap) {
+            int swaps = lengths.swapSiblings();
+            cout << "Swapped " << swaps << " pair(s) of units in " << baseName << ", for a wire length of "
+                 << lengths.totalLength() << " mm\n";
+        }
+    }
+
+    setNameMode(names);
+    ostream& HSOut = outputHotSpotHeader((baseName + ".flp").c_str());
+    flat.outputHotSpotLayout(HSOut);
+    outputHotSpotFooter(HSOut);
+    if (svg) {
+        ostream& SVGOut = outputSVGHeader((baseName + ".svg").c_str());
+        flat.outputSVG(SVGOut);
+        outputSVGFooter(SVGOut);
+    }
+    setNameMode(true);
+
+    floorplanCount += 1;
+}
+
+void FPSpec::parseLine(string& line) {
+    // Strip off the comment, and break the rest into tokens.
+    size_t hash = line.find('#');
+    if (hash != string::npos) line.erase(hash);
+    istringstream words(line);
+    vector<string> tokens;
+    string word;
+    while (words >> word) tokens.push_back(word);
+    if (tokens.empty()) return;
+
+    string& keyword = tokens[0];
+    int tokenCount = tokens.size();
+
+    if (keyword == "net") {
+        if (tokenCount != 2) error("Usage: net <net>");
+        FPNet * net = defineNet(tokens[1]);
+        if (curContainer) curContainer->addNet(net);
+    } else if (keyword == "geog" || keyword == "bag" || keyword == "grid") {
+        if (curContainer) error("Container definitions can not be nested.  Define '" + tokens[1] + "' first, then add it.");
+        if (tokenCount != 2) error("Usage: " + keyword + " <name>");
+        FPContainer * cont;
+        if      (keyword == "geog") { cont = new geogLayout(); curKind = GeogContainer; }
+        else if (keyword == "bag")  { cont = new bagLayout();  curKind = BagContainer; }
+        else                        { cont = new gridLayout(); curKind = GridContainer; }
+        defineContainer(tokens[1], cont);
+        curContainer = cont;
+        curName = tokens[1];
+    } else if (keyword == "fixed") {
+        if (curContainer) error("Fixed layouts can not be defined inside another container.");
+        if (tokenCount < 3 || tokenCount > 4) error("Usage: fixed <name> <hotspot flp file> [<scaling factor>]");
+        double scale = 1.0;
+        if (tokenCount == 4) {
+            try {
+                scale = parseNumber(tokens[3], "scaling factor");
+            } catch (invalid_argument& e) {
+                error(e.what());
+            }
+        }
+        ifstream test(tokens[2].c_str());
+        if (!test) error("Unable to open fixed layout file '" + tokens[2] + "'.");
+        defineContainer(tokens[1], new fixedLayout(tokens[2].c_str(), scale));
+    } else if (keyword == "cluster") {
+        if (!curContainer) error("'cluster' is only allowed inside a container definition.");
+        addCluster(&tokens[0], tokenCount);
+    } else if (keyword == "add") {
+        if (!curContainer) error("'add' is only allowed inside a container definition.");
+        addContainer(&tokens[0], tokenCount);
+    } else if (keyword == "mirror") {
+        if (!curContainer) error("'mirror' is only allowed inside a container definition.");
+        if (tokenCount != 2 || (tokens[1] != "x" && tokens[1] != "y")) error("Usage: mirror x | y");
+        if (tokens[1] == "x") curContainer->xMirror = true;
+        else                  curContainer->yMirror = true;
+    } else if (keyword == "end") {
+        if (!curContainer) error("'end' without a container definition.");
+        curContainer = 0;
+        curKind = NoContainer;
+    } else if (keyword == "floorplan") {
+        if (curContainer) error("Container '" + curName + "' is missing its 'end'.");
+        produceFloorplan(&tokens[0], tokenCount);
+    } else {
+        error("Unknown statement '" + keyword + "'.");
+    }
+}
+
+int FPSpec::parse(istream& in) {
+    string line;
+    while (getline(in, line)) {
+        lineNum += 1;
+        parseLine(line);
+    }
+    if (curContainer) error("Container '" + curName + "' is missing its 'end'.");
+    return floorplanCount;
+}
+
+int layoutSpecFile(const char * filename) {
+    FPSpec spec(filename);
+    if (string(filename) == "-") return spec.parse(cin);
+    ifstream in(filename);
+    if (!in) throw invalid_argument(string("Unable to open spec file ") + filename);
+    return spec.parse(in);
+}
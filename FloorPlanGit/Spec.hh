@@ -0,0 +1,97 @@
+/* -*- Mode: C++ ; indent-tabs-mode: nil ; c-file-style: "stroustrup" -*-
+
+   Rapid Prototyping Floorplanner Project
+   Author: Greg Faust
+
+   File:   Spec.hh     C++ Header file for the declarative floorplan specification reader.
+
+   Include this after Floorplan.hh.
+
+*/
+
+#include <string>
+#include <iostream>
+#include <map>
+using namespace std;
+
+// A floorplan specification is a plain text file that describes the same trees
+//    that the generate* routines in Main.cc build by hand.
+// It is read a line at a time, and each floorplan is layed out and written
+//    as soon as its "floorplan" statement is seen.
+// So a single run of ArchFP can produce any number of floorplans without recompiling.
+//
+// Tokens are separated by white space, and everything after a '#' is a comment.
+// The statements are:
+//
+//   net <net>
+//       Declare a net.  Inside a container, the net is also added to that container,
+//       which is what makes it show up in the .nets output of that container.
+//   geog <name> | bag <name> | grid <name>
+//       Start the definition of a container.  It is ended by "end".
+//   fixed <name> <hotspot flp file> [<scaling factor>]
+//       Read in an existing floorplan as a fixed layout.
+//   cluster <component> <count> <area> <maxAR> <minAR> [<hint>] [nets <net> ...]
+//       Add a cluster of components to the current container.
+//       Counts here and in add are whole numbers of at least 1.
+//       If the component name is a ComponentType (e.g. L2, Core, NoC), that type is used.
+//   add <container> <count> [<hint>]
+//       Add a previously defined container to the current container.
+//   mirror x | y
+//       Mirror the current container when it is output.
+//   end
+//       End the definition of the current container.
+//   floorplan <container> <targetAR> <output basename> [blocks] [nets] [nonames] [svg] [wirelength [<model>]] [swap]
+//       Layout the container and write <basename>.flp.
+//       Optionally also write the .blocks and .nets files.
+//       nonames suppresses unit names in the .flp file (and the .svg).
+//       svg also draws the floorplan into <basename>.svg, as does running ArchFP with -g.
+//       wirelength prints the total length of the container's nets, using the
+//       chain, hpwl (the default), star or clique model.  See NetLength.hh.
+//       If any units overlap, it also prints the area of the overlap.
+//       swap then trades the places of sibling units and containers of the same size
+//       wherever that shortens the nets, in the same model, before anything is written.
+//
+// Hints are only allowed in geog containers, and are spelled as in the GeographyHint enum.
+
+class FPContainer;
+class FPNet;
+
+// The kinds of container definition a spec can be in the middle of.
+enum SpecContainerKind {NoContainer, GeogContainer, BagContainer, GridContainer};
+
+class FPSpec {
+    string fileName;            // Used to make error messages useful.
+    int    lineNum;
+    int    floorplanCount;      // The number of floorplans produced so far.
+
+    // Everything defined in the spec, by name.
+    map<string, FPContainer *> containers;
+    map<string, FPNet *>       nets;
+
+    // The container currently being defined, if any.
+    FPContainer * curContainer;
+    string        curName;
+    SpecContainerKind curKind;
+
+    void          parseLine(string& line);
+    void          error(string message);
+    FPContainer * findContainer(string& name);
+    FPNet *       findNet(string& name);
+    FPNet *       defineNet(string& name);
+    void          defineContainer(string& name, FPContainer * cont);
+    void          addCluster(string * tokens, int tokenCount);
+    void          addContainer(string * tokens, int tokenCount);
+    void          produceFloorplan(string * tokens, int tokenCount);
+
+public:
+    FPSpec(const char * filename);
+    ~FPSpec();
+
+    // Read statements until the end of the stream.
+    // Returns the number of floorplans produced.
+    int parse(istream& in);
+};
+
+// Read a spec from the named file, or from stdin if the name is "-".
+// Returns the number of floorplans produced.
+int layoutSpecFile(const char * filename);
@@ -0,0 +1,101 @@
+# ArchFP floorplan specification for a 45nm Penryn core.
+# This is the same floorplan as generatePenryn45nm() in Main.cc.
+# Areas are from McPAT, already scaled by the 1.1 read port overhead
+#   (Dtlb, Itlb, StQ, LdQ and DCache) and the 1.20496 undiff ratio.
+
+# MMU
+geog MMU
+    cluster Dtlb    1 0.34355686974400007  20 1 Left
+    cluster Itlb    1 0.0782631400672      20 1 Right
+end
+
+# ReN
+geog ReN
+    cluster IntRAT  1 0.71966236           20 1 Left
+    cluster FlpRAT  1 0.42253368352        20 1 Center
+    cluster FL      1 0.03880392936        20 1 Right
+end
+
+# IFU Bottom Left
+geog IFU_BL
+    cluster BTB     1 0.42111424064        20 1 Left
+    cluster BrP     1 0.18437936432        20 1 Center
+    cluster InstBuf 1 0.033546809376       20 1 Right
+end
+
+# IFU left
+geog IFU_L
+    cluster InstDec 1 2.2388036304         20 1 Top
+    add IFU_BL 1 Bottom
+end
+
+# IFU
+geog IFU
+    add IFU_L 1 Left
+    cluster ICache  1 0.84641330736        20 1 Right
+end
+
+# core Bottom Right Corner
+geog core_BR
+    add ReN 1 Top
+    add IFU 1 Center
+    add MMU 1 Bottom
+end
+
+# LSU Top
+geog LSU_T
+    cluster StQ     1 1.4050628873600002   20 1 Left
+    cluster LdQ     1 0.345686877536       20 1 Right
+end
+
+# LSU
+geog LSU
+    add LSU_T 1 Top
+    cluster DCache  1 6.1638210550400006   20 1 Bottom
+end
+
+# Core Lower Half
+geog core_LH
+    add core_BR 1 Right
+    add LSU 1 Left
+end
+
+# RF in execution block combined with complex ALUs
+geog EXE_RF
+    cluster IntRF   1 0.40540397216        20 1 Top
+    cluster FlpRF   1 0.2309064848         20 1 Center
+    cluster CplALU  1 0.28368975760000004  20 1 Bottom
+end
+
+# IW in exe block
+geog EXE_IW
+    cluster IntIW   1 1.07204206736        20 1 Top
+    cluster FlpIW   1 0.41863081807999997  20 1 Center
+end
+
+# EXE Bottom Right Corner
+geog EXE_BR
+    add EXE_RF 1 Left
+    add EXE_IW 1 Center
+    cluster ROB     1 0.8882109598400001   20 1 Right
+end
+
+# EXE Right
+geog EXE_R
+    cluster ALU     1 3.4042770912         20 1 Top
+    add EXE_BR 1 Bottom
+end
+
+# EXE
+geog EXE
+    cluster FPU     1 5.6133061600000005   20 1 Left
+    add EXE_R 1 Right
+end
+
+# Core area
+geog core
+    add EXE 1 Center
+    add core_LH 1 Bottom
+end
+
+floorplan core 1 Penryn45 nonames
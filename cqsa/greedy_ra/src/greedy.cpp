@@ -1386,5 +1386,8 @@ int main(int argc, char* argv[]) {
     }
   
     cout << "### Total number of designs evaluated: " << nExpl << endl;
+    if (sys.getThermalCache().isOpen())
+	cout << "*** Thermal cache: " << sys.getThermalCache().getHits() << " hits, "
+	     << sys.getThermalCache().getMisses() << " misses" << endl;
     return 0;
 }
@@ -87,6 +87,11 @@ public:
 	Component(string cname, componentLibraryEntry *compLib, componentType cType, int cID, bool sysInitTemp);
 	virtual ~Component();
 
+	// copy of this component with failure mechanisms of its own drawing
+	// from rng, for a sampling thread; its preclusions are still the originals
+	Component *clone(gsl_rng *rng) const;
+	void deleteMechanisms();	// free the mechanisms of a copy
+
 	void setComponentType(componentType cType);
 	void clearRedundancy();
 	
@@ -159,6 +164,7 @@ public:
 	void addPreclusion(Component *c);
 	list<Component*> getPreclusions() const { return preclusions; }
 	int getNPreclusions() const { return n_preclusions; }
+	void setPreclusions(list<Component*> cs) { preclusions = cs; n_preclusions = (int) cs.size(); }
 
 	// manipulate initial tasks
 	void addInitialTask(Task *t);
@@ -47,6 +47,11 @@ public:
 	// set various parameters
 	void setMTTF(float time) { mttf = time; }
 	void setTimeToFailure(float time) { failureTime = time; }
+	void setOwner(Component *fowner) { owner = fowner; }
+	void setRNG(gsl_rng *rng) { rand_ln = rng; }
+
+	// copy of this mechanism for another component, drawing from rng
+	virtual FailureMechanism *clone(Component *fowner, gsl_rng *rng) const;
 
 	// update component-dependent parameters
 	virtual void updateParameters(); 
@@ -42,6 +42,9 @@ class ManufacturingDefect
     // set various parametrs
     void setDefectDensity(float density) { defectDensity = density; }
 
+    // copy of this defect model for another component, drawing from rng
+    ManufacturingDefect *clone(Component *downer, gsl_rng *rng) const;
+
     void initialize();       // initialize expected yield
     bool sample();           // generate a random defect sample
 };
@@ -12,6 +12,9 @@
 #include <map>
 #include <vector>
 #include <string>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #include "ComponentLibrary.h"
 #include "TaskMapping.h"
@@ -19,10 +22,14 @@
 #include "ComponentNet.h"
 #include "TaskNet.h"
 #include "Task.h"
+#include "ThermalCache.h"
 #include "blockFiller.h"
 
 using namespace std;
 
+// HotSpot's in-memory thermal model (see hotSpot/hotspot.h)
+struct hotspot_handle_t_st;
+
 // caching settings
 #define CACHE_OPSCN
 //#define CACHE_OPSCN_LIMIT 0
@@ -86,6 +93,19 @@ struct ltstr
   }
 };
 
+// one thread's share of a parallel sampling run: copies of the components,
+// whose failure mechanisms draw from the thread's own random number
+// generator, and the sums of the samples it has generated
+struct SamplingWorker
+{
+  gsl_rng *rng;
+  vector<Component*> components;
+  set<Component*,compareComponentIDs> failedComponents;
+  int n_samples;
+  double sum1;			// sum of the samples
+  double sum2;			// sum of their squares
+};
+
 typedef enum {TG_SECTION_NONE,
 	      TG_SECTION_COMP,
 	      TG_SECTION_COMM} TG_SECTIONTYPE;
@@ -124,6 +144,7 @@ class System
 	bool fpAreaMin;
 	float fpAreaWeight;
 	float fpWireWeight;
+	int fpSeed;                     // ParquetFP random seed, or -1 to seed from the clock
 	
 	string workingDirectory; 	// working directory where temporary files are stored
 	
@@ -156,6 +177,12 @@ class System
 	int m_samples;			// maximum number of samples to generate
 	float moment1;			// first moment
 	float moment2;			// second moment
+	int samplingThreads;		// threads generating samples, 0 for one per processor
+
+#ifdef _OPENMP
+	// held by a sampling thread while it uses the scenarios and task mappings
+	omp_lock_t scenarioLock;
+#endif
 
 #ifdef STATS
 	// store the average time of the first failure
@@ -200,6 +227,10 @@ class System
 	// hotSpot parameters
 	float r_convec;                 // convection resistance
 	bool externalRConvec;           // true when r_convec is provided by the cmd line
+	hotspot_handle_t_st *thermalModel; // in-memory thermal model of the filled floorplan
+	vector<int> thermalUnits;       // floorplan unit of each component in the thermal model
+	string thermalSolver;           // HotSpot block model steady state solver (lu, cholesky or pcg)
+	ThermalCache thermalCache;      // steady state temperatures kept on disk across runs
 	
 	// indicates whether or not the initial component temps have been found
 	bool initialTempsFound;
@@ -218,6 +249,12 @@ public:
 	void setRConvec(float rc) { r_convec = rc; }
 	bool getExternalRCConvec() const { return externalRConvec; }
 	void setExternalRConvec(bool extRC) { externalRConvec = true; }
+	hotspot_handle_t_st *getThermalModel() { return thermalModel; }
+	void setThermalModel(hotspot_handle_t_st *hs) { thermalModel = hs; }
+	vector<int> &getThermalUnits() { return thermalUnits; }
+	string getThermalSolver() const { return thermalSolver; }
+	void setThermalSolver(string solver) { thermalSolver = solver; }
+	ThermalCache &getThermalCache() { return thermalCache; }
 	
 	// set working directory
 	void removeWorkingDirectory();
@@ -237,6 +274,7 @@ public:
 	bool getFPAreaMin() const { return fpAreaMin; }
 	float getFPAreaWeight() const { return fpAreaWeight; }
 	float getFPWireWeight() const { return fpWireWeight; }
+	int getFPSeed() const { return fpSeed; }
 	componentType getMaxMemoryType() { return maxMemoryType; }
 	
 	// set system parameters
@@ -258,6 +296,7 @@ public:
 	void setFPAreaMin(bool min) { fpAreaMin = min; }
 	void setFPAreaWeight(float aw) { fpAreaWeight = aw; }
 	void setFPWireWeight(float ww) { fpWireWeight = ww; }
+	void setFPSeed(int seed) { fpSeed = seed; }
 	
 	// get various data structures
 	vector<Component*> getComponents();		// get the vector of all components
@@ -365,10 +404,16 @@ public:
 	// sample generation and support functions
 	int getMaxSamples() const; 	        // get max samples
 	void setMaxSamples(int samples); 	// set max samples
-	void resolvePreclusions(Component *c); 	// propagate failure to preclusions
-	bool resolveSystemFailure(); 	        // determine if system is failed
+	int getSamplingThreads() const { return samplingThreads; }
+	void setSamplingThreads(int threads) { samplingThreads = threads; }
+	// propagate failure to preclusions
+	void resolvePreclusions(Component *c, set<Component*,compareComponentIDs> &failed);
+	// determine if system is failed
+	bool resolveSystemFailure(const vector<Component*> &sampleComponents,
+				  const set<Component*,compareComponentIDs> &failed);
 	void updateStatistics(float data); 	// update statistics
-	void sample();                  	// generate a sample
+	void sample(SamplingWorker *worker = NULL); // generate a sample, with a thread's copies if given
+	void generateSamples();                 // generate maxSamples, split between the sampling threads
 	// resets and generates maxSamples, using db'd results if available
 	// returns true if system was found in the database, false otherwise
 	bool samplingRun();
@@ -439,10 +484,28 @@ public:
 	
  private:
 	// Set each component temperature according to the given operating scenario
-	void readTempsFromFile(int operatingScenarioIndex);
+	void readTemps(int operatingScenarioIndex);
+
+	// Find the power and temperatures of every task mapping that doesn't have them yet,
+	// solving the thermal model for all of them together.  The power of task mapping current
+	// is found last, so the components are left with its bandwidths.
+	void calculatePendingTemps(int current);
+
+	// Find the operating scenarios with a single component failed, and solve their
+	// temperatures in one batch before sampling starts
+	void buildSingleFailureScenarios();
 
 	// Set each component power according to the given operating scenario
-	void updatePowerValues(int operatingScenarioIndex);
+	void updatePowerValues(int operatingScenarioIndex, const vector<Component*> &sampleComponents);
+
+	// the system's own components in a scenario of a sampling thread's copies
+	set<Component*,compareComponentIDs> systemScenario(const set<Component*,compareComponentIDs> &scenario);
+
+	// support for parallel sampling
+	void lockScenarios();
+	void unlockScenarios();
+	void resetSampleTemps(SamplingWorker *worker); // setInitialComponentTemps() for a thread's copies
+	void addSample(SamplingWorker *worker, float data); // count a sample in the statistics or a thread's sums
 
 	string buildOperatingScenarioKey(set<Component*,compareComponentIDs> scenario);
 
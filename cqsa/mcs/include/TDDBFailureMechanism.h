@@ -27,6 +27,7 @@ public:
 	float calculateMTTF();
 	float updateFailureTime();
 	void initialize();
+	FailureMechanism *clone(Component *fowner, gsl_rng *rng) const;
 };
 
 #endif
@@ -37,6 +37,9 @@ private:
 
 	// vector parallels main component vector, saves component power
 	vector<float> power;
+
+	// vector parallels main component vector, saves component steady state temperature
+	vector<float> temperature;
 	
 	// Indicates whether or not a valid task mapping was found during object creation
 	bool mappingFound;
@@ -44,6 +47,10 @@ private:
 	// Indicates whether or not HotSpot has been used to calculate temperatures for this task mapping
 	bool tempsCalculated;
 
+	// Seed of the random stream the permutations are drawn from, or -1 to use rand()
+	int shuffleSeed;
+	unsigned int shuffleState;
+
 	// Compares available capacity in the system to the required capacity for all tasks to be remapped to
 	// determine whether or not any remapping is possible
 	bool checkAvailableCapacity(vector<Component *> componentsToBeMapped, vector<set<Task *> > tasksToBeMapped);
@@ -79,8 +86,9 @@ public:
 	// Constructs a blank task mapping
 	TaskMapping(System *sys);
 	
-	// Constructs a task mapping from an operating scenario (sys.operatingScenarios[pos])
-	TaskMapping(System *sys, set<Component*,compareComponentIDs> curScenario);
+	// Constructs a task mapping from an operating scenario (sys.operatingScenarios[pos]),
+	// drawing the permutations from a stream of their own if a seed is given
+	TaskMapping(System *sys, set<Component*,compareComponentIDs> curScenario, int seed = -1);
 	
 	// Task mapping destructor
 	virtual ~TaskMapping();
@@ -114,6 +122,10 @@ public:
 	// push a power value on the power vector
 	void pushPower(float cPower) { power.push_back(cPower); }
 	float getPower(int idx) { return power[idx]; }
+
+	// set and get the temperatures found by HotSpot
+	void setTemperatures(vector<float> temps) { temperature = temps; }
+	float getTemperature(int idx) { return temperature[idx]; }
 };
 
 bool compareComponentDistances(const componentDistance a, const componentDistance b);
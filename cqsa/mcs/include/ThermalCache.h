@@ -0,0 +1,63 @@
+/*                                                                              
+   Copyright 2009 Carnegie Mellon University.                                   
+                                                                                
+   This software developed under GRC contract 2008-HJ-1795 funded by            
+   the Semiconductor Research Corporation.                                      
+*/
+
+#ifndef THERMALCACHE_H_
+#define THERMALCACHE_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// On-disk cache of HotSpot steady state temperatures, shared by every process
+// pointed at the same directory. An entry is addressed by a hash of everything
+// the temperatures depend on: the contents of the filled floorplan file, the
+// chip parameters, the solver and the power vector. Each entry is its own file
+// holding that key in full (floorplan text included) followed by the
+// temperatures, so a hash collision is a miss and never a wrong answer. Entries
+// are written to a temporary file and renamed into place, so concurrent
+// processes never see a partial one.
+class ThermalCache
+{
+private:
+  string directory;        // empty when the cache is off
+  string floorplan;        // contents of the filled floorplan file
+  unsigned long hits;
+  unsigned long misses;
+
+  // the key of one solve, and its file
+  string buildKey(float maxDimension, float r_convec, const string &solver,
+		  const vector<double> &power) const;
+  string entryFile(const string &key) const;
+
+public:
+  // Constructors
+  ThermalCache();
+
+  // Destructor
+  virtual ~ThermalCache();
+
+  // turn the cache on, creating the directory if needed
+  bool open(const string &dir);
+  bool isOpen() const { return !directory.empty(); }
+
+  // read the filled floorplan the following solves are for
+  bool setFloorplan(const string &floorplanFileName);
+
+  // the temperatures for a power vector (both in floorplan order), if cached
+  bool lookup(float maxDimension, float r_convec, const string &solver,
+	      const vector<double> &power, vector<double> &temp);
+  void store(float maxDimension, float r_convec, const string &solver,
+	     const vector<double> &power, const vector<double> &temp);
+
+  // Accessors
+  unsigned long getHits() const { return hits; }
+  unsigned long getMisses() const { return misses; }
+};
+
+#endif
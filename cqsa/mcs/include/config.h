@@ -25,6 +25,12 @@ typedef enum {SECTION_NONE,
 void parse_cmd_sys(int argc, char *argv[], System &sys);
 void parse_config(const char *filename, System &sys);
 //void run_HotSpot_simulations(System *sys);
+// build (or rebuild) the in-memory thermal model of the filled floorplan
+void open_thermal_model(System *sys, float maxDimension, float r_convec);
+void close_thermal_model(System *sys);
+// find the steady state temperatures of an operating scenario, and store them in its task mapping
 void run_single_HotSpot_simulation(System *sys, int pos, float maxDimension, float r_convec);
+// the same for several operating scenarios at once, sharing one factorisation of the model
+void run_HotSpot_batch(System *sys, vector<int> &positions, float maxDimension, float r_convec);
 
 #endif
@@ -14,6 +14,10 @@ extern "C" double getRouterPower(int degree, double load);
 //extern int mcsVerbosity;
 
 void create_power_traces(System *sys);
+// Work out the power of every component in an operating scenario, and store
+// it in the scenario's task mapping
+void calculate_single_power(System *sys, int pos);
+// ... and also write it out as a HotSpot power trace
 void create_single_power_trace(System *sys, int pos);
 
 #endif
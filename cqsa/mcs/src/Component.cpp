@@ -45,6 +45,33 @@ Component::~Component()
 	// TODO: destruct failure mechanisms?
 }
 
+Component *Component::clone(gsl_rng *rng) const
+{
+	Component *c = new Component(*this);
+
+	c->failureMechanisms.clear();
+	for (list<FailureMechanism*>::const_iterator iter = failureMechanisms.begin();
+	     iter != failureMechanisms.end(); iter++) {
+	    c->failureMechanisms.push_back((*iter)->clone(c, rng));
+	} // for
+	c->defectMechanism = defectMechanism->clone(c, rng);
+
+	return c;
+}
+
+void Component::deleteMechanisms()
+{
+	for (list<FailureMechanism*>::iterator iter = failureMechanisms.begin();
+	     iter != failureMechanisms.end(); iter++) {
+	    delete *iter;
+	} // for
+	failureMechanisms.clear();
+	n_failureMechanisms = 0;
+
+	delete defectMechanism;
+	defectMechanism = NULL;
+}
+
 void Component::setComponentType(componentType type) {
 	vdd = componentLibrary[type].vdd;
 
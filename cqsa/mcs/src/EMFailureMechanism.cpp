@@ -27,6 +27,14 @@ EMFailureMechanism::~EMFailureMechanism()
 {
 }
 
+FailureMechanism *EMFailureMechanism::clone(Component *fowner, gsl_rng *rng) const
+{
+	EMFailureMechanism *fm = new EMFailureMechanism(*this);
+	fm->setOwner(fowner);
+	fm->setRNG(rng);
+	return fm;
+}
+
 void EMFailureMechanism::updateParameters() {
     componentType cType = getOwner()->getCType();
     componentLibraryEntry *compLib = getOwner()->getComponentLibrary();
@@ -50,6 +50,14 @@ FailureMechanism::~FailureMechanism()
 {
 }
 
+FailureMechanism *FailureMechanism::clone(Component *fowner, gsl_rng *rng) const
+{
+	FailureMechanism *fm = new FailureMechanism(*this);
+	fm->setOwner(fowner);
+	fm->setRNG(rng);
+	return fm;
+}
+
 /*
 void FailureMechanism::setInitialTemperature(float temperature)
 {
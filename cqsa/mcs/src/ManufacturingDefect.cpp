@@ -25,6 +25,13 @@ ManufacturingDefect::ManufacturingDefect(string dname, Component *downer, gsl_rn
     defectDensity = DEFECTDENSITY;
 }
 
+ManufacturingDefect *ManufacturingDefect::clone(Component *downer, gsl_rng *rng) const {
+    ManufacturingDefect *md = new ManufacturingDefect(*this);
+    md->owner = downer;
+    md->rand_u = rng;
+    return md;
+}
+
 void ManufacturingDefect::initialize() {
     // calculate average yield
     yield = (float) pow((double) (1 + owner->getArea() * owner->getCriticalFraction() * defectDensity), (double) -14.5);
@@ -62,11 +62,17 @@ System::System()
 	netlistFileName = "";
 	databaseFileName = "";
 	m_samples = N_SAMPLES;
+	samplingThreads = 1;
+#ifdef _OPENMP
+	omp_init_lock(&scenarioLock);
+#endif
 	initialTaskMapping = new TaskMapping(this);
 	reset();
 
 	// default value
 	r_convec = 15;
+	thermalModel = NULL;
+	thermalSolver = "lu";
 	
 	setWorkingDirectory();
 
@@ -74,13 +80,18 @@ System::System()
 	fpIter = FP_ITER;
 	fpAreaWeight = FP_AW;
 	fpWireWeight = FP_WW;
+	fpSeed = -1;
 
 	maxMemoryType = MEM2MB;
 }
 
 System::~System()
 {
-	// Nothing needs to be done here assuming that strings free themselves
+	// Strings free themselves, but the thermal model does not
+	close_thermal_model(this);
+#ifdef _OPENMP
+	omp_destroy_lock(&scenarioLock);
+#endif
 }
 
 float System::averageComponentTemperature() {
@@ -115,8 +126,8 @@ void System::calibrateRConvec(int taskmapping) {
 	// run hotSpot
 	run_single_HotSpot_simulation(this, taskmapping, (xsize >= ysize) ? xsize : ysize, r_convec);
 
-	// read temperature file
-	readTempsFromFile(taskmapping);
+	// read back the temperatures
+	readTemps(taskmapping);
 
 	// determine average component temperature
 	float avgTemp = averageComponentTemperature();
@@ -1137,9 +1148,12 @@ void System::setInitialComponentTemps()
 	      cout << "fillBlocks() failed...now exiting" << endl;
 	      cleanUpAndExit(1);
 	  }
+
+	  // build the thermal model of the filled floorplan, used for every operating scenario
+	  open_thermal_model(this, (xsize >= ysize) ? xsize : ysize, r_convec);
 	  
-	  // create the system power trace and set system power values
-	  create_single_power_trace(this, 0);
+	  // set system power values
+	  calculate_single_power(this, 0);
 
 	  // sum the power for the baseline configuration
 	  float power = 0;
@@ -1159,10 +1173,16 @@ void System::setInitialComponentTemps()
 	  if (externalRConvec) {
 	      //cout << "*** Using external r_convec " << r_convec << endl;
 	      run_single_HotSpot_simulation(this, 0, (xsize >= ysize) ? xsize : ysize, r_convec);
-	      readTempsFromFile(0);
+	      readTemps(0);
 	  } else {
 	      calibrateRConvec(0);
 	  }
+	  taskMappings[0]->setTempsCalculated(true);
+
+	  // with temperatures updated after every failure, solve the likely
+	  // scenarios up front, rather than one at a time as samples find them
+	  if (tempUpdate)
+	      buildSingleFailureScenarios();
       }
 
       // Start with component temperatures of 345K, if -i 0 is specified on the command line
@@ -1173,14 +1193,36 @@ void System::setInitialComponentTemps()
       }      
   } else if (tempUpdate) {
       // Read back the initial component temperatures from HotSpot
-      updatePowerValues(0);    
-      readTempsFromFile(0);
+      updatePowerValues(0, components);
+      readTemps(0);
   }
   
   return;
 }
 
-void System::resolvePreclusions(Component *failedComponent) {
+void System::buildSingleFailureScenarios()
+{
+  // every sample starts with a single failure, and memories never fail
+  for(int x = 0; x < (int)components.size(); x++) {
+    Component *c = components[x];
+    if(c->getGType() == MEM)
+      continue;
+
+    // the precluded components go down with it; resolvePreclusions() would
+    // also mark them failed, which only a sample should do
+    set<Component*,compareComponentIDs> failed;
+    failed.insert(c);
+    list<Component*> preclusions = c->getPreclusions();
+    failed.insert(preclusions.begin(), preclusions.end());
+
+    // keeps the scenario, and its task mapping if the system still works
+    resolveSystemFailure(components, failed);
+  }
+
+  calculatePendingTemps(0);
+}
+
+void System::resolvePreclusions(Component *failedComponent, set<Component*,compareComponentIDs> &failed) {
     // resolve preclusions
     if (failedComponent->getNPreclusions() > 0) {
 	list<Component*> preclusions = failedComponent->getPreclusions();
@@ -1191,14 +1233,15 @@ void System::resolvePreclusions(Component *failedComponent) {
 	    
 	    // mark precluded component as failed
 	    precludedComponent->setFailed();
-	    failedComponents.insert(precludedComponent);
+	    failed.insert(precludedComponent);
 	    
 	    //cout << "XXX Component preclusion: " << precludedComponent->getName() << endl;
 	} // for
     } // if
 }
 
-bool System::resolveSystemFailure() {
+bool System::resolveSystemFailure(const vector<Component*> &sampleComponents,
+				  const set<Component*,compareComponentIDs> &failed) {
     // is the scenario an operating scenario?
 
     //cout << "*** Resolving system failure: " << endl;
@@ -1210,8 +1253,8 @@ bool System::resolveSystemFailure() {
     curScenario.clear();
     
     // Add all components that aren't in failedComponents to a new set
-    diffEnd = set_difference(components.begin(),components.end(),
-			     failedComponents.begin(),failedComponents.end(),
+    diffEnd = set_difference(sampleComponents.begin(),sampleComponents.end(),
+			     failed.begin(),failed.end(),
 			     diffBegin,compareComponentIDs());
     
     string operatingScenarioKey = buildOperatingScenarioKey(curScenario);
@@ -1235,15 +1278,28 @@ bool System::resolveSystemFailure() {
 	
 	// check if the failure scenario is a subset of the failed components;
 	// if so, then the system has failed
-	if (includes(failedComponents.begin(),failedComponents.end(),fs.begin(),fs.end(),compareComponentIDs())) {
+	if (includes(failed.begin(),failed.end(),fs.begin(),fs.end(),compareComponentIDs())) {
 	    //cout << "***   An existing failure scenario" << endl;
 	    return true;
 	}
     }
 
     // this scenario isn't a subset of an existing failure scenario,
-    // so try to build a task mapping    
-    TaskMapping *tm = new TaskMapping(this,curScenario);
+    // so try to build a task mapping, and keep any new scenario, with the
+    // system's own components rather than a sampling thread's copies.  the
+    // threads find scenarios in no particular order, so their mappings draw
+    // permutations from the scenario itself rather than from rand()
+    int shuffleSeed = -1;
+    if (&sampleComponents != &components) {
+	curScenario = systemScenario(curScenario);
+
+	unsigned int h = LN_R_SEED;
+	for (int i=0; i<(int) operatingScenarioKey.size(); i++)
+	    h = h*31 + (unsigned char) operatingScenarioKey[i];
+	shuffleSeed = (int) (h & 0x7fffffff);
+    }
+
+    TaskMapping *tm = new TaskMapping(this,curScenario,shuffleSeed);
     //tm->setTempsCalculated(false);
     
     // If no task mapping could be found, add the missing components
@@ -1260,7 +1316,7 @@ bool System::resolveSystemFailure() {
 
 	// Add all components that are in failedComponents to a new set
 	intEnd = set_intersection(components.begin(),components.end(),
-				  failedComponents.begin(),failedComponents.end(),
+				  failed.begin(),failed.end(),
 				  intBegin,compareComponentIDs());
 
 	//cout << "*** New failure scenario" << endl;
@@ -1271,7 +1327,7 @@ bool System::resolveSystemFailure() {
 	for (int i=0; i<(int) components.size(); i++) {
 	    Component *c = components[i];
 
-	    if (c->isFailed()) {
+	    if (failed.count(c)) {
 		failureScenario.insert(c);
 		failedCount++;
 	    } // if
@@ -1347,15 +1403,19 @@ void System::updateStatistics(float data) {
     moment2 = (moment2*n_samples + data*data)/(n_samples+1);
 }
 
-void System::sample() {
+void System::sample(SamplingWorker *worker) {
   //cout << "Sample " << n_samples << endl;
 	
   bool matchedOperatingScenario = false;
+
+  // a sampling thread works on its own copies of the components
+  vector<Component*> &sampleComponents = worker ? worker->components : components;
+  set<Component*,compareComponentIDs> &failed = worker ? worker->failedComponents : failedComponents;
 	
   // clear set of failed components
-  failedComponents.erase(failedComponents.begin(),failedComponents.end());
+  failed.erase(failed.begin(),failed.end());
 
-  vector<Component*> failureTimes = components;
+  vector<Component*> failureTimes = sampleComponents;
 	
   if (measureYield) {
       // generate a sample
@@ -1377,17 +1437,18 @@ void System::sample() {
 	      updateSTATS(c, false);
 #endif
 	      
-	      failedComponents.insert(c);
-	      resolvePreclusions(c);
+	      failed.insert(c);
+	      resolvePreclusions(c, failed);
 	  } // if
       } // for
   
       // is the system still functional?
-      bool failure = resolveSystemFailure();
+      lockScenarios();
+      bool failure = resolveSystemFailure(sampleComponents, failed);
+      unlockScenarios();
 
       // update distribution moments
-      updateStatistics((float) (!failure));
-      n_samples++;
+      addSample(worker, (float) (!failure));
       
   } else {
       // generate a sample
@@ -1430,7 +1491,7 @@ void System::sample() {
 	      
 #ifdef STATS	
 	      // updated statistics
-	      if (failedComponents.empty())
+	      if (failed.empty())
 		  updateSTATS(failedComponent, true);
 	      else
 		  updateSTATS(failedComponent, false);
@@ -1438,10 +1499,10 @@ void System::sample() {
 	      
 	      // mark component as failed (also resolves preclusions)
 	      failedComponent->setFailed();
-	      failedComponents.insert(failedComponent);
+	      failed.insert(failedComponent);
 
 	      // resolve preclusions
-	      resolvePreclusions(failedComponent);
+	      resolvePreclusions(failedComponent, failed);
 	      
 	      // advance time to the failure of the current component
 	      if(tempUpdate) {
@@ -1452,13 +1513,14 @@ void System::sample() {
 	      }
 	      //printf("Time is now %f\n",time);
 
-	      failure = resolveSystemFailure();
+	      lockScenarios();
+	      failure = resolveSystemFailure(sampleComponents, failed);
+	      unlockScenarios();
 	      
 	      // update distribution moments if the system has failed
 	      if (failure) {
 		  //cout << "*** System is failed" << endl;
-		  updateStatistics(time);
-		  n_samples++;
+		  addSample(worker, time);
 		  //cout << "!!! System failure" << endl << endl;
 	      }
 	      
@@ -1474,11 +1536,6 @@ void System::sample() {
 		  
 		  // Find the operating scenario that the system is in
 		  int x;
-		  FILE *tempFile;
-		  //char *tempFileName;
-		  char line[20];
-		  string componentName;
-		  float componentTemp;
 				
 		  /*
 		  // Print the failed components
@@ -1497,13 +1554,14 @@ void System::sample() {
 		  diffResult.clear();
 		  
 		  // Add all componets that aren't in failedComponents to a new set
-		  diffEnd = set_difference(components.begin(),components.end(),
-					   failedComponents.begin(),failedComponents.end(),
+		  diffEnd = set_difference(sampleComponents.begin(),sampleComponents.end(),
+					   failed.begin(),failed.end(),
 					   diffBegin,compareComponentIDs());
 		  
 		  string operatingScenarioKey = buildOperatingScenarioKey(diffResult);
 		  
 		  // Loop over all operating scenarios
+		  lockScenarios();
 		  matchedOperatingScenario = false;
 		  int operatingScenarioPos = -1;
 		  operatingScenarioPos = operatingScenarioLookup[operatingScenarioKey];
@@ -1514,13 +1572,9 @@ void System::sample() {
 		      x = operatingScenarioPos;
 		      matchedOperatingScenario = true;
 		      if(!taskMappings[operatingScenarioPos]->getTempsCalculated()) {
-			  // Create a power trace for the new task mapping
-			  create_single_power_trace(this,operatingScenarioPos);
-			  
-			  // Run HotSpot for the new operating scenario
-			  run_single_HotSpot_simulation(this,operatingScenarioPos,(xsize >= ysize) ? xsize : ysize, r_convec);
-			  
-			  taskMappings[operatingScenarioPos]->setTempsCalculated(true);
+			  // Run HotSpot for the new operating scenario, along with any others
+			  // found since the last time
+			  calculatePendingTemps(operatingScenarioPos);
 		      }
 		  }
 		  
@@ -1564,8 +1618,8 @@ void System::sample() {
 		      // Create a task mapping for the new operating scenario
 		      createSingleTaskMapping(operatingScenarios.size() - 1);
 		      
-		      // Create a power trace for the new task mapping
-		      create_single_power_trace(this,operatingScenarios.size() - 1);
+		      // Calculate the power for the new task mapping
+		      calculate_single_power(this,operatingScenarios.size() - 1);
 		      
 		      // Run HotSpot for the new operating scenario
 		      run_single_HotSpot_simulation(this,operatingScenarios.size() - 1,(xsize >= ysize) ? xsize : ysize, r_convec);
@@ -1573,49 +1627,19 @@ void System::sample() {
 		  
 		  // Update the current power values for each component
 		  //updatePowerValues(operatingScenarios.size() - 1);
-		  updatePowerValues(operatingScenarioPos);
-		  
-		  // Open the HotSpot temperature file corresponding to the current operating scenario
-		  string tempFileName;
-		  stringstream ss;
-		  ss << getWorkingDirectory() << HSPATH << operatingScenarioPos << ".temp";
-		  tempFileName = ss.str();
-		  
-		  //tempFileName = (char *)malloc((strlen(configFileName.c_str()) + 12) * sizeof(char));
-		  //sprintf(tempFileName,"%s.%05d.temp",configFileName.c_str(),x);
+		  updatePowerValues(operatingScenarioPos, sampleComponents);
 		  
-		  tempFile = fopen(tempFileName.c_str(),"r");
-		  
-		  // Ensure the temperature file opened correctly
-		  if(!tempFile) {
-		      cerr << "Couldn't open temperature file " << tempFileName << " for reading...giving up on sample" << endl;
-		      failure = true;
-		  }
-		  
-		  // Step through each line in the temperature file
-		  while(fgets(line,sizeof(line),tempFile)) {
-		      componentName = strtok(line,"\t\n");
-		      //componentTemp = atoff(strtok(NULL,"\t\n"));
-		      componentTemp = atof(strtok(NULL,"\t\n"));
-		      
-		      // Step through all of the components in the system
-		      for(x = 0; x < (int)components.size(); x++) {
-			  
-			  // Set the current temperature of the component to what is found in the temperature file
-			  if(componentName == components[x]->getName()) {
-			      components[x]->setCurrentTemperature(componentTemp);
-			  }
-		      }
+		  // Set the current temperature of each component to what HotSpot found for this operating scenario
+		  for(x = 0; x < (int)sampleComponents.size(); x++) {
+		      sampleComponents[x]->setCurrentTemperature(taskMappings[operatingScenarioPos]->getTemperature(x));
 		  }
+		  unlockScenarios();
 		  
 		  // Update failure times for all components
 		  for (vector<Component *>::iterator iter = fiter; iter != failureTimes.end(); iter++) {
 		      Component *c = *iter;
 		      c->updateFailureTime();
 		  }
-				
-		  fclose(tempFile);
-		  //free(tempFileName);
 	      }
 	      
 	      // Resort the vector of failure times
@@ -1631,6 +1655,151 @@ void System::sample() {
   } // sample lifetime
 } // sample
 
+void System::lockScenarios() {
+#ifdef _OPENMP
+    omp_set_lock(&scenarioLock);
+#endif
+}
+
+void System::unlockScenarios() {
+#ifdef _OPENMP
+    omp_unset_lock(&scenarioLock);
+#endif
+}
+
+void System::addSample(SamplingWorker *worker, float data) {
+    if (!worker) {
+	updateStatistics(data);
+	n_samples++;
+	return;
+    }
+
+    worker->sum1 += data;
+    worker->sum2 += (double) data*data;
+    worker->n_samples++;
+}
+
+void System::resetSampleTemps(SamplingWorker *worker) {
+    if (!tempUpdate)
+	return;
+
+    // back to the fully working system, as setInitialComponentTemps() does
+    lockScenarios();
+    updatePowerValues(0, worker->components);
+    for (int x=0; x<(int) worker->components.size(); x++) {
+	worker->components[x]->setCurrentTemperature(taskMappings[0]->getTemperature(x));
+    } // for
+    unlockScenarios();
+}
+
+set<Component*,compareComponentIDs> System::systemScenario(const set<Component*,compareComponentIDs> &scenario) {
+    set<Component*,compareComponentIDs> result;
+
+    // copies keep the IDs of their originals
+    for (int i=0; i<(int) components.size(); i++) {
+	if (scenario.count(components[i]))
+	    result.insert(components[i]);
+    } // for
+
+    return result;
+}
+
+// Samples are split between the sampling threads in contiguous blocks.
+// Each thread draws from a generator seeded from the system's, so a run
+// is repeatable for a given seed and number of threads, and its sums are
+// combined in thread order.  Operating and failure scenarios are shared
+// between the threads, and found under the scenario lock.
+void System::generateSamples() {
+    int threads = samplingThreads;
+#ifdef _OPENMP
+    if (threads == 0)
+	threads = omp_get_max_threads();
+#endif
+#ifdef STATS
+    // the statistics are kept for the system's own components
+    threads = 1;
+#endif
+    if (threads > getMaxSamples())
+	threads = getMaxSamples();
+
+    if (threads <= 1) {
+	for (int i=0; i<getMaxSamples(); i++) {
+	    setInitialComponentTemps();
+	    sample();
+	}
+	return;
+    }
+
+    // floorplan and find the baseline temperatures before copying the components
+    setInitialComponentTemps();
+
+    vector<SamplingWorker> workers(threads);
+    for (int t=0; t<threads; t++) {
+	SamplingWorker &w = workers[t];
+
+	w.rng = gsl_rng_alloc(gsl_rng_taus);
+	gsl_rng_set(w.rng, gsl_rng_get(rand_ln));
+	w.n_samples = 0;
+	w.sum1 = 0;
+	w.sum2 = 0;
+
+	map<Component*,Component*> copies;
+	for (int i=0; i<(int) components.size(); i++) {
+	    Component *c = components[i]->clone(w.rng);
+	    w.components.push_back(c);
+	    copies[components[i]] = c;
+	} // for
+
+	// a copy precludes the thread's other copies
+	for (int i=0; i<(int) components.size(); i++) {
+	    list<Component*> preclusions = components[i]->getPreclusions();
+	    list<Component*> copiedPreclusions;
+
+	    for (list<Component*>::iterator iter = preclusions.begin();
+		 iter != preclusions.end(); iter++) {
+		copiedPreclusions.push_back(copies[*iter]);
+	    } // for
+	    w.components[i]->setPreclusions(copiedPreclusions);
+	} // for
+    } // for
+
+#pragma omp parallel for num_threads(threads) schedule(static, 1)
+    for (int t=0; t<threads; t++) {
+	SamplingWorker &w = workers[t];
+	int first = (int) ((long long) getMaxSamples() * t / threads);
+	int last = (int) ((long long) getMaxSamples() * (t + 1) / threads);
+
+	for (int i=first; i<last; i++) {
+	    resetSampleTemps(&w);
+	    sample(&w);
+	} // for
+    } // for
+
+    // carry on from any samples taken before
+    double sum1 = (double) moment1 * n_samples, sum2 = (double) moment2 * n_samples;
+    for (int t=0; t<threads; t++) {
+	SamplingWorker &w = workers[t];
+
+	sum1 += w.sum1;
+	sum2 += w.sum2;
+	n_samples += w.n_samples;
+
+	for (int i=0; i<(int) w.components.size(); i++) {
+	    w.components[i]->deleteMechanisms();
+	    delete w.components[i];
+	} // for
+	gsl_rng_free(w.rng);
+    } // for
+
+    moment1 = (float) (sum1 / n_samples);
+    moment2 = (float) (sum2 / n_samples);
+
+    if (isnan((double)moment1) || isinf((double)moment1)) {
+	cout << "*** Error: statistics diverge after " << n_samples << " samples" << endl;
+	cleanUpAndExit(1);
+    }
+}
+
 bool System::samplingRun() {
     float mttf, area, wl;
 
@@ -1647,10 +1816,7 @@ bool System::samplingRun() {
 	reset();
 	
 	// mttf wasn't found, determine it
-	for (int i=0; i<getMaxSamples(); i++) {
-	    setInitialComponentTemps();
-	    sample();
-	}
+	generateSamples();
 
 	//cout << "&&& ... done sampling ..." << endl;
 
@@ -1796,13 +1962,16 @@ void System::floorplan() {
 
     int argc;
     char **argv;
+
+    // two more arguments when the seed is fixed
+    int seedArgs = (fpSeed >= 0) ? 2 : 0;
     
     if (fpAreaMin) {
 	// floorplan to minimize area
 	
 	// construct the command line for ParquetFP
 	// count up the arguments (including "1" for the program name ...)
-	argc = 9;
+	argc = 9 + seedArgs;
 	argv = new char*[argc];
 
 	for (int i=0; i<argc; i++) {
@@ -1822,7 +1991,7 @@ void System::floorplan() {
 	
 	// construct the command line for ParquetFP
 	// count up the arguments (including "1" for the program name ...)
-	argc = 14;
+	argc = 14 + seedArgs;
 	argv = new char*[argc];
 
 	for (int i=0; i<argc; i++) {
@@ -1843,6 +2012,11 @@ void System::floorplan() {
 	sprintf(argv[12], "-timeInit");
 	sprintf(argv[13], "%f", FP_TI);
     }
+
+    if (seedArgs) {
+	sprintf(argv[argc - 2], "-s");
+	sprintf(argv[argc - 1], "%d", fpSeed);
+    }
     
     floorplanFileName.append(".pl");
     setFloorplanFileName(floorplanFileName);
@@ -1859,49 +2033,42 @@ void System::floorplan() {
     return;
 } // floorplan
 
-void System::readTempsFromFile(int operatingScenarioIndex)
+void System::calculatePendingTemps(int current)
 {
-  int x;
-  //char *tempFileName;
-  FILE *tempFile;
-  char line[20];
-  string componentName;
-  float componentTemp;
-
-  // Open the HotSpot temperature file corresponding to the current operating scenario
-  string tempFileName;
-  stringstream ss;
-  ss << getWorkingDirectory() << HSPATH << operatingScenarioIndex << ".temp";
-  tempFileName = ss.str();
-
-  //tempFileName = (char *)malloc((strlen(configFileName.c_str()) + 12) * sizeof(char));
-  //sprintf(tempFileName,"%s.%05d.temp",configFileName.c_str(),operatingScenarioIndex);
-  tempFile = fopen(tempFileName.c_str(),"r");
-  
-  // Ensure the temperature file opened correctly
-  if(!tempFile) {
-    cerr << "Couldn't open temperature file " << tempFileName << " for reading" << endl;
-    cleanUpAndExit(1);
+  vector<int> pending;
+  for(int x = 0; x < (int)taskMappings.size(); x++) {
+    if(x != current && !taskMappings[x]->getTempsCalculated()) {
+      // Calculate the power for the new task mapping
+      calculate_single_power(this, x);
+      pending.push_back(x);
+    }
   }
-  
-  // Step through each line in the temperature file
-  while(fgets(line,sizeof(line),tempFile)) {
-    componentName = strtok(line,"\t\n");
-    componentTemp = atof(strtok(NULL,"\t\n"));
-    
-    // Step through all of the components in the system
-    for(x = 0; x < (int)components.size(); x++) {
-      
-      // Set the current temperature of the component to what is found in the temperature file
-      if(componentName == components[x]->getName()) {
-	components[x]->setCurrentTemperature(componentTemp);
+  if(!taskMappings[current]->getTempsCalculated()) {
+    calculate_single_power(this, current);
+    pending.push_back(current);
+  }
+
+  run_HotSpot_batch(this, pending, (xsize >= ysize) ? xsize : ysize, r_convec);
+
+  for(int x = 0; x < (int)pending.size(); x++) {
+    taskMappings[pending[x]]->setTempsCalculated(true);
+  }
+}
+
+void System::readTemps(int operatingScenarioIndex)
+{
+  int x;
+  TaskMapping *curTaskMapping = taskMappings[operatingScenarioIndex];
+
+  // Set the current temperature of each component to what HotSpot found for the operating scenario
+  for(x = 0; x < (int)components.size(); x++) {
+    float componentTemp = curTaskMapping->getTemperature(x);
+    components[x]->setCurrentTemperature(componentTemp);
 
 #ifdef STATS
-	// store initial component temperature
-	statsTemp[x] = componentTemp;
+    // store initial component temperature
+    statsTemp[x] = componentTemp;
 #endif
-      }
-    }
   }
 
   // Should this be here when resetting the temps for the components?
@@ -1914,19 +2081,16 @@ void System::readTempsFromFile(int operatingScenarioIndex)
   }
   */
   
-  fclose(tempFile);
-  //free(tempFileName);
- 
   return;
 }
 
-void System::updatePowerValues(int operatingScenarioIndex)
+void System::updatePowerValues(int operatingScenarioIndex, const vector<Component*> &sampleComponents)
 {
     TaskMapping *curTaskMapping = taskMappings[operatingScenarioIndex];
     
     // loop over all components in the system and get their power from the task mapping
-    for (int y=0; y<(int) components.size(); y++) {
-	Component *c = components[y];
+    for (int y=0; y<(int) sampleComponents.size(); y++) {
+	Component *c = sampleComponents[y];
 	c->setCurPower(curTaskMapping->getPower(y));
     } // for
 }
@@ -26,6 +26,14 @@ TCFailureMechanism::~TCFailureMechanism()
 {
 }
 
+FailureMechanism *TCFailureMechanism::clone(Component *fowner, gsl_rng *rng) const
+{
+	TCFailureMechanism *fm = new TCFailureMechanism(*this);
+	fm->setOwner(fowner);
+	fm->setRNG(rng);
+	return fm;
+}
+
 void TCFailureMechanism::updateParameters() {
     return;
 }
@@ -29,6 +29,14 @@ TDDBFailureMechanism::~TDDBFailureMechanism()
 {
 }
 
+FailureMechanism *TDDBFailureMechanism::clone(Component *fowner, gsl_rng *rng) const
+{
+	TDDBFailureMechanism *fm = new TDDBFailureMechanism(*this);
+	fm->setOwner(fowner);
+	fm->setRNG(rng);
+	return fm;
+}
+
 void TDDBFailureMechanism::updateAtddb() {
     Atddb = 30.0 / (pow(1.0 / vdd,PARAM_A - (PARAM_B * T_CHAR)) *
 		    exp((PARAM_X + (PARAM_Y / T_CHAR) + (PARAM_Z * T_CHAR)) / (PARAM_K * T_CHAR)));
@@ -20,9 +20,10 @@ TaskMapping::TaskMapping(System *theSystem)
   
   sys = theSystem;
   mcsVerbosity = sys->getVerbosity();
+  shuffleSeed = -1;
 }
 
-TaskMapping::TaskMapping(System *theSystem, set<Component*,compareComponentIDs> curScenario)
+TaskMapping::TaskMapping(System *theSystem, set<Component*,compareComponentIDs> curScenario, int seed)
 {
   int x, y, numPermutations, precludedComponentPos;
   bool componentFound = false;
@@ -30,6 +31,8 @@ TaskMapping::TaskMapping(System *theSystem, set<Component*,compareComponentIDs>
 	
   sys = theSystem;
   mcsVerbosity = sys->getVerbosity();
+  shuffleSeed = seed;
+  shuffleState = (unsigned int) seed;
 	
   TaskMapping *initialTaskMapping = sys->getInitialTaskMapping();
 	
@@ -1093,7 +1096,7 @@ vector<int> TaskMapping::knuthShuffle(int N)
   }
 
   while(n > 1) {
-    k = rand() % n;
+    k = ((shuffleSeed != -1) ? rand_r(&shuffleState) : rand()) % n;
     n--;
     t = thePermutation[n];
     thePermutation[n] = thePermutation[k];
@@ -0,0 +1,148 @@
+/*                                                                              
+   Copyright 2009 Carnegie Mellon University.                                   
+                                                                                
+   This software developed under GRC contract 2008-HJ-1795 funded by            
+   the Semiconductor Research Corporation.                                      
+*/
+
+#include <cstdio>
+#include <cstring>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#include "ThermalCache.h"
+
+#define CACHE_MAGIC "MCSTHC02"
+
+// 64 bit FNV-1a
+static uint64_t hashBytes(const char *data, size_t size, uint64_t h = 14695981039346656037ULL)
+{
+  for (size_t i=0; i<size; i++) {
+    h ^= (unsigned char) data[i];
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+// a whole file, or false if it cannot be read
+static bool readFile(const string &fileName, string &contents)
+{
+  ifstream in(fileName.c_str(), ios::in | ios::binary);
+  if (!in)
+    return false;
+  stringstream ss;
+  ss << in.rdbuf();
+  contents = ss.str();
+  return true;
+}
+
+ThermalCache::ThermalCache()
+{
+  hits = 0;
+  misses = 0;
+}
+
+ThermalCache::~ThermalCache()
+{
+}
+
+bool ThermalCache::open(const string &dir)
+{
+  directory = dir;
+  if (directory.empty())
+    return false;
+  if (directory[directory.size() - 1] != '/')
+    directory.append("/");
+
+  // shared between users and processes, like the working directories
+  errno = 0;
+  mkdir(directory.c_str(), S_IRWXU | S_IRWXG | S_IRWXO);
+  if (errno != EEXIST && errno != 0) {
+    directory.clear();
+    return false;
+  }
+  return true;
+}
+
+bool ThermalCache::setFloorplan(const string &floorplanFileName)
+{
+  return readFile(floorplanFileName, floorplan);
+}
+
+string ThermalCache::buildKey(float maxDimension, float r_convec, const string &solver,
+			      const vector<double> &power) const
+{
+  uint32_t n = (uint32_t) power.size();
+  uint32_t length = (uint32_t) floorplan.size();
+  string key(CACHE_MAGIC);
+  key.append((const char *) &length, sizeof(length));
+  key.append(floorplan);
+  key.append((const char *) &maxDimension, sizeof(maxDimension));
+  key.append((const char *) &r_convec, sizeof(r_convec));
+  key.append(solver);
+  key.push_back('\0');
+  key.append((const char *) &n, sizeof(n));
+  key.append((const char *) &power[0], n * sizeof(double));
+  return key;
+}
+
+string ThermalCache::entryFile(const string &key) const
+{
+  stringstream ss;
+  ss << directory << hex << setw(16) << setfill('0') << hashBytes(key.data(), key.size()) << ".temp";
+  return ss.str();
+}
+
+bool ThermalCache::lookup(float maxDimension, float r_convec, const string &solver,
+			  const vector<double> &power, vector<double> &temp)
+{
+  if (!isOpen())
+    return false;
+
+  string key = buildKey(maxDimension, r_convec, solver, power);
+  string contents;
+  size_t size = power.size() * sizeof(double);
+
+  // the whole key has to match, not just its hash
+  if (!readFile(entryFile(key), contents) || contents.size() != key.size() + size ||
+      contents.compare(0, key.size(), key)) {
+    misses++;
+    return false;
+  }
+
+  temp.resize(power.size());
+  memcpy(&temp[0], contents.data() + key.size(), size);
+  hits++;
+  return true;
+}
+
+void ThermalCache::store(float maxDimension, float r_convec, const string &solver,
+			 const vector<double> &power, const vector<double> &temp)
+{
+  if (!isOpen())
+    return;
+
+  string key = buildKey(maxDimension, r_convec, solver, power);
+  string fileName = entryFile(key);
+
+  // write under a name of our own, then move it into place in one step
+  stringstream ss;
+  ss << fileName << "." << (int) getpid();
+  string tmpName = ss.str();
+
+  ofstream out(tmpName.c_str(), ios::out | ios::binary | ios::trunc);
+  if (!out)
+    return;
+  out.write(key.data(), key.size());
+  out.write((const char *) &temp[0], temp.size() * sizeof(double));
+  out.close();
+
+  if (!out || rename(tmpName.c_str(), fileName.c_str()))
+    remove(tmpName.c_str());
+}
@@ -11,9 +11,11 @@
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <vector>
 
 #include "config.h"
 #include "System.h"
+#include "TaskMapping.h"
 #include "hotSpot/hotspot.h"
 #include "ComponentLibrary.h"
 
@@ -325,7 +327,7 @@ void parse_cmd_sys(int argc, char *argv[], System &sys) {
 	// Determine whether or not the command line has the correct number of parameters
 	if(argc < 7) {
 		cout << "Invalid command line specified...usage is as follows" << endl;
-		cout << argv[0] << " -c <configFile> -n <netlistFile> -t <taskGraphFile> [-d <databaseFile>] [-u 0/1] [-b 0/1] [-i 0/1] [-z 0/1] [-I 0/1] [-s numSamples] [-f fpIterations] [-w areaWeight wireWeight] [-v verbosity] [-r numPermutations] [-y ddp ddm]" << endl;
+		cout << argv[0] << " -c <configFile> -n <netlistFile> -t <taskGraphFile> [-d <databaseFile>] [-u 0/1] [-b 0/1] [-i 0/1] [-z 0/1] [-I 0/1] [-s numSamples] [-f fpIterations] [-S fpSeed] [-w areaWeight wireWeight] [-v verbosity] [-r numPermutations] [-y ddp ddm] [-h r_convec] [-H lu/cholesky/pcg] [-T thermalCacheDir] [-j samplingThreads]" << endl;
 		sys.cleanUpAndExit(1);
 	}
 	
@@ -374,6 +376,16 @@ void parse_cmd_sys(int argc, char *argv[], System &sys) {
 		  }
 		}				
 
+		// -S fixes the floorplanner's seed, so runs on the same system get the same floorplan
+		if(!strncmp("-S",argv[x],2)) {
+		  if(atoi(argv[x + 1]) < 0) {
+		    cout << "Floorplanning seed must be greater than or equal to 0...seeding from the clock instead" << endl;
+		  }
+		  else {
+		    sys.setFPSeed(atoi(argv[x + 1]));
+		  }
+		}
+
 		// -a 1 indicates that area minimization should be performed during floorplanning (no WL minimization)
 		if(!strncmp("-a",argv[x],2)) {
 			if((atoi(argv[x + 1]) != 0) && (atoi(argv[x + 1]) != 1)) {
@@ -492,6 +504,35 @@ void parse_cmd_sys(int argc, char *argv[], System &sys) {
 			sys.setRConvec(r_convec);
 		    }
 		}
+
+		// -H selects HotSpot's steady state solver: dense LU, or sparse cholesky or conjugate gradient
+		if (!strncmp("-H", argv[x],2)) {
+		    string solver = argv[x + 1];
+
+		    if (solver != "lu" && solver != "cholesky" && solver != "pcg") {
+			cerr << "Invalid thermal solver " << solver << ", please specify lu, cholesky or pcg" << endl;
+			sys.cleanUpAndExit(1);
+		    } else {
+			sys.setThermalSolver(solver);
+		    }
+		}
+
+		// -T keeps HotSpot's results in a directory, reused by later solves and runs
+		if (!strncmp("-T", argv[x],2)) {
+		    if (!sys.getThermalCache().open(argv[x + 1])) {
+			cerr << "Unable to use thermal cache directory " << argv[x + 1] << endl;
+			sys.cleanUpAndExit(1);
+		    }
+		}
+
+		// -j splits the samples between threads, 0 for one per processor
+		if (!strncmp("-j", argv[x],2)) {
+		    if (atoi(argv[x + 1]) < 0) {
+			cout << "Number of sampling threads must be greater than or equal to 0...using default value instead" << endl;
+		    } else {
+			sys.setSamplingThreads(atoi(argv[x + 1]));
+		    }
+		}
 	}
 	
 	if(!(configFileSpecified && taskGraphFileSpecified && netlistFileSpecified)) {
@@ -543,47 +584,107 @@ void parse_cmd_sys(int argc, char *argv[], System &sys) {
 	return;
 } // parse_cmd_sys
 
-void run_single_HotSpot_simulation(System *sys, int pos, float maxDimension, float r_convec)
+void open_thermal_model(System *sys, float maxDimension, float r_convec)
 {
     stringstream ss;
-    string floorplanFileName, powerTraceFileName, outputFileName;
+    string floorplanFileName;
 
+    close_thermal_model(sys);
+
+    // read the floorplan with dead blocks once; every operating scenario is solved against it
     ss << sys->getWorkingDirectory() << FPPATH << FP_BASENAME << ".pl.filled";
     floorplanFileName = ss.str();
-    ss.clear();
-    ss.str("");
-    
-    ss << sys->getWorkingDirectory() << HSPATH << pos << ".ptrace";
-    powerTraceFileName = ss.str();
-    ss.clear();
-    ss.str("");
+    flp_t *flp = read_flp(&floorplanFileName[0], FALSE);
+    if (sys->getThermalCache().isOpen() && !sys->getThermalCache().setFloorplan(floorplanFileName)) {
+	cerr << "Unable to read " << floorplanFileName << " for the thermal cache" << endl;
+	sys->cleanUpAndExit(1);
+    }
+
+    sys->setThermalModel(hotspot_open(flp, maxDimension, r_convec, sys->getThermalSolver().c_str()));
+
+    // find each component in the floorplan, so the power and temperature vectors
+    // can be permuted without searching by name
+    vector<Component *> components = sys->getComponents();
+    vector<int> &units = sys->getThermalUnits();
+    units.clear();
+    for (int y=0; y<(int) components.size(); y++) {
+	string name = components[y]->getName();
+	units.push_back(get_blk_index(flp, &name[0]));
+    } // for
+}
+
+void close_thermal_model(System *sys)
+{
+    hotspot_handle_t *hs = sys->getThermalModel();
+    if (!hs)
+	return;
+
+    flp_t *flp = hs->flp;
+    hotspot_close(hs);
+    free_flp(flp, FALSE);
+    sys->setThermalModel(NULL);
+    sys->getThermalUnits().clear();
+}
+
+void run_single_HotSpot_simulation(System *sys, int pos, float maxDimension, float r_convec)
+{
+    vector<int> positions(1, pos);
+    run_HotSpot_batch(sys, positions, maxDimension, r_convec);
+}
+
+void run_HotSpot_batch(System *sys, vector<int> &positions, float maxDimension, float r_convec)
+{
+    int count = (int) positions.size();
+    if (count == 0)
+	return;
+
+    hotspot_handle_t *hs = sys->getThermalModel();
+    if (!hs) {
+	cerr << "No thermal model for operating scenario " << positions[0] << endl;
+	sys->cleanUpAndExit(1);
+    }
+
+    // only rebuilds the model when calibrating r_convec
+    hotspot_set_params(hs, maxDimension, r_convec);
+
+    // permute the power numbers into floorplan order; the dead blocks dissipate nothing
+    vector<int> &units = sys->getThermalUnits();
+    vector<vector<double> > power(count, vector<double>(hs->flp->n_units, 0.0));
+    vector<vector<double> > temp(count, vector<double>(hs->flp->n_units, 0.0));
+    for (int i=0; i<count; i++) {
+	TaskMapping *taskMapping = sys->getTaskMappings()[positions[i]];
+	for (int y=0; y<(int) units.size(); y++) {
+	    power[i][units[y]] = taskMapping->getPower(y);
+	} // for
+    } // for
+
+    // only solve what the thermal cache, if any, has not seen before
+    ThermalCache &cache = sys->getThermalCache();
+    string solver = sys->getThermalSolver();
+    vector<int> solve;
+    vector<double *> powerPtrs, tempPtrs;
+    for (int i=0; i<count; i++) {
+	if (!cache.lookup(maxDimension, r_convec, solver, power[i], temp[i])) {
+	    solve.push_back(i);
+	    powerPtrs.push_back(&power[i][0]);
+	    tempPtrs.push_back(&temp[i][0]);
+	} // if
+    } // for
+
+    if (!solve.empty())
+	hotspot_steady_temp_batch(hs, &powerPtrs[0], &tempPtrs[0], (int) solve.size());
+    for (int i=0; i<(int) solve.size(); i++) {
+	cache.store(maxDimension, r_convec, solver, power[solve[i]], temp[solve[i]]);
+    } // for
+
+    // ... and the temperatures back into component order
+    for (int i=0; i<count; i++) {
+	vector<float> temps(units.size());
+	for (int y=0; y<(int) units.size(); y++) {
+	    temps[y] = temp[i][units[y]];
+	} // for
+	sys->getTaskMappings()[positions[i]]->setTemperatures(temps);
+    } // for
 
-    ss << sys->getWorkingDirectory() << HSPATH << pos << ".temp";
-    outputFileName = ss.str();
-    
-    // Allocate space for the floorplan file name to be passed to HotSpot (8 -> "filled." + NULL)
-    //char *floorplanFileName = (char *)malloc((8 + strlen(sys->getFloorplanFileName().c_str())) * sizeof(char));
-    //sprintf(floorplanFileName,"%s.filled",sys->getFloorplanFileName().c_str());
-    
-    // Allocate space for the power trace file name to be passed to HotSpot (14 -> ".#####.ptrace + NULL)
-    //char *powerTraceFileName = (char *)malloc((14 + strlen(sys->getConfigFileName().c_str())) * sizeof(char));
-    //sprintf(powerTraceFileName,"%s.%05d.ptrace",sys->getConfigFileName().c_str(),pos);
-    
-    // Allocate space for the output file name to be passed to HotSpot (12 -> ".#####.temp + NULL)
-    //char *outputFileName = (char *)malloc((12 + strlen(sys->getConfigFileName().c_str())) * sizeof(char));
-    //sprintf(outputFileName,"%s.%05d.temp",sys->getConfigFileName().c_str(),pos);
-    
-    hotSpot_main(
-		 floorplanFileName.c_str(),
-		 powerTraceFileName.c_str(),
-		 outputFileName.c_str(),
-		 maxDimension,
-		 r_convec
-		 );
-
-    //free(floorplanFileName);
-    //free(powerTraceFileName);
-    //free(outputFileName);
-    
     return;
 }
@@ -46,11 +46,14 @@ int main(int argc, char* argv[]) {
 	*/
 
 	// generate samples
+#ifndef SAMPLE_CONFIDENCE
+	sys.generateSamples();
+#else
+	// one at a time, to report the statistics as they converge
 	for (int i=0;i<sys.getMaxSamples();i++) {
 	    sys.setInitialComponentTemps();
 	    sys.sample();
 
-#ifdef SAMPLE_CONFIDENCE
 		if (i > 0 && i % INTERVAL == 0) {
 		    // report statistics
 		    gettimeofday(&sample, NULL);
@@ -66,9 +69,9 @@ int main(int argc, char* argv[]) {
 		    printf("%5d ", i);
 		    cout << mttf << " " << s_var << " " << var << " " << conf << endl;
 		} // if
-#endif
 
 	} // for
+#endif
 
 	// if we're sampling yield, apply Y0
 	if (sys.getMeasureYield())
@@ -86,6 +89,9 @@ int main(int argc, char* argv[]) {
 	float s_var = sys.getSVar();
 	float conf = sys.getConfidence();
 
+	if (sys.getThermalCache().isOpen())
+	    cout << "*** Thermal cache: " << sys.getThermalCache().getHits() << " hits, "
+		 << sys.getThermalCache().getMisses() << " misses" << endl;
 #ifdef SAMPLE_CONFIDENCE
 	printf("%3.2f ", diff);
 #endif
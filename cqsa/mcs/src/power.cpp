@@ -24,15 +24,11 @@ void create_power_traces(System *sys) {
 	return;
 }
 
-void create_single_power_trace(System *sys, int pos)
+void calculate_single_power(System *sys, int pos)
 {
 	int y;
-	//char curTraceName[100];
-	FILE *curTraceFile;
-	
 
 	vector<Component *> localComponents = sys->getComponents();
-	vector<string> localEmptyBlocks = sys->getEmptyBlocks();
 	set<Component*,compareComponentIDs> curOperatingScenario;
 	TaskMapping *curTaskMapping;
 	vector<Component *> curTaskMappingComponents;
@@ -55,31 +51,6 @@ void create_single_power_trace(System *sys, int pos)
 	printf("\n");
 	*/
 
-	// Create the file name for this power trace
-	//sprintf(curTraceName,"%s.%05d.ptrace",sys->getConfigFileName().c_str(),pos);
-	string curTraceName;
-	stringstream ss;
-	ss << sys->getWorkingDirectory() << HSPATH << pos << ".ptrace";
-	curTraceName = ss.str();
-	
-	// Open the current power trace file
-	curTraceFile = fopen(curTraceName.c_str(),"w");
-	if(!curTraceFile) {
-		cerr << "Failed to open power trace file " << curTraceName << " for writing" << endl;
-		sys->cleanUpAndExit(1);
-	}
-	
-	// Loop over all components in the system to print the first line of the power trace
-	for(y = 0; y < (int)localComponents.size(); y++) {
-		fprintf(curTraceFile,"%s\t\t",localComponents[y]->getName().c_str());
-	}
-	
-	// Loop over all empty blocks in the system to complete the first line
-	for(y = 0; y < (int)localEmptyBlocks.size(); y++) {
-		fprintf(curTraceFile,"%s\t",localEmptyBlocks[y].c_str());
-	}
-	fprintf(curTraceFile,"\n");
-
 	vector<Component*> components = sys->getComponents();
 	
 	// loop over all nets and clear their foward and reverse bandwidths
@@ -223,6 +194,45 @@ void create_single_power_trace(System *sys, int pos)
 	    // update power vector in task mapping
 	    curTaskMapping->pushPower(c->getCurPower());
 	} // for
+}
+
+void create_single_power_trace(System *sys, int pos)
+{
+	int y;
+	//char curTraceName[100];
+	FILE *curTraceFile;
+
+	vector<Component *> localComponents = sys->getComponents();
+	vector<string> localEmptyBlocks = sys->getEmptyBlocks();
+
+	calculate_single_power(sys, pos);
+
+	// Create the file name for this power trace
+	//sprintf(curTraceName,"%s.%05d.ptrace",sys->getConfigFileName().c_str(),pos);
+	string curTraceName;
+	stringstream ss;
+	ss << sys->getWorkingDirectory() << HSPATH << pos << ".ptrace";
+	curTraceName = ss.str();
+	
+	// Open the current power trace file
+	curTraceFile = fopen(curTraceName.c_str(),"w");
+	if(!curTraceFile) {
+		cerr << "Failed to open power trace file " << curTraceName << " for writing" << endl;
+		sys->cleanUpAndExit(1);
+	}
+	
+	// Loop over all components in the system to print the first line of the power trace
+	for(y = 0; y < (int)localComponents.size(); y++) {
+		fprintf(curTraceFile,"%s\t\t",localComponents[y]->getName().c_str());
+	}
+	
+	// Loop over all empty blocks in the system to complete the first line
+	for(y = 0; y < (int)localEmptyBlocks.size(); y++) {
+		fprintf(curTraceFile,"%s\t",localEmptyBlocks[y].c_str());
+	}
+	fprintf(curTraceFile,"\n");
+
+	vector<Component*> components = sys->getComponents();
 	
 	// loop over all components in the system and print their power
 	for (y=0; y<(int) components.size(); y++) {
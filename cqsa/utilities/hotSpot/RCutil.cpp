@@ -181,6 +181,98 @@ void lusolve(double **a, int n, int *p, double *b, double *x, int spd)
 	#endif
 }
 
+/* 
+ * same as lusolve for 'nrhs' right hand sides. the vendor routines
+ * take them all at once. the vanilla code carries BATCH_BLOCK of them
+ * through the factor together, interleaved so that each element of 
+ * 'a' is read once per block and applied to a contiguous run of 
+ * values. every right hand side sees the same operations as it 
+ * would in lusolve
+ */
+void lusolve_batch(double **a, int n, int *p, double **b, double **x, int nrhs, int spd)
+{
+	#if(MATHACCEL == MA_NONE)
+	int i, j, r, r0, m;
+	double *y = dvector(n * BATCH_BLOCK);
+	double sum[BATCH_BLOCK];
+
+	for (r0 = 0; r0 < nrhs; r0 += BATCH_BLOCK) {
+		m = MIN(BATCH_BLOCK, nrhs - r0);
+
+		/* forward substitution	- solves ly = pb	*/
+		for (i=0; i < n; i++) {
+			double *yi = &y[i*m];
+			for (r=0; r < m; r++)
+				sum[r] = 0;
+			for (j=0; j < i; j++) {
+				double l = a[i][j];
+				double *yj = &y[j*m];
+				for (r=0; r < m; r++)
+					sum[r] += yj[r] * l;
+			}
+			for (r=0; r < m; r++)
+				yi[r] = b[r0+r][p[i]] - sum[r];
+		}
+
+		/* backward substitution - solves ux = y. y is overwritten by x	*/
+		for (i=n-1; i >= 0; i--) {
+			double *yi = &y[i*m];
+			for (r=0; r < m; r++)
+				sum[r] = 0;
+			for (j=i+1; j < n; j++) {
+				double u = a[i][j];
+				double *yj = &y[j*m];
+				for (r=0; r < m; r++)
+					sum[r] += yj[r] * u;
+			}
+			for (r=0; r < m; r++)
+				yi[r] = (yi[r] - sum[r]) / a[i][i];
+		}
+
+		for (i=0; i < n; i++)
+			for (r=0; r < m; r++)
+				x[r0+r][i] = y[i*m+r];
+	}
+
+	free_dvector(y);
+	#else
+	int r, nr = nrhs, info = 0;
+	/* right hand sides as the columns of a column major matrix	*/
+	double *y = dvector(n * nrhs);
+	for (r=0; r < nrhs; r++)
+		copy_dvector(&y[r*n], b[r], n);
+	#if(MATHACCEL == MA_INTEL)
+	if (!spd)
+		dgetrs("T", &n, &nr, a[0], &n, p, y, &n, &info);
+	else	
+		dpotrs("U", &n, &nr, a[0], &n, y, &n, &info);
+	#elif(MATHACCEL == MA_AMD)
+	if (!spd)
+		dgetrs_("T", &n, &nr, a[0], &n, p, y, &n, &info, 1);
+	else	
+		dpotrs_("U", &n, &nr, a[0], &n, y, &n, &info, 1);
+	#elif(MATHACCEL == MA_APPLE)
+	if (!spd)
+		dgetrs_("T", (__CLPK_integer *)&n, (__CLPK_integer *)&nr, a[0],
+				(__CLPK_integer *)&n, (__CLPK_integer *)p, y,
+				(__CLPK_integer *)&n, (__CLPK_integer *)&info);
+	else	
+		dpotrs_("U", (__CLPK_integer *)&n, (__CLPK_integer *)&nr, a[0],
+				(__CLPK_integer *)&n, y, (__CLPK_integer *)&n,
+				(__CLPK_integer *)&info);
+	#elif(MATHACCEL == MA_SUN)
+	if (!spd)
+		dgetrs_("T", &n, &nr, a[0], &n, p, y, &n, &info);
+	else	
+		dpotrs_("U", &n, &nr, a[0], &n, y, &n, &info);
+	#endif
+	assert(info == 0);	
+	for (r=0; r < nrhs; r++)
+		copy_dvector(x[r], &y[r*n], n);
+	free_dvector(y);
+	#endif
+}
+
 /* core of the 4th order Runge-Kutta method, where the Euler step
  * (y(n+1) = y(n) + h * k1 where k1 = dydx(n)) is provided as an input.
  * to evaluate dydx at different points, a call back function f (slope
@@ -190,14 +282,12 @@ void lusolve(double **a, int n, int *p, double *b, double *x, int spd)
  * Recipes in C", Chapter 16, from 
  * http://www.nrbook.com/a/bookcpdf/c16-1.pdf
  */
-void rk4_core(void *model, double *y, double *k1, void *p, int n, double h, double *yout, slope_fn_ptr f)
+void rk4_core(void *model, double *y, double *k1, void *p, int n, double h, double *yout, 
+			  slope_fn_ptr f, double *work)
 {
 	int i;
-	double *t, *k2, *k3, *k4;
-	k2 = dvector(n);
-	k3 = dvector(n);
-	k4 = dvector(n);
-	t = dvector(n);
+	/* scratch pad of 4n doubles	*/
+	double *k2 = work, *k3 = work + n, *k4 = work + 2*n, *t = work + 3*n;
 
 	/* k2 is the slope at the trial midpoint (t) found using 
 	 * slope k1 (which is at the starting point).
@@ -276,11 +366,6 @@ void rk4_core(void *model, double *y, double *k1, void *p, int n, double h, doub
 	for (i =0; i < n; i++) 
 		yout[i] = y[i] + h * (k1[i] + 2*k2[i] + 2*k3[i] + k4[i])/6.0;
 	#endif
-
-	free_dvector(k2);
-	free_dvector(k3);
-	free_dvector(k4);
-	free_dvector(t);
 }
 
 /* 
@@ -294,15 +379,15 @@ void rk4_core(void *model, double *y, double *k1, void *p, int n, double h, doub
 #define RK4_MAXUP		5.0
 #define RK4_MAXDOWN		10.0
 #define RK4_PRECISION	0.01
-double rk4(void *model, double *y, void *p, int n, double h, double *yout, slope_fn_ptr f)
+double rk4(void *model, double *y, void *p, int n, double h, double *yout, slope_fn_ptr f, 
+		   double *work)
 {
 	int i;
-	double *k1, *t1, *t2, *ytemp, max, new_h = h;
-
-	k1 = dvector(n);
-	t1 = dvector(n);
-	t2 = dvector(n);
-	ytemp = dvector(n); 
+	double max, new_h = h;
+	double *w = work ? work : dvector(RK4_WORK(n));
+	double *k1 = w, *t1 = w + n, *t2 = w + 2*n, *ytemp = w + 3*n;
+	/* rk4_core's scratch pad	*/
+	double *core = w + 4*n;
 
 	/* evaluate the slope k1 at the beginning */
 	(*f)(model, y, p, k1);
@@ -312,16 +397,16 @@ double rk4(void *model, double *y, void *p, int n, double h, double *yout, slope
 		h = new_h;
 
 		/* try RK4 once with normal step size	*/
-		rk4_core(model, y, k1, p, n, h, ytemp, f);
+		rk4_core(model, y, k1, p, n, h, ytemp, f, core);
 
 		/* repeat it with two half-steps	*/
-		rk4_core(model, y, k1, p, n, h/2.0, t1, f);
+		rk4_core(model, y, k1, p, n, h/2.0, t1, f, core);
 
 		/* y after 1st half-step is in t1. re-evaluate k1 for this	*/
 		(*f)(model, t1, p, k1);
 
 		/* get output of the second half-step in t2	*/	
-		rk4_core(model, t1, k1, p, n, h/2.0, t2, f);
+		rk4_core(model, t1, k1, p, n, h/2.0, t2, f, core);
 
 		/* find the max diff between these two results:
 		 * use t1 to store the diff
@@ -382,15 +467,23 @@ double rk4(void *model, double *y, void *p, int n, double h, double *yout, slope
 	#endif
 
 	/* clean up */
-	free_dvector(k1);
-	free_dvector(t1);
-	free_dvector(t2);
-	free_dvector(ytemp);
+	if (!work)
+		free_dvector(w);
 
 	/* return the step-size	*/
 	return new_h;
 }
 
+/* 
+ * the fuzz keeps an interval that is a whole no. of steps but 
+ * for rounding from taking an extra step
+ */
+int implicit_steps(double time_elapsed, double max_step)
+{
+	int n = (int) ceil(time_elapsed / max_step * (1.0 - 1e-9));
+	return MAX(n, 1);
+}
+
 /* matmult: C = AB, A, B are n x n square matrices	*/
 void matmult(double **c, double **a, double **b, int n) 
 {
@@ -603,3 +696,479 @@ void scaleadd_dvector (double *dst, double *src1, double *src2, int n, double sc
 	} 
 	#endif
 }
+
+/* non-zeros of the n by n matrix 'm' in CSR form	*/
+sparse_matrix_t *dmatrix_to_sparse(double **m, int n)
+{
+	int i, j, k;
+	sparse_matrix_t *s = (sparse_matrix_t *) calloc (1, sizeof(sparse_matrix_t));
+	if (!s)
+		fatal("memory allocation error\n");
+
+	s->n = n;
+	s->nnz = 0;
+	for (i = 0; i < n; i++)
+		for (j = 0; j < n; j++)
+			if (m[i][j] != 0.0)
+				s->nnz++;
+
+	s->row_start = ivector(n+1);
+	s->col = ivector(s->nnz);
+	s->val = dvector(s->nnz);
+	for (i = 0, k = 0; i < n; i++) {
+		s->row_start[i] = k;
+		for (j = 0; j < n; j++)
+			if (m[i][j] != 0.0) {
+				s->col[k] = j;
+				s->val[k] = m[i][j];
+				k++;
+			}
+	}
+	s->row_start[n] = k;
+
+	return s;
+}
+
+sparse_matrix_t *copy_sparse_matrix(sparse_matrix_t *s)
+{
+	sparse_matrix_t *c = (sparse_matrix_t *) calloc (1, sizeof(sparse_matrix_t));
+	if (!c)
+		fatal("memory allocation error\n");
+
+	c->n = s->n;
+	c->nnz = s->nnz;
+	c->row_start = ivector(s->n+1);
+	c->col = ivector(s->nnz);
+	c->val = dvector(s->nnz);
+	copy_ivector(c->row_start, s->row_start, s->n+1);
+	copy_ivector(c->col, s->col, s->nnz);
+	copy_dvector(c->val, s->val, s->nnz);
+
+	return c;
+}
+
+void dump_sparse_matrix(sparse_matrix_t *s)
+{
+	int i, k;
+
+	for (i = 0; i < s->n; i++) {
+		for (k = s->row_start[i]; k < s->row_start[i+1]; k++)
+			fprintf(stdout, "%d:%.5f\t", s->col[k], s->val[k]);
+		fprintf(stdout, "\n");
+	}
+	fprintf(stdout, "\n");
+}
+
+void free_sparse_matrix(sparse_matrix_t *s)
+{
+	free_ivector(s->row_start);
+	free_ivector(s->col);
+	free_dvector(s->val);
+	free(s);
+}
+
+/* vout = s * vin	*/
+void sparse_matvectmult(double *vout, sparse_matrix_t *s, double *vin)
+{
+	int i, k;
+	double sum;
+
+	for (i = 0; i < s->n; i++) {
+		for (k = s->row_start[i], sum = 0; k < s->row_start[i+1]; k++)
+			sum += s->val[k] * vin[s->col[k]];
+		vout[i] = sum;
+	}
+}
+
+/* 
+ * reverse Cuthill-McKee ordering of the first 'n' rows of 'a', ignoring 
+ * their connections to the rows beyond. a breadth first search from a 
+ * node of least degree, visiting the neighbours in the increasing order 
+ * of their degrees, numbers adjacent nodes close to each other. 
+ * perm[i] is the original index of the i-th node in the new order
+ */
+static void rcm_order(sparse_matrix_t *a, int n, int *perm)
+{
+	int i, j, k, head, tail, start, first;
+	int *degree = ivector(n);
+	int *visited = ivector(n);
+
+	for (i = 0; i < n; i++) {
+		degree[i] = 0;
+		visited[i] = FALSE;
+		for (k = a->row_start[i]; k < a->row_start[i+1]; k++)
+			if (a->col[k] < n && a->col[k] != i)
+				degree[i]++;
+	}
+
+	tail = 0;
+	while (tail < n) {
+		/* a disconnected part starts from its node of least degree	*/
+		start = -1;
+		for (i = 0; i < n; i++)
+			if (!visited[i] && (start < 0 || degree[i] < degree[start]))
+				start = i;
+		visited[start] = TRUE;
+		perm[tail++] = start;
+
+		for (head = tail - 1; head < tail; head++) {
+			first = tail;
+			for (k = a->row_start[perm[head]]; k < a->row_start[perm[head]+1]; k++) {
+				j = a->col[k];
+				if (j < n && !visited[j]) {
+					visited[j] = TRUE;
+					perm[tail++] = j;
+				}
+			}
+			/* insertion sort of the new neighbours by degree	*/
+			for (i = first + 1; i < tail; i++) {
+				int v = perm[i];
+				for (j = i; j > first && degree[perm[j-1]] > degree[v]; j--)
+					perm[j] = perm[j-1];
+				perm[j] = v;
+			}
+		}
+	}
+
+	/* reverse	*/
+	for (i = 0; i < n / 2; i++)
+		swap_ival(&perm[i], &perm[n-1-i]);
+
+	free_ivector(degree);
+	free_ivector(visited);
+}
+
+/* 
+ * envelope cholesky decomposition. row i of the lower triangular 
+ * factor l has non-zeros only from column first[i] to i, which is 
+ * all that is stored. since l[i][j] only depends on the rows i and 
+ * j, the factor fits within the envelope of the reordered 'a'
+ */
+sparse_chol_t *sparse_chol_dcmp(sparse_matrix_t *a, int n_reorder)
+{
+	int i, j, k, n = a->n;
+	int *iperm;
+	double sum;
+	sparse_chol_t *f = (sparse_chol_t *) calloc (1, sizeof(sparse_chol_t));
+	if (!f)
+		fatal("memory allocation error\n");
+
+	f->n = n;
+	f->perm = ivector(n);
+	f->first = ivector(n);
+	f->row_start = ivector(n+1);
+	iperm = ivector(n);
+
+	rcm_order(a, n_reorder, f->perm);
+	for (i = n_reorder; i < n; i++)
+		f->perm[i] = i;
+	for (i = 0; i < n; i++)
+		iperm[f->perm[i]] = i;
+
+	/* envelope of each row in the new order	*/
+	f->row_start[0] = 0;
+	for (i = 0; i < n; i++) {
+		f->first[i] = i;
+		for (k = a->row_start[f->perm[i]]; k < a->row_start[f->perm[i]+1]; k++)
+			f->first[i] = MIN(f->first[i], iperm[a->col[k]]);
+		f->row_start[i+1] = f->row_start[i] + i - f->first[i] + 1;
+	}
+
+	/* scatter the lower triangle of 'a' into the envelope	*/
+	f->val = dvector(f->row_start[n]);
+	for (i = 0; i < n; i++)
+		for (k = a->row_start[f->perm[i]]; k < a->row_start[f->perm[i]+1]; k++) {
+			j = iperm[a->col[k]];
+			if (j <= i)
+				f->val[f->row_start[i] + j - f->first[i]] = a->val[k];
+		}
+
+	/* 
+	 * l[i][j] = (a[i][j] - sum(l[i][k] * l[j][k], k < j)) / l[j][j]
+	 * l[i][i] = sqrt(a[i][i] - sum(l[i][k]^2, k < i))
+	 * where the sums only run over the overlap of the envelopes
+	 */
+	for (i = 0; i < n; i++) {
+		/* element (i, j) of the factor is at val[oi + j]	*/
+		int oi = f->row_start[i] - f->first[i];
+		for (j = f->first[i]; j <= i; j++) {
+			int oj = f->row_start[j] - f->first[j];
+			sum = f->val[oi+j];
+			for (k = MAX(f->first[i], f->first[j]); k < j; k++)
+				sum -= f->val[oi+k] * f->val[oj+k];
+			if (j < i)
+				f->val[oi+j] = sum / f->val[oj+j];
+			else if (sum <= 0)
+				fatal("matrix not positive definite in sparse_chol_dcmp\n");
+			else
+				f->val[oi+i] = sqrt(sum);
+		}
+	}
+
+	free_ivector(iperm);
+	return f;
+}
+
+void free_sparse_chol(sparse_chol_t *f)
+{
+	free_ivector(f->perm);
+	free_ivector(f->first);
+	free_ivector(f->row_start);
+	free_dvector(f->val);
+	free(f);
+}
+
+/* 
+ * forward substitution solves ly = pb and backward 
+ * substitution solves (l^T)(px) = y. the latter walks
+ * the rows of l, which are the columns of l^T
+ */
+void sparse_chol_solve(sparse_chol_t *f, double *b, double *x)
+{
+	int i, j, n = f->n;
+	double sum;
+	double *y = dvector(n);
+
+	for (i = 0; i < n; i++)
+		y[i] = b[f->perm[i]];
+
+	for (i = 0; i < n; i++) {
+		int oi = f->row_start[i] - f->first[i];
+		for (j = f->first[i], sum = y[i]; j < i; j++)
+			sum -= f->val[oi+j] * y[j];
+		y[i] = sum / f->val[oi+i];
+	}
+
+	for (i = n-1; i >= 0; i--) {
+		int oi = f->row_start[i] - f->first[i];
+		y[i] /= f->val[oi+i];
+		for (j = f->first[i]; j < i; j++)
+			y[j] -= f->val[oi+j] * y[i];
+	}
+
+	for (i = 0; i < n; i++)
+		x[f->perm[i]] = y[i];
+
+	free_dvector(y);
+}
+
+/* 
+ * same as sparse_chol_solve for 'nrhs' right hand sides, 
+ * interleaved in blocks of BATCH_BLOCK as in lusolve_batch
+ */
+void sparse_chol_solve_batch(sparse_chol_t *f, double **b, double **x, int nrhs)
+{
+	int i, j, r, r0, m, n = f->n;
+	double *y = dvector(n * BATCH_BLOCK);
+
+	for (r0 = 0; r0 < nrhs; r0 += BATCH_BLOCK) {
+		m = MIN(BATCH_BLOCK, nrhs - r0);
+
+		for (i = 0; i < n; i++)
+			for (r = 0; r < m; r++)
+				y[i*m+r] = b[r0+r][f->perm[i]];
+
+		for (i = 0; i < n; i++) {
+			int oi = f->row_start[i] - f->first[i];
+			double *yi = &y[i*m];
+			for (j = f->first[i]; j < i; j++) {
+				double l = f->val[oi+j];
+				double *yj = &y[j*m];
+				for (r = 0; r < m; r++)
+					yi[r] -= l * yj[r];
+			}
+			for (r = 0; r < m; r++)
+				yi[r] /= f->val[oi+i];
+		}
+
+		for (i = n-1; i >= 0; i--) {
+			int oi = f->row_start[i] - f->first[i];
+			double *yi = &y[i*m];
+			for (r = 0; r < m; r++)
+				yi[r] /= f->val[oi+i];
+			for (j = f->first[i]; j < i; j++) {
+				double l = f->val[oi+j];
+				double *yj = &y[j*m];
+				for (r = 0; r < m; r++)
+					yj[r] -= l * yi[r];
+			}
+		}
+
+		for (i = 0; i < n; i++)
+			for (r = 0; r < m; r++)
+				x[r0+r][f->perm[i]] = y[i*m+r];
+	}
+
+	free_dvector(y);
+}
+
+/* 
+ * row i of the factor l is computed from the rows of l above it:
+ * l[i][j] = (a[i][j] - sum(l[i][k] * l[j][k], k < j)) / l[j][j]
+ * l[i][i] = sqrt(a[i][i] - sum(l[i][k]^2, k < i))
+ * except that l[i][j] is only kept where a[i][j] is non-zero. 
+ * the rows are sorted, so the sums are merges of two rows
+ */
+sparse_matrix_t *sparse_ic0_dcmp(sparse_matrix_t *a)
+{
+	int i, j, k, p, q, n = a->n;
+	double sum;
+	sparse_matrix_t *l = (sparse_matrix_t *) calloc (1, sizeof(sparse_matrix_t));
+	if (!l)
+		fatal("memory allocation error\n");
+
+	/* lower triangle of 'a' with the columns of each row in order	*/
+	l->n = n;
+	l->row_start = ivector(n+1);
+	for (i = 0, l->nnz = 0; i < n; i++)
+		for (k = a->row_start[i]; k < a->row_start[i+1]; k++)
+			if (a->col[k] <= i)
+				l->nnz++;
+	l->col = ivector(l->nnz);
+	l->val = dvector(l->nnz);
+	for (i = 0, p = 0; i < n; i++) {
+		l->row_start[i] = p;
+		for (k = a->row_start[i]; k < a->row_start[i+1]; k++)
+			if (a->col[k] <= i) {
+				/* insertion sort	*/
+				for (q = p; q > l->row_start[i] && l->col[q-1] > a->col[k]; q--) {
+					l->col[q] = l->col[q-1];
+					l->val[q] = l->val[q-1];
+				}
+				l->col[q] = a->col[k];
+				l->val[q] = a->val[k];
+				p++;
+			}
+		/* the diagonal is the last element of the row	*/
+		if (p == l->row_start[i] || l->col[p-1] != i)
+			fatal("missing diagonal in sparse_ic0_dcmp\n");
+	}
+	l->row_start[n] = p;
+
+	for (i = 0; i < n; i++) {
+		int diag = l->row_start[i+1] - 1;
+		for (p = l->row_start[i]; p < diag; p++) {
+			j = l->col[p];
+			/* merge row i and row j below column j	*/
+			sum = l->val[p];
+			k = l->row_start[i];
+			q = l->row_start[j];
+			while (k < p && l->col[q] < j) {
+				if (l->col[k] < l->col[q])
+					k++;
+				else if (l->col[k] > l->col[q])
+					q++;
+				else
+					sum -= l->val[k++] * l->val[q++];
+			}
+			l->val[p] = sum / l->val[l->row_start[j+1]-1];
+		}
+		sum = l->val[diag];
+		for (p = l->row_start[i]; p < diag; p++)
+			sum -= l->val[p] * l->val[p];
+		if (sum <= 0)
+			fatal("matrix not positive definite in sparse_ic0_dcmp\n");
+		l->val[diag] = sqrt(sum);
+	}
+
+	return l;
+}
+
+/* forward substitution solves ly = b, backward substitution (l^T)x = y	*/
+void sparse_ic0_solve(sparse_matrix_t *l, double *b, double *x)
+{
+	int i, p, n = l->n;
+	double sum;
+
+	for (i = 0; i < n; i++) {
+		int diag = l->row_start[i+1] - 1;
+		for (p = l->row_start[i], sum = b[i]; p < diag; p++)
+			sum -= l->val[p] * x[l->col[p]];
+		x[i] = sum / l->val[diag];
+	}
+
+	for (i = n-1; i >= 0; i--) {
+		int diag = l->row_start[i+1] - 1;
+		x[i] /= l->val[diag];
+		for (p = l->row_start[i]; p < diag; p++)
+			x[l->col[p]] -= l->val[p] * x[i];
+	}
+}
+
+/* 
+ * see Shewchuk, "An Introduction to the Conjugate Gradient Method 
+ * Without the Agonizing Pain", 1994, section B3
+ */
+int pcgsolve(sparse_matrix_t *a, sparse_matrix_t *ic, double *b, double *x, 
+			 double tol, int max_iter, double *resid, double *work)
+{
+	int i, k, iter, n = a->n;
+	double rz, rz_new, alpha, beta, pq, rr, bb;
+	double *w = work ? work : dvector(PCG_WORK(n));
+	double *r = w, *z = w + n, *p = w + 2*n, *q = w + 3*n;
+	double *inv_diag = NULL;
+
+	if (!ic) {
+		inv_diag = w + 4*n;
+		for (i = 0; i < n; i++) {
+			inv_diag[i] = 1.0;
+			for (k = a->row_start[i]; k < a->row_start[i+1]; k++)
+				if (a->col[k] == i && a->val[k] != 0.0)
+					inv_diag[i] = 1.0 / a->val[k];
+		}
+	}
+
+	/* r = b - ax, z = inv(m) * r, p = z	*/
+	sparse_matvectmult(q, a, x);
+	for (i = 0, bb = 0; i < n; i++) {
+		r[i] = b[i] - q[i];
+		bb += b[i] * b[i];
+	}
+	if (ic)
+		sparse_ic0_solve(ic, r, z);
+	else
+		for (i = 0; i < n; i++)
+			z[i] = inv_diag[i] * r[i];
+	for (i = 0, rz = 0; i < n; i++) {
+		p[i] = z[i];
+		rz += r[i] * z[i];
+	}
+
+	for (iter = 0; ; iter++) {
+		for (i = 0, rr = 0; i < n; i++)
+			rr += r[i] * r[i];
+		if (rr <= tol * tol * bb)
+			break;
+		if (iter >= max_iter) {
+			iter = -1;
+			break;
+		}
+
+		sparse_matvectmult(q, a, p);
+		for (i = 0, pq = 0; i < n; i++)
+			pq += p[i] * q[i];
+		alpha = rz / pq;
+		for (i = 0; i < n; i++) {
+			x[i] += alpha * p[i];
+			r[i] -= alpha * q[i];
+		}
+		if (ic)
+			sparse_ic0_solve(ic, r, z);
+		else
+			for (i = 0; i < n; i++)
+				z[i] = inv_diag[i] * r[i];
+		for (i = 0, rz_new = 0; i < n; i++)
+			rz_new += r[i] * z[i];
+		beta = rz_new / rz;
+		rz = rz_new;
+		for (i = 0; i < n; i++)
+			p[i] = z[i] + beta * p[i];
+	}
+
+	if (resid)
+		*resid = (bb > 0) ? sqrt(rr / bb) : sqrt(rr);
+
+	if (!work)
+		free_dvector(w);
+	return iter;
+}
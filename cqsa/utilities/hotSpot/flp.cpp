@@ -3,6 +3,9 @@
 #include <string.h>
 #include <stdlib.h>
 #include <math.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #include "flp.h"
 #include "npe.h"
@@ -88,6 +91,13 @@ flp_config_t default_flp_config(void)
 	config.lambdaT = 1.0;
 	config.lambdaW = 350;
 
+	/* warm started pcg for the thermal model of each move	*/
+	config.anneal_warm = TRUE;
+
+	/* a single annealing chain	*/
+	config.n_chains = 1;
+	config.replica_exchange = TRUE;
+
 	return config;
 }
 
@@ -143,6 +153,15 @@ void flp_config_add_from_strs(flp_config_t *config, str_pair *table, int size)
 	if ((idx = get_str_index(table, size, "lambdaW")) >= 0)
 		if(sscanf(table[idx].value, "%lf", &config->lambdaW) != 1)
 			fatal("invalid format for configuration  parameter lambdaW\n");
+	if ((idx = get_str_index(table, size, "anneal_warm")) >= 0)
+		if(sscanf(table[idx].value, "%d", &config->anneal_warm) != 1)
+			fatal("invalid format for configuration  parameter anneal_warm\n");
+	if ((idx = get_str_index(table, size, "n_chains")) >= 0)
+		if(sscanf(table[idx].value, "%d", &config->n_chains) != 1)
+			fatal("invalid format for configuration  parameter n_chains\n");
+	if ((idx = get_str_index(table, size, "replica_exchange")) >= 0)
+		if(sscanf(table[idx].value, "%d", &config->replica_exchange) != 1)
+			fatal("invalid format for configuration  parameter replica_exchange\n");
 			
 	if (config->rim_thickness <= 0)
 		fatal("rim thickness should be greater than zero\n");
@@ -160,6 +179,8 @@ void flp_config_add_from_strs(flp_config_t *config, str_pair *table, int size)
 		fatal("Rreject should be between 0 and 1\n");
 	if (config->Nmax < 0)
 		fatal("Nmax should be non-negative\n");
+	if (config->n_chains < 0)
+		fatal("n_chains should be non-negative\n");
 }
 
 /* 
@@ -168,7 +189,7 @@ void flp_config_add_from_strs(flp_config_t *config, str_pair *table, int size)
  */
 int flp_config_to_strs(flp_config_t *config, str_pair *table, int max_entries)
 {
-	if (max_entries < 15)
+	if (max_entries < 18)
 		fatal("not enough entries in table\n");
 
 	sprintf(table[0].name, "wrap_l2");
@@ -186,6 +207,9 @@ int flp_config_to_strs(flp_config_t *config, str_pair *table, int max_entries)
 	sprintf(table[12].name, "lambdaA");
 	sprintf(table[13].name, "lambdaT");
 	sprintf(table[14].name, "lambdaW");
+	sprintf(table[15].name, "anneal_warm");
+	sprintf(table[16].name, "n_chains");
+	sprintf(table[17].name, "replica_exchange");
 
 	sprintf(table[0].value, "%d", config->wrap_l2);
 	sprintf(table[1].value, "%s", config->l2_label);
@@ -202,8 +226,291 @@ int flp_config_to_strs(flp_config_t *config, str_pair *table, int max_entries)
 	sprintf(table[12].value, "%lg", config->lambdaA);
 	sprintf(table[13].value, "%lg", config->lambdaT);
 	sprintf(table[14].value, "%lg", config->lambdaW);
+	sprintf(table[15].value, "%d", config->anneal_warm);
+	sprintf(table[16].value, "%d", config->n_chains);
+	sprintf(table[17].value, "%d", config->replica_exchange);
+
+	return 18;
+}
+
+/* wire density routines	*/
+
+/*
+ * no. of metrics found incrementally before a full one. each
+ * step adds its own rounding error, so they are not let to pile up
+ */
+#define WIRE_MAX_DELTAS	64
+
+flp_wire_t *alloc_flp_wire(int n_units)
+{
+	flp_wire_t *w = (flp_wire_t *) calloc(1, sizeof(flp_wire_t));
+	if (!w)
+		fatal("memory allocation error\n");
+	w->n_units = n_units;
+	/* a few connections per unit to begin with	*/
+	w->max_conn = 4 * n_units + 1;
+	w->row = ivector(w->max_conn);
+	w->col = ivector(w->max_conn);
+	w->density = dvector(w->max_conn);
+	w->tmp_row = ivector(w->max_conn);
+	w->tmp_col = ivector(w->max_conn);
+	w->tmp_density = dvector(w->max_conn);
+	w->start = ivector(n_units + 1);
+	w->unit_start = ivector(n_units + 1);
+	w->unit_conn = ivector(2 * w->max_conn);
+	w->count = ivector(n_units + 1);
+	w->cx = dvector(n_units);
+	w->cy = dvector(n_units);
+	w->new_cx = dvector(n_units);
+	w->new_cy = dvector(n_units);
+	w->moved = ivector(n_units);
+	zero_ivector(w->start, n_units + 1);
+	zero_ivector(w->unit_start, n_units + 1);
+	zero_ivector(w->moved, n_units);
+	return w;
+}
 
-	return 15;
+void free_flp_wire(flp_wire_t *w)
+{
+	free_ivector(w->row);
+	free_ivector(w->col);
+	free_dvector(w->density);
+	free_ivector(w->tmp_row);
+	free_ivector(w->tmp_col);
+	free_dvector(w->tmp_density);
+	free_ivector(w->start);
+	free_ivector(w->unit_start);
+	free_ivector(w->unit_conn);
+	free_ivector(w->count);
+	free_dvector(w->cx);
+	free_dvector(w->cy);
+	free_dvector(w->new_cx);
+	free_dvector(w->new_cy);
+	free_ivector(w->moved);
+	free(w);
+}
+
+/* make room for one more connection	*/
+static void wire_grow(flp_wire_t *w)
+{
+	if (w->n_conn < w->max_conn)
+		return;
+	w->max_conn *= 2;
+	w->row = (int *) realloc(w->row, w->max_conn * sizeof(int));
+	w->col = (int *) realloc(w->col, w->max_conn * sizeof(int));
+	w->density = (double *) realloc(w->density, w->max_conn * sizeof(double));
+	w->tmp_row = (int *) realloc(w->tmp_row, w->max_conn * sizeof(int));
+	w->tmp_col = (int *) realloc(w->tmp_col, w->max_conn * sizeof(int));
+	w->tmp_density = (double *) realloc(w->tmp_density, w->max_conn * sizeof(double));
+	w->unit_conn = (int *) realloc(w->unit_conn, 2 * w->max_conn * sizeof(int));
+	if (!w->row || !w->col || !w->density || !w->tmp_row || !w->tmp_col ||
+		!w->tmp_density || !w->unit_conn)
+		fatal("memory allocation error\n");
+}
+
+static void wire_append(flp_wire_t *w, int row, int col, double density)
+{
+	wire_grow(w);
+	w->row[w->n_conn] = row;
+	w->col[w->n_conn] = col;
+	w->density[w->n_conn] = density;
+	w->n_conn++;
+	w->unsorted = TRUE;
+	w->cached = FALSE;
+}
+
+/* stable counting sort of the connections by row (or by col)	*/
+static void wire_sort(flp_wire_t *w, int by_row)
+{
+	int k, r, *swap;
+	int *key = by_row ? w->row : w->col;
+	double *dswap;
+
+	zero_ivector(w->count, w->n_units + 1);
+	for (k = 0; k < w->n_conn; k++)
+		w->count[key[k]+1]++;
+	for (r = 0; r < w->n_units; r++)
+		w->count[r+1] += w->count[r];
+	for (k = 0; k < w->n_conn; k++) {
+		int pos = w->count[key[k]]++;
+		w->tmp_row[pos] = w->row[k];
+		w->tmp_col[pos] = w->col[k];
+		w->tmp_density[pos] = w->density[k];
+	}
+	swap = w->row; w->row = w->tmp_row; w->tmp_row = swap;
+	swap = w->col; w->col = w->tmp_col; w->tmp_col = swap;
+	dswap = w->density; w->density = w->tmp_density; w->tmp_density = dswap;
+}
+
+/*
+ * drop the duplicates of sorted connections - the last one set
+ * stands - and the zeros. then index the rest by row and by unit
+ */
+static void wire_compact(flp_wire_t *w)
+{
+	int i, k, n = 0;
+
+	for (k = 0; k < w->n_conn; k++) {
+		/* a later one for the same pair	*/
+		if (k+1 < w->n_conn && w->row[k+1] == w->row[k] && w->col[k+1] == w->col[k])
+			continue;
+		if (!w->density[k])
+			continue;
+		w->row[n] = w->row[k];
+		w->col[n] = w->col[k];
+		w->density[n] = w->density[k];
+		n++;
+	}
+	w->n_conn = n;
+
+	zero_ivector(w->start, w->n_units + 1);
+	zero_ivector(w->unit_start, w->n_units + 1);
+	for (k = 0; k < n; k++) {
+		w->start[w->row[k]+1]++;
+		w->unit_start[w->row[k]+1]++;
+		if (w->col[k] != w->row[k])
+			w->unit_start[w->col[k]+1]++;
+	}
+	for (i = 0; i < w->n_units; i++) {
+		w->start[i+1] += w->start[i];
+		w->unit_start[i+1] += w->unit_start[i];
+	}
+	/*
+	 * in the order of the connections, a unit meets its lower
+	 * numbered partners (its own row) before its higher ones
+	 */
+	copy_ivector(w->count, w->unit_start, w->n_units);
+	for (k = 0; k < n; k++) {
+		w->unit_conn[w->count[w->row[k]]++] = k;
+		if (w->col[k] != w->row[k])
+			w->unit_conn[w->count[w->col[k]]++] = k;
+	}
+	w->unsorted = w->zeroed = FALSE;
+}
+
+/* every pair connected, kept explicitly	*/
+static void wire_expand(flp_wire_t *w)
+{
+	int i, j;
+	w->uniform = FALSE;
+	w->n_conn = 0;
+	for (i = 0; i < w->n_units; i++)
+		for (j = 0; j <= i; j++)
+			wire_append(w, i, j, 1.0);
+}
+
+void flp_wire_update(flp_t *flp)
+{
+	flp_wire_t *w = flp->wire;
+	if (w->uniform)
+		wire_expand(w);
+	if (w->unsorted) {
+		wire_sort(w, FALSE);
+		wire_sort(w, TRUE);
+	}
+	if (w->unsorted || w->zeroed)
+		wire_compact(w);
+}
+
+/* index of the connection between row and col, -1 if none	*/
+static int wire_find(flp_wire_t *w, int row, int col)
+{
+	int lo = w->start[row], hi = w->start[row+1] - 1;
+	while (lo <= hi) {
+		int mid = (lo + hi) / 2;
+		if (w->col[mid] == col)
+			return mid;
+		if (w->col[mid] < col)
+			lo = mid + 1;
+		else
+			hi = mid - 1;
+	}
+	return -1;
+}
+
+double get_wire_density(flp_t *flp, int i, int j)
+{
+	int k;
+	if (flp->wire->uniform)
+		return 1.0;
+	flp_wire_update(flp);
+	k = wire_find(flp->wire, MAX(i, j), MIN(i, j));
+	return (k >= 0) ? flp->wire->density[k] : 0.0;
+}
+
+void set_wire_density(flp_t *flp, int i, int j, double density)
+{
+	flp_wire_t *w = flp->wire;
+	int k, row = MAX(i, j), col = MIN(i, j);
+
+	if (w->uniform)
+		wire_expand(w);
+	/*
+	 * while sorted, a connection is changed in place and a new
+	 * one only appended. otherwise, the last one set stands
+	 */
+	if (!w->unsorted) {
+		if ((k = wire_find(w, row, col)) >= 0) {
+			if (w->density[k] != density) {
+				w->density[k] = density;
+				w->zeroed |= !density;
+				w->cached = FALSE;
+			}
+			return;
+		}
+		if (!density)
+			return;
+	}
+	wire_append(w, row, col, density);
+}
+
+void clear_wire_density(flp_t *flp, int i)
+{
+	flp_wire_t *w = flp->wire;
+	int k;
+
+	if (w->uniform || w->unsorted)
+		flp_wire_update(flp);
+	for (k = w->unit_start[i]; k < w->unit_start[i+1]; k++)
+		if (w->density[w->unit_conn[k]]) {
+			w->density[w->unit_conn[k]] = 0;
+			w->zeroed = TRUE;
+			w->cached = FALSE;
+		}
+}
+
+/* 
+ * weighted length of the first 'n_conn' connections for the unit
+ * centres in cx and cy. a connection counts both ways round, as 
+ * every ordered pair of units does in the metric
+ */
+static double wire_sum(flp_wire_t *w, int n_conn, double *cx, double *cy)
+{
+	int k;
+	int *row = w->row, *col = w->col;
+	double *density = w->density;
+	double sum = 0.0;
+
+	#pragma omp simd reduction(+:sum)
+	for (k = 0; k < n_conn; k++)
+		sum += density[k] * (fabs(cx[row[k]] - cx[col[k]]) + 
+							 fabs(cy[row[k]] - cy[col[k]]));
+	return 2.0 * sum;
+}
+
+/* same as above with every pair of the first n units connected	*/
+static double wire_sum_uniform(int n, double *cx, double *cy)
+{
+	int i, j;
+	double sum = 0.0;
+
+	for (i = 1; i < n; i++) {
+		double x = cx[i], y = cy[i];
+		#pragma omp simd reduction(+:sum)
+		for (j = 0; j < i; j++)
+			sum += fabs(cx[j] - x) + fabs(cy[j] - y);
+	}
+	return 2.0 * sum;
 }
 
 /* 
@@ -218,12 +525,9 @@ void copy_l2_info (flp_t *flp, int to, flp_desc_t *flp_desc, int from, int size)
 	for(count=0; count < L2_ARMS + 1; count++, to++) {
 		/* copy names */
 		strcpy(flp->units[to].name, flp_desc->units[from].name);
-		for(j=0; j < size; j++) {
-			/* rows	*/
-			flp->wire_density[to][j] = flp_desc->wire_density[from][j];
-			/* columns	*/	
-			flp->wire_density[j][to] = flp_desc->wire_density[j][from];
-		}
+		/* the densities are kept both ways round	*/
+		for(j=0; j < size; j++)
+			set_wire_density(flp, to, j, flp_desc->wire_density[from][j]);
 	}
 	/* fix the names of the arms	*/
 	strcat(flp->units[to-L2_ARMS+L2_LEFT].name, L2_LEFT_STR);	
@@ -269,20 +573,15 @@ flp_t *flp_placeholder(flp_desc_t *flp_desc)
 		flp->n_units += (2*flp->n_units + 2);
 
 	flp->units = (unit_t *) calloc (flp->n_units, sizeof(unit_t));
-	flp->wire_density = (double **) calloc(flp->n_units, sizeof(double *));
-	if (!flp->units || !flp->wire_density)
+	if (!flp->units)
 		fatal("memory allocation error\n");
-	for (i=0; i < flp->n_units; i++) {
-	  flp->wire_density[i] = (double *) calloc(flp->n_units, sizeof(double));
-	  if (!flp->wire_density[i])
-	  	fatal("memory allocation error\n");
-	}
+	flp->wire = alloc_flp_wire(flp->n_units);
 
 	/* copy connectivity (only for non-dead core blocks) */
 	for(i=0; i < flp_desc->n_units-!!(wrap_l2); i++) {
 	  strcpy(flp->units[i].name, flp_desc->units[i].name);
-	  for (j=0; j < flp_desc->n_units-!!(wrap_l2); j++) {
-	  	flp->wire_density[i][j] = flp_desc->wire_density[i][j];
+	  for (j=0; j <= i; j++) {
+	  	set_wire_density(flp, i, j, flp_desc->wire_density[i][j]);
 	  }
 	}
 
@@ -305,7 +604,7 @@ void restore_dead_blocks(flp_t *flp, flp_desc_t *flp_desc,
 						 int compacted, int wrap_l2, 
 						 int model_rim, int rim_blocks)
 {
-	int i, j, idx=0;
+	int i, idx=0;
 	/* remove L2 and rim blocks and restore the compacted blocks */
 	if(model_rim)
 		flp->n_units -= rim_blocks;
@@ -319,9 +618,9 @@ void restore_dead_blocks(flp_t *flp, flp_desc_t *flp_desc,
 		sprintf(flp->units[idx].name, DEAD_PREFIX"%d", i);
 		flp->units[idx].leftx = flp->units[idx].bottomy = 0;
 		flp->units[idx].width = flp->units[idx].height = 0;
-		for(j=0; j < flp->n_units; j++)
-			flp->wire_density[idx][j] = flp->wire_density[j][idx] = 0;
+		clear_wire_density(flp, idx);
 	}
+	flp_invalidate_adj(flp);
 }
 
 /* translate the floorplan to new origin (x,y)	*/
@@ -341,6 +640,7 @@ void flp_translate(flp_t *flp, double x, double y)
 		flp->units[i].leftx += (x - minx);
 		flp->units[i].bottomy += (y - miny);
 	}
+	flp_invalidate_adj(flp);
 }
 
 /* scale the floorplan by a factor 'factor'	*/
@@ -362,6 +662,7 @@ void flp_scale(flp_t *flp, double factor)
 		flp->units[i].width *= factor;
 		flp->units[i].height *= factor;
 	}
+	flp_invalidate_adj(flp);
 }
 
 /* 
@@ -439,6 +740,7 @@ void flp_change_orient(flp_t *flp, double xorig, double yorig,
 		flp->units[i].leftx += (xorig + width / 2.0);
 		flp->units[i].bottomy += (yorig + height / 2.0);
 	}
+	flp_invalidate_adj(flp);
 }
 
 /* 
@@ -459,7 +761,7 @@ flp_t *flp_create_grid(flp_t *flp)
 	double x[MAX_UNITS], y[MAX_UNITS];
 	double rightx = flp->units[0].leftx + flp->units[0].width;
 	double topy = flp->units[0].bottomy + flp->units[0].height;
-	int i, j, xsize=0, ysize=0, count=0;
+	int i, j, k, xsize=0, ysize=0, count=0;
 	flp_t *grid;
 	int **map;
 
@@ -488,14 +790,9 @@ flp_t *flp_create_grid(flp_t *flp)
 		fatal("memory allocation error\n");
 	grid->n_units = (xsize-1) * (ysize-1);	
 	grid->units = (unit_t *) calloc (grid->n_units, sizeof(unit_t));
-	grid->wire_density = (double **) calloc(grid->n_units, sizeof(double *));
-	if (!grid->units || !grid->wire_density)
+	if (!grid->units)
 		fatal("memory allocation error\n");
-	for (i=0; i < grid->n_units; i++) {
-	  grid->wire_density[i] = (double *) calloc(grid->n_units, sizeof(double));
-	  if (!grid->wire_density[i])
-	  	fatal("memory allocation error\n");
-	}
+	grid->wire = alloc_flp_wire(grid->n_units);
 	/* mapping between blocks of 'flp' to those of 'grid'	*/
 	map = (int **) calloc(flp->n_units, sizeof(int *));
 	if (!map)
@@ -551,13 +848,15 @@ flp_t *flp_create_grid(flp_t *flp)
 		fatal("mismatch in the no. of units\n");
 
 	/* fill-in the wire densities	*/
-	for(i=0; i < flp->n_units; i++)
-		for(j=0; j < flp->n_units; j++) {
-			int p, q;
-			for(p=1; p <= map[i][0]; p++)
-				for(q=1; q <= map[j][0]; q++)
-					grid->wire_density[map[i][p]][map[j][q]] = flp->wire_density[i][j];
-		}
+	flp_wire_update(flp);
+	for(k=0; k < flp->wire->start[flp->n_units]; k++) {
+		int p, q;
+		i = flp->wire->row[k];
+		j = flp->wire->col[k];
+		for(p=1; p <= map[i][0]; p++)
+			for(q=1; q <= map[j][0]; q++)
+				set_wire_density(grid, map[i][p], map[j][q], flp->wire->density[k]);
+	}
 
 	for(i=0; i < flp->n_units; i++)
 		free(map[i]);
@@ -657,6 +956,7 @@ void flp_wrap_l2(flp_t *flp, flp_desc_t *flp_desc)
 	l2_right->height = core_height;
 	l2_right->leftx = x + core_width;
 	l2_right->bottomy = y;
+	flp_invalidate_adj(flp);
 }
 
 /*
@@ -668,7 +968,7 @@ void flp_wrap_l2(flp_t *flp, flp_desc_t *flp_desc)
 int flp_wrap_rim(flp_t *flp, double rim_thickness)
 {
 	double width, height;
-	int i, j = 0, k, n = flp->n_units;
+	int i, j = 0, n = flp->n_units;
 
 	width = get_total_width(flp) + 2 * rim_thickness;
 	height = get_total_height(flp) + 2 * rim_thickness;
@@ -740,45 +1040,247 @@ int flp_wrap_rim(flp_t *flp, double rim_thickness)
 	}	
 
 	flp->n_units += j;
+	flp_invalidate_adj(flp);
 
 	/* update all the rim wire densities */
 	for(i=n; i < n+j; i++)
-		for(k=0; k <= i; k++)
-			flp->wire_density[i][k] = flp->wire_density[k][i] = 0;
+		clear_wire_density(flp, i);
 
 	return j;
 }
 
+/* one annealing chain, with a floorplan and thermal model of its own	*/
+typedef struct anneal_chain_t_st
+{
+	flp_t *flp;
+	RC_model_t *model;
+	/* 
+	 * to maintain the order of power values during
+	 * the compaction/shifting around of blocks
+	 */
+	double *tpower;
+	/* slicing tree of the current NPE	*/
+	slicing_tree_t *tree;
+	/* state of the random stream. NULL for the global one	*/
+	unsigned int *seed;
+	unsigned int seed_state;
+	/* current and best NPEs, their costs and the temperature	*/
+	NPE_t *expr, *best;
+	double cost, best_cost, T;
+	/* statistics of the last step	*/
+	int tries, rejects;
+	double sum_cost;
+	/* too few accepts to go on?	*/
+	int done;
+}anneal_chain_t;
+
+/* 
+ * cost of the floorplan of the chain's NPE, after a move that
+ * changed its positions 'first' to 'last'. it is laid out in 
+ * the chain's placeholder, which is restored afterwards
+ */
+static double anneal_evaluate(anneal_chain_t *c, flp_desc_t *flp_desc,
+							  double *power, int first, int last, 
+							  int wrap_l2)
+{
+	tree_node_t *root;			/* shape curve tree	*/
+	int compacted, rim_blocks = 0;
+	double cost;
+	flp_config_t *cfg = &flp_desc->config;
+
+	/* convert NPE to flp	*/
+	root = slicing_tree_update(c->tree, flp_desc, c->expr, first, last);
+	/* compacts too small dead blocks	*/
+	compacted = tree_to_flp(root, c->flp, TRUE, cfg->compact_ratio);
+	/* update the tpower vector according to the compaction	*/
+	trim_hotspot_vector(c->model, c->tpower, power, c->flp->n_units, compacted);
+	if(wrap_l2)
+		flp_wrap_l2(c->flp, flp_desc);
+	if(cfg->model_rim)
+		rim_blocks = flp_wrap_rim(c->flp, cfg->rim_thickness);
+
+	resize_thermal_model(c->model, c->flp->n_units);
+	#if VERBOSE > 2
+	print_flp(c->flp);
+	#endif
+	cost = flp_evaluate_metric(c->flp, c->model, c->tpower, cfg->lambdaA, 
+							   cfg->lambdaT, cfg->lambdaW);
+	/* restore the compacted blocks	*/
+	restore_dead_blocks(c->flp, flp_desc, compacted, wrap_l2, cfg->model_rim, rim_blocks);
+
+	return cost;
+}
+
+/* one annealing step of a chain at its temperature	*/
+static void anneal_step(anneal_chain_t *c, flp_desc_t *flp_desc, 
+						double *power, int wrap_l2)
+{
+	NPE_move_t move;
+	double new_cost;
+	int downs = 0;
+	/* shortcut	*/
+	int n = flp_desc->config.Kmoves * c->flp->n_units;
+
+	c->tries = c->rejects = 0;
+	c->sum_cost = 0;
+	/* try enough total or downhill moves per T */
+	while ((c->tries < 2 * n) && (downs < n)) {
+		/* moves are made in place and undone if rejected	*/
+		NPE_random_move(c->expr, &move, c->seed);
+		new_cost = anneal_evaluate(c, flp_desc, power, move.first, 
+								   move.last, wrap_l2);
+
+		#if VERBOSE > 1
+		fprintf(stdout, "count: %d\tdowns: %d\tcost: %g\t", 
+				c->tries, downs, new_cost);
+		#endif
+
+		/* move accepted?	*/
+		if (new_cost < c->cost || 	/* downhill always accepted	*/
+			/* boltzmann probability function	*/
+		    rand_fraction_r(c->seed) < exp(-(new_cost-c->cost)/c->T)) {
+
+			/* downhill move	*/
+			if (new_cost < c->cost) {
+				downs++;
+				/* found new best	*/
+				if (new_cost < c->best_cost) {
+					NPE_copy(c->best, c->expr);
+					c->best_cost = new_cost;
+				}
+			}
+
+			#if VERBOSE > 1
+			fprintf(stdout, "accepted\n");
+			#endif
+			c->cost = new_cost;
+			c->sum_cost += c->cost;
+		} else {	/* rejected move	*/
+			c->rejects++;
+			NPE_undo_move(c->expr, &move);
+			slicing_tree_undo(c->tree);
+			#if VERBOSE > 1
+			fprintf(stdout, "rejected\n");
+			#endif
+		}
+		c->tries++;
+	}
+}
+
+/* 
+ * replica exchange between the chains 'first' and 'first+1',
+ * 'first+2' and 'first+3' and so on. a colder chain always takes
+ * over a better state from its hotter neighbour. otherwise, the
+ * two swap with the probability exp(-(1/T1 - 1/T2) * (C2 - C1))
+ */
+static void anneal_exchange(anneal_chain_t *chains, int n_chains, 
+							int first, unsigned int *seed)
+{
+	int k;
+	NPE_t *expr;
+	slicing_tree_t *tree;
+	double cost, delta;
+
+	for (k = first; k + 1 < n_chains; k += 2) {
+		anneal_chain_t *cold = &chains[k], *hot = &chains[k+1];
+		if (cold->done || hot->done)
+			continue;
+		delta = (1.0 / cold->T - 1.0 / hot->T) * (cold->cost - hot->cost);
+		if (delta >= 0 || rand_fraction_r(seed) < exp(delta)) {
+			expr = cold->expr;
+			cold->expr = hot->expr;
+			hot->expr = expr;
+			tree = cold->tree;
+			cold->tree = hot->tree;
+			hot->tree = tree;
+			cost = cold->cost;
+			cold->cost = hot->cost;
+			hot->cost = cost;
+		}
+	}
+}
+
 /* 
  * floorplanning using simulated annealing.
  * precondition: flp is a pre-allocated placeholder.
  * returns the number of compacted blocks in the selected
- * floorplan
+ * floorplan. with more than one chain configured, the chains
+ * anneal in parallel, each from a random stream, floorplan and 
+ * thermal model of its own. the first chain uses the ones passed
+ * in. with replica exchange, the chains are at successively 
+ * higher temperatures and swap their states after every step.
+ * the best floorplan of all the chains is returned
  */
 int floorplan(flp_t *flp, flp_desc_t *flp_desc, 
 			  RC_model_t *model, double *power)
 {
-	NPE_t *expr, *next, *best;	/* Normalized Polish Expressions */
-	tree_node_stack_t *stack;	/* for NPE evaluation	*/
+	anneal_chain_t *chains, *c;
+	NPE_t *expr, *best;			/* Normalized Polish Expressions */
 	tree_node_t *root;			/* shape curve tree	*/
-	double cost, new_cost, best_cost, sum_cost, T, Tcold;
-	int i, steps, downs, n, rejects, compacted, rim_blocks = 0;
+	double best_cost, T, Tcold;
+	int k, steps, n_chains, n_done, compacted;
 	int original_n = flp->n_units;
-
-	/* to maintain the order of power values during
-	 * the compaction/shifting around of blocks
-	 */
-	double *tpower = hotspot_vector(model);
+	char solver[STR_SIZE];
+	int warm;
+	/* random stream for the replica exchanges	*/
+	unsigned int exchange_seed = RAND_SEED;
 
 	/* shortcut	*/
 	flp_config_t cfg = flp_desc->config;
 
+	n_chains = cfg.n_chains;
+	#ifdef _OPENMP
+	if (!n_chains)
+		n_chains = omp_get_max_threads();
+	#endif
+	n_chains = MAX(n_chains, 1);
+
+	/* 
+	 * the annealer only ranks the floorplans. a move rebuilds the 
+	 * whole slicing floorplan and changes the chip size, so all of
+	 * B changes. but the temperatures change little from one move 
+	 * to the next. so, rather than a fresh LUP decomposition for
+	 * every move, solve by pcg starting from the last move's solution
+	 */
+	warm = cfg.anneal_warm && model->type == BLOCK_MODEL;
+	if (warm)
+		strcpy(solver, model->block->config.block_solver);
+
+	/* 
+	 * the placeholders of the other chains have to be
+	 * made before L2 disappears from the description
+	 */
+	chains = (anneal_chain_t *) calloc(n_chains, sizeof(anneal_chain_t));
+	if (!chains)
+		fatal("memory allocation error\n");
+	for (k = 0; k < n_chains; k++) {
+		c = &chains[k];
+		if (k) {
+			c->flp = flp_placeholder(flp_desc);
+			c->model = alloc_RC_model(model->config, c->flp);
+		} else {
+			c->flp = flp;
+			c->model = model;
+		}
+		if (warm) {
+			strcpy(c->model->block->config.block_solver, BLOCK_SOLVER_PCG_STR);
+			c->model->block->n_warm = 0;
+		}
+		c->tpower = hotspot_vector(c->model);
+		/* a single chain draws from the global stream	*/
+		if (n_chains > 1) {
+			c->seed_state = RAND_SEED + k + 1;
+			c->seed = &c->seed_state;
+		}
+	}
+
 	/* 
 	 * make the rim strips disappear for slicing tree
 	 * purposes. can be restored at the end
 	 */
 	if (cfg.model_rim)
-		flp->n_units = (flp->n_units - 2) / 3;
+		for (k = 0; k < n_chains; k++)
+			chains[k].flp->n_units = (chains[k].flp->n_units - 2) / 3;
 
 	/* wrap L2 around?	*/
 	int wrap_l2 = FALSE;
@@ -787,36 +1289,24 @@ int floorplan(flp_t *flp, flp_desc_t *flp_desc,
 		wrap_l2 = TRUE;
 		/* make L2 disappear too */
 		flp_desc->n_units--;
-		flp->n_units -= (L2_ARMS+1);
+		for (k = 0; k < n_chains; k++)
+			chains[k].flp->n_units -= (L2_ARMS+1);
 	}
 
 	/* initialization	*/
 	expr = NPE_get_initial(flp_desc);
-	stack = new_tree_node_stack();
 	init_rand();
-	
-	/* convert NPE to flp	*/
-	root = tree_from_NPE(flp_desc, stack, expr);
-	/* compacts too small dead blocks	*/
-	compacted = tree_to_flp(root, flp, TRUE, cfg.compact_ratio);
-	/* update the tpower vector according to the compaction	*/
-	trim_hotspot_vector(model, tpower, power, flp->n_units, compacted);
-	free_tree(root);
-	if(wrap_l2)
-		flp_wrap_l2(flp, flp_desc);
-	if(cfg.model_rim)
-		rim_blocks = flp_wrap_rim(flp, cfg.rim_thickness);
-
-	resize_thermal_model(model, flp->n_units);
-	#if VERBOSE > 2
-	print_flp(flp);
-	#endif
-	cost = flp_evaluate_metric(flp, model, tpower, cfg.lambdaA, cfg.lambdaT, cfg.lambdaW);
-	/* restore the compacted blocks	*/
-	restore_dead_blocks(flp, flp_desc, compacted, wrap_l2, cfg.model_rim, rim_blocks);
 
-	best = NPE_duplicate(expr);	/* best till now	*/
-	best_cost = cost;
+	#pragma omp parallel for schedule(dynamic, 1) if (n_chains > 1)
+	for (k = 0; k < n_chains; k++) {
+		anneal_chain_t *c = &chains[k];
+		c->expr = NPE_duplicate(expr);
+		c->tree = new_slicing_tree(expr->size);
+		c->cost = anneal_evaluate(c, flp_desc, power, 0, expr->size-1, wrap_l2);
+		c->best = NPE_duplicate(c->expr);	/* best till now	*/
+		c->best_cost = c->cost;
+	}
+	free_NPE(expr);
 
 	/* simulated annealing	*/
 	steps = 0;
@@ -832,95 +1322,71 @@ int floorplan(flp_t *flp, flp_desc_t *flp_desc,
 	 */
 	Tcold = -cfg.Davg / log ((1.0 - cfg.Rreject) / 2.0);
 	#if VERBOSE > 0
-	fprintf(stdout, "initial cost: %g\tinitial T: %g\tfinal T: %g\n", cost, T, Tcold);
+	fprintf(stdout, "initial cost: %g\tinitial T: %g\tfinal T: %g\n", chains[0].cost, T, Tcold);
 	#endif
 	/* 
 	 * stop annealing if temperature has cooled down enough or
-	 * max no. of iterations have been tried
+	 * max no. of iterations have been tried. the temperatures
+	 * of the replicas are relative to the coldest one
 	 */
 	while (T >= Tcold && steps < cfg.Nmax) {
-		/* shortcut	*/
-		n = cfg.Kmoves * flp->n_units; 
-		i = downs = rejects = 0;
-		sum_cost = 0;
-		/* try enough total or downhill moves per T */
-		while ((i < 2 * n) && (downs < n)) {
-			next = make_random_move(expr);
-
-			/* convert NPE to flp	*/
-			root = tree_from_NPE(flp_desc, stack, next);
-			compacted = tree_to_flp(root, flp, TRUE, cfg.compact_ratio);
-			/* update the tpower vector according to the compaction	*/
-			trim_hotspot_vector(model, tpower, power, flp->n_units, compacted);
-			free_tree(root);
-			if(wrap_l2)
-				flp_wrap_l2(flp, flp_desc);
-			if(cfg.model_rim)
-				rim_blocks = flp_wrap_rim(flp, cfg.rim_thickness);
-
-			resize_thermal_model(model, flp->n_units);
-			#if VERBOSE > 2
-			print_flp(flp);
-			#endif
-			new_cost = flp_evaluate_metric(flp, model, tpower, cfg.lambdaA, cfg.lambdaT, cfg.lambdaW);
-			restore_dead_blocks(flp, flp_desc, compacted, wrap_l2, cfg.model_rim, rim_blocks);
-
-			#if VERBOSE > 1
-			fprintf(stdout, "count: %d\tdowns: %d\tcost: %g\t", 
-					i, downs, new_cost);
+		for (k = 0; k < n_chains; k++)
+			chains[k].T = cfg.replica_exchange ? T * pow(REPLICA_T_RATIO, k) : T;
+
+		#pragma omp parallel for schedule(dynamic, 1) if (n_chains > 1)
+		for (k = 0; k < n_chains; k++)
+			if (!chains[k].done)
+				anneal_step(&chains[k], flp_desc, power, wrap_l2);
+
+		n_done = 0;
+		for (k = 0; k < n_chains; k++) {
+			c = &chains[k];
+			if (c->done) {
+				n_done++;
+				continue;
+			}
+			#if VERBOSE > 0
+			if (n_chains > 1)
+				fprintf(stdout, "chain: %d\t", k);
+			fprintf(stdout, "step: %d\tT: %g\ttries: %d\taccepts: %d\trejects: %d\t", 
+					steps, c->T, c->tries, (c->tries-c->rejects), c->rejects);
+			fprintf(stdout, "avg. cost: %g\tbest cost: %g\n", 
+					(c->tries-c->rejects)?(c->sum_cost / (c->tries-c->rejects)):c->sum_cost, 
+					c->best_cost); 
 			#endif
-
-			/* move accepted?	*/
-			if (new_cost < cost || 	/* downhill always accepted	*/
-				/* boltzmann probability function	*/
-			    rand_fraction() < exp(-(new_cost-cost)/T)) {
-
-				free_NPE(expr);
-				expr = next;
-
-				/* downhill move	*/
-				if (new_cost < cost) {
-					downs++;
-					/* found new best	*/
-					if (new_cost < best_cost) {
-						free_NPE(best);
-						best = NPE_duplicate(expr);
-						best_cost = new_cost;
-					}
-				}
-
-				#if VERBOSE > 1
-				fprintf(stdout, "accepted\n");
-				#endif
-				cost = new_cost;
-				sum_cost += cost;
-			} else {	/* rejected move	*/
-				rejects++;
-				free_NPE(next);
-				#if VERBOSE > 1
-				fprintf(stdout, "rejected\n");
-				#endif
+			/* stop annealing if there are too little accepts */
+			if(((double)c->rejects/c->tries) > cfg.Rreject) {
+				c->done = TRUE;
+				n_done++;
 			}
-			i++;
 		}
-		#if VERBOSE > 0
-		fprintf(stdout, "step: %d\tT: %g\ttries: %d\taccepts: %d\trejects: %d\t", 
-				steps, T, i, (i-rejects), rejects);
-		fprintf(stdout, "avg. cost: %g\tbest cost: %g\n", 
-		 		(i-rejects)?(sum_cost / (i-rejects)):sum_cost, best_cost); 
-		#endif
 
-		/* stop annealing if there are too little accepts */
-		if(((double)rejects/i) > cfg.Rreject)
+		/* 
+		 * the replicas stop with the coldest one. independent
+		 * chains go on till every one of them has stopped
+		 */
+		if (cfg.replica_exchange ? chains[0].done : (n_done == n_chains))
 			break;
+		if (cfg.replica_exchange)
+			anneal_exchange(chains, n_chains, steps % 2, &exchange_seed);
 
 		/* annealing schedule	*/
 		T *= cfg.Rcool;
 		steps++;	
 	}
 
-	/* best floorplan found	*/
-	root = tree_from_NPE(flp_desc, stack, best);
+	/* best floorplan found by any chain	*/
+	best = chains[0].best;
+	best_cost = chains[0].best_cost;
+	for (k = 1; k < n_chains; k++)
+		if (chains[k].best_cost < best_cost) {
+			best = chains[k].best;
+			best_cost = chains[k].best_cost;
+		}
+	c = &chains[0];
+	if (best != c->best)
+		NPE_copy(c->best, best);
+	root = slicing_tree_update(c->tree, flp_desc, c->best, 0, best->size-1);
 	#if VERBOSE > 0
 	{
 		int pos = min_area_pos(root->curve);
@@ -930,23 +1396,40 @@ int floorplan(flp_t *flp, flp_desc_t *flp_desc,
 	compacted = tree_to_flp(root, flp, TRUE, cfg.compact_ratio);
 	/* update the power vector according to the compaction	*/
 	trim_hotspot_vector(model, power, power, flp->n_units, compacted);
-	free_tree(root);
 	/*  restore L2 and rim */
 	if(wrap_l2) {
 		flp_wrap_l2(flp, flp_desc);
 		flp_desc->n_units++;
 	}
 	if(cfg.model_rim)
-		rim_blocks = flp_wrap_rim(flp, cfg.rim_thickness);
+		flp_wrap_rim(flp, cfg.rim_thickness);
 	resize_thermal_model(model, flp->n_units);
 	#if VERBOSE > 2
 	print_flp(flp);
 	#endif
 
-	free_NPE(expr);
-	free_NPE(best);
-	free_tree_node_stack(stack);
-	free_dvector(tpower);
+	/* 
+	 * back to the configured solver. the R model is of the
+	 * last move anyway and has to be populated again
+	 */
+	if (warm) {
+		strcpy(model->block->config.block_solver, solver);
+		free_sparse_model_block(model->block);
+		model->block->r_ready = FALSE;
+	}
+
+	for (k = 0; k < n_chains; k++) {
+		c = &chains[k];
+		free_NPE(c->expr);
+		free_NPE(c->best);
+		free_slicing_tree(c->tree);
+		free_dvector(c->tpower);
+		if (k) {
+			delete_RC_model(c->model);
+			free_flp(c->flp, 0);
+		}
+	}
+	free(chains);
 
 	/* 
 	 * return the number of blocks compacted finally
@@ -991,22 +1474,15 @@ int flp_count_units(FILE *fp)
 
 flp_t *flp_alloc_init_mem(int count)
 {
-	int i;
 	flp_t *flp;
 	flp = (flp_t *) calloc (1, sizeof(flp_t));
 	if(!flp)
 		fatal("memory allocation error\n");
 	flp->units = (unit_t *) calloc(count, sizeof(unit_t));
-	flp->wire_density = (double **) calloc(count, sizeof(double *));
-	if (!flp->units || !flp->wire_density)
+	if (!flp->units)
 		fatal("memory allocation error\n");
 	flp->n_units = count;
-
-	for (i=0; i < count; i++) {
-	  flp->wire_density[i] = (double *) calloc(count, sizeof(double));
-	  if (!flp->wire_density[i])
-	  	fatal("memory allocation error\n");
-	}
+	flp->wire = alloc_flp_wire(count);
 	return flp;
 }
 
@@ -1057,12 +1533,12 @@ void flp_populate_connects(flp_t *flp, FILE *fp)
 	double f1, f2, f3, f4, f5, f6;
 	double wire_density;
 	char *ptr;
-	int x, y, temp;
+	int x, y, k, temp;
+	flp_wire_t *w = flp->wire;
 
 	/* initialize wire_density	*/
-	for(x=0; x < flp->n_units; x++)
-		for(y=0; y < flp->n_units; y++)
-			flp->wire_density[x][y] = 0.0;
+	w->uniform = FALSE;
+	w->n_conn = 0;
 
 	fseek(fp, 0, SEEK_SET);
 	while(!feof(fp)) {
@@ -1090,17 +1566,22 @@ void flp_populate_connects(flp_t *flp, FILE *fp)
 			if (x == y)
 				fatal("block connected to itself?\n");
 
-			if (!flp->wire_density[x][y] && !flp->wire_density[y][x])
-				flp->wire_density[x][y] = flp->wire_density[y][x] = wire_density;
-			else if((flp->wire_density[x][y] != flp->wire_density[y][x]) ||
-			        (flp->wire_density[x][y] != wire_density)) {
-				sprintf(str2, "wrong connectivity information for blocks %s and %s\n", 
-				        name1, name2);
-				fatal(str2);
-			}
+			wire_append(w, MAX(x, y), MIN(x, y), wire_density);
 		} else 
 		  	fatal("invalid floorplan file format\n");
 	} /* end while	*/
+
+	/* a pair given more than once has to be given the same density	*/
+	wire_sort(w, FALSE);
+	wire_sort(w, TRUE);
+	for (k=1; k < w->n_conn; k++)
+		if (w->row[k] == w->row[k-1] && w->col[k] == w->col[k-1] &&
+			w->density[k] != w->density[k-1]) {
+			sprintf(str2, "wrong connectivity information for blocks %s and %s\n", 
+					flp->units[w->row[k]].name, flp->units[w->col[k]].name);
+			fatal(str2);
+		}
+	wire_compact(w);
 }
 
 flp_t *read_flp(char *file, int read_connects)
@@ -1108,7 +1589,7 @@ flp_t *read_flp(char *file, int read_connects)
 	char str[STR_SIZE];
 	FILE *fp;
 	flp_t *flp;
-	int count, i, j;
+	int count;
 
 	if (!strcasecmp(file, "stdin"))
 		fp = stdin;
@@ -1134,10 +1615,12 @@ flp_t *read_flp(char *file, int read_connects)
 	/* 3rd pass - populate connectivity info    */
 	if (read_connects)
 		flp_populate_connects(flp, fp);
-	/* older version - no connectivity	*/	
-	else for (i=0; i < flp->n_units; i++)
-			for (j=0; j < flp->n_units; j++)
-				flp->wire_density[i][j] = 1.0;
+	/* 
+	 * older version - no connectivity. every pair is connected, 
+	 * which is kept as a flag rather than n^2 connections
+	 */
+	else
+		flp->wire->uniform = TRUE;
 
 	if(fp != stdin)
 		fclose(fp);	
@@ -1147,7 +1630,7 @@ flp_t *read_flp(char *file, int read_connects)
 void dump_flp(flp_t *flp, char *file, int dump_connects)
 {
 	char str[STR_SIZE];
-	int i, j;
+	int i, k;
 	FILE *fp;
 
 	if (!strcasecmp(file, "stdout"))
@@ -1171,11 +1654,11 @@ void dump_flp(flp_t *flp, char *file, int dump_connects)
 	if (dump_connects) {
 		fprintf(fp, "\n");
 		/* connectivity information	*/
-		for(i=1; i < flp->n_units; i++)
-			for(j=0; j < i; j++)
-				if (flp->wire_density[i][j])
-					fprintf(fp, "%s\t%s\t%.3f\n", flp->units[i].name,
-							flp->units[j].name, flp->wire_density[i][j]);
+		flp_wire_update(flp);
+		for(k=0; k < flp->wire->start[flp->n_units]; k++)
+			if (flp->wire->row[k] != flp->wire->col[k])
+				fprintf(fp, "%s\t%s\t%.3f\n", flp->units[flp->wire->row[k]].name,
+						flp->units[flp->wire->col[k]].name, flp->wire->density[k]);
 	}
 	
 	if(fp != stdout && fp != stderr)
@@ -1184,12 +1667,9 @@ void dump_flp(flp_t *flp, char *file, int dump_connects)
 
 void free_flp(flp_t *flp, int compacted)
 {
-	int i;
-	for (i=0; i < flp->n_units + compacted; i++) {
-		free(flp->wire_density[i]);
-	}
+	free_flp_wire(flp->wire);
+	free_flp_adj(flp);
 	free(flp->units);
-	free(flp->wire_density);
 	free(flp);
 }
 
@@ -1215,7 +1695,8 @@ void print_flp_fig (flp_t *flp)
 /* debug print	*/
 void print_flp (flp_t *flp)
 {
-	int i, j;
+	int i, j, k;
+	flp_wire_t *w = flp->wire;
 
 	fprintf(stdout, "printing floorplan information for %d blocks\n", flp->n_units);
 	fprintf(stdout, "name\tarea\twidth\theight\tleftx\tbottomy\trightx\ttopy\n");
@@ -1234,11 +1715,16 @@ void print_flp (flp_t *flp)
 			    name, area, width, height, leftx, bottomy, rightx, topy);
 	}
 	fprintf(stdout, "printing connections:\n");
+	flp_wire_update(flp);
+	/* a unit's partners are in increasing order	*/
 	for (i=0; i< flp->n_units; i++)
-		for (j=i+1; j < flp->n_units; j++)
-			if (flp->wire_density[i][j])
+		for (k=w->unit_start[i]; k < w->unit_start[i+1]; k++) {
+			int c = w->unit_conn[k];
+			j = w->row[c] + w->col[c] - i;
+			if (j > i && j < flp->n_units)
 				fprintf(stdout, "%s\t%s\t%lg\n", flp->units[i].name, 
-						flp->units[j].name, flp->wire_density[i][j]);
+						flp->units[j].name, w->density[c]);
+		}
 }
 
 /* print the statistics about this floorplan.
@@ -1300,7 +1786,7 @@ void print_flp_stats(flp_t *flp, RC_model_t *model,
 	fclose(fp);
 }
 
-int get_blk_index(flp_t *flp, char *name)
+int get_blk_index(flp_t *flp, const char *name)
 {
 	int i;
 	char msg[STR_SIZE];
@@ -1416,6 +1902,268 @@ double get_shared_len(flp_t *flp, int i, int j)
 	return (MIN(p12, p22) - MAX(p11, p21));
 }
 
+/* an edge of a unit for the adjacency sweep	*/
+typedef struct adj_edge_t_st
+{
+	/* position across the edge - compared as eq() does	*/
+	float pos;
+	/* extent along the edge	*/
+	double lo, hi;
+	int unit;
+	/* left/bottom (FALSE) or right/top (TRUE) edge of the unit	*/
+	int high;
+}adj_edge_t;
+
+static int cmp_adj_edge_pos(const void *a, const void *b)
+{
+	float x = ((adj_edge_t *) a)->pos, y = ((adj_edge_t *) b)->pos;
+	return (x > y) - (x < y);
+}
+
+static int cmp_adj_edge_lo(const void *a, const void *b)
+{
+	double x = ((adj_edge_t *) a)->lo, y = ((adj_edge_t *) b)->lo;
+	return (x > y) - (x < y);
+}
+
+static int cmp_adj_pair(const void *a, const void *b)
+{
+	int *x = (int *) a, *y = (int *) b;
+	if (x[0] != y[0])
+		return x[0] - y[0];
+	return x[1] - y[1];
+}
+
+/* 
+ * find the pairs of units whose edges could touch - a left/bottom 
+ * edge and a right/top one in the same place as far as eq() is 
+ * concerned, overlapping along their length. the pairs (two ints
+ * each, lower index first) are appended to adj->pairs, which grows
+ * as needed. returns the new no. of pairs
+ */
+static int adj_sweep(flp_adj_t *adj, int n_edges, int n_pairs)
+{
+	adj_edge_t *edges = adj->edges;
+	int *active = adj->active;
+	int s, e, k, a, kept;
+
+	qsort(edges, n_edges, sizeof(adj_edge_t), cmp_adj_edge_pos);
+	for (s = 0; s < n_edges; s = e) {
+		/* 
+		 * a run of edges at the same position. consecutive edges
+		 * closer than DELTA are chained, so every two edges that
+		 * eq() finds equal end up in the same run
+		 */
+		for (e = s + 1; e < n_edges && 
+			 (float) (edges[e].pos - edges[e-1].pos) < DELTA; e++);
+		if (e - s < 2)
+			continue;
+
+		/* 
+		 * sweep along the run. the units do not overlap, so only
+		 * a few of its edges are active at any point
+		 */
+		qsort(&edges[s], e - s, sizeof(adj_edge_t), cmp_adj_edge_lo);
+		kept = 0;
+		for (k = s; k < e; k++) {
+			int n_active = kept;
+			for (a = 0, kept = 0; a < n_active; a++) {
+				adj_edge_t *other = &edges[active[a]];
+				/* ends before this one and so before the rest	*/
+				if (other->hi < edges[k].lo - DELTA)
+					continue;
+				active[kept++] = active[a];
+				if (other->high == edges[k].high || other->unit == edges[k].unit)
+					continue;
+				if (n_pairs == adj->max_pairs) {
+					adj->max_pairs *= 2;
+					adj->pairs = (int *) realloc(adj->pairs, 2 * adj->max_pairs * sizeof(int));
+					if (!adj->pairs)
+						fatal("memory allocation error\n");
+				}
+				adj->pairs[2*n_pairs] = MIN(other->unit, edges[k].unit);
+				adj->pairs[2*n_pairs+1] = MAX(other->unit, edges[k].unit);
+				n_pairs++;
+			}
+			active[kept++] = k;
+		}
+	}
+	return n_pairs;
+}
+
+/* fingerprint (FNV-1a) of the no. and the geometry of the units	*/
+static unsigned long flp_geometry_key(flp_t *flp)
+{
+	unsigned long key = 14695981039346656037UL;
+	unsigned char *c;
+	int i;
+	size_t k;
+
+	key = (key ^ (unsigned long) flp->n_units) * 1099511628211UL;
+	for (i = 0; i < flp->n_units; i++) {
+		double geom[4];
+		geom[0] = flp->units[i].width;
+		geom[1] = flp->units[i].height;
+		geom[2] = flp->units[i].leftx;
+		geom[3] = flp->units[i].bottomy;
+		c = (unsigned char *) geom;
+		for (k = 0; k < sizeof(geom); k++)
+			key = (key ^ c[k]) * 1099511628211UL;
+	}
+	return key;
+}
+
+void flp_invalidate_adj(flp_t *flp)
+{
+	if (flp->adj)
+		flp->adj->valid = FALSE;
+}
+
+void free_flp_adj(flp_t *flp)
+{
+	flp_adj_t *adj = flp->adj;
+	if (!adj)
+		return;
+	free(adj->start);
+	free(adj->idx);
+	free(adj->len);
+	free(adj->horiz);
+	free(adj->edges);
+	free(adj->active);
+	free(adj->pairs);
+	free(adj);
+	flp->adj = NULL;
+}
+
+/* make room for 'n' units and their edges	*/
+static void adj_reserve_units(flp_adj_t *adj, int n)
+{
+	if (n <= adj->max_units)
+		return;
+	adj->max_units = n = MAX(n, 2 * adj->max_units);
+	adj->start = (int *) realloc(adj->start, (n + 1) * sizeof(int));
+	adj->edges = (adj_edge_t *) realloc(adj->edges, (2 * n + 1) * sizeof(adj_edge_t));
+	adj->active = (int *) realloc(adj->active, (2 * n + 1) * sizeof(int));
+	if (!adj->start || !adj->edges || !adj->active)
+		fatal("memory allocation error\n");
+}
+
+/* make room for 'n' adjacent pairs	*/
+static void adj_reserve_pairs(flp_adj_t *adj, int n)
+{
+	if (n <= adj->max_adj)
+		return;
+	adj->max_adj = n = MAX(n, 2 * adj->max_adj);
+	adj->idx = (int *) realloc(adj->idx, (2 * n + 1) * sizeof(int));
+	adj->len = (double *) realloc(adj->len, (2 * n + 1) * sizeof(double));
+	adj->horiz = (int *) realloc(adj->horiz, (2 * n + 1) * sizeof(int));
+	if (!adj->idx || !adj->len || !adj->horiz)
+		fatal("memory allocation error\n");
+}
+
+flp_adj_t *get_flp_adj(flp_t *flp)
+{
+	int i, k, n = flp->n_units, n_pairs = 0, n_adj;
+	unsigned long key = flp_geometry_key(flp);
+	adj_edge_t *edges;
+	int *pairs, *fill;
+	flp_adj_t *adj = flp->adj;
+
+	if (adj && adj->valid && adj->key == key)
+		return adj;
+
+	if (!adj) {
+		adj = (flp_adj_t *) calloc(1, sizeof(flp_adj_t));
+		if (!adj)
+			fatal("memory allocation error\n");
+		/* about two neighbours per edge to begin with	*/
+		adj->max_pairs = 4 * n + 1;
+		adj->pairs = (int *) calloc(2 * adj->max_pairs, sizeof(int));
+		if (!adj->pairs)
+			fatal("memory allocation error\n");
+		flp->adj = adj;
+	}
+	adj_reserve_units(adj, n);
+	edges = adj->edges;
+
+	/* side by side - the vertical edges	*/
+	for (i = 0; i < n; i++) {
+		unit_t *u = &flp->units[i];
+		edges[2*i].pos = u->leftx;
+		edges[2*i+1].pos = u->leftx + u->width;
+		edges[2*i].lo = edges[2*i+1].lo = u->bottomy;
+		edges[2*i].hi = edges[2*i+1].hi = u->bottomy + u->height;
+		edges[2*i].unit = edges[2*i+1].unit = i;
+		edges[2*i].high = FALSE;
+		edges[2*i+1].high = TRUE;
+	}
+	n_pairs = adj_sweep(adj, 2 * n, n_pairs);
+
+	/* one above the other - the horizontal edges	*/
+	for (i = 0; i < n; i++) {
+		unit_t *u = &flp->units[i];
+		edges[2*i].pos = u->bottomy;
+		edges[2*i+1].pos = u->bottomy + u->height;
+		edges[2*i].lo = edges[2*i+1].lo = u->leftx;
+		edges[2*i].hi = edges[2*i+1].hi = u->leftx + u->width;
+		edges[2*i].unit = edges[2*i+1].unit = i;
+		edges[2*i].high = FALSE;
+		edges[2*i+1].high = TRUE;
+	}
+	n_pairs = adj_sweep(adj, 2 * n, n_pairs);
+
+	/* 
+	 * the sweep only narrows down the pairs. the exact tests decide,
+	 * so the answers are those of the pairwise functions. a pair 
+	 * found more than once is only tested once
+	 */
+	pairs = adj->pairs;
+	qsort(pairs, n_pairs, 2 * sizeof(int), cmp_adj_pair);
+	for (i = 0, k = 0; i < n_pairs; i++) {
+		int u = pairs[2*i], v = pairs[2*i+1];
+		if (k && pairs[2*(k-1)] == u && pairs[2*(k-1)+1] == v)
+			continue;
+		if (!is_horiz_adj(flp, u, v) && !is_vert_adj(flp, u, v))
+			continue;
+		pairs[2*k] = u;
+		pairs[2*k+1] = v;
+		k++;
+	}
+	n_adj = k;
+
+	/* both ways round in compressed row form	*/
+	adj_reserve_pairs(adj, n_adj);
+	adj->n_units = n;
+	adj->key = key;
+	adj->valid = TRUE;
+	zero_ivector(adj->start, n + 1);
+	for (i = 0; i < n_adj; i++) {
+		adj->start[pairs[2*i]+1]++;
+		adj->start[pairs[2*i+1]+1]++;
+	}
+	for (i = 0; i < n; i++)
+		adj->start[i+1] += adj->start[i];
+	/* 
+	 * the pairs are sorted, so every unit's neighbours come out in
+	 * increasing order - the lower ones first, then the higher ones
+	 */
+	fill = adj->active;
+	copy_ivector(fill, adj->start, n);
+	for (i = 0; i < n_adj; i++) {
+		int u = pairs[2*i], v = pairs[2*i+1];
+		int h = is_horiz_adj(flp, u, v);
+		double len = get_shared_len(flp, u, v);
+		adj->idx[fill[u]] = v;
+		adj->len[fill[u]] = len;
+		adj->horiz[fill[u]++] = h;
+		adj->idx[fill[v]] = u;
+		adj->len[fill[v]] = len;
+		adj->horiz[fill[v]++] = h;
+	}
+
+	return adj;
+}
+
 double get_total_width(flp_t *flp)
 {	
 	int i;
@@ -1555,16 +2303,65 @@ double get_core_occupied_area(flp_t *flp, char *l2_label)
 
 double get_wire_metric(flp_t *flp)
 {
-	int i, j;
-	double w = 0.0, dist;
+	flp_wire_t *w = flp->wire;
+	int i, k, n = flp->n_units, work = 0, found = FALSE;
+	double delta = 0.0, *swap;
+
+	/* centres of the units, as get_manhattan_dist finds them	*/
+	for (i=0; i < n; i++) {
+		w->new_cx[i] = flp->units[i].leftx + flp->units[i].width / 2.0;
+		w->new_cy[i] = flp->units[i].bottomy + flp->units[i].height / 2.0;
+	}
+	if (w->uniform)
+		return wire_sum_uniform(n, w->new_cx, w->new_cy);
+	flp_wire_update(flp);
 
-	for (i=0; i < flp->n_units; i++)
-		for (j=0; j < flp->n_units; j++)
-			if (flp->wire_density[i][j]) {
-				dist = get_manhattan_dist(flp, i, j);
-				w += flp->wire_density[i][j] * dist;
+	/* 
+	 * the units that have moved since the last metric. if their 
+	 * wires are less than half of all, only those are gone over
+	 */
+	if (w->cached && w->cached_n == n && w->n_deltas < WIRE_MAX_DELTAS) {
+		for (i=0; i < n && 2 * work <= w->start[n]; i++)
+			if (w->new_cx[i] != w->cx[i] || w->new_cy[i] != w->cy[i]) {
+				w->moved[i] = TRUE;
+				work += w->unit_start[i+1] - w->unit_start[i];
+			}
+		if (2 * work <= w->start[n]) {
+			int u, v;
+			for (u=0; u < n; u++) {
+				if (!w->moved[u])
+					continue;
+				for (k=w->unit_start[u]; k < w->unit_start[u+1]; k++) {
+					int c = w->unit_conn[k];
+					v = w->row[c] + w->col[c] - u;
+					/* the partners are in increasing order	*/
+					if (v >= n)
+						break;
+					/* both moved - counted once, from the lower one	*/
+					if (w->moved[v] && v < u)
+						continue;
+					delta += w->density[c] * 
+							 (fabs(w->new_cx[u] - w->new_cx[v]) + fabs(w->new_cy[u] - w->new_cy[v]) - 
+							  fabs(w->cx[u] - w->cx[v]) - fabs(w->cy[u] - w->cy[v]));
+				}
 			}
-	return w;		
+			w->metric += 2.0 * delta;
+			w->n_deltas++;
+			found = TRUE;
+		}
+		zero_ivector(w->moved, i);
+	}
+	if (!found) {
+		w->metric = wire_sum(w, w->start[n], w->new_cx, w->new_cy);
+		w->n_deltas = 0;
+	}
+
+	/* the centres the metric is now for	*/
+	swap = w->cx; w->cx = w->new_cx; w->new_cx = swap;
+	swap = w->cy; w->cy = w->new_cy; w->new_cy = swap;
+	w->cached = TRUE;
+	w->cached_n = n;
+	return w->metric;
 }
 
 double get_manhattan_dist(flp_t *flp, int i, int j)
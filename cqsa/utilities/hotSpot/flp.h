@@ -34,6 +34,12 @@
 #define RIM_TOP_STR		RIM_PREFIX"_top"
 #define RIM_BOTTOM_STR	RIM_PREFIX"_bottom"
 
+/* 
+ * ratio of the temperatures of adjacent chains
+ * in replica exchange annealing
+ */
+#define REPLICA_T_RATIO	1.5
+
 /* prefix denoting dead block	*/
 #define DEAD_PREFIX		"_"
 
@@ -90,6 +96,23 @@ typedef struct flp_config_t_st
 	double lambdaA;
 	double lambdaT;
 	double lambdaW;
+
+	/* 
+	 * solve the thermal model of each move by warm started
+	 * pcg instead of the configured block solver?
+	 */
+	int anneal_warm;
+
+	/* 
+	 * no. of annealing chains, run in parallel. 0 means
+	 * one for each thread available
+	 */
+	int n_chains;
+	/* 
+	 * do the chains exchange their states (replica exchange)
+	 * or anneal independently?
+	 */
+	int replica_exchange;
 } flp_config_t;
 
 /* unplaced unit	*/
@@ -127,13 +150,96 @@ typedef struct unit_t_st
 	double bottomy;
 }unit_t;
 
+/* 
+ * thermal adjacency of the placed units - the edges they share. 
+ * it is in compressed row form: the neighbours of unit i are 
+ * idx[start[i]] to idx[start[i+1]-1], in increasing order, each
+ * with the length of the shared edge and whether they are side 
+ * by side (is_horiz_adj) or one above the other (is_vert_adj)
+ */
+typedef struct flp_adj_t_st
+{
+	int n_units;
+	int *start;
+	int *idx;
+	double *len;
+	int *horiz;
+	/* fingerprint of the unit geometry it was built from	*/
+	unsigned long key;
+	int valid;
+	/* 
+	 * the arrays are kept from one rebuild to the next and only 
+	 * grow. the annealer rebuilds for every move - allocating 
+	 * afresh each time churns the heap under the slicing trees
+	 */
+	int max_units;
+	int max_adj;
+	/* scratch space for the sweep	*/
+	struct adj_edge_t_st *edges;
+	int *active;
+	int *pairs;
+	int max_pairs;
+}flp_adj_t;
+
+/* 
+ * density of wires between the placed units. a connection is kept
+ * once, under the higher numbered of its two units - row >= col.
+ * the connections are sorted by row and then by col, with start[r]
+ * the first one of row r. so, the connections amongst the first n
+ * units are 0 to start[n]-1, whatever lies beyond them. the rows of
+ * unit_conn list the connections of each unit either way, in the
+ * increasing order of the other unit
+ */
+typedef struct flp_wire_t_st
+{
+	/* no. of units the connections can refer to	*/
+	int n_units;
+	/* every pair connected with density 1.0 - no connections kept	*/
+	int uniform;
+	int n_conn;
+	int max_conn;
+	int *start;
+	int *row;
+	int *col;
+	double *density;
+	int *unit_start;
+	int *unit_conn;
+	/* 
+	 * connections added since the last sort, and ones set to 
+	 * zero in place since then. both are tidied up lazily
+	 */
+	int unsorted;
+	int zeroed;
+	/* scratch space for sorting	*/
+	int *count;
+	int *tmp_row;
+	int *tmp_col;
+	double *tmp_density;
+	/* 
+	 * the last wire metric and the unit centres it was found 
+	 * for. a metric with only a few of the units moved is found
+	 * from the wires of those units alone
+	 */
+	int cached;
+	int cached_n;
+	int n_deltas;
+	double metric;
+	double *cx;
+	double *cy;
+	double *new_cx;
+	double *new_cy;
+	int *moved;
+}flp_wire_t;
+
 /* floorplan data structure	*/
 typedef struct flp_t_st
 {
 	unit_t *units;
 	int n_units;
   	/* density of wires between units	*/
-  	double **wire_density;
+  	flp_wire_t *wire;
+	/* cached adjacency - see get_flp_adj	*/
+	flp_adj_t *adj;
 } flp_t;
 
 /* flp_config routines	*/
@@ -221,6 +327,8 @@ double flp_evaluate_metric(flp_t *flp, struct RC_model_t_st *model, double *powe
 						   double lambdaA, double lambdaT, double lambdaW);
 /* dump the floorplan onto a file	*/
 void dump_flp(flp_t *flp, char *file, int dump_connects);
+/* memory allocation for a floorplan of 'count' units	*/
+flp_t *flp_alloc_init_mem(int count);
 /* memory uninitialization	*/
 void free_flp(flp_t *flp, int compacted);
 
@@ -228,13 +336,24 @@ void free_flp(flp_t *flp, int compacted);
 /* placed floorplan access routines	*/
 
 /* get unit index from its name	*/
-int get_blk_index(flp_t *flp, char *name);
+int get_blk_index(flp_t *flp, const char *name);
 /* are the units horizontally adjacent?	*/
 int is_horiz_adj(flp_t *flp, int i, int j);
 /* are the units vertically adjacent?	*/
 int is_vert_adj (flp_t *flp, int i, int j);
 /* shared length between units	*/
 double get_shared_len(flp_t *flp, int i, int j);
+/* 
+ * adjacency of all the units, found by sorting and sweeping their 
+ * edges in O(n log n) instead of testing every pair. it is the same
+ * as calling the three functions above for every pair. the result
+ * is cached on the floorplan and rebuilt when the units have moved
+ */
+flp_adj_t *get_flp_adj(flp_t *flp);
+/* mark the cached adjacency as out of date	*/
+void flp_invalidate_adj(flp_t *flp);
+/* free the cached adjacency along with its storage	*/
+void free_flp_adj(flp_t *flp);
 /* total chip width	*/
 double get_total_width(flp_t *flp);
 /* total chip height */
@@ -251,6 +370,27 @@ double get_manhattan_dist(flp_t *flp, int i, int j);
 double get_total_area(flp_t *flp);
 double get_core_area(flp_t *flp, char *l2_label);
 double get_core_occupied_area(flp_t *flp, char *l2_label);
+/* 
+ * sum of the manhattan distances between the centres of the units 
+ * weighted by the density of the wires between them
+ */
 double get_wire_metric(flp_t *flp);
 
+/* wire density routines	*/
+
+/* connections for a floorplan of 'n_units' units - none to begin with	*/
+flp_wire_t *alloc_flp_wire(int n_units);
+void free_flp_wire(flp_wire_t *wire);
+/* density of the wires between units i and j	*/
+double get_wire_density(flp_t *flp, int i, int j);
+/* set it (both ways). zero disconnects them	*/
+void set_wire_density(flp_t *flp, int i, int j, double density);
+/* disconnect unit i from all the others	*/
+void clear_wire_density(flp_t *flp, int i);
+/* 
+ * bring the connection arrays up to date - sorted, with neither
+ * duplicates nor zeros. needed before walking them directly
+ */
+void flp_wire_update(flp_t *flp);
+
 #endif
@@ -0,0 +1,102 @@
+/*
+ * throughput of the grid model's kernels - the steady state
+ * (red-black gauss-seidel) sweep and the transient slope function -
+ * in cells per second, for a range of grid sizes. the floorplan is a
+ * 4x4 array of 1mm blocks. build with 'make bench' and run as
+ * 	grid_bench [sweeps]
+ * with OMP_NUM_THREADS to set the no. of threads
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "temperature.h"
+#include "temperature_grid.h"
+#include "flp.h"
+#include "util.h"
+
+/* side of the floorplan in blocks and of a block in meters	*/
+#define BENCH_BLOCKS	4
+#define BENCH_SIDE		1e-3
+
+double now(void)
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+flp_t *bench_flp(void)
+{
+	int i, j, k = 0;
+	flp_t *flp = flp_alloc_init_mem(BENCH_BLOCKS * BENCH_BLOCKS);
+
+	for (i = 0; i < BENCH_BLOCKS; i++)
+		for (j = 0; j < BENCH_BLOCKS; j++, k++) {
+			sprintf(flp->units[k].name, "b%d_%d", i, j);
+			flp->units[k].width = flp->units[k].height = BENCH_SIDE;
+			flp->units[k].leftx = j * BENCH_SIDE;
+			flp->units[k].bottomy = i * BENCH_SIDE;
+		}
+	return flp;
+}
+
+int main(int argc, char **argv)
+{
+	int sizes[] = {32, 64, 128, 256, 512};
+	int s, k, n_cells, sweeps = (argc > 1) ? atoi(argv[1]) : 50;
+	double t0, t_steady, t_slope;
+	flp_t *flp = bench_flp();
+
+	fprintf(stdout, "grid\tcells\tsteady (Mcells/s)\tslope (Mcells/s)\n");
+	for (s = 0; s < (int) (sizeof(sizes) / sizeof(sizes[0])); s++) {
+		thermal_config_t config = default_thermal_config();
+		RC_model_t *model;
+		grid_model_t *grid;
+		grid_model_vector_t *p, *t;
+		double *power, *dv;
+
+		strcpy(config.model_type, GRID_MODEL_STR);
+		config.grid_rows = config.grid_cols = sizes[s];
+		model = alloc_RC_model(&config, flp);
+		populate_R_model(model, flp);
+		populate_C_model(model, flp);
+		grid = model->grid;
+		n_cells = grid->n_layers * grid->rows * grid->cols;
+
+		/* 1W per block	*/
+		power = hotspot_vector(model);
+		for (k = 0; k < flp->n_units; k++)
+			power[k] = 1.0;
+		p = new_grid_model_vector(model->grid);
+		t = new_grid_model_vector(model->grid);
+		xlate_vector_b2g(grid, power, p, V_POWER);
+		for (k = 0; k < n_cells + EXTRA; k++)
+			t->cuboid[0][0][k] = config.ambient;
+		dv = dvector(n_cells + EXTRA);
+
+		t0 = now();
+		for (k = 0; k < sweeps; k++)
+			single_iteration_steady_grid(grid, p, t);
+		t_steady = now() - t0;
+
+		t0 = now();
+		for (k = 0; k < sweeps; k++)
+			slope_fn_grid(grid, t->cuboid[0][0], p, dv);
+		t_slope = now() - t0;
+
+		fprintf(stdout, "%dx%d\t%d\t%.1f\t%.1f\n", sizes[s], sizes[s], n_cells,
+				n_cells * (double) sweeps / t_steady / 1e6,
+				n_cells * (double) sweeps / t_slope / 1e6);
+
+		free_dvector(dv);
+		free_grid_model_vector(p);
+		free_grid_model_vector(t);
+		free_dvector(power);
+		delete_RC_model(model);
+	}
+
+	free_flp(flp, FALSE);
+	return 0;
+}
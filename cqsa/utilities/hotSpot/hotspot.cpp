@@ -16,6 +16,7 @@
 #include "temperature_grid.h"
 #include "util.h"
 #include "hotspot.h"
+#include "trace.h"
 
 /* HotSpot thermal model is offered in two flavours - the block
  * version and the grid version. The block model models temperature
@@ -78,7 +79,9 @@ void usage(int argc, char **argv)
 	fprintf(stdout, "   -f <file>\tfloorplan input file (e.g. ev6.flp) - overridden by the\n");
 	fprintf(stdout, "            \tlayer configuration file (e.g. layer.lcf) when the\n");
 	fprintf(stdout, "            \tlatter is specified\n");
-	fprintf(stdout, "   -p <file>\tpower trace input file (e.g. gcc.ptrace)\n");
+	fprintf(stdout, "   -p <file>\tpower trace input file (e.g. gcc.ptrace) - text or binary\n");
+	fprintf(stdout, "            \t(see trace.h and trace_convert). the temperature trace of\n");
+	fprintf(stdout, "            \ta binary power trace is binary too\n");
 	fprintf(stdout, "  [-o <file>]\ttransient temperature trace output file - if not provided, only\n");
 	fprintf(stdout, "            \tsteady state temperatures are output to stdout\n");
 	fprintf(stdout, "  [-c <file>]\tinput configuration parameters from file (e.g. hotspot.config)\n");
@@ -272,17 +275,24 @@ void free_names(char **m)
  * columns are tab-separated and each row is a separate line. the first
  * line contains the names of the functional blocks. the order in which
  * the columns are specified doesn't have to match that of the floorplan 
- * file.
+ * file. the power trace can also be a binary trace (trace.h), which is
+ * memory mapped instead of parsed - the temperature trace is then
+ * written in the same format.
  */
 //int hotSpot_main(int argc, char **argv)
 int hotSpot_main(char const *floorplanFileName, char const *powerTraceFileName, char const *outputFileName, float maxDimension, float r_convec)
 {
-	int i, j, idx, base = 0, count = 0, n = 0;
+	int i, j, base = 0, count = 0, n = 0;
 	int num, size = 0, lines = 0, do_transient = TRUE;
 	char **names;
 	double *vals;
+	/* trace column -> index into the power and temperature vectors	*/
+	int *order;
 	/* trace file pointers	*/
-	FILE *pin, *tout = NULL;
+	FILE *pin = NULL, *tout = NULL;
+	/* binary traces	*/
+	trace_in_t *bin = NULL;
+	trace_out_t *bout = NULL;
 	/* floorplan	*/
 	flp_t *flp;
 	/* hotspot temperature model	*/
@@ -309,8 +319,10 @@ int hotSpot_main(char const *floorplanFileName, char const *powerTraceFileName,
 	//global_config_from_strs(&global_config, table, size);
 	
 	// Copy the function arguments into HotSpot's own configuration structure
-	strncpy(global_config.flp_file,floorplanFileName,STR_SIZE);
-	strncpy(global_config.p_infile,powerTraceFileName,STR_SIZE);
+	strncpy(global_config.flp_file,floorplanFileName,STR_SIZE-1);
+	global_config.flp_file[STR_SIZE-1] = '\0';
+	strncpy(global_config.p_infile,powerTraceFileName,STR_SIZE-1);
+	global_config.p_infile[STR_SIZE-1] = '\0';
 	
 	// Copy NULLFILE to all of the input files that are currently unused
 	strcpy(global_config.t_outfile,NULLFILE);
@@ -332,16 +344,7 @@ int hotSpot_main(char const *floorplanFileName, char const *powerTraceFileName,
 	size = str_pairs_remove_duplicates(table, size);
 
 	// Set custom thermal parameters
-	sprintf(table[0].name,"s_spreader\0");
-	sprintf(table[0].value,"%lf\0",(maxDimension / 1000.0) + 0.0001);
-	sprintf(table[1].name,"s_sink\0");
-	sprintf(table[1].value,"%lf\0",(maxDimension / 1000.0) + 0.0002);
-	sprintf(table[2].name,"r_convec\0");
-	//sprintf(table[2].value,"14.50\0");
-	sprintf(table[2].value,"%lf\0",r_convec);
-	sprintf(table[3].name,"ambient\0");
-	sprintf(table[3].value,"300.0\0");
-	size = 4;
+	size = hotspot_chip_params(table, maxDimension, r_convec);
 
 	/* get defaults */
 	thermal_config = default_thermal_config();
@@ -403,41 +406,71 @@ int hotSpot_main(char const *floorplanFileName, char const *powerTraceFileName,
 	} else 
 		fatal("unknown model type\n");
 
-	if(!(pin = fopen(global_config.p_infile, "r")))
-		fatal("unable to open power trace input file\n");
-	if(do_transient && !(tout = fopen(global_config.t_outfile, "w")))
-		fatal("unable to open temperature trace file for output\n");
-
 	/* names of functional units	*/
 	names = alloc_names(MAX_UNITS, STR_SIZE);
-	if(read_names(pin, names) != n)
-		fatal("no. of units in floorplan and trace file differ\n");
+	if (is_binary_trace(global_config.p_infile)) {
+		bin = open_trace_in(global_config.p_infile);
+		if ((int) bin->hdr->n_cols != n)
+			fatal("no. of units in floorplan and trace file differ\n");
+		for(i=0; i < n; i++)
+			strncpy(names[i], bin->names[i], STR_SIZE-1);
+	} else {
+		if(!(pin = fopen(global_config.p_infile, "r")))
+			fatal("unable to open power trace input file\n");
+		if(read_names(pin, names) != n)
+			fatal("no. of units in floorplan and trace file differ\n");
+	}
 
 	/* header line of temperature trace	*/
-	if (do_transient)
+	if (do_transient && bin)
+		bout = open_trace_out(global_config.t_outfile, names, n);
+	else if (do_transient) {
+		if(!(tout = fopen(global_config.t_outfile, "w")))
+			fatal("unable to open temperature trace file for output\n");
 		write_names(tout, names, n);
+	}
+
+	/* 
+	 * where each column goes in the floorplan order - looked up once
+	 * rather than for every line of the trace
+	 */
+	order = ivector(n);
+	if (model->type == BLOCK_MODEL)
+		for(i=0; i < n; i++)
+			order[i] = get_blk_index(flp, names[i]);
+	else
+		for(i=0, base=0, count=0; i < model->grid->n_layers; i++) {
+			if(model->grid->layers[i].has_power) {
+				for(j=0; j < model->grid->layers[i].flp->n_units; j++)
+					order[count+j] = base + get_blk_index(model->grid->layers[i].flp, names[count+j]);
+				count += model->grid->layers[i].flp->n_units;
+			}	
+			base += model->grid->layers[i].flp->n_units;	
+		}
 
-	/* read the instantaneous power trace	*/
 	vals = dvector(MAX_UNITS);
-	while ((num=read_vals(pin, vals)) != 0) {
+
+	/* 
+	 * steady state only with a binary trace - the average power is all
+	 * that is needed. sum the columns block by block straight off the
+	 * map. the sums are added in the same order as below, which then
+	 * finds no rows left
+	 */
+	if (bin && !do_transient) {
+		trace_column_sums(bin, vals);
+		for(i=0; i < n; i++)
+			overall_power[order[i]] = vals[i];
+		lines = bin->hdr->n_rows;
+	}
+
+	/* read the instantaneous power trace	*/
+	while ((num = bin ? read_trace_row(bin, vals) : read_vals(pin, vals)) != 0) {
 		if(num != n)
 			fatal("invalid trace file format\n");
 
 		/* permute the power numbers according to the floorplan order	*/
-		if (model->type == BLOCK_MODEL)
-			for(i=0; i < n; i++)
-				power[get_blk_index(flp, names[i])] = vals[i];
-		else
-			for(i=0, base=0, count=0; i < model->grid->n_layers; i++) {
-				if(model->grid->layers[i].has_power) {
-					for(j=0; j < model->grid->layers[i].flp->n_units; j++) {
-						idx = get_blk_index(model->grid->layers[i].flp, names[count+j]);
-						power[base+idx] = vals[count+j];
-					}
-					count += model->grid->layers[i].flp->n_units;
-				}	
-				base += model->grid->layers[i].flp->n_units;	
-			}
+		for(i=0; i < n; i++)
+			power[order[i]] = vals[i];
 
 		/* compute temperature	*/
 		if (do_transient) {
@@ -453,23 +486,17 @@ int hotSpot_main(char const *floorplanFileName, char const *powerTraceFileName,
 				compute_temp(model, power, NULL, model->config->sampling_intvl);
 	
 			/* permute back to the trace file order	*/
-			if (model->type == BLOCK_MODEL)
-				for(i=0; i < n; i++)
-					vals[i] = temp[get_blk_index(flp, names[i])];
-			else
-				for(i=0, base=0, count=0; i < model->grid->n_layers; i++) {
-					if(model->grid->layers[i].has_power) {
-						for(j=0; j < model->grid->layers[i].flp->n_units; j++) {
-							idx = get_blk_index(model->grid->layers[i].flp, names[count+j]);
-							vals[count+j] = temp[base+idx];
-						}
-						count += model->grid->layers[i].flp->n_units;	
-					}	
-					base += model->grid->layers[i].flp->n_units;	
-				}
+			for(i=0; i < n; i++)
+				vals[i] = temp[order[i]];
 		
 			/* output instantaneous temperature trace	*/
-			write_vals(tout, vals, n);
+			if (bout) {
+				/* in degree C like the text trace	*/
+				for(i=0; i < n; i++)
+					vals[i] -= 273.15;
+				write_trace_row(bout, vals);
+			} else
+				write_vals(tout, vals, n);
 		}		
 	
 		/* for computing average	*/
@@ -523,8 +550,13 @@ int hotSpot_main(char const *floorplanFileName, char const *powerTraceFileName,
 	#endif
 
 	/* cleanup	*/
-	fclose(pin);
-	if (do_transient)
+	if (bin)
+		close_trace_in(bin);
+	else
+		fclose(pin);
+	if (bout)
+		close_trace_out(bout);
+	else if (do_transient)
 		fclose(tout);
 	delete_RC_model(model);
 	free_flp(flp, FALSE);
@@ -535,6 +567,117 @@ int hotSpot_main(char const *floorplanFileName, char const *powerTraceFileName,
 	free_dvector(overall_power);
 	free_names(names);
 	free_dvector(vals);
+	free_ivector(order);
 
 	return 0;
 }
+
+/* 
+ * fill in the thermal parameters that depend on the chip being 
+ * modeled. returns the no. of entries used in 'table'
+ */
+int hotspot_chip_params(str_pair *table, float maxDimension, float r_convec)
+{
+	sprintf(table[0].name,"s_spreader");
+	sprintf(table[0].value,"%lf",(maxDimension / 1000.0) + 0.0001);
+	sprintf(table[1].name,"s_sink");
+	sprintf(table[1].value,"%lf",(maxDimension / 1000.0) + 0.0002);
+	sprintf(table[2].name,"r_convec");
+	//sprintf(table[2].value,"14.50");
+	sprintf(table[2].value,"%lf",r_convec);
+	sprintf(table[3].name,"ambient");
+	sprintf(table[3].value,"300.0");
+	return 4;
+}
+
+/* 
+ * in-memory interface - the configuration is built exactly as 
+ * hotSpot_main builds it, so the temperatures are the same as 
+ * going through the files, less the rounding of the file formats.
+ */
+hotspot_handle_t *hotspot_open(flp_t *flp, float maxDimension, float r_convec, char const *solver)
+{
+	str_pair table[MAX_ENTRIES];
+	int size;
+	hotspot_handle_t *hs = (hotspot_handle_t *) calloc (1, sizeof(hotspot_handle_t));
+	if (!hs)
+		fatal("memory allocation error\n");
+
+	size = hotspot_chip_params(table, maxDimension, r_convec);
+	sprintf(table[size].name, "block_solver");
+	strncpy(table[size].value, solver, STR_SIZE-1);
+	table[size].value[STR_SIZE-1] = '\0';
+	size++;
+	hs->config = default_thermal_config();
+	thermal_config_add_from_strs(&hs->config, table, size);
+
+	hs->flp = flp;
+	hs->maxDimension = maxDimension;
+	hs->r_convec = r_convec;
+	hs->model = alloc_RC_model(&hs->config, flp);
+	populate_R_model(hs->model, flp);
+
+	hs->power = hotspot_vector(hs->model);
+	hs->temp = hotspot_vector(hs->model);
+	return hs;
+}
+
+void hotspot_set_params(hotspot_handle_t *hs, float maxDimension, float r_convec)
+{
+	str_pair table[MAX_ENTRIES];
+	int size;
+
+	if (maxDimension == hs->maxDimension && r_convec == hs->r_convec)
+		return;
+
+	/* the model keeps its own copy of the configuration	*/
+	size = hotspot_chip_params(table, maxDimension, r_convec);
+	thermal_config_add_from_strs(hs->model->config, table, size);
+	hs->maxDimension = maxDimension;
+	hs->r_convec = r_convec;
+	populate_R_model(hs->model, hs->flp);
+}
+
+void hotspot_steady_temp(hotspot_handle_t *hs, double *power, double *temp)
+{
+	int n = hs->flp->n_units;
+
+	/* steady_state_temp fills in the internal nodes of the power vector	*/
+	copy_dvector(hs->power, power, n);
+	steady_state_temp(hs->model, hs->power, hs->temp);
+	copy_dvector(temp, hs->temp, n);
+}
+
+void hotspot_steady_temp_batch(hotspot_handle_t *hs, double **power, double **temp, int count)
+{
+	int i, n = hs->flp->n_units;
+	double **p = (double **) calloc (count, sizeof(double *));
+	double **t = (double **) calloc (count, sizeof(double *));
+	if (!p || !t)
+		fatal("memory allocation error\n");
+
+	/* vectors with room for the internal nodes	*/
+	for (i = 0; i < count; i++) {
+		p[i] = hotspot_vector(hs->model);
+		t[i] = hotspot_vector(hs->model);
+		copy_dvector(p[i], power[i], n);
+	}
+
+	steady_state_temp_batch(hs->model, p, t, count);
+
+	for (i = 0; i < count; i++) {
+		copy_dvector(temp[i], t[i], n);
+		free_dvector(p[i]);
+		free_dvector(t[i]);
+	}
+	free(p);
+	free(t);
+}
+
+void hotspot_close(hotspot_handle_t *hs)
+{
+	delete_RC_model(hs->model);
+	free_dvector(hs->power);
+	free_dvector(hs->temp);
+	free(hs);
+}
@@ -2,6 +2,8 @@
 #define __HOTSPOT_H_
 
 #include "util.h"
+#include "flp.h"
+#include "temperature.h"
 
 /* global configuration parameters for HotSpot	*/
 typedef struct global_config_t_st
@@ -29,7 +31,61 @@ void global_config_from_strs(global_config_t *config, str_pair *table, int size)
  */
 int global_config_to_strs(global_config_t *config, str_pair *table, int max_entries);
 
+/* text trace files - a line of names and lines of values	*/
+int read_names(FILE *fp, char **names);
+int read_vals(FILE *fp, double *vals);
+void write_names(FILE *fp, char **names, int size);
+/* values in Kelvin, written in degree C	*/
+void write_vals(FILE *fp, double *vals, int size);
+char **alloc_names(int nr, int nc);
+void free_names(char **m);
+
 // Run the HotSpot simulation
 int hotSpot_main(char const *floorplanFileName, char const *powerTraceFileName, char const *outputFileName, float maxDimension, float r_convec);
 
+/* 
+ * fill in the thermal parameters that depend on the chip being 
+ * modeled. returns the no. of entries used in 'table'
+ */
+int hotspot_chip_params(str_pair *table, float maxDimension, float r_convec);
+
+/* 
+ * in-memory interface to the steady state solver. the RC model is 
+ * built once for a floorplan and kept across calls, so callers that 
+ * already have the floorplan and the power numbers in memory never 
+ * have to go through the .flp, .ptrace and .temp files.
+ */
+typedef struct hotspot_handle_t_st
+{
+	/* floorplan - owned by the caller	*/
+	flp_t *flp;
+	/* thermal model and its configuration	*/
+	RC_model_t *model;
+	thermal_config_t config;
+	/* parameters the R model was last built for	*/
+	float maxDimension;
+	float r_convec;
+	/* scratch vectors including the internal nodes	*/
+	double *power;
+	double *temp;
+}hotspot_handle_t;
+
+/* 
+ * build the steady state model for 'flp'. 'solver' is one of the
+ * block_solver options - "lu", "cholesky" or "pcg"
+ */
+hotspot_handle_t *hotspot_open(flp_t *flp, float maxDimension, float r_convec, char const *solver);
+/* change the chip parameters, rebuilding the R model only if they differ	*/
+void hotspot_set_params(hotspot_handle_t *hs, float maxDimension, float r_convec);
+/* 
+ * steady state temperatures (in Kelvin) of the functional units for the 
+ * given power numbers (in W). both are in floorplan order and have one 
+ * entry per unit
+ */
+void hotspot_steady_temp(hotspot_handle_t *hs, double *power, double *temp);
+/* same as above for 'count' power vectors, solved together	*/
+void hotspot_steady_temp_batch(hotspot_handle_t *hs, double **power, double **temp, int count);
+/* the floorplan is left alone	*/
+void hotspot_close(hotspot_handle_t *hs);
+
 #endif
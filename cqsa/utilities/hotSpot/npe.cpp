@@ -149,7 +149,7 @@ void print_NPE(NPE_t *expr, flp_desc_t *flp_desc)
  * move M1 of the floorplan paper 
  * swap two units adjacent in the NPE	
  */
-void NPE_swap_units(NPE_t *expr, int pos)
+int NPE_swap_units(NPE_t *expr, int pos)
 {
 	int i, t;
 	
@@ -164,10 +164,12 @@ void NPE_swap_units(NPE_t *expr, int pos)
 	t = expr->elements[pos];
 	expr->elements[pos] = expr->elements[i]; 
 	expr->elements[i] = t;
+
+	return i;
 }
 
 /* move M2 - invert a chain of cut_types in the NPE	*/
-void NPE_invert_chain(NPE_t *expr, int pos)
+int NPE_invert_chain(NPE_t *expr, int pos)
 {
 	int i = pos+1, prev = expr->elements[pos];
 
@@ -190,6 +192,8 @@ void NPE_invert_chain(NPE_t *expr, int pos)
 			fatal("unknown cut type\n");
 		i++;	
 	}
+
+	return i-1;
 }
 
 /* binary search and increment the unit position by delta	*/
@@ -261,40 +265,62 @@ int NPE_swap_cut_unit(NPE_t *expr, int pos)
 /* make a random move out of the above	*/
 NPE_t *make_random_move(NPE_t *expr)
 {
-	int i, move, count = 0, done = FALSE, m3_count;
+	return make_random_move_r(expr, NULL);
+}
+
+/* same as above with the random stream 'seed' (see rand_upto_r)	*/
+NPE_t *make_random_move_r(NPE_t *expr, unsigned int *seed)
+{
+	NPE_move_t move;
 	NPE_t *copy = NPE_duplicate(expr);
+	NPE_random_move(copy, &move, seed);
+	return copy;
+}
+
+/* 
+ * make a random move on 'expr' itself and note down in 'move'
+ * where it was and how to undo it
+ */
+void NPE_random_move(NPE_t *expr, NPE_move_t *move, unsigned int *seed)
+{
+	int i, count = 0, done = FALSE, m3_count;
 
 	while (!done && count < MAX_MOVES) {
 		/* choose one of three moves	*/
-		move = rand_upto(3);
-		switch(move) {
-			case 0:	/* swap adjacent units	*/
+		move->type = rand_upto_r(3, seed);
+		switch(move->type) {
+			case NPE_M1:	/* swap adjacent units	*/
 				/* leave the unit last in the NPE	*/
-				i = rand_upto(expr->n_units-1);
+				i = rand_upto_r(expr->n_units-1, seed);
 				#if VERBOSE > 2
 				fprintf(stdout, "making M1 at %d\n", expr->unit_pos[i]);
 				#endif
-				NPE_swap_units(copy, expr->unit_pos[i]);
+				move->first = move->pos = expr->unit_pos[i];
+				move->last = NPE_swap_units(expr, move->pos);
 				done = TRUE;
 				break;
 
-			case 1:	/* invert an arbitrary chain	*/
-				i = rand_upto(expr->n_chains);
+			case NPE_M2:	/* invert an arbitrary chain	*/
+				i = rand_upto_r(expr->n_chains, seed);
 				#if VERBOSE > 2
 				fprintf(stdout, "making M2 at %d\n", expr->chain_pos[i]);
 				#endif
-				NPE_invert_chain(copy, expr->chain_pos[i]);
+				move->first = move->pos = expr->chain_pos[i];
+				move->last = NPE_invert_chain(expr, move->pos);
 				done = TRUE;
 				break;
 
-			case 2:	/* swap a unit and an adjacent cut_type	*/
+			case NPE_M3:	/* swap a unit and an adjacent cut_type	*/
 				m3_count = 0; 
 				while (!done && m3_count < MAX_MOVES) {
-					i = rand_upto(expr->n_flips);
+					i = rand_upto_r(expr->n_flips, seed);
 					#if VERBOSE > 2
 					fprintf(stdout, "making M3 at %d\n", expr->flip_pos[i]);
 					#endif
-					done = NPE_swap_cut_unit(copy, expr->flip_pos[i]);
+					move->first = move->pos = expr->flip_pos[i];
+					move->last = move->pos + 1;
+					/* an illegal move leaves expr as it was	*/
+					done = NPE_swap_cut_unit(expr, move->pos);
 					m3_count++;
 				}
 				break;
@@ -311,8 +337,29 @@ NPE_t *make_random_move(NPE_t *expr)
 		sprintf(msg, "tried %d moves, now giving up\n", MAX_MOVES); 
 		fatal(msg);
 	}
+}
 
-	return copy;
+/* 
+ * take back a move made by NPE_random_move. each of the
+ * moves is its own inverse at the same position
+ */
+void NPE_undo_move(NPE_t *expr, NPE_move_t *move)
+{
+	switch(move->type) {
+		case NPE_M1:
+			NPE_swap_units(expr, move->pos);
+			break;
+		case NPE_M2:
+			NPE_invert_chain(expr, move->pos);
+			break;
+		case NPE_M3:
+			if (!NPE_swap_cut_unit(expr, move->pos))
+				fatal("unable to undo move M3\n");
+			break;
+		default:
+			fatal("unknown move type\n");
+			break;
+	}
 }
 
 /* make a copy of this NPE	*/
@@ -350,3 +397,17 @@ NPE_t *NPE_duplicate(NPE_t *expr)
 	return copy;
 }
 
+/* copy 'src' into 'dst' - an NPE of the same size	*/
+void NPE_copy(NPE_t *dst, NPE_t *src)
+{
+	if (dst->size != src->size)
+		fatal("mismatch in NPE sizes\n");
+	memcpy(dst->elements, src->elements, src->size * sizeof(int));
+	dst->n_units = src->n_units;
+	memcpy(dst->unit_pos, src->unit_pos, src->n_units * sizeof(int));
+	dst->n_flips = src->n_flips;
+	memcpy(dst->flip_pos, src->flip_pos, src->n_flips * sizeof(int));
+	dst->n_chains = src->n_chains;
+	memcpy(dst->chain_pos, src->chain_pos, src->n_chains * sizeof(int));
+	memcpy(dst->ballot_count, src->ballot_count, src->size * sizeof(int));
+}
@@ -3,6 +3,11 @@
 
 #include "flp.h"
 
+/* moves on an NPE	*/
+#define NPE_M1		0	/* swap adjacent units	*/
+#define NPE_M2		1	/* invert a chain of cut_types	*/
+#define NPE_M3		2	/* swap adjacent unit and cut_type	*/
+
 /* normalized polish expression	*/
 typedef struct NPE_t_st
 {
@@ -29,6 +34,17 @@ typedef struct NPE_t_st
 	int *ballot_count;
 }NPE_t;
 
+/* a move made in place, with enough to undo it	*/
+typedef struct NPE_move_t_st
+{
+	int type;
+	/* position the move was made at	*/
+	int pos;
+	/* span of the positions it changed	*/
+	int first;
+	int last;
+}NPE_move_t;
+
 /* NPE routines	*/
 
 /* the starting solution for simulated annealing	*/
@@ -39,16 +55,26 @@ void free_NPE(NPE_t *expr);
 void print_NPE(NPE_t *expr, flp_desc_t *flp_desc);
 /* 
  * move M1 of the floorplan paper 
- * swap two units adjacent in the NPE	
+ * swap two units adjacent in the NPE.
+ * returns the position of the other unit
+ */
+int NPE_swap_units(NPE_t *expr, int pos);
+/* 
+ * move M2 - invert a chain of cut_types in the NPE.
+ * returns the position of the chain's last cut_type
  */
-void NPE_swap_units(NPE_t *expr, int pos);
-/* move M2 - invert a chain of cut_types in the NPE	*/
-void NPE_invert_chain(NPE_t *expr, int pos);
+int NPE_invert_chain(NPE_t *expr, int pos);
 /* move M3 - swap adjacent cut_type and unit in the NPE	*/
 int NPE_swap_cut_unit(NPE_t *expr, int pos);
 /* make a random move out of the above	*/
 NPE_t *make_random_move(NPE_t *expr);
+NPE_t *make_random_move_r(NPE_t *expr, unsigned int *seed);
+/* the same move in place, and its undo	*/
+void NPE_random_move(NPE_t *expr, NPE_move_t *move, unsigned int *seed);
+void NPE_undo_move(NPE_t *expr, NPE_move_t *move);
 /* make a copy of this NPE	*/
 NPE_t *NPE_duplicate(NPE_t *expr);
+/* copy into an NPE of the same size	*/
+void NPE_copy(NPE_t *dst, NPE_t *src);
 
 #endif
@@ -29,6 +29,7 @@ shape_t *shape_from_aspect(double area, double min,
 	else
 		shape->size = n_orients;
 
+	shape->max_size = shape->size;
 	shape->x = (double *) calloc(shape->size, sizeof(double));
 	shape->y = (double *) calloc(shape->size, sizeof(double));
 	if (!shape->x || !shape->y)
@@ -81,7 +82,8 @@ shape_t *shape_from_aspect(double area, double min,
 	return shape;
 }
 
-void free_shape(shape_t *shape)
+/* free the arrays of a shape curve, leaving the curve itself	*/
+static void free_shape_arrays(shape_t *shape)
 {
 	free (shape->x);
 	free (shape->y);
@@ -90,6 +92,11 @@ void free_shape(shape_t *shape)
 		free(shape->right_pos);
 		free(shape->median);
 	}	
+}
+
+void free_shape(shape_t *shape)
+{
+	free_shape_arrays(shape);
 	free(shape);
 }
 
@@ -116,15 +123,14 @@ void print_shape(shape_t *shape)
 	fprintf(stdout, "\n");	
 }
 
-/* shape curve arithmetic	*/
-shape_t *shape_add(shape_t *shape1, shape_t *shape2, int cut_type)
+/* 
+ * shape curve arithmetic into 'sum'. its arrays are grown 
+ * when they are too small and reused otherwise
+ */
+static void shape_add_into(shape_t *sum, shape_t *shape1, 
+						   shape_t *shape2, int cut_type)
 {
 	int i=0, j=0, k=0, total=0, m, n;
-	shape_t *sum;
-
-	sum = (shape_t *) calloc(1, sizeof(shape_t));
-	if (!sum)
-		fatal("memory allocation error\n");
 
 	/* shortcuts	*/	
 	m = shape1->size;
@@ -146,14 +152,17 @@ shape_t *shape_add(shape_t *shape1, shape_t *shape2, int cut_type)
 		total++;
 	}
 
-	sum->x = (double *) calloc(total, sizeof(double));
-	sum->y = (double *) calloc(total, sizeof(double));
-	sum->left_pos = (int *) calloc(total, sizeof(int));
-	sum->right_pos = (int *) calloc(total, sizeof(int));
-	sum->median = (double *) calloc(total, sizeof(double));
-	if (!sum->x || !sum->y || !sum->left_pos || 
-	    !sum->right_pos || !sum->median)
-		fatal("memory allocation error\n");
+	if (total > sum->max_size) {
+		sum->max_size = MAX(total, 2 * sum->max_size);
+		sum->x = (double *) realloc(sum->x, sum->max_size * sizeof(double));
+		sum->y = (double *) realloc(sum->y, sum->max_size * sizeof(double));
+		sum->left_pos = (int *) realloc(sum->left_pos, sum->max_size * sizeof(int));
+		sum->right_pos = (int *) realloc(sum->right_pos, sum->max_size * sizeof(int));
+		sum->median = (double *) realloc(sum->median, sum->max_size * sizeof(double));
+		if (!sum->x || !sum->y || !sum->left_pos || 
+			!sum->right_pos || !sum->median)
+			fatal("memory allocation error\n");
+	}
 	sum->size = total;	
 
 	i=j=0;
@@ -188,6 +197,17 @@ shape_t *shape_add(shape_t *shape1, shape_t *shape2, int cut_type)
 		}
 		k++;
 	}
+}
+
+/* shape curve arithmetic	*/
+shape_t *shape_add(shape_t *shape1, shape_t *shape2, int cut_type)
+{
+	shape_t *sum;
+
+	sum = (shape_t *) calloc(1, sizeof(shape_t));
+	if (!sum)
+		fatal("memory allocation error\n");
+	shape_add_into(sum, shape1, shape2, cut_type);
 
 	return sum;
 }
@@ -200,7 +220,7 @@ shape_t *shape_duplicate(shape_t *shape)
 	copy = (shape_t *) calloc(1, sizeof(shape_t));
 	if (!copy)
 		fatal("memory allocation error\n");
-	copy->size = shape->size;
+	copy->size = copy->max_size = shape->size;
 	copy->x = (double *) calloc(copy->size, sizeof(double));
 	copy->y = (double *) calloc(copy->size, sizeof(double));
 	if (!copy->x || !copy->y)
@@ -396,9 +416,14 @@ int min_area_pos(shape_t *curve)
  * the added up shape curves. 'pos' denotes the current
  * added up orientation. 'leftx' & 'bottomy' denote the
  * left and bottom ends of the current bounding rectangle
+ * and 'width' & 'height' its size. the rectangle can be
+ * larger than the orientation when dead space has been
+ * absorbed into it. the shape curves themselves are left
+ * untouched so that they can be reused
  */
 int recursive_sizing (tree_node_t *node, int pos, 
 					   double leftx, double bottomy,
+					   double width, double height,
 					   int dead_count, int compact_dead,
 					   double compact_ratio,
 #if VERBOSE > 1					   
@@ -411,8 +436,8 @@ int recursive_sizing (tree_node_t *node, int pos,
 
 	/* leaf node. fill the placeholder	*/
 	if (node->label.unit >= 0) {
-		flp->units[node->label.unit].width = self->x[pos];
-		flp->units[node->label.unit].height = self->y[pos];
+		flp->units[node->label.unit].width = width;
+		flp->units[node->label.unit].height = height;
 		flp->units[node->label.unit].leftx = leftx;
 		flp->units[node->label.unit].bottomy = bottomy;
 	} else {
@@ -436,16 +461,13 @@ int recursive_sizing (tree_node_t *node, int pos,
 			 * if a dead block has been previously compacted away from this
 			 * bounding rectangle, absorb that area into the child also
 			 */
-			if(self->y[pos] > MAX(y1, y2)) {
-				left->y[self->left_pos[pos]] += (self->y[pos] - MAX(y1, y2));
-				right->y[self->right_pos[pos]] += (self->y[pos] - MAX(y1, y2));
-				y1 = left->y[self->left_pos[pos]];
-				y2 = right->y[self->right_pos[pos]];
-			}	
-			if(self->x[pos] > (x1+x2)) {
-				right->x[self->right_pos[pos]] += self->x[pos]-(x1+x2);
-				x2 = right->x[self->right_pos[pos]];
+			if(height > MAX(y1, y2)) {
+				double extra = height - MAX(y1, y2);
+				y1 += extra;
+				y2 += extra;
 			}	
+			if(width > (x1+x2))
+				x2 += width-(x1+x2);
 
 			flp->units[idx].width = (y2 >= y1) ? x1 : x2;
 			flp->units[idx].height = fabs(y2 - y1);
@@ -462,39 +484,37 @@ int recursive_sizing (tree_node_t *node, int pos,
 				*compacted_area += (flp->units[idx].width * flp->units[idx].height);
 				#endif
 				if (y2 >= y1) 
-					left->y[self->left_pos[pos]] = y2;
+					y1 = y2;
 				else
-					right->y[self->right_pos[pos]] = y1;
+					y2 = y1;
 			} else {
 				dead_count++;
 			}
 
 			/* left and bottom don't change for the left child	*/
 			dead_count = recursive_sizing(node->left, self->left_pos[pos],
-										 leftx, bottomy, dead_count, compact_dead, 
-										 compact_ratio,
+										 leftx, bottomy, x1, y1, dead_count, 
+										 compact_dead, compact_ratio,
 			#if VERBOSE > 1
 										 compacted_area,
 			#endif
 										 flp);
 			dead_count = recursive_sizing(node->right, self->right_pos[pos],
 										 leftx + self->median[pos], bottomy, 
-										 dead_count, compact_dead, compact_ratio,
+										 x2, y2, dead_count, compact_dead, 
+										 compact_ratio,
 			#if VERBOSE > 1
 										 compacted_area,
 			#endif
 										 flp);
 		} else {
-			if(self->x[pos] > MAX(x1, x2)) {
-				left->x[self->left_pos[pos]] += (self->x[pos] - MAX(x1, x2));
-				right->x[self->right_pos[pos]] += (self->x[pos] - MAX(x1, x2));
-				x1 = left->x[self->left_pos[pos]];
-				x2 = right->x[self->right_pos[pos]];
-			}	
-			if(self->y[pos] > (y1+y2)) {
-				right->y[self->right_pos[pos]] += self->y[pos]-(y1+y2);
-				y2 = right->y[self->right_pos[pos]];
+			if(width > MAX(x1, x2)) {
+				double extra = width - MAX(x1, x2);
+				x1 += extra;
+				x2 += extra;
 			}	
+			if(height > (y1+y2))
+				y2 += height-(y1+y2);
 
 			flp->units[idx].width = fabs(x2 - x1);
 			flp->units[idx].height = (x2 >= x1) ? y1 : y2;
@@ -506,24 +526,25 @@ int recursive_sizing (tree_node_t *node, int pos,
 				*compacted_area += (flp->units[idx].width * flp->units[idx].height);
 				#endif
 				if (x2 >= x1) 
-					left->x[self->left_pos[pos]] = x2;
+					x1 = x2;
 				else
-					right->x[self->right_pos[pos]] = x1;
+					x2 = x1;
 			} else {
 				dead_count++;
 			}
 
 			/* left and bottom don't change for the left child	*/
 			dead_count = recursive_sizing(node->left, self->left_pos[pos],
-										 leftx, bottomy, dead_count, compact_dead, 
-										 compact_ratio,
+										 leftx, bottomy, x1, y1, dead_count, 
+										 compact_dead, compact_ratio,
 			#if VERBOSE > 1
 										 compacted_area,
 			#endif
 										 flp);
 			dead_count = recursive_sizing(node->right, self->right_pos[pos],
 							 			 leftx, bottomy + self->median[pos], 
-										 dead_count, compact_dead, compact_ratio,
+										 x2, y2, dead_count, compact_dead, 
+										 compact_ratio,
 			#if VERBOSE > 1
 										 compacted_area,
 			#endif
@@ -548,8 +569,9 @@ int tree_to_flp(tree_node_t *root, flp_t *flp, int compact_dead,
 	#if VERBOSE > 1									  
 	double compacted_area = 0.0;
 	#endif								  
-	int dead_count = recursive_sizing(root, pos, 0.0, 0.0, 0, 
-					 				  compact_dead, compact_ratio,
+	int dead_count = recursive_sizing(root, pos, 0.0, 0.0, 
+									  root->curve->x[pos], root->curve->y[pos], 
+					 				  0, compact_dead, compact_ratio,
 	#if VERBOSE > 1									  
 									  &compacted_area,
 	#endif								  
@@ -557,9 +579,159 @@ int tree_to_flp(tree_node_t *root, flp_t *flp, int compact_dead,
 					 
 	int compacted = (flp->n_units - 1) / 2 - dead_count;
 	flp->n_units -= compacted;
+	flp_invalidate_adj(flp);
 	#if VERBOSE > 1
 	fprintf(stdout, "%d dead blocks, %.2f%% of the core compacted\n", compacted, 
 			compacted_area / (get_total_area(flp)-compacted_area) * 100);
 	#endif
 	return compacted;
 }
+
+/* pooled slicing tree routines	*/
+
+slicing_tree_t *new_slicing_tree(int size)
+{
+	slicing_tree_t *tree = (slicing_tree_t *) calloc(1, sizeof(slicing_tree_t));
+	if (!tree)
+		fatal("memory allocation error\n");
+	tree->size = size;
+	tree->nodes = (tree_node_t *) calloc(size, sizeof(tree_node_t));
+	tree->curves = (shape_t *) calloc(size, sizeof(shape_t));
+	tree->spare = (shape_t *) calloc(size, sizeof(shape_t));
+	if (!tree->nodes || !tree->curves || !tree->spare)
+		fatal("memory allocation error\n");
+	tree->start = ivector(size);
+	tree->dirty = ivector(size);
+	tree->changed = ivector(size);
+	tree->stack = ivector(size);
+	/* nothing built yet	*/
+	tree->valid = FALSE;
+	return tree;
+}
+
+void free_slicing_tree(slicing_tree_t *tree)
+{
+	int i;
+	for (i = 0; i < tree->size; i++) {
+		free_shape_arrays(&tree->curves[i]);
+		free_shape_arrays(&tree->spare[i]);
+	}
+	free(tree->nodes);
+	free(tree->curves);
+	free(tree->spare);
+	free_ivector(tree->start);
+	free_ivector(tree->dirty);
+	free_ivector(tree->changed);
+	free_ivector(tree->stack);
+	free(tree);
+}
+
+/* 
+ * bring the tree up to date with 'expr' after a move that changed
+ * its positions 'first' to 'last'. the subtree at a position depends
+ * only on the positions it spans. so, the nodes before the move keep
+ * their curves and links, and after it, only those whose subtrees
+ * take in a changed position are added up again - the path from the
+ * move to the root. the rest are just linked. returns the root
+ */
+tree_node_t *slicing_tree_update(slicing_tree_t *tree, flp_desc_t *flp_desc, 
+								 NPE_t *expr, int first, int last)
+{
+	int i, k, t, top = 0, from, left, right;
+	int *stack = tree->stack;
+	tree_node_t *node;
+	shape_t swap;
+
+	if (expr->size != tree->size)
+		fatal("mismatch in the sizes of NPE and slicing tree\n");
+
+	/* build from scratch	*/
+	tree->full = !tree->valid;
+	if (tree->full) {
+		first = 0;
+		last = expr->size - 1;
+	}
+	/* links after an undone move are stale	*/
+	from = MIN(first, tree->relink);
+
+	/* 
+	 * the stack just before 'from' holds the subtrees ending
+	 * there, one right before the other. push them bottom up
+	 */
+	for (k = from - 1; k >= 0; k = tree->start[k] - 1)
+		stack[top++] = k;
+	for (k = 0; k < top / 2; k++) {
+		t = stack[k];
+		stack[k] = stack[top-1-k];
+		stack[top-1-k] = t;
+	}
+
+	tree->n_changed = 0;
+	for (i = from; i < expr->size; i++) {
+		node = &tree->nodes[i];
+		tree->dirty[i] = (i >= first && i <= last);
+		/* leaf - the unit's own shape curve	*/
+		if (expr->elements[i] >= 0) {
+			node->curve = flp_desc->units[expr->elements[i]].shape;
+			node->left = node->right = NULL;
+			node->label.unit = expr->elements[i];
+			tree->start[i] = i;
+		/*	internal node denoting a cut	*/
+		} else {
+			if (top < 2)
+				fatal("invalid NPE in slicing_tree_update\n");
+			right = stack[--top];
+			left = stack[--top];
+			node->left = &tree->nodes[left];
+			node->right = &tree->nodes[right];
+			node->label.cut_type = expr->elements[i];
+			tree->start[i] = tree->start[left];
+			/* positions before 'from' are clean	*/
+			if ((left >= from && tree->dirty[left]) || 
+				(right >= from && tree->dirty[right]))
+				tree->dirty[i] = TRUE;
+			/* keep the old curve for an undo	*/
+			if (tree->dirty[i]) {
+				swap = tree->curves[i];
+				tree->curves[i] = tree->spare[i];
+				tree->spare[i] = swap;
+				shape_add_into(&tree->curves[i], node->left->curve, 
+							   node->right->curve, node->label.cut_type);
+				tree->changed[tree->n_changed++] = i;
+			}
+			node->curve = &tree->curves[i];
+		}
+		stack[top++] = i;
+	}
+	if (top != 1)
+		fatal("invalid NPE in slicing_tree_update\n");
+
+	tree->first = from;
+	tree->relink = expr->size;
+	tree->valid = TRUE;
+	return &tree->nodes[expr->size-1];
+}
+
+/* 
+ * roll the curves back to before the last update, once its
+ * move has been undone. the links are redone by the next update
+ */
+void slicing_tree_undo(slicing_tree_t *tree)
+{
+	int k, i;
+	shape_t swap;
+
+	/* nothing to go back to	*/
+	if (tree->full) {
+		tree->valid = FALSE;
+		return;
+	}
+	for (k = 0; k < tree->n_changed; k++) {
+		i = tree->changed[k];
+		swap = tree->curves[i];
+		tree->curves[i] = tree->spare[i];
+		tree->spare[i] = swap;
+	}
+	tree->n_changed = 0;
+	tree->relink = MIN(tree->relink, tree->first);
+}
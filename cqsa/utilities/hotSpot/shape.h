@@ -24,6 +24,8 @@ typedef struct shape_t_st
    */
   double *median;
   int size;
+  /* no. of entries allocated	*/
+  int max_size;
 }shape_t;
 
 /* slicing tree node	*/
@@ -38,6 +40,38 @@ typedef struct tree_node_t_st
 	struct tree_node_t_st *right;
 }tree_node_t;
 
+/* 
+ * slicing tree kept up to date with an NPE across in-place moves
+ * (see NPE_random_move). its nodes and added up shape curves are
+ * pooled, one per NPE position, and a move adds up the curves
+ * only along its way to the root
+ */
+typedef struct slicing_tree_t_st
+{
+	/* node and added up shape curve at each NPE position	*/
+	tree_node_t *nodes;
+	shape_t *curves;
+	/* curves replaced by the last update, kept for an undo	*/
+	shape_t *spare;
+	/* first NPE position of the subtree at each position	*/
+	int *start;
+	/* has the subtree at a position changed in this update?	*/
+	int *dirty;
+	/* positions whose curves the last update replaced	*/
+	int *changed;
+	int n_changed;
+	/* first position relinked by the last update	*/
+	int first;
+	/* position from which the links are stale after an undo	*/
+	int relink;
+	/* scratch stack of positions	*/
+	int *stack;
+	int size;
+	/* built yet? and was the last update a build from scratch?	*/
+	int valid;
+	int full;
+}slicing_tree_t;
+
 /* tree node stack	*/
 typedef struct tree_node_stack_t_st
 {
@@ -88,4 +122,16 @@ void print_tree_relevant(tree_node_t *root, int pos, flp_desc_t *flp_desc);
  */
 int tree_to_flp(tree_node_t *root, flp_t *flp, int compact_dead, 
 				double compact_ratio);
+
+/* pooled slicing tree operations	*/
+slicing_tree_t *new_slicing_tree(int size);
+void free_slicing_tree(slicing_tree_t *tree);
+/* 
+ * bring the tree up to date with 'expr' after a move that
+ * changed its positions 'first' to 'last'. returns the root
+ */
+tree_node_t *slicing_tree_update(slicing_tree_t *tree, flp_desc_t *flp_desc, 
+								 NPE_t *expr, int first, int last);
+/* roll back the last update after its move has been undone	*/
+void slicing_tree_undo(slicing_tree_t *tree);
 #endif
@@ -19,8 +19,8 @@
 
 /* input and output files	*/
 static char *flp_file;		/* has the floorplan configuration	*/
-static char *init_file;		/* initial temperatures	from file	*/
-static char *steady_file;	/* steady state temperatures to file	*/
+static const char *init_file = NULLFILE;	/* initial temperatures	from file	*/
+static const char *steady_file = NULLFILE;	/* steady state temperatures to file	*/
 
 /* floorplan	*/
 static flp_t *flp;
@@ -45,9 +45,15 @@ thermal_config_t default_thermal_config(void)
 	config.dtm_used = FALSE;			/* set accordingly	*/
 	/* set block model as default	*/
 	strcpy(config.model_type, BLOCK_MODEL_STR);
+	/* adaptive runge-kutta for the transient	*/
+	strcpy(config.trans_solver, TRANS_SOLVER_RK4_STR);
+	/* implicit solvers step once per sampling interval	*/
+	config.trans_step = 3.333e-6;
 
 	/* block model specific parameters	*/
 	config.block_omit_lateral = FALSE;	/* omit lateral chip resistances?	*/
+	/* dense LUP decomposition for the steady state	*/
+	strcpy(config.block_solver, BLOCK_SOLVER_LU_STR);
 
 	/* grid model specific parameters	*/
 	config.grid_rows = 50;				/* grid resolution - no. of rows	*/
@@ -62,6 +68,8 @@ thermal_config_t default_thermal_config(void)
 	 * grid cell as that of the entire block
 	 */
 	strcpy(config.grid_map_mode, GRID_CENTER_STR);
+	/* gauss-seidel iterations for the steady state	*/
+	strcpy(config.grid_solver, GRID_SOLVER_GS_STR);
 
 	return config;
 }
@@ -124,9 +132,18 @@ void thermal_config_add_from_strs(thermal_config_t *config, str_pair *table, int
 	if ((idx = get_str_index(table, size, "model_type")) >= 0)
 		if(sscanf(table[idx].value, "%s", config->model_type) != 1)
 			fatal("invalid format for configuration  parameter model_type\n");
+	if ((idx = get_str_index(table, size, "trans_solver")) >= 0)
+		if(sscanf(table[idx].value, "%s", config->trans_solver) != 1)
+			fatal("invalid format for configuration  parameter trans_solver\n");
+	if ((idx = get_str_index(table, size, "trans_step")) >= 0)
+		if(sscanf(table[idx].value, "%lf", &config->trans_step) != 1)
+			fatal("invalid format for configuration  parameter trans_step\n");
 	if ((idx = get_str_index(table, size, "block_omit_lateral")) >= 0)
 		if(sscanf(table[idx].value, "%d", &config->block_omit_lateral) != 1)
 			fatal("invalid format for configuration  parameter block_omit_lateral\n");
+	if ((idx = get_str_index(table, size, "block_solver")) >= 0)
+		if(sscanf(table[idx].value, "%s", config->block_solver) != 1)
+			fatal("invalid format for configuration  parameter block_solver\n");
 	if ((idx = get_str_index(table, size, "grid_rows")) >= 0)
 		if(sscanf(table[idx].value, "%d", &config->grid_rows) != 1)
 			fatal("invalid format for configuration  parameter grid_rows\n");
@@ -142,6 +159,9 @@ void thermal_config_add_from_strs(thermal_config_t *config, str_pair *table, int
 	if ((idx = get_str_index(table, size, "grid_map_mode")) >= 0)
 		if(sscanf(table[idx].value, "%s", config->grid_map_mode) != 1)
 			fatal("invalid format for configuration  parameter grid_map_mode\n");
+	if ((idx = get_str_index(table, size, "grid_solver")) >= 0)
+		if(sscanf(table[idx].value, "%s", config->grid_solver) != 1)
+			fatal("invalid format for configuration  parameter grid_solver\n");
 	
 	if ((config->t_chip <= 0) || (config->s_sink <= 0) || (config->t_sink <= 0) || 
 		(config->s_spreader <= 0) || (config->t_spreader <= 0) || 
@@ -154,6 +174,16 @@ void thermal_config_add_from_strs(thermal_config_t *config, str_pair *table, int
 	if (strcasecmp(config->model_type, BLOCK_MODEL_STR) &&
 		strcasecmp(config->model_type, GRID_MODEL_STR))
 		fatal("invalid model type. use 'block' or 'grid'\n");
+	if (strcasecmp(config->trans_solver, TRANS_SOLVER_RK4_STR) &&
+		strcasecmp(config->trans_solver, TRANS_SOLVER_EULER_STR) &&
+		strcasecmp(config->trans_solver, TRANS_SOLVER_CN_STR))
+		fatal("invalid transient solver. use 'rk4', 'euler' or 'cn'\n");
+	if (config->trans_step <= 0)
+		fatal("transient step should be greater than zero\n");
+	if (strcasecmp(config->block_solver, BLOCK_SOLVER_LU_STR) &&
+		strcasecmp(config->block_solver, BLOCK_SOLVER_CHOLESKY_STR) &&
+		strcasecmp(config->block_solver, BLOCK_SOLVER_PCG_STR))
+		fatal("invalid block solver. use 'lu', 'cholesky' or 'pcg'\n");
 	if(config->grid_rows <= 0 || config->grid_cols <= 0)
 		fatal("grid rows and columns should both be greater than 0\n");
 	if (strcasecmp(config->grid_map_mode, GRID_AVG_STR) &&
@@ -161,6 +191,9 @@ void thermal_config_add_from_strs(thermal_config_t *config, str_pair *table, int
 		strcasecmp(config->grid_map_mode, GRID_MAX_STR) &&
 		strcasecmp(config->grid_map_mode, GRID_CENTER_STR))
 		fatal("invalid mapping mode. use 'avg', 'min', 'max' or 'center'\n");
+	if (strcasecmp(config->grid_solver, GRID_SOLVER_GS_STR) &&
+		strcasecmp(config->grid_solver, GRID_SOLVER_PCG_STR))
+		fatal("invalid grid solver. use 'gs' or 'pcg'\n");
 }
 
 /* 
@@ -169,7 +202,7 @@ void thermal_config_add_from_strs(thermal_config_t *config, str_pair *table, int
  */
 int thermal_config_to_strs(thermal_config_t *config, str_pair *table, int max_entries)
 {
-	if (max_entries < 23)
+	if (max_entries < 27)
 		fatal("not enough entries in table\n");
 
 	sprintf(table[0].name, "t_chip");
@@ -195,6 +228,10 @@ int thermal_config_to_strs(thermal_config_t *config, str_pair *table, int max_en
 	sprintf(table[20].name, "grid_layer_file");
 	sprintf(table[21].name, "grid_steady_file");
 	sprintf(table[22].name, "grid_map_mode");
+	sprintf(table[23].name, "block_solver");
+	sprintf(table[24].name, "grid_solver");
+	sprintf(table[25].name, "trans_solver");
+	sprintf(table[26].name, "trans_step");
 
 	sprintf(table[0].value, "%lg", config->t_chip);
 	sprintf(table[1].value, "%lg", config->thermal_threshold);
@@ -219,8 +256,12 @@ int thermal_config_to_strs(thermal_config_t *config, str_pair *table, int max_en
 	sprintf(table[20].value, "%s", config->grid_layer_file);
 	sprintf(table[21].value, "%s", config->grid_steady_file);
 	sprintf(table[22].value, "%s", config->grid_map_mode);
+	sprintf(table[23].value, "%s", config->block_solver);
+	sprintf(table[24].value, "%s", config->grid_solver);
+	sprintf(table[25].value, "%s", config->trans_solver);
+	sprintf(table[26].value, "%lg", config->trans_step);
 
-	return 23;
+	return 27;
 }
 
 /* package parameter routines	*/
@@ -352,6 +393,15 @@ void steady_state_temp(RC_model_t *model, double *power, double *temp)
 	else fatal("unknown model type\n");	
 }
 
+void steady_state_temp_batch(RC_model_t *model, double **power, double **temp, int n) 
+{
+	if (model->type == BLOCK_MODEL)
+		steady_state_temp_block_batch(model->block, power, temp, n);
+	else if (model->type == GRID_MODEL)	
+		steady_state_temp_grid_batch(model->grid, power, temp, n);
+	else fatal("unknown model type\n");	
+}
+
 /* transient (instantaneous) temperature	*/
 void compute_temp(RC_model_t *model, double *power, double *temp, double time_elapsed)
 {
@@ -20,6 +20,20 @@
 #define	GRID_MAX_STR	"max"
 #define	GRID_CENTER_STR	"center"
 
+/* steady state solver of the block model	*/
+#define	BLOCK_SOLVER_LU_STR			"lu"
+#define	BLOCK_SOLVER_CHOLESKY_STR	"cholesky"
+#define	BLOCK_SOLVER_PCG_STR		"pcg"
+
+/* steady state solver of the grid model	*/
+#define	GRID_SOLVER_GS_STR		"gs"
+#define	GRID_SOLVER_PCG_STR		"pcg"
+
+/* transient solver - adaptive runge-kutta or implicit fixed step	*/
+#define	TRANS_SOLVER_RK4_STR	"rk4"
+#define	TRANS_SOLVER_EULER_STR	"euler"
+#define	TRANS_SOLVER_CN_STR		"cn"
+
 /* number of extra nodes due to the model:
  * 4 spreader nodes, 4 heat sink nodes under
  * the spreader (center), 4 peripheral heat 
@@ -57,6 +71,13 @@
 /* model specific constants	*/
 #define C_FACTOR	0.5		/* fitting factor to match floworks (due to lumping)	*/
 
+/* 
+ * no. of right hand sides a batched solve carries through 
+ * the factor together. they are interleaved, so that each 
+ * element of the factor is applied to all of them at once
+ */
+#define BATCH_BLOCK	8
+
 /* constants related to transient temperature calculation	*/
 #define MIN_STEP	1e-7	/* 0.1 us	*/
 
@@ -111,9 +132,17 @@ typedef struct thermal_config_t_st
 	int dtm_used;			/* flag to guide the scaling of init Ts	*/
 	/* model type - block or grid */
 	char model_type[STR_SIZE];
+	/* 
+	 * transient solver - 4th order runge-kutta, backward euler 
+	 * or crank-nicolson - and the largest step of the latter two
+	 */
+	char trans_solver[STR_SIZE];
+	double trans_step;
 
 	/* parameters specific to block model	*/
 	int block_omit_lateral;	/* omit lateral resistance?	*/
+	/* steady state solver - dense LU, sparse cholesky or pcg	*/
+	char block_solver[STR_SIZE];
 
 	/* parameters specific to grid model	*/
 	int grid_rows;			/* grid resolution - no. of rows	*/
@@ -124,6 +153,8 @@ typedef struct thermal_config_t_st
 	char grid_steady_file[STR_SIZE];
 	/* mapping mode between grid and block models	*/
 	char grid_map_mode[STR_SIZE];
+	/* steady state solver - gauss-seidel or pcg	*/
+	char grid_solver[STR_SIZE];
 }thermal_config_t;
 
 /* defaults	*/
@@ -219,6 +250,12 @@ void populate_C_model(RC_model_t *model, flp_t *flp);
 
 /* hotspot main interfaces - temperature.c	*/
 void steady_state_temp(RC_model_t *model, double *power, double *temp);
+/* 
+ * same as above for 'n' power vectors on the same model. the 
+ * conductance matrix is factorized once, and the solves share 
+ * each pass over the factor
+ */
+void steady_state_temp_batch(RC_model_t *model, double **power, double **temp, int n);
 void compute_temp(RC_model_t *model, double *power, double *temp, double time_elapsed);
 /* differs from 'dvector()' in that memory for internal nodes is also allocated	*/
 double *hotspot_vector(RC_model_t *model);
@@ -251,9 +288,22 @@ double getcap(double sp_heat, double thickness, double area);
 
 /* LU forward and backward substitution	*/
 void lusolve(double **a, int n, int *p, double *b, double *x, int spd);
+/* same as above for the 'nrhs' right hand sides b[0..nrhs-1]	*/
+void lusolve_batch(double **a, int n, int *p, double **b, double **x, int nrhs, int spd);
 
-/* 4th order Runge Kutta solver with adaptive step sizing */
-double rk4(void *model, double *y, void *p, int n, double h, double *yout, slope_fn_ptr f);
+/* 
+ * 4th order Runge Kutta solver with adaptive step sizing. 'work' is 
+ * scratch space for RK4_WORK(n) doubles, or NULL to have it 
+ * allocated for the call
+ */
+#define RK4_WORK(n)		(8 * (n))
+double rk4(void *model, double *y, void *p, int n, double h, double *yout, slope_fn_ptr f, 
+		   double *work);
+/* 
+ * no. of equal steps, none longer than 'max_step', the implicit 
+ * solvers take to cover 'time_elapsed'
+ */
+int implicit_steps(double time_elapsed, double max_step);
 
 /* matrix and vector routines	*/
 void matmult(double **c, double **a, double **b, int n);
@@ -272,4 +322,77 @@ void matinv(double **inv, double **m, int n, int spd);
 /* dst = src1 + scale * src2	*/
 void scaleadd_dvector (double *dst, double *src1, double *src2, int n, double scale);
 
+/* square sparse matrix in compressed sparse row (CSR) form	*/
+typedef struct sparse_matrix_t_st
+{
+	int n;			/* no. of rows (and columns)	*/
+	int nnz;		/* no. of non-zeros	*/
+	/* the non-zeros of row i are at row_start[i] up to row_start[i+1]	*/
+	int *row_start;
+	int *col;
+	double *val;
+}sparse_matrix_t;
+
+/* non-zeros of the n by n matrix 'm' in CSR form	*/
+sparse_matrix_t *dmatrix_to_sparse(double **m, int n);
+sparse_matrix_t *copy_sparse_matrix(sparse_matrix_t *s);
+void free_sparse_matrix(sparse_matrix_t *s);
+/* one row per line, as 'column:value' pairs	*/
+void dump_sparse_matrix(sparse_matrix_t *s);
+/* vout = s * vin	*/
+void sparse_matvectmult(double *vout, sparse_matrix_t *s, double *vin);
+
+/* 
+ * cholesky factor of a symmetric positive definite sparse matrix,
+ * stored by rows within its envelope (from the first non-zero of
+ * each row up to the diagonal) after a reordering that keeps the
+ * envelope narrow
+ */
+typedef struct sparse_chol_t_st
+{
+	int n;
+	/* perm[i] = original index of the i-th row of the factor	*/
+	int *perm;
+	/* row i holds columns first[i] to i at val[row_start[i]] onwards	*/
+	int *first;
+	int *row_start;
+	double *val;
+}sparse_chol_t;
+
+/* 
+ * factorize 'a'. the first 'n_reorder' rows are reordered (reverse
+ * Cuthill-McKee) while the rest, which might be connected to many
+ * others, are left at the end where they do not widen the envelope
+ */
+sparse_chol_t *sparse_chol_dcmp(sparse_matrix_t *a, int n_reorder);
+void free_sparse_chol(sparse_chol_t *f);
+/* solve ax = b using the factor of a	*/
+void sparse_chol_solve(sparse_chol_t *f, double *b, double *x);
+/* same as above for the 'nrhs' right hand sides b[0..nrhs-1]	*/
+void sparse_chol_solve_batch(sparse_chol_t *f, double **b, double **x, int nrhs);
+
+/* 
+ * incomplete cholesky factor of a symmetric positive definite 'a' 
+ * with no fill-in, i.e., with the same non-zeros as the lower
+ * triangle of 'a'. each row must have its diagonal element
+ */
+sparse_matrix_t *sparse_ic0_dcmp(sparse_matrix_t *a);
+/* solve (l)(l^T)x = b	*/
+void sparse_ic0_solve(sparse_matrix_t *l, double *b, double *x);
+
+/* 
+ * preconditioned conjugate gradient solution of ax = b for a 
+ * symmetric positive definite 'a'. the preconditioner is the 
+ * incomplete cholesky factor 'ic' or, when that is NULL, the 
+ * diagonal of 'a'. 'x' is the initial guess on entry. iterates 
+ * till the residual is within 'tol' times 'b' and returns the no. 
+ * of iterations, or -1 if that takes more than 'max_iter' of them.
+ * the final residual relative to 'b' goes into 'resid' if not NULL.
+ * 'work' is scratch space for PCG_WORK(n) doubles, or NULL to have 
+ * it allocated for the call
+ */
+#define PCG_WORK(n)		(5 * (n))
+int pcgsolve(sparse_matrix_t *a, sparse_matrix_t *ic, double *b, double *x, 
+			 double tol, int max_iter, double *resid, double *work);
+
 #endif
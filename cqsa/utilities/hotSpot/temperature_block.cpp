@@ -37,6 +37,8 @@ block_model_t *alloc_block_model(thermal_config_t *config, flp_t *placeholder)
 	/* vertical conductances to ambient	*/
 	model->g_amb = dvector(n+EXTRA);
 	model->t_vector = dvector(m);/* scratch pad	*/
+	model->t_warm = dvector(m);	/* last pcg solution	*/
+	model->pcg_work = dvector(PCG_WORK(m));	/* pcg's scratch pad	*/
 	model->p = ivector(m);		/* permutation vector for b's LUP decomposition	*/
 
 	model->a = dvector(m);		/* vertical Cs - diagonal matrix stored as a 1-d vector	*/
@@ -50,6 +52,294 @@ block_model_t *alloc_block_model(thermal_config_t *config, flp_t *placeholder)
 	return model;
 }
 
+/* free the sparse forms of B	*/
+void free_sparse_model_block(block_model_t *model)
+{
+	if (model->b_sparse)
+		free_sparse_matrix(model->b_sparse);
+	if (model->chol)
+		free_sparse_chol(model->chol);
+	model->b_sparse = NULL;
+	model->chol = NULL;
+}
+
+/* free the implicit transient solvers' factor	*/
+void free_trans_model_block(block_model_t *model)
+{
+	if (model->trans_chol)
+		free_sparse_chol(model->trans_chol);
+	model->trans_chol = NULL;
+	model->trans_h = 0;
+}
+
+/* 
+ * the conductances of the block model. 'g_edge' has the sums of 
+ * the lateral conductances of the blocks on each chip edge, in the
+ * spreader (SP_W to SP_S) and the sink (SINK_C_W to SINK_C_S)
+ */
+
+/* lateral conductance from block i towards its neighbour in layer l	*/
+static double block_g_lat(block_model_t *model, flp_t *flp, int l, int i, 
+						  int horiz, double len)
+{
+	double *gx[NL] = {model->gx, model->gx_int, model->gx_sp, model->gx_hs};
+	double *gy[NL] = {model->gy, model->gy_int, model->gy_sp, model->gy_hs};
+	double part;
+
+	if (horiz)
+		part = gx[l][i] / flp->units[i].height;
+	else
+		part = gy[l][i] / flp->units[i].width;
+	return part * len;
+}
+
+/* vertical conductance from block i in layer l to the one below it	*/
+static double block_g_vert(block_model_t *model, flp_t *flp, int l, int i)
+{
+	double area = (flp->units[i].height * flp->units[i].width);
+
+	/* the 2.0 factor is explained during the calculation of B	*/
+	if (l == 0)
+		return 2.0/getr(K_SI, model->config.t_chip, area);
+	if (l == IFACE)
+		return 2.0/getr(K_INT, model->config.t_interface, area);
+	return 2.0/getr(K_CU, model->config.t_spreader, area);
+}
+
+/* 
+ * conductance from the spreader or sink portion of block i to 
+ * the peripheral node e - zero unless i is on that edge
+ */
+static double block_g_per(block_model_t *model, int i, int e, double *g_edge)
+{
+	/* the edges are numbered as in 'border'	*/
+	int d = e % 4, ns = (d == SP_N || d == SP_S);
+	double gq, r1;
+
+	if (e < SINK_C_W) {
+		gq = ns ? model->gy_sp[i] : model->gx_sp[i];
+		r1 = ns ? model->pack.r_sp1_y : model->pack.r_sp1_x;
+	} else {
+		gq = ns ? model->gy_hs[i] : model->gx_hs[i];
+		r1 = ns ? model->pack.r_hs1_y : model->pack.r_hs1_x;
+	}
+	return 2.0*model->border[i][d] / ((1.0/gq)+r1*g_edge[e]/gq);
+}
+
+/* 
+ * conductance between the peripheral node e and the next one
+ * outwards - spreader to center sink and center sink to outer sink
+ */
+static double block_g_out(block_model_t *model, int e)
+{
+	int ns = (e % 4 == SP_N || e % 4 == SP_S);
+
+	if (e < SINK_C_W)
+		return 2.0/(ns ? model->pack.r_sp_per_y : model->pack.r_sp_per_x);
+	return 2.0/(model->pack.r_hs + (ns ? model->pack.r_hs2_y : model->pack.r_hs2_x));
+}
+
+/* 
+ * adds the element of B between the nodes joined by the conductances 
+ * 'g1' and 'g2' (one from each side) to a row. returns the new count
+ */
+static int block_R_add(int *col, double *val, int cnt, int node, double g1, double g2)
+{
+	if ((g1 == 0.0) || (g2 == 0.0))
+		return cnt;
+	col[cnt] = node;
+	/* here is why the 2.0 factor comes when calculating the g's	*/
+	val[cnt] = -1.0/((1.0/g1)+(1.0/g2));
+	return cnt + 1;
+}
+
+/* 
+ * row 'node' of B with the columns in increasing order. returns 
+ * the no. of elements. the diagonal is summed in that same order, 
+ * so the row is exactly the one populate_dense_R_block makes
+ */
+static int block_R_row(block_model_t *model, flp_t *flp, flp_adj_t *adj, 
+					   double *g_edge, int node, int *col, double *val)
+{
+	int n = flp->n_units, cnt = 0, diag = -1;
+	int i, j, k, l, e;
+
+	/* functional blocks	*/
+	if (node < NL*n) {
+		l = node / n;
+		i = node % n;
+		if (l > 0) {
+			double g = block_g_vert(model, flp, l-1, i);
+			cnt = block_R_add(col, val, cnt, (l-1)*n+i, g, g);
+		}
+		/* the lower neighbours come first, then the higher ones	*/
+		for (k = adj->start[i]; k < adj->start[i+1]; k++) {
+			j = adj->idx[k];
+			if (j > i && diag < 0)
+				diag = cnt++;
+			cnt = block_R_add(col, val, cnt, l*n+j, 
+							  block_g_lat(model, flp, l, i, adj->horiz[k], adj->len[k]),
+							  block_g_lat(model, flp, l, j, adj->horiz[k], adj->len[k]));
+		}
+		if (diag < 0)
+			diag = cnt++;
+		if (l < NL-1) {
+			double g = block_g_vert(model, flp, l, i);
+			cnt = block_R_add(col, val, cnt, (l+1)*n+i, g, g);
+		}
+		if (l == HSP || l == HSINK)
+			for (e = (l == HSP ? SP_W : SINK_C_W); e <= (l == HSP ? SP_S : SINK_C_S); e++) {
+				double g = block_g_per(model, i, e, g_edge);
+				cnt = block_R_add(col, val, cnt, NL*n+e, g, g);
+			}
+		val[diag] = (l == HSINK) ? model->g_amb[i] : 0.0;
+	/* peripheral nodes	*/
+	} else {
+		e = node - NL*n;
+		if (e < SINK_W)
+			for (i = 0; i < n; i++) {
+				double g = block_g_per(model, i, e, g_edge);
+				cnt = block_R_add(col, val, cnt, (e < SINK_C_W ? HSP : HSINK)*n+i, g, g);
+			}
+		if (e >= SINK_C_W) {
+			double g = block_g_out(model, e-4);
+			cnt = block_R_add(col, val, cnt, node-4, g, g);
+		}
+		diag = cnt++;
+		if (e < SINK_W) {
+			double g = block_g_out(model, e);
+			cnt = block_R_add(col, val, cnt, node+4, g, g);
+		}
+		val[diag] = (e >= SINK_C_W) ? model->g_amb[n+e] : 0.0;
+	}
+
+	/* sum up the conductances	*/
+	col[diag] = node;
+	for (k = 0; k < cnt; k++)
+		if (k != diag)
+			val[diag] -= val[k];
+	return cnt;
+}
+
+/* 
+ * B in CSR form, straight from the adjacency lists. only adjacent 
+ * blocks are connected, so there are O(n) elements to find
+ */
+static sparse_matrix_t *assemble_R_block(block_model_t *model, flp_t *flp, 
+										 flp_adj_t *adj, double *g_edge)
+{
+	int node, k, cnt;
+	int n_nodes = NL * flp->n_units + EXTRA;
+	/* a peripheral node can be connected to every block	*/
+	int max_row = flp->n_units + EXTRA;
+	int *col = ivector(max_row);
+	double *val = dvector(max_row);
+	sparse_matrix_t *s = (sparse_matrix_t *) calloc (1, sizeof(sparse_matrix_t));
+	if (!s)
+		fatal("memory allocation error\n");
+
+	/* count the elements first	*/
+	s->n = n_nodes;
+	s->nnz = 0;
+	for(node=0; node < n_nodes; node++)
+		s->nnz += block_R_row(model, flp, adj, g_edge, node, col, val);
+
+	s->row_start = ivector(n_nodes+1);
+	s->col = ivector(s->nnz);
+	s->val = dvector(s->nnz);
+	s->row_start[0] = 0;
+	for(node=0; node < n_nodes; node++) {
+		cnt = block_R_row(model, flp, adj, g_edge, node, col, val);
+		for(k=0; k < cnt; k++) {
+			s->col[s->row_start[node] + k] = col[k];
+			s->val[s->row_start[node] + k] = val[k];
+		}
+		s->row_start[node+1] = s->row_start[node] + cnt;
+	}
+
+	free_ivector(col);
+	free_dvector(val);
+	return s;
+}
+
+/* 
+ * B as a dense matrix, for the LUP decomposition. the g's are 
+ * filled in for all pairs of nodes and then combined
+ */
+static void populate_dense_R_block(block_model_t *model, flp_t *flp, 
+								   flp_adj_t *adj, double *g_edge)
+{
+	/*	shortcuts	*/
+	double **b = model->b;
+	double *g_amb = model->g_amb;
+	double **len = model->len, **g = model->g;
+	int i, j, k, l, e, n = flp->n_units;
+
+	/* shared lengths between blocks - zero unless adjacent	*/
+	zero_dmatrix(len, n, n);
+	for (i = 0; i < n; i++) 
+		for (k = adj->start[i]; k < adj->start[i+1]; k++) 
+			len[i][adj->idx[k]] = adj->len[k];
+
+	/* initialize g	*/
+	zero_dmatrix(g, NL*n+EXTRA, NL*n+EXTRA);
+
+	/* overall Rs between nodes */
+	for (i = 0; i < n; i++) {
+		/* amongst functional units	in the various layers	*/
+		for (k = adj->start[i]; k < adj->start[i+1]; k++) {
+			j = adj->idx[k];
+			for (l = 0; l < NL; l++)
+				g[l*n+i][l*n+j] = block_g_lat(model, flp, l, i, adj->horiz[k], len[i][j]);
+		}
+		/* vertical g's from each layer to the next	*/
+		for (l = 0; l < NL-1; l++)
+			g[l*n+i][(l+1)*n+i]=g[(l+1)*n+i][l*n+i]=block_g_vert(model, flp, l, i);
+		/* 
+		 * lateral g's from block center (spreader and heatsink layers) 
+		 * to peripheral (n,s,e,w) spreader and heatsink nodes
+		 */
+		for (e = SP_W; e <= SP_S; e++)
+			g[HSP*n+i][NL*n+e]=g[NL*n+e][HSP*n+i]=block_g_per(model, i, e, g_edge);
+		for (e = SINK_C_W; e <= SINK_C_S; e++)
+			g[HSINK*n+i][NL*n+e]=g[NL*n+e][HSINK*n+i]=block_g_per(model, i, e, g_edge);
+	}
+
+	/* g's from peripheral(n,s,e,w) nodes	*/
+	/* 
+	 * vertical g's between peripheral spreader nodes and center peripheral heatsink 
+	 * nodes, and lateral g's between those and the peripheral outer sink nodes
+	 */
+	for (e = SP_W; e <= SINK_C_S; e++)
+		g[NL*n+e][NL*n+e+4]=g[NL*n+e+4][NL*n+e]=block_g_out(model, e);
+
+	/* calculate matrix B such that BT = POWER in steady state */
+	/* non-diagonal elements	*/
+	for (i = 0; i < NL*n+EXTRA; i++)
+		for (j = 0; j < i; j++)
+			if ((g[i][j] == 0.0) || (g[j][i] == 0.0))
+				b[i][j] = b[j][i] = 0.0;
+			else
+				/* here is why the 2.0 factor comes when calculating g[][]	*/
+				b[i][j] = b[j][i] = -1.0/((1.0/g[i][j])+(1.0/g[j][i]));
+	/* diagonal elements	*/			
+	for (i = 0; i < NL*n+EXTRA; i++) {
+		/* functional blocks in the heat sink layer	*/
+		if (i >= HSINK*n && i < NL*n) 
+			b[i][i] = g_amb[i%n];
+		/* heat sink peripheral nodes	*/
+		else if (i >= NL*n+SINK_C_W)
+			b[i][i] = g_amb[n+i-NL*n];
+		/* all other nodes that are not connected to the ambient	*/	
+		else
+			b[i][i] = 0.0;
+		/* sum up the conductances	*/	
+		for(j=0; j < NL*n+EXTRA; j++)
+			if (i != j)
+				b[i][i] -= b[i][j];
+	}
+}
+
 /* creates matrices  B and invB: BT = Power in the steady state. 
  * NOTE: EXTRA nodes: 4 heat spreader peripheral nodes, 4 heat 
  * sink inner peripheral nodes, 4 heat sink outer peripheral 
@@ -58,13 +348,12 @@ block_model_t *alloc_block_model(thermal_config_t *config, flp_t *placeholder)
 void populate_R_model_block(block_model_t *model, flp_t *flp)
 {
 	/*	shortcuts	*/
-	double **b = model->b;
 	double *gx = model->gx, *gy = model->gy;
 	double *gx_int = model->gx_int, *gy_int = model->gy_int;
 	double *gx_sp = model->gx_sp, *gy_sp = model->gy_sp;
 	double *gx_hs = model->gx_hs, *gy_hs = model->gy_hs;
 	double *g_amb = model->g_amb;
-	double **len = model->len, **g = model->g, **lu = model->lu;
+	double **lu = model->lu;
 	int **border = model->border;
 	int *p = model->p;
 	double t_chip = model->config.t_chip;
@@ -75,9 +364,10 @@ void populate_R_model_block(block_model_t *model, flp_t *flp)
 	double t_spreader = model->config.t_spreader;
 	double t_interface = model->config.t_interface;
 
-	int i, j, n = flp->n_units;
-	double gn_sp=0, gs_sp=0, ge_sp=0, gw_sp=0;
-	double gn_hs=0, gs_hs=0, ge_hs=0, gw_hs=0;
+	int i, n = flp->n_units;
+	flp_adj_t *adj;
+	/* lateral conductances of the blocks on each edge of the chip	*/
+	double g_edge[SINK_C_S+1] = {0};
 	double r_amb;
 
 	double w_chip = get_total_width (flp);	/* x-axis	*/
@@ -118,10 +408,8 @@ void populate_R_model_block(block_model_t *model, flp_t *flp)
 		gy_hs[i] = 1.0/getr(K_CU, flp->units[i].height / 2.0, flp->units[i].width * t_sink);
 	}
 
-	/* shared lengths between blocks	*/
-	for (i = 0; i < n; i++) 
-		for (j = i; j < n; j++) 
-			len[i][j] = len[j][i] = get_shared_len(flp, i, j);
+	/* blocks that share an edge - the only ones connected laterally	*/
+	adj = get_flp_adj(flp);
 
 	/* package R's	*/
 	populate_package_R(&model->pack, &model->config, w_chip, l_chip);
@@ -129,107 +417,42 @@ void populate_R_model_block(block_model_t *model, flp_t *flp)
 	/* short the R's from block centers to a particular chip edge	*/
 	for (i = 0; i < n; i++) {
 		if (eq(flp->units[i].bottomy + flp->units[i].height, l_chip)) {
-			gn_sp += gy_sp[i];
-			gn_hs += gy_hs[i];
+			g_edge[SP_N] += gy_sp[i];
+			g_edge[SINK_C_N] += gy_hs[i];
 			border[i][2] = 1;	/* block is on northern border 	*/
 		} else
 			border[i][2] = 0;
 
 		if (eq(flp->units[i].bottomy, 0)) {
-			gs_sp += gy_sp[i];
-			gs_hs += gy_hs[i];
+			g_edge[SP_S] += gy_sp[i];
+			g_edge[SINK_C_S] += gy_hs[i];
 			border[i][3] = 1;	/* block is on southern border	*/
 		} else
 			border[i][3] = 0;
 
 		if (eq(flp->units[i].leftx + flp->units[i].width, w_chip)) {
-			ge_sp += gx_sp[i];
-			ge_hs += gx_hs[i];
+			g_edge[SP_E] += gx_sp[i];
+			g_edge[SINK_C_E] += gx_hs[i];
 			border[i][1] = 1;	/* block is on eastern border	*/
 		} else 
 			border[i][1] = 0;
 
 		if (eq(flp->units[i].leftx, 0)) {
-			gw_sp += gx_sp[i];
-			gw_hs += gx_hs[i];
+			g_edge[SP_W] += gx_sp[i];
+			g_edge[SINK_C_W] += gx_hs[i];
 			border[i][0] = 1;	/* block is on western border	*/
 		} else
 			border[i][0] = 0;
 	}
 
-	/* initialize g	*/
-	zero_dmatrix(g, NL*n+EXTRA, NL*n+EXTRA);
+	/* vertical g's to ambient	*/
 	zero_dvector(g_amb, n+EXTRA);
-
-	/* overall Rs between nodes */
 	for (i = 0; i < n; i++) {
 		double area = (flp->units[i].height * flp->units[i].width);
-		/* amongst functional units	in the various layers	*/
-		for (j = 0; j < n; j++) {
-			double part = 0, part_int = 0, part_sp = 0, part_hs = 0;
-			if (is_horiz_adj(flp, i, j)) {
-				part = gx[i] / flp->units[i].height;
-				part_int = gx_int[i] / flp->units[i].height;
-				part_sp = gx_sp[i] / flp->units[i].height;
-				part_hs = gx_hs[i] / flp->units[i].height;
-			}
-			else if (is_vert_adj(flp, i,j))  {
-				part = gy[i] / flp->units[i].width;
-				part_int = gy_int[i] / flp->units[i].width;
-				part_sp = gy_sp[i] / flp->units[i].width;
-				part_hs = gy_hs[i] / flp->units[i].width;
-			}
-			g[i][j] = part * len[i][j];
-			g[IFACE*n+i][IFACE*n+j] = part_int * len[i][j];
-			g[HSP*n+i][HSP*n+j] = part_sp * len[i][j];
-			g[HSINK*n+i][HSINK*n+j] = part_hs * len[i][j];
-		}
-		/* the 2.0 factor in the following equations is 
-		 * explained during the calculation of the B matrix
-		 */
- 		/* vertical g's in the silicon layer	*/
-		g[i][IFACE*n+i]=g[IFACE*n+i][i]=2.0/getr(K_SI, t_chip, area);
- 		/* vertical g's in the interface layer	*/
-		g[IFACE*n+i][HSP*n+i]=g[HSP*n+i][IFACE*n+i]=2.0/getr(K_INT, t_interface, area);
-		/* vertical g's in the spreader layer	*/
-		g[HSP*n+i][HSINK*n+i]=g[HSINK*n+i][HSP*n+i]=2.0/getr(K_CU, t_spreader, area);
-		/* vertical g's in the heatsink core layer	*/
 		/* vertical R to ambient: divide r_convec proportional to area	*/
 		r_amb = r_convec * (s_sink * s_sink) / area;
 		g_amb[i] = 1.0 / (getr(K_CU, t_sink, area) + r_amb);
-
-		/* lateral g's from block center (spreader layer) to peripheral (n,s,e,w) spreader nodes	*/
-		g[HSP*n+i][NL*n+SP_N]=g[NL*n+SP_N][HSP*n+i]=2.0*border[i][2] /
-							  ((1.0/gy_sp[i])+model->pack.r_sp1_y*gn_sp/gy_sp[i]);
-		g[HSP*n+i][NL*n+SP_S]=g[NL*n+SP_S][HSP*n+i]=2.0*border[i][3] /
-							  ((1.0/gy_sp[i])+model->pack.r_sp1_y*gs_sp/gy_sp[i]);
-		g[HSP*n+i][NL*n+SP_E]=g[NL*n+SP_E][HSP*n+i]=2.0*border[i][1] /
-							  ((1.0/gx_sp[i])+model->pack.r_sp1_x*ge_sp/gx_sp[i]);
-		g[HSP*n+i][NL*n+SP_W]=g[NL*n+SP_W][HSP*n+i]=2.0*border[i][0] /
-							  ((1.0/gx_sp[i])+model->pack.r_sp1_x*gw_sp/gx_sp[i]);
-		
-		/* lateral g's from block center (heatsink layer) to peripheral (n,s,e,w) heatsink nodes	*/
-		g[HSINK*n+i][NL*n+SINK_C_N]=g[NL*n+SINK_C_N][HSINK*n+i]=2.0*border[i][2] /
-									((1.0/gy_hs[i])+model->pack.r_hs1_y*gn_hs/gy_hs[i]);
-		g[HSINK*n+i][NL*n+SINK_C_S]=g[NL*n+SINK_C_S][HSINK*n+i]=2.0*border[i][3] /
-									((1.0/gy_hs[i])+model->pack.r_hs1_y*gs_hs/gy_hs[i]);
-		g[HSINK*n+i][NL*n+SINK_C_E]=g[NL*n+SINK_C_E][HSINK*n+i]=2.0*border[i][1] /
-									((1.0/gx_hs[i])+model->pack.r_hs1_x*ge_hs/gx_hs[i]);
-		g[HSINK*n+i][NL*n+SINK_C_W]=g[NL*n+SINK_C_W][HSINK*n+i]=2.0*border[i][0] /
-									((1.0/gx_hs[i])+model->pack.r_hs1_x*gw_hs/gx_hs[i]);
 	}
-
-	/* g's from peripheral(n,s,e,w) nodes	*/
-	/* vertical g's between peripheral spreader nodes and center peripheral heatsink nodes */
-	g[NL*n+SP_N][NL*n+SINK_C_N]=g[NL*n+SINK_C_N][NL*n+SP_N]=2.0/model->pack.r_sp_per_y;
-	g[NL*n+SP_S][NL*n+SINK_C_S]=g[NL*n+SINK_C_S][NL*n+SP_S]=2.0/model->pack.r_sp_per_y;
-	g[NL*n+SP_E][NL*n+SINK_C_E]=g[NL*n+SINK_C_E][NL*n+SP_E]=2.0/model->pack.r_sp_per_x;
-	g[NL*n+SP_W][NL*n+SINK_C_W]=g[NL*n+SINK_C_W][NL*n+SP_W]=2.0/model->pack.r_sp_per_x;
-	/* lateral g's between peripheral outer sink nodes and center peripheral sink nodes	*/
-	g[NL*n+SINK_C_N][NL*n+SINK_N]=g[NL*n+SINK_N][NL*n+SINK_C_N]=2.0/(model->pack.r_hs + model->pack.r_hs2_y);
-	g[NL*n+SINK_C_S][NL*n+SINK_S]=g[NL*n+SINK_S][NL*n+SINK_C_S]=2.0/(model->pack.r_hs + model->pack.r_hs2_y);
-	g[NL*n+SINK_C_E][NL*n+SINK_E]=g[NL*n+SINK_E][NL*n+SINK_C_E]=2.0/(model->pack.r_hs + model->pack.r_hs2_x);
-	g[NL*n+SINK_C_W][NL*n+SINK_W]=g[NL*n+SINK_W][NL*n+SINK_C_W]=2.0/(model->pack.r_hs + model->pack.r_hs2_x);
 	/* vertical g's between inner peripheral sink nodes and ambient	*/
 	g_amb[n+SINK_C_N] = g_amb[n+SINK_C_S] = 1.0 / (model->pack.r_hs_c_per_y+model->pack.r_amb_c_per_y);
 	g_amb[n+SINK_C_E] = g_amb[n+SINK_C_W] = 1.0 / (model->pack.r_hs_c_per_x+model->pack.r_amb_c_per_x);
@@ -237,34 +460,6 @@ void populate_R_model_block(block_model_t *model, flp_t *flp)
 	g_amb[n+SINK_N] = g_amb[n+SINK_S] = g_amb[n+SINK_E] =
 					  g_amb[n+SINK_W] = 1.0 / (model->pack.r_hs_per+model->pack.r_amb_per);
 
-	/* calculate matrix B such that BT = POWER in steady state */
-	/* non-diagonal elements	*/
-	for (i = 0; i < NL*n+EXTRA; i++)
-		for (j = 0; j < i; j++)
-			if ((g[i][j] == 0.0) || (g[j][i] == 0.0))
-				b[i][j] = b[j][i] = 0.0;
-			else
-				/* here is why the 2.0 factor comes when calculating g[][]	*/
-				b[i][j] = b[j][i] = -1.0/((1.0/g[i][j])+(1.0/g[j][i]));
-	/* diagonal elements	*/			
-	for (i = 0; i < NL*n+EXTRA; i++) {
-		/* functional blocks in the heat sink layer	*/
-		if (i >= HSINK*n && i < NL*n) 
-			b[i][i] = g_amb[i%n];
-		/* heat sink peripheral nodes	*/
-		else if (i >= NL*n+SINK_C_W)
-			b[i][i] = g_amb[n+i-NL*n];
-		/* all other nodes that are not connected to the ambient	*/	
-		else
-			b[i][i] = 0.0;
-		/* sum up the conductances	*/	
-		for(j=0; j < NL*n+EXTRA; j++)
-			if (i != j)
-				b[i][i] -= b[i][j];
-	}
-
-	/* compute the LUP decomposition of B and store it too	*/
-	copy_dmatrix(lu, b, NL*n+EXTRA, NL*n+EXTRA);
 	/* 
 	 * B is a symmetric positive definite matrix. It is
 	 * symmetric because if a node A is connected to B, 
@@ -277,7 +472,25 @@ void populate_R_model_block(block_model_t *model, flp_t *flp)
 	 * = total power dissipated in the resistors > 0 
 	 * for x != 0. 
 	 */
-	lupdcmp(lu, NL*n+EXTRA, p, 1);
+	free_sparse_model_block(model);
+	free_trans_model_block(model);
+	if (!strcasecmp(model->config.block_solver, BLOCK_SOLVER_LU_STR)) {
+		/* compute the LUP decomposition of B and store it too	*/
+		populate_dense_R_block(model, flp, adj, g_edge);
+		copy_dmatrix(lu, model->b, NL*n+EXTRA, NL*n+EXTRA);
+		lupdcmp(lu, NL*n+EXTRA, p, 1);
+	} else {
+		/* 
+		 * only adjacent blocks are connected. so, B is mostly 
+		 * zeros and the sparse solvers avoid the O(n^3) LUP 
+		 * decomposition. the peripheral nodes, which are
+		 * connected to all the blocks on an edge, go last.
+		 * the dense B is neither filled in nor used
+		 */
+		model->b_sparse = assemble_R_block(model, flp, adj, g_edge);
+		if (!strcasecmp(model->config.block_solver, BLOCK_SOLVER_CHOLESKY_STR))
+			model->chol = sparse_chol_dcmp(model->b_sparse, NL*n);
+	}
 
 	/* done	*/
 	model->flp = flp;
@@ -317,6 +530,8 @@ void populate_C_model_block(block_model_t *model, flp_t *flp)
 
 	/* package C's	*/
 	populate_package_C(&model->pack, &model->config, w_chip, l_chip);
+	/* the implicit transient solvers' factor depends on the C's	*/
+	free_trans_model_block(model);
 	
 	/* functional block C's */
 	for (i = 0; i < n; i++) {
@@ -356,8 +571,12 @@ void populate_C_model_block(block_model_t *model, flp_t *flp)
 	for (i = 0; i < NL*n+EXTRA; i++)
 		inva[i] = 1.0/a[i];
 
-	/* we are always going to use the eqn dT + A^-1 * B T = A^-1 * POWER. so, store  C = A^-1 * B	*/
-	diagmatmult(c, inva, b, NL*n+EXTRA);
+	/* 
+	 * we are always going to use the eqn dT + A^-1 * B T = A^-1 * POWER. so, store  C = A^-1 * B.
+	 * the sparse solvers have no dense B, and their rk4 slope finds the elements of C as it goes
+	 */
+	if (!model->b_sparse)
+		diagmatmult(c, inva, b, NL*n+EXTRA);
 
 	/*	done	*/
 	model->c_ready = TRUE;
@@ -373,6 +592,26 @@ void set_internal_power_block(block_model_t *model, double *power)
 		power[HSINK*model->n_units+i] = model->config.ambient * model->g_amb[i];
 }
 
+/* 
+ * start 'temp' from the last pcg solution. the floorplan may have 
+ * lost or gained dead blocks since, but those always come after the 
+ * functional blocks. so, the nodes of each layer are matched by block
+ * index and the blocks that were not there start from the ambient
+ */
+void warm_start_block(block_model_t *model, double *temp)
+{
+	int i, l, n = model->n_units, m = model->n_warm;
+
+	set_temp_block(model, temp, model->config.ambient);
+	if (!m)
+		return;
+	for (l = 0; l < NL; l++)
+		for (i = 0; i < n && i < m; i++)
+			temp[l*n+i] = model->t_warm[l*m+i];
+	for (i = 0; i < EXTRA; i++)
+		temp[NL*n+i] = model->t_warm[NL*m+i];
+}
+
 /* power and temp should both be alloced using hotspot_vector. 
  * 'b' is the 'thermal conductance' matrix. i.e, b * temp = power
  *  => temp = invb * power. instead of computing invb, we have
@@ -392,7 +631,52 @@ void steady_state_temp_block(block_model_t *model, double *power, double *temp)
 	 * find temperatures (spd flag is set to 1 by the same argument
 	 * as mentioned in the populate_R_model_block function)
 	 */
-	lusolve(model->lu, model->n_nodes, model->p, power, temp, 1);
+	if (model->chol)
+		sparse_chol_solve(model->chol, power, temp);
+	else if (model->b_sparse) {
+		/* 
+		 * successive solves (of moves in the floorplanner, or of 
+		 * operating scenarios) are close to each other. so, start
+		 * from the previous solution rather than the ambient
+		 */
+		warm_start_block(model, temp);
+		if (pcgsolve(model->b_sparse, NULL, power, temp, BLOCK_PCG_TOL, 
+					 BLOCK_PCG_ITER * model->n_nodes, NULL, model->pcg_work) < 0)
+			warning("pcg steady state solver did not converge\n");
+		copy_dvector(model->t_warm, temp, model->n_nodes);
+		model->n_warm = model->n_units;
+	} else
+		lusolve(model->lu, model->n_nodes, model->p, power, temp, 1);
+}
+
+/* 
+ * steady state temperatures for 'n' power vectors. the direct 
+ * solvers go through the factor once for a block of them
+ */
+void steady_state_temp_block_batch(block_model_t *model, double **power, double **temp, int n)
+{
+	int i;
+
+	if (!model->r_ready)
+		fatal("R model not ready\n");
+
+	for (i = 0; i < n; i++)
+		set_internal_power_block(model, power[i]);
+
+	if (model->chol)
+		sparse_chol_solve_batch(model->chol, power, temp, n);
+	else if (model->b_sparse)
+		/* 
+		 * each pcg solution takes its own iterations. the vectors of
+		 * a batch are unrelated and may come in any order, so each 
+		 * starts from the ambient, to give the same answer every time
+		 */
+		for (i = 0; i < n; i++) {
+			model->n_warm = 0;
+			steady_state_temp_block(model, power[i], temp[i]);
+		}
+	else
+		lusolve_batch(model->lu, model->n_nodes, model->p, power, temp, n, 1);
 }
 
 /* compute the slope vector dy for the transient equation 
@@ -405,6 +689,18 @@ void slope_fn_block(block_model_t *model, double *y, double *p, double *dy)
 	double **c = model->c;
 
 	/* for our equation, dy = p - cy */
+	if (model->b_sparse) {
+		/* c = inva * b, an element at a time	*/
+		sparse_matrix_t *b = model->b_sparse;
+		int i, k;
+		for (i = 0; i < n; i++) {
+			double t = 0;
+			for (k = b->row_start[i]; k < b->row_start[i+1]; k++)
+				t += (model->inva[i] * b->val[k]) * y[b->col[k]];
+			dy[i] = p[i] - t;
+		}
+		return;
+	}
 	#if (MATHACCEL == MA_INTEL || MATHACCEL == MA_APPLE)
 	/* dy = p	*/
 	cblas_dcopy(n, p, 1, dy, 1);
@@ -431,6 +727,53 @@ void slope_fn_block(block_model_t *model, double *y, double *p, double *dy)
  * last interval (time_elapsed), find the new temperature at time t+time_elapsed.
  * power and temp should both be alloced using hotspot_vector
  */
+/* 
+ * implicit transient solution with equal steps of size h. backward 
+ * euler solves (A/h + B) T(t+h) = (A/h) T(t) + POWER at each step.
+ * crank-nicolson's matrix A/h + B/2 is twice the backward euler
+ * one for h/2. so, it takes a backward euler half step T' and 
+ * extrapolates, T(t+h) = 2T' - T(t). either way, the matrix is 
+ * factorized once and reused for as long as h stays the same
+ */
+void implicit_temp_block(block_model_t *model, double *power, double *temp, double time_elapsed)
+{
+	int i, k, n_steps, n = model->n_nodes;
+	int cn = !strcasecmp(model->config.trans_solver, TRANS_SOLVER_CN_STR);
+	double h;
+
+	n_steps = implicit_steps(time_elapsed, model->config.trans_step);
+	/* step of the backward euler solve	*/
+	h = time_elapsed / n_steps;
+	if (cn)
+		h /= 2.0;
+
+	if (model->trans_h != h) {
+		sparse_matrix_t *m;
+		free_trans_model_block(model);
+		m = model->b_sparse ? copy_sparse_matrix(model->b_sparse) : dmatrix_to_sparse(model->b, n);
+		for (i = 0; i < n; i++)
+			for (k = m->row_start[i]; k < m->row_start[i+1]; k++)
+				if (m->col[k] == i)
+					m->val[k] += model->a[i] / h;
+		/* as with b, the peripheral nodes go last	*/
+		model->trans_chol = sparse_chol_dcmp(m, NL * model->n_units);
+		model->trans_h = h;
+		free_sparse_matrix(m);
+	}
+
+	for (k = 0; k < n_steps; k++) {
+		for (i = 0; i < n; i++)
+			model->t_vector[i] = model->a[i] / h * temp[i] + power[i];
+		if (cn) {
+			/* t_vector is free once the solve has read it	*/
+			sparse_chol_solve(model->trans_chol, model->t_vector, model->t_vector);
+			for (i = 0; i < n; i++)
+				temp[i] = 2.0 * model->t_vector[i] - temp[i];
+		} else
+			sparse_chol_solve(model->trans_chol, model->t_vector, temp);
+	}
+}
+
 void compute_temp_block(block_model_t *model, double *power, double *temp, double time_elapsed)
 {
 	double t, h, new_h;
@@ -447,6 +790,11 @@ void compute_temp_block(block_model_t *model, double *power, double *temp, doubl
 	/* set power numbers for the virtual nodes */
 	set_internal_power_block(model, power);
 
+	if (strcasecmp(model->config.trans_solver, TRANS_SOLVER_RK4_STR)) {
+		implicit_temp_block(model, power, temp, time_elapsed);
+		return;
+	}
+
 	/* use the scratch pad vector to find (inv_A)*POWER */
 	diagmatvectmult(model->t_vector, model->inva, power, model->n_nodes);
 
@@ -459,7 +807,7 @@ void compute_temp_block(block_model_t *model, double *power, double *temp, doubl
 		h = new_h;
 		new_h = rk4(model, temp, model->t_vector, model->n_nodes, h, 
 		/* the slope function callback is typecast accordingly */
-					temp, (slope_fn_ptr) slope_fn_block);
+					temp, (slope_fn_ptr) slope_fn_block, NULL);
 		#if VERBOSE > 1
 		i++;
 		#endif
@@ -468,7 +816,7 @@ void compute_temp_block(block_model_t *model, double *power, double *temp, doubl
 	if (time_elapsed > t)
 		rk4(model, temp, model->t_vector, model->n_nodes, time_elapsed - t, 
 		/* the slope function callback is typecast accordingly */
-			temp, (slope_fn_ptr) slope_fn_block);
+			temp, (slope_fn_ptr) slope_fn_block, NULL);
 
 	#if VERBOSE > 1
 	fprintf(stdout, "no. of rk4 calls during compute_temp: %d\n", i+1);
@@ -798,6 +1146,8 @@ void delete_block_model(block_model_t *model)
 	free_dvector(model->gy_hs);
 	free_dvector(model->g_amb);
 	free_dvector(model->t_vector);
+	free_dvector(model->t_warm);
+	free_dvector(model->pcg_work);
 	free_ivector(model->p);
 
 	free_dmatrix(model->len);
@@ -806,6 +1156,9 @@ void delete_block_model(block_model_t *model)
 
 	free_imatrix(model->border);
 
+	free_sparse_model_block(model);
+	free_trans_model_block(model);
+
 	free(model);
 }
 
@@ -821,13 +1174,18 @@ void debug_print_block(block_model_t *model)
 	debug_print_package_RC(&model->pack);
 
 	fprintf(stdout, "printing matrix b:\n");
-	dump_dmatrix(model->b, model->n_nodes, model->n_nodes);
+	if (model->b_sparse)
+		dump_sparse_matrix(model->b_sparse);
+	else
+		dump_dmatrix(model->b, model->n_nodes, model->n_nodes);
 	fprintf(stdout, "printing vector a:\n");
 	dump_dvector(model->a, model->n_nodes);
 	fprintf(stdout, "printing vector inva:\n");
 	dump_dvector(model->inva, model->n_nodes);
-	fprintf(stdout, "printing matrix c:\n");
-	dump_dmatrix(model->c, model->n_nodes, model->n_nodes);
+	if (!model->b_sparse) {
+		fprintf(stdout, "printing matrix c:\n");
+		dump_dmatrix(model->c, model->n_nodes, model->n_nodes);
+	}
 	fprintf(stdout, "printing vector g_amb:\n");
 	dump_dvector(model->g_amb, model->n_units+EXTRA);
 }
@@ -16,6 +16,14 @@
 /* heat sink */
 #define HSINK 3
 
+/* 
+ * the pcg steady state solver stops when the residual 
+ * is this small relative to the power vector, or after 
+ * this many iterations per node
+ */
+#define BLOCK_PCG_TOL		1e-12
+#define BLOCK_PCG_ITER		10
+
 /* block thermal model	*/
 typedef struct block_model_t_st
 {
@@ -26,7 +34,7 @@ typedef struct block_model_t_st
 	thermal_config_t config;
 
 	/* main matrices	*/
-	/* conductance matrix */
+	/* conductance matrix - only filled in for the lu solver	*/
 	double **b;
 	/* LUP decomposition of b	*/
 	double **lu; 
@@ -35,8 +43,25 @@ typedef struct block_model_t_st
 	double *a; 
 	/* inverse of the above	*/
 	double *inva;
-	/* c = inva * b	*/
+	/* c = inva * b - also only for the lu solver	*/
 	double **c;
+	/* b in CSR form and its cholesky factor - for the sparse solvers	*/
+	sparse_matrix_t *b_sparse;
+	sparse_chol_t *chol;
+	/* 
+	 * last pcg solution and the no. of blocks it was found 
+	 * for (0 if none). the next pcg solve starts from it
+	 */
+	double *t_warm;
+	int n_warm;
+	/* scratch pad of the pcg solves	*/
+	double *pcg_work;
+	/* 
+	 * for the implicit transient solvers - the cholesky factor 
+	 * of a/h + b and the h it was found for (0 if none)
+	 */
+	sparse_chol_t *trans_chol;
+	double trans_h;
 
 	/* package parameters	*/
 	package_RC_t pack;
@@ -48,6 +73,7 @@ typedef struct block_model_t_st
 	double *gx_hs, *gy_hs;
 	double *g_amb;
 	double *t_vector;
+	/* for the dense b	*/
 	double **len, **g;
 	int **border;
 
@@ -70,11 +96,17 @@ void delete_block_model(block_model_t *model);
 
 /* initialization	*/
 void populate_R_model_block(block_model_t *model, flp_t *flp);
+void free_sparse_model_block(block_model_t *model);
+void free_trans_model_block(block_model_t *model);
 void populate_C_model_block(block_model_t *model, flp_t *flp);
 
 /* hotspot main interfaces - temperature.c	*/
 void steady_state_temp_block(block_model_t *model, double *power, double *temp);
+void warm_start_block(block_model_t *model, double *temp);
+void steady_state_temp_block_batch(block_model_t *model, double **power, double **temp, int n);
 void compute_temp_block(block_model_t *model, double *power, double *temp, double time_elapsed);
+/* backward euler / crank-nicolson part of the above	*/
+void implicit_temp_block(block_model_t *model, double *power, double *temp, double time_elapsed);
 /* differs from 'dvector()' in that memory for internal nodes is also allocated	*/
 double *hotspot_vector_block(block_model_t *model);
 /* copy 'src' to 'dst' except for a window of 'size'
@@ -7,102 +7,55 @@
 #include "flp.h"
 #include "util.h"
 
-/* constructors	*/
-blist_t *new_blist(int idx, double occupancy)
-{
-	blist_t *ptr = (blist_t *) calloc (1, sizeof(blist_t));
-	if (!ptr)
-		fatal("memory allocation error\n");
-	ptr->idx = idx;
-	ptr->occupancy = occupancy;
-	ptr->next = NULL;
-	return ptr;
-}
-
-blist_t ***new_b2gmap(int rows, int cols)
+/* constructor	*/
+b2gmap_t *new_b2gmap(int rows, int cols)
 {
-	int i;
-	blist_t ***b2gmap;
-
-	b2gmap = (blist_t ***) calloc (rows, sizeof(blist_t **));
-	b2gmap[0] = (blist_t **) calloc (rows * cols, sizeof(blist_t *));
-	if (!b2gmap || !b2gmap[0])
+	b2gmap_t *map = (b2gmap_t *) calloc (1, sizeof(b2gmap_t));
+	if (!map)
 		fatal("memory allocation error\n");
 
-	for(i=1; i < rows; i++) 
-		b2gmap[i] = b2gmap[0] + cols * i;
-
-	return b2gmap;	
+	map->n_cells = rows * cols;
+	map->start = ivector(rows * cols + 1);
+	/* every cell has at least one block	*/
+	map->size = rows * cols;
+	map->idx = ivector(map->size);
+	map->occupancy = dvector(map->size);
+	return map;
 }
 
 /* destructor	*/
-void delete_b2gmap(blist_t ***b2gmap, int rows, int cols)
+void delete_b2gmap(b2gmap_t *map)
 {
-	int i, j;
-	blist_t *ptr, *temp;
-
-	/* free the linked list	*/
-	for(i=0; i < rows; i++)
-		for(j=0; j < cols; j++) {
-			ptr = b2gmap[i][j];
-			while(ptr) {
-				temp = ptr->next;
-				free(ptr);
-				ptr = temp;
-			}
-		}
-
-	/* free the array space	*/
-	free(b2gmap[0]);
-	free(b2gmap);
-}
-
-/* re-initialize */
-void reset_b2gmap(grid_model_t *model, layer_t *layer)
-{
-	int i, j;
-	blist_t *ptr, *temp;
-
-	/* free the linked list	*/
-	for(i=0; i < model->rows; i++)
-		for(j=0; j < model->cols; j++) {
-			ptr = layer->b2gmap[i][j];
-			while(ptr) {
-				temp = ptr->next;
-				free(ptr);
-				ptr = temp;
-			}
-			layer->b2gmap[i][j] = NULL;
-		}
+	free_ivector(map->start);
+	free_ivector(map->idx);
+	free_dvector(map->occupancy);
+	free(map);
 }
 
-/* create a linked list node and append it at the end	*/
-void blist_append(blist_t *head, int idx, double occupancy)
+/* make room for 'size' entries. the old entries are not kept	*/
+void reserve_b2gmap(b2gmap_t *map, int size)
 {
-	blist_t *tail = NULL;
-	
-	if(!head)
-		fatal("blist_append called with empty list\n");
-
-	/* traverse till the end	*/
-	for(; head; head = head->next)
-		tail = head;
-
-	/* append */
-	tail->next =  new_blist(idx, occupancy);
+	if (size <= map->size)
+		return;
+	free_ivector(map->idx);
+	free_dvector(map->occupancy);
+	map->size = size;
+	map->idx = ivector(size);
+	map->occupancy = dvector(size);
 }
 
 /* compute the power/temperature average weighted by occupancies	*/
-double blist_avg(blist_t *ptr, flp_t *flp, double *v, int type)
+double b2gmap_avg(b2gmap_t *map, int cell, flp_t *flp, double *v, int type)
 {
+	int k;
 	double  val = 0.0;
 	
-	for(; ptr; ptr = ptr->next) {
+	for(k = map->start[cell]; k < map->start[cell+1]; k++) {
 		if (type == V_POWER)
-			val += ptr->occupancy * v[ptr->idx] / (flp->units[ptr->idx].width * 
-				   flp->units[ptr->idx].height);
+			val += map->occupancy[k] * v[map->idx[k]] / (flp->units[map->idx[k]].width * 
+				   flp->units[map->idx[k]].height);
 		else if (type == V_TEMP)		   
-			val += ptr->occupancy * v[ptr->idx];
+			val += map->occupancy[k] * v[map->idx[k]];
 		else
 			fatal("unknown vector type\n");
 	}		
@@ -110,26 +63,26 @@ double blist_avg(blist_t *ptr, flp_t *flp, double *v, int type)
 	return val;		   
 }
 
-void debug_print_blist(blist_t *head, flp_t *flp);
+void debug_print_b2gmap(b2gmap_t *map, int cell, flp_t *flp);
 /* test the block-grid map data structure	*/
 void test_b2gmap(grid_model_t *model, layer_t *layer)
 {
-	int i, j;
-	blist_t *ptr;
+	int i, j, k, cell;
 	double sum;
 
 	/* a correctly formed b2gmap should have the 
-	 * sum of occupancies in each linked list
-	 * to be equal to 1.0
+	 * sum of occupancies of each cell to be 
+	 * equal to 1.0
 	 */
 	for (i=0; i < model->rows; i++)
 		for(j=0; j < model->cols; j++) {
+			cell = i * model->cols + j;
 			sum = 0.0;
-			for(ptr = layer->b2gmap[i][j]; ptr; ptr = ptr->next)
-				sum += ptr->occupancy;
+			for(k = layer->b2gmap->start[cell]; k < layer->b2gmap->start[cell+1]; k++)
+				sum += layer->b2gmap->occupancy[k];
 			if (!eq(floor(sum*1e5 + 0.5)/1e5, 1.0)) {
 				fprintf(stdout, "i: %d\tj: %d\n", i, j);
-				debug_print_blist(layer->b2gmap[i][j], layer->flp);
+				debug_print_b2gmap(layer->b2gmap, cell, layer->flp);
 				fatal("erroneous b2gmap data structure. invalid floorplan?\n");
 			}	
 		}
@@ -139,16 +92,19 @@ void test_b2gmap(grid_model_t *model, layer_t *layer)
 void set_bgmap(grid_model_t *model, layer_t *layer)
 {
 	/* i1, i2, j1 and j2 are indices of the boundary grid cells	*/
-	int i, j, u, i1, i2, j1, j2;
+	int i, j, u, i1, i2, j1, j2, cell;
+	b2gmap_t *map = layer->b2gmap;
+	int *next;
 
 	/* shortcuts for cell width(cw) and cell height(ch)	*/
 	double cw = model->width / model->cols;
 	double ch = model->height / model->rows;
 
-	/* initialize	*/
-	reset_b2gmap(model, layer);
-
-	/* for each functional unit	*/
+	/* 
+	 * first pass - the extent of each functional unit in 
+	 * grid cells (g2bmap) and the no. of units in each cell
+	 */
+	zero_ivector(map->start, map->n_cells + 1);
 	for(u=0; u < layer->flp->n_units; u++) {
 		/* shortcuts for unit boundaries	*/
 		double lu = layer->flp->units[u].leftx;
@@ -178,23 +134,48 @@ void set_bgmap(grid_model_t *model, layer_t *layer)
 		layer->g2bmap[u].j1 = j1;
 		layer->g2bmap[u].j2 = j2;
 
-		/* setup b2gmap	*/
-		/* for each grid cell in this unit	*/
+		/* count this unit in each of its grid cells	*/
 		for(i=i1; i < i2; i++)
 			for(j=j1; j < j2; j++)
+				map->start[i * model->cols + j + 1]++;
+	}
+	for(cell=0; cell < map->n_cells; cell++)
+		map->start[cell+1] += map->start[cell];
+	reserve_b2gmap(map, map->start[map->n_cells]);
+
+	/* 
+	 * second pass - the occupancies. the units go into each 
+	 * cell in the order of the floorplan. next[cell] is the 
+	 * cell's next free entry
+	 */
+	next = ivector(map->n_cells);
+	copy_ivector(next, map->start, map->n_cells);
+	for(u=0; u < layer->flp->n_units; u++) {
+		/* shortcuts for unit boundaries	*/
+		double lu = layer->flp->units[u].leftx;
+		double ru = lu + layer->flp->units[u].width;
+		double bu = layer->flp->units[u].bottomy;
+		double tu = bu + layer->flp->units[u].height;
+
+		i1 = layer->g2bmap[u].i1;
+		i2 = layer->g2bmap[u].i2;
+		j1 = layer->g2bmap[u].j1;
+		j2 = layer->g2bmap[u].j2;
+
+		/* for each grid cell in this unit	*/
+		for(i=i1; i < i2; i++)
+			for(j=j1; j < j2; j++) {
+				cell = i * model->cols + j;
 				/* grid cells fully overlapped by this unit	*/
 				if ((i > i1) && (i < i2-1) && (j > j1) && (j < j2-1)) {
-					/* first unit in the list	*/
-					if (!layer->b2gmap[i][j])
-						layer->b2gmap[i][j] = new_blist(u, 1.0);
-					else {
 					/* this should not occur since the grid cell is 
 					 * fully covered and hence, no other unit should 
 					 * be sharing it
 					 */
-						blist_append(layer->b2gmap[i][j], u, 1.0);
+					if (next[cell] > map->start[cell])
 						warning("overlap of functional blocks?\n");
-					}
+					map->idx[next[cell]] = u;
+					map->occupancy[next[cell]++] = 1.0;
 				/* boundary grid cells partially overlapped by this unit	*/
 				} else {
 					/* shortcuts for cell boundaries	*/
@@ -222,14 +203,12 @@ void set_bgmap(grid_model_t *model, layer_t *layer)
 					if (oh < 0 || ow < 0)
 						fatal("negative overlap!\n");
 
-					/* first unit in the list	*/
-					if (!layer->b2gmap[i][j])
-						layer->b2gmap[i][j] = new_blist(u, occupancy);
-					else
-					/* append at the end	*/
-						blist_append(layer->b2gmap[i][j], u, occupancy);
+					map->idx[next[cell]] = u;
+					map->occupancy[next[cell]++] = occupancy;
 				}
+			}
 	}
+	free_ivector(next);
 
 	/* 
 	 * sanity check	
@@ -395,7 +374,7 @@ void parse_layer_file(grid_model_t *model, FILE *fp)
  */
 void populate_layers_grid(grid_model_t *model, flp_t *flp_default)
 {
-	char str[STR_SIZE];
+	char str[STR_SIZE+32];
 	FILE *fp = NULL;
 
 	/* lcf file specified	*/
@@ -405,7 +384,7 @@ void populate_layers_grid(grid_model_t *model, flp_t *flp_default)
 		else
 			fp = fopen (model->config.grid_layer_file, "r");
 		if (!fp) {
-			sprintf(str, "error opening file %s\n", model->config.grid_layer_file);
+			snprintf(str, sizeof(str), "error opening file %s\n", model->config.grid_layer_file);
 			fatal(str);
 		}
 	}
@@ -440,6 +419,24 @@ void populate_layers_grid(grid_model_t *model, flp_t *flp_default)
 		fclose(fp);
 }
 
+/* allocate the per call scratch space	*/
+void alloc_workspace_grid(grid_model_t *model)
+{
+	int n_nodes = model->n_layers * model->rows * model->cols + EXTRA;
+	size_t size = grid_model_vector_arena_size(model) + 
+				  2 * ARENA_ROUND(n_nodes * sizeof(double)) +
+				  ARENA_ROUND(MAX(PCG_WORK(n_nodes), RK4_WORK(n_nodes)) * sizeof(double)) +
+				  ARENA_ROUND(model->rows * model->cols * sizeof(double));
+
+	model->arena = new_arena(size);
+	model->w_power = arena_grid_model_vector(model, model->arena);
+	model->w_rhs = arena_dvector(model->arena, n_nodes);
+	model->w_half = arena_dvector(model->arena, n_nodes);
+	/* pcgsolve and rk4 never need their work vectors together	*/
+	model->w_work = arena_dvector(model->arena, MAX(PCG_WORK(n_nodes), RK4_WORK(n_nodes)));
+	model->w_sum = arena_dvector(model->arena, model->rows * model->cols);
+}
+
 /* constructor	*/ 
 grid_model_t *alloc_grid_model(thermal_config_t *config, flp_t *flp_default)
 {
@@ -482,10 +479,266 @@ grid_model_t *alloc_grid_model(thermal_config_t *config, flp_t *flp_default)
 	/* allocate internal state	*/
 	model->last_steady = new_grid_model_vector(model);
 	model->last_trans = new_grid_model_vector(model);
+	alloc_workspace_grid(model);
 
 	return model;
 }
 
+/* free the pcg solver's matrices	*/
+void free_sparse_R_grid(grid_model_t *model)
+{
+	if (model->r_sparse)
+		free_sparse_matrix(model->r_sparse);
+	if (model->r_ic)
+		free_sparse_matrix(model->r_ic);
+	if (model->g_amb)
+		free_dvector(model->g_amb);
+	model->r_sparse = NULL;
+	model->r_ic = NULL;
+	model->g_amb = NULL;
+}
+
+/* 
+ * row 'node' of the grid model's conductance matrix. the nodes are
+ * numbered as in a grid_model_vector_t - the grid cells by layer, 
+ * row and column, followed by the package nodes. the off-diagonal
+ * elements go into 'col' and 'val' followed by the diagonal, and 
+ * the conductance to the ambient into 'amb'. returns the no. of 
+ * elements. the conductances are those that single_iteration_steady_grid
+ * and single_iteration_steady_pack use
+ */
+int grid_R_row(grid_model_t *model, int node, int *col, double *val, double *amb)
+{
+	int n, i, j, k = 0;
+	double g, csum = 0;
+
+	/* shortcuts	*/
+	package_RC_t *pk = &model->pack;
+	layer_t *l = model->layers;
+	int nl = model->n_layers;
+	int nr = model->rows;
+	int nc = model->cols;
+	int ncells = nl * nr * nc;
+	int spidx = nl - DEFAULT_PACK_LAYERS + LAYER_SP;
+	int hsidx = nl - DEFAULT_PACK_LAYERS + LAYER_SINK;
+
+	/* conductance 'cond' to node 'to'	*/
+	# define EDGE(to, cond)	{ g = (cond); col[k] = (to); val[k++] = -g; csum += g; }
+
+	*amb = 0.0;
+	if (node < ncells) {
+		n = node / (nr * nc);
+		i = (node / nc) % nr;
+		j = node % nc;
+		/* cells above, north, west, east, south and below	*/
+		if (n > 0)
+			EDGE(node - nr*nc, 1.0/l[n-1].rz);
+		if (i > 0)
+			EDGE(node - nc, 1.0/l[n].ry);
+		if (j > 0)
+			EDGE(node - 1, 1.0/l[n].rx);
+		if (j < nc-1)
+			EDGE(node + 1, 1.0/l[n].rx);
+		if (i < nr-1)
+			EDGE(node + nc, 1.0/l[n].ry);
+		if (n < nl-1)
+			EDGE(node + nr*nc, 1.0/l[n].rz);
+
+		/* spreader core is connected to its periphery	*/
+		if (n == spidx) {
+			if (i == 0)
+				EDGE(ncells + SP_N, 1.0/(l[n].ry/2.0 + nc*pk->r_sp1_y));
+			if (i == nr-1)
+				EDGE(ncells + SP_S, 1.0/(l[n].ry/2.0 + nc*pk->r_sp1_y));
+			if (j == nc-1)
+				EDGE(ncells + SP_E, 1.0/(l[n].rx/2.0 + nr*pk->r_sp1_x));
+			if (j == 0)
+				EDGE(ncells + SP_W, 1.0/(l[n].rx/2.0 + nr*pk->r_sp1_x));
+		/* heatsink core is connected to its inner periphery and ambient	*/
+		} else if (n == hsidx) {
+			*amb = 1.0/l[n].rz;
+			if (i == 0)
+				EDGE(ncells + SINK_C_N, 1.0/(l[n].ry/2.0 + nc*pk->r_hs1_y));
+			if (i == nr-1)
+				EDGE(ncells + SINK_C_S, 1.0/(l[n].ry/2.0 + nc*pk->r_hs1_y));
+			if (j == nc-1)
+				EDGE(ncells + SINK_C_E, 1.0/(l[n].rx/2.0 + nr*pk->r_hs1_x));
+			if (j == 0)
+				EDGE(ncells + SINK_C_W, 1.0/(l[n].rx/2.0 + nr*pk->r_hs1_x));
+		}
+	} else switch (node - ncells) {
+		/* sink outer	*/
+		case SINK_N:
+			*amb = 1.0/(pk->r_hs_per + pk->r_amb_per);
+			EDGE(ncells + SINK_C_N, 1.0/(pk->r_hs2_y + pk->r_hs));
+			break;
+		case SINK_S:
+			*amb = 1.0/(pk->r_hs_per + pk->r_amb_per);
+			EDGE(ncells + SINK_C_S, 1.0/(pk->r_hs2_y + pk->r_hs));
+			break;
+		case SINK_W:
+			*amb = 1.0/(pk->r_hs_per + pk->r_amb_per);
+			EDGE(ncells + SINK_C_W, 1.0/(pk->r_hs2_x + pk->r_hs));
+			break;
+		case SINK_E:
+			*amb = 1.0/(pk->r_hs_per + pk->r_amb_per);
+			EDGE(ncells + SINK_C_E, 1.0/(pk->r_hs2_x + pk->r_hs));
+			break;
+		/* sink inner - connected to the edge cells of the heatsink core	*/
+		case SINK_C_N:
+		case SINK_C_S:
+			i = (node - ncells == SINK_C_N) ? 0 : nr-1;
+			for(j=0; j < nc; j++)
+				EDGE(hsidx*nr*nc + i*nc + j, 1.0/(l[hsidx].ry/2.0 + nc*pk->r_hs1_y));
+			*amb = 1.0/(pk->r_hs_c_per_y + pk->r_amb_c_per_y);
+			EDGE(ncells + ((node - ncells == SINK_C_N) ? SP_N : SP_S), 1.0/pk->r_sp_per_y);
+			EDGE(ncells + ((node - ncells == SINK_C_N) ? SINK_N : SINK_S), 1.0/(pk->r_hs2_y + pk->r_hs));
+			break;
+		case SINK_C_W:
+		case SINK_C_E:
+			j = (node - ncells == SINK_C_W) ? 0 : nc-1;
+			for(i=0; i < nr; i++)
+				EDGE(hsidx*nr*nc + i*nc + j, 1.0/(l[hsidx].rx/2.0 + nr*pk->r_hs1_x));
+			*amb = 1.0/(pk->r_hs_c_per_x + pk->r_amb_c_per_x);
+			EDGE(ncells + ((node - ncells == SINK_C_W) ? SP_W : SP_E), 1.0/pk->r_sp_per_x);
+			EDGE(ncells + ((node - ncells == SINK_C_W) ? SINK_W : SINK_E), 1.0/(pk->r_hs2_x + pk->r_hs));
+			break;
+		/* spreader - connected to the edge cells of the spreader core	*/
+		case SP_N:
+		case SP_S:
+			i = (node - ncells == SP_N) ? 0 : nr-1;
+			for(j=0; j < nc; j++)
+				EDGE(spidx*nr*nc + i*nc + j, 1.0/(l[spidx].ry/2.0 + nc*pk->r_sp1_y));
+			EDGE(ncells + ((node - ncells == SP_N) ? SINK_C_N : SINK_C_S), 1.0/pk->r_sp_per_y);
+			break;
+		case SP_W:
+		case SP_E:
+			j = (node - ncells == SP_W) ? 0 : nc-1;
+			for(i=0; i < nr; i++)
+				EDGE(spidx*nr*nc + i*nc + j, 1.0/(l[spidx].rx/2.0 + nr*pk->r_sp1_x));
+			EDGE(ncells + ((node - ncells == SP_W) ? SINK_C_W : SINK_C_E), 1.0/pk->r_sp_per_x);
+			break;
+		default:
+			fatal("invalid grid model node\n");
+			break;
+	}
+	# undef EDGE
+
+	/* diagonal	*/
+	col[k] = node;
+	val[k++] = csum + *amb;
+	return k;
+}
+
+/* 
+ * assemble the conductance matrix for the pcg solver and 
+ * its incomplete cholesky factor (the preconditioner)
+ */
+/* 
+ * the conductance matrix in CSR form, with each node's
+ * conductance to the ambient going into 'amb'
+ */
+sparse_matrix_t *assemble_R_grid(grid_model_t *model, double *amb)
+{
+	int node, k, cnt;
+	int n_nodes = model->n_layers * model->rows * model->cols + EXTRA;
+	/* the package nodes have the most elements	*/
+	int max_row = MAX(model->rows, model->cols) + EXTRA;
+	int *col = ivector(max_row);
+	double *val = dvector(max_row);
+	sparse_matrix_t *s = (sparse_matrix_t *) calloc (1, sizeof(sparse_matrix_t));
+	if (!s)
+		fatal("memory allocation error\n");
+
+	/* count the elements first	*/
+	s->n = n_nodes;
+	s->nnz = 0;
+	for(node=0; node < n_nodes; node++)
+		s->nnz += grid_R_row(model, node, col, val, &amb[node]);
+
+	s->row_start = ivector(n_nodes+1);
+	s->col = ivector(s->nnz);
+	s->val = dvector(s->nnz);
+	s->row_start[0] = 0;
+	for(node=0; node < n_nodes; node++) {
+		cnt = grid_R_row(model, node, col, val, &amb[node]);
+		for(k=0; k < cnt; k++) {
+			s->col[s->row_start[node] + k] = col[k];
+			s->val[s->row_start[node] + k] = val[k];
+		}
+		s->row_start[node+1] = s->row_start[node] + cnt;
+	}
+
+	free_ivector(col);
+	free_dvector(val);
+	return s;
+}
+
+void populate_sparse_R_grid(grid_model_t *model)
+{
+	int n_nodes = model->n_layers * model->rows * model->cols + EXTRA;
+
+	free_sparse_R_grid(model);
+	model->g_amb = dvector(n_nodes);
+	model->r_sparse = assemble_R_grid(model, model->g_amb);
+	model->r_ic = sparse_ic0_dcmp(model->r_sparse);
+}
+
+void free_trans_grid(grid_model_t *model)
+{
+	if (model->trans_sparse)
+		free_sparse_matrix(model->trans_sparse);
+	if (model->trans_ic)
+		free_sparse_matrix(model->trans_ic);
+	if (model->trans_c)
+		free_dvector(model->trans_c);
+	if (model->trans_amb)
+		free_dvector(model->trans_amb);
+	model->trans_sparse = NULL;
+	model->trans_ic = NULL;
+	model->trans_c = NULL;
+	model->trans_amb = NULL;
+	model->trans_h = 0;
+}
+
+/* 
+ * assemble C/h + G for the implicit transient solvers. the 
+ * capacitances are those that slope_fn_grid and slope_fn_pack use
+ */
+void populate_trans_grid(grid_model_t *model, double h)
+{
+	int n, i, k;
+	int nl = model->n_layers;
+	int nr = model->rows;
+	int nc = model->cols;
+	int n_nodes = nl*nr*nc + EXTRA;
+	package_RC_t *pk = &model->pack;
+	double *c, *x;
+	sparse_matrix_t *s;
+
+	free_trans_grid(model);
+	c = model->trans_c = dvector(n_nodes);
+	model->trans_amb = dvector(n_nodes);
+
+	for(n=0; n < nl; n++)
+		for(i=0; i < nr*nc; i++)
+			c[n*nr*nc + i] = model->layers[n].c;
+	x = c + nl*nr*nc;
+	x[SINK_N] = x[SINK_S] = x[SINK_W] = x[SINK_E] = pk->c_hs_per + pk->c_amb_per;
+	x[SINK_C_N] = x[SINK_C_S] = pk->c_hs_c_per_y + pk->c_amb_c_per_y;
+	x[SINK_C_W] = x[SINK_C_E] = pk->c_hs_c_per_x + pk->c_amb_c_per_x;
+	x[SP_N] = x[SP_S] = pk->c_sp_per_y;
+	x[SP_W] = x[SP_E] = pk->c_sp_per_x;
+
+	/* grid_R_row puts the diagonal last in each row	*/
+	s = model->trans_sparse = assemble_R_grid(model, model->trans_amb);
+	for(i=0; i < n_nodes; i++) {
+		k = s->row_start[i+1] - 1;
+		s->val[k] += c[i] / h;
+	}
+	model->trans_ic = sparse_ic0_dcmp(s);
+	model->trans_h = h;
+}
 void populate_R_model_grid(grid_model_t *model, flp_t *flp)
 {
 	int i;
@@ -544,6 +797,13 @@ void populate_R_model_grid(grid_model_t *model, flp_t *flp)
 								   (model->config.s_sink * model->config.s_sink) / (cw * ch);
 	}
 
+	/* the pcg solver works on the assembled matrix	*/
+	if (!strcasecmp(model->config.grid_solver, GRID_SOLVER_PCG_STR))
+		populate_sparse_R_grid(model);
+	else
+		free_sparse_R_grid(model);
+	free_trans_grid(model);
+
 	/* done	*/
 	model->r_ready = TRUE;
 }
@@ -563,6 +823,8 @@ void populate_C_model_grid(grid_model_t *model, flp_t *flp)
 
 	/* package C's	*/
 	populate_package_C(&model->pack, &model->config, model->width, model->height);
+	/* the implicit transient solvers' matrix depends on the C's	*/
+	free_trans_grid(model);
 
 	/* layer specific capacitances	*/
 	for(i=0; i < model->n_layers; i++)
@@ -585,7 +847,7 @@ void delete_grid_model(grid_model_t *model)
 
 	if (model->has_lcf) 
 		for(i=0; i < model->n_layers - DEFAULT_PACK_LAYERS; i++) {
-			delete_b2gmap(model->layers[i].b2gmap, model->rows, model->cols);
+			delete_b2gmap(model->layers[i].b2gmap);
 			free(model->layers[i].g2bmap);
 			free_flp(model->layers[i].flp, FALSE);
 		}
@@ -594,12 +856,15 @@ void delete_grid_model(grid_model_t *model)
 	 * allocated elsewhere. so, we don't need to deallocate those.
 	 */
 	else {
-		delete_b2gmap(model->layers[LAYER_SI].b2gmap, model->rows, model->cols);
+		delete_b2gmap(model->layers[LAYER_SI].b2gmap);
 		free(model->layers[LAYER_SI].g2bmap);
 	}
 	
 	free_grid_model_vector(model->last_steady);
 	free_grid_model_vector(model->last_trans);
+	free_sparse_R_grid(model);
+	free_trans_grid(model);
+	free_arena(model->arena);
 	free(model->layers);
 	free(model);
 }
@@ -1077,6 +1342,39 @@ void free_grid_model_vector(grid_model_vector_t *v)
 	free(v);
 }
 
+/* bytes of arena space a grid_model_vector_t takes	*/
+size_t grid_model_vector_arena_size(grid_model_t *model)
+{
+	int nl = model->n_layers, nr = model->rows, nc = model->cols;
+	return ARENA_ROUND(sizeof(grid_model_vector_t)) + 
+		   ARENA_ROUND(nl * sizeof(double **)) +
+		   ARENA_ROUND(nl * nr * sizeof(double *)) +
+		   ARENA_ROUND((nl * nr * nc + EXTRA) * sizeof(double));
+}
+
+/* 
+ * same layout as new_grid_model_vector but carved out of 
+ * an arena. it goes away with the arena
+ */
+grid_model_vector_t *arena_grid_model_vector(grid_model_t *model, arena_t *a)
+{
+	int n, i;
+	int nl = model->n_layers, nr = model->rows, nc = model->cols;
+	grid_model_vector_t *v;
+	
+	v = (grid_model_vector_t *) arena_alloc(a, sizeof(grid_model_vector_t));
+	v->cuboid = (double ***) arena_alloc(a, nl * sizeof(double **));
+	v->cuboid[0] = (double **) arena_alloc(a, nl * nr * sizeof(double *));
+	v->cuboid[0][0] = arena_dvector(a, nl * nr * nc + EXTRA);
+	for(n=0; n < nl; n++) {
+		v->cuboid[n] = v->cuboid[0] + nr * n;
+		for(i=0; i < nr; i++)
+			v->cuboid[n][i] = v->cuboid[0][0] + (nr * nc) * n + nc * i;
+	}
+	v->extra = v->cuboid[0][0] + nl * nr * nc;
+	return v;
+}
+
 /* translate power/temperature between block and grid vectors	*/
 void xlate_vector_b2g(grid_model_t *model, double *b, grid_model_vector_t *g, int type)
 {
@@ -1095,11 +1393,11 @@ void xlate_vector_b2g(grid_model_t *model, double *b, grid_model_vector_t *g, in
 				 */
 				/* convert power density to power	*/ 
 				if (type == V_POWER)
-					g->cuboid[n][i][j] = blist_avg(model->layers[n].b2gmap[i][j], 
+					g->cuboid[n][i][j] = b2gmap_avg(model->layers[n].b2gmap, i * model->cols + j, 
 										 model->layers[n].flp, &b[base], type) * area;
 				/* no conversion necessary for temperature	*/ 
 				else if (type == V_TEMP)
-					g->cuboid[n][i][j] = blist_avg(model->layers[n].b2gmap[i][j], 
+					g->cuboid[n][i][j] = b2gmap_avg(model->layers[n].b2gmap, i * model->cols + j, 
 										 model->layers[n].flp, &b[base], type);
 				else
 					fatal("unknown vector type\n");
@@ -1208,7 +1506,7 @@ void set_heuristic_temp(grid_model_t *model, grid_model_vector_t *power,
 						grid_model_vector_t *temp, double total)
 {
 	int n, i, j, nl, nr, nc;
-	double **sum;
+	double *sum = model->w_sum;
 
 	/* shortcuts	*/
 	nl = model->n_layers;
@@ -1229,28 +1527,26 @@ void set_heuristic_temp(grid_model_t *model, grid_model_vector_t *power,
 
 	/* layer temperatures	*/
 	/* add up power for each grid cell across all layers */
-	sum = dmatrix(nr, nc);
+	zero_dvector(sum, nr*nc);
 	for(n=0; n < nl; n++)
-		scaleadd_dvector(sum[0], sum[0], power->cuboid[n][0], nr*nc, 1.0);
+		scaleadd_dvector(sum, sum, power->cuboid[n][0], nr*nc, 1.0);
 
 	/* last layer	*/
 	for(i=0; i < nr; i++)
 		for(j=0; j < nc; j++)
-			temp->cuboid[nl-1][i][j] = model->config.ambient + sum[i][j] * 
+			temp->cuboid[nl-1][i][j] = model->config.ambient + sum[i*nc+j] * 
 									 model->layers[nl-1].rz;
 	/* subtract away the layer's power	*/			
-	scaleadd_dvector(sum[0], sum[0], power->cuboid[nl-1][0], nr*nc, -1.0);
+	scaleadd_dvector(sum, sum, power->cuboid[nl-1][0], nr*nc, -1.0);
 			
 	/* go from last-1 to first	*/
 	for(n=nl-2; n >= 0; n--) {
 		/* nth layer temp is n+1th temp + cumul_power * rz of the nth layer	*/
-		scaleadd_dvector(temp->cuboid[n][0], temp->cuboid[n+1][0], sum[0], 
+		scaleadd_dvector(temp->cuboid[n][0], temp->cuboid[n+1][0], sum, 
 						 nr*nc, model->layers[n].rz);
 		/* subtract away the layer's power	*/			
-		scaleadd_dvector(sum[0], sum[0], power->cuboid[n][0], nr*nc, -1.0);
+		scaleadd_dvector(sum, sum, power->cuboid[n][0], nr*nc, -1.0);
 	}
-	
-	free_dmatrix(sum);
 }
 
 /* single steady state iteration of grid solver - package part */
@@ -1258,7 +1554,7 @@ double single_iteration_steady_pack(grid_model_t *model, grid_model_vector_t *po
 									grid_model_vector_t *temp)
 {
 	int i, j;
-	double *delta, max = 0;
+	double delta[EXTRA], max = 0;
 	/* sum of the conductances	*/
 	double csum;
 	/* weighted sum of temperatures	*/
@@ -1275,8 +1571,6 @@ double single_iteration_steady_pack(grid_model_t *model, grid_model_vector_t *po
 	int spidx = nl - DEFAULT_PACK_LAYERS + LAYER_SP;
 	int hsidx = nl - DEFAULT_PACK_LAYERS + LAYER_SINK;
 
-	delta = dvector(EXTRA);
-
 	/* sink outer north/south	*/
 	csum = 1.0/(pk->r_hs_per + pk->r_amb_per) + 1.0/(pk->r_hs2_y + pk->r_hs);
 	wsum = c->ambient/(pk->r_hs_per + pk->r_amb_per) + v[SINK_C_N]/(pk->r_hs2_y + pk->r_hs);
@@ -1388,7 +1682,6 @@ double single_iteration_steady_pack(grid_model_t *model, grid_model_vector_t *po
 	for(i=0; i < EXTRA; i++)
 		if (delta[i] > max)
 			max = delta[i];
-	free_dvector(delta);
 
 	return max;
 }
@@ -1421,12 +1714,14 @@ double single_iteration_steady_pack(grid_model_t *model, grid_model_vector_t *po
 /* weighted T of the next cell above. zero if on top face			*/
 # define AT(l,v,n,i,j,nl,nr,nc)		((n > 0) ? (v[n-1][i][j]/l[n-1].rz) : 0.0)
 
-/* single steady state iteration of grid solver - silicon part */
-double single_iteration_steady_grid(grid_model_t *model, grid_model_vector_t *power,
-									grid_model_vector_t *temp)
+/* 
+ * new temperature of the grid cell (n, i, j) from its neighbours, in 
+ * full, with the terms for the spreader and sink peripheries. used 
+ * for the cells on the edges of a layer
+ */
+double steady_cell_grid(grid_model_t *model, grid_model_vector_t *power,
+						grid_model_vector_t *temp, int n, int i, int j)
 {
-	int n, i, j;
-	double prev, delta, max = 0;
 	/* sum of the conductances	*/
 	double csum;
 	/* weighted sum of temperatures	*/
@@ -1442,98 +1737,192 @@ double single_iteration_steady_grid(grid_model_t *model, grid_model_vector_t *po
 	int spidx = nl - DEFAULT_PACK_LAYERS + LAYER_SP;
 	int hsidx = nl - DEFAULT_PACK_LAYERS + LAYER_SINK;
 
-	/* for each grid cell	*/
-	for(n=0; n < nl; n++)
-		for(i=0; i < nr; i++)
-			for(j=0; j < nc; j++) {
-				/* sum the conductances to cells north, south, 
-				 * east, west, above and below
-				 */
-				csum = NC(l,n,i,j,nl,nr,nc) + SC(l,n,i,j,nl,nr,nc) + 
-					   EC(l,n,i,j,nl,nr,nc) + WC(l,n,i,j,nl,nr,nc) + 
-					   AC(l,n,i,j,nl,nr,nc) + BC(l,n,i,j,nl,nr,nc);
-
-				/* sum of the weighted temperatures of all the neighbours	*/
-				wsum = NT(l,v,n,i,j,nl,nr,nc) + ST(l,v,n,i,j,nl,nr,nc) + 
-					   ET(l,v,n,i,j,nl,nr,nc) + WT(l,v,n,i,j,nl,nr,nc) + 
-					   AT(l,v,n,i,j,nl,nr,nc) + BT(l,v,n,i,j,nl,nr,nc);
-
-				/* spreader core is connected to its periphery	*/
-				if (n == spidx) {
-					/* northern boundary - edge cell has half the ry	*/
-					if (i == 0) {
-						csum += 1.0/(l[n].ry/2.0 + nc*model->pack.r_sp1_y); 
-						wsum += temp->extra[SP_N]/(l[n].ry/2.0 + nc*model->pack.r_sp1_y); 
-					}
-					/* southern boundary - edge cell has half the ry	*/
-					if (i == nr-1) {
-						csum += 1.0/(l[n].ry/2.0 + nc*model->pack.r_sp1_y); 
-						wsum += temp->extra[SP_S]/(l[n].ry/2.0 + nc*model->pack.r_sp1_y); 
-					}
-					/* eastern boundary	 - edge cell has half the rx	*/
-					if (j == nc-1) {
-						csum += 1.0/(l[n].rx/2.0 + nr*model->pack.r_sp1_x); 
-						wsum += temp->extra[SP_E]/(l[n].rx/2.0 + nr*model->pack.r_sp1_x); 
-					}
-					/* western boundary	- edge cell has half the rx		*/
-					if (j == 0) {
-						csum += 1.0/(l[n].rx/2.0 + nr*model->pack.r_sp1_x); 
-						wsum += temp->extra[SP_W]/(l[n].rx/2.0 + nr*model->pack.r_sp1_x); 
-					}
-				/* heatsink core is connected to its inner periphery and ambient	*/
-				} else if (n == hsidx) {
-					/* all nodes are connected to the ambient	*/
-					csum += 1.0/l[n].rz;
-					wsum += c->ambient/l[n].rz;
-					/* northern boundary - edge cell has half the ry	*/
-					if (i == 0) {
-						csum += 1.0/(l[n].ry/2.0 + nc*model->pack.r_hs1_y); 
-						wsum += temp->extra[SINK_C_N]/(l[n].ry/2.0 + nc*model->pack.r_hs1_y); 
-					}
-					/* southern boundary - edge cell has half the ry	*/
-					if (i == nr-1) {
-						csum += 1.0/(l[n].ry/2.0 + nc*model->pack.r_hs1_y); 
-						wsum += temp->extra[SINK_C_S]/(l[n].ry/2.0 + nc*model->pack.r_hs1_y); 
-					}
-					/* eastern boundary	 - edge cell has half the rx	*/
-					if (j == nc-1) {
-						csum += 1.0/(l[n].rx/2.0 + nr*model->pack.r_hs1_x); 
-						wsum += temp->extra[SINK_C_E]/(l[n].rx/2.0 + nr*model->pack.r_hs1_x); 
-					}
-					/* western boundary	- edge cell has half the rx		*/
-					if (j == 0) {
-						csum += 1.0/(l[n].rx/2.0 + nr*model->pack.r_hs1_x); 
-						wsum += temp->extra[SINK_C_W]/(l[n].rx/2.0 + nr*model->pack.r_hs1_x); 
-					}
-				}
+	/* sum the conductances to cells north, south, 
+	 * east, west, above and below
+	 */
+	csum = NC(l,n,i,j,nl,nr,nc) + SC(l,n,i,j,nl,nr,nc) + 
+		   EC(l,n,i,j,nl,nr,nc) + WC(l,n,i,j,nl,nr,nc) + 
+		   AC(l,n,i,j,nl,nr,nc) + BC(l,n,i,j,nl,nr,nc);
+
+	/* sum of the weighted temperatures of all the neighbours	*/
+	wsum = NT(l,v,n,i,j,nl,nr,nc) + ST(l,v,n,i,j,nl,nr,nc) + 
+		   ET(l,v,n,i,j,nl,nr,nc) + WT(l,v,n,i,j,nl,nr,nc) + 
+		   AT(l,v,n,i,j,nl,nr,nc) + BT(l,v,n,i,j,nl,nr,nc);
+
+	/* spreader core is connected to its periphery	*/
+	if (n == spidx) {
+		/* northern boundary - edge cell has half the ry	*/
+		if (i == 0) {
+			csum += 1.0/(l[n].ry/2.0 + nc*model->pack.r_sp1_y); 
+			wsum += temp->extra[SP_N]/(l[n].ry/2.0 + nc*model->pack.r_sp1_y); 
+		}
+		/* southern boundary - edge cell has half the ry	*/
+		if (i == nr-1) {
+			csum += 1.0/(l[n].ry/2.0 + nc*model->pack.r_sp1_y); 
+			wsum += temp->extra[SP_S]/(l[n].ry/2.0 + nc*model->pack.r_sp1_y); 
+		}
+		/* eastern boundary	 - edge cell has half the rx	*/
+		if (j == nc-1) {
+			csum += 1.0/(l[n].rx/2.0 + nr*model->pack.r_sp1_x); 
+			wsum += temp->extra[SP_E]/(l[n].rx/2.0 + nr*model->pack.r_sp1_x); 
+		}
+		/* western boundary	- edge cell has half the rx		*/
+		if (j == 0) {
+			csum += 1.0/(l[n].rx/2.0 + nr*model->pack.r_sp1_x); 
+			wsum += temp->extra[SP_W]/(l[n].rx/2.0 + nr*model->pack.r_sp1_x); 
+		}
+	/* heatsink core is connected to its inner periphery and ambient	*/
+	} else if (n == hsidx) {
+		/* all nodes are connected to the ambient	*/
+		csum += 1.0/l[n].rz;
+		wsum += c->ambient/l[n].rz;
+		/* northern boundary - edge cell has half the ry	*/
+		if (i == 0) {
+			csum += 1.0/(l[n].ry/2.0 + nc*model->pack.r_hs1_y); 
+			wsum += temp->extra[SINK_C_N]/(l[n].ry/2.0 + nc*model->pack.r_hs1_y); 
+		}
+		/* southern boundary - edge cell has half the ry	*/
+		if (i == nr-1) {
+			csum += 1.0/(l[n].ry/2.0 + nc*model->pack.r_hs1_y); 
+			wsum += temp->extra[SINK_C_S]/(l[n].ry/2.0 + nc*model->pack.r_hs1_y); 
+		}
+		/* eastern boundary	 - edge cell has half the rx	*/
+		if (j == nc-1) {
+			csum += 1.0/(l[n].rx/2.0 + nr*model->pack.r_hs1_x); 
+			wsum += temp->extra[SINK_C_E]/(l[n].rx/2.0 + nr*model->pack.r_hs1_x); 
+		}
+		/* western boundary	- edge cell has half the rx		*/
+		if (j == 0) {
+			csum += 1.0/(l[n].rx/2.0 + nr*model->pack.r_hs1_x); 
+			wsum += temp->extra[SINK_C_W]/(l[n].rx/2.0 + nr*model->pack.r_hs1_x); 
+		}
+	}
+
+	return (power->cuboid[n][i][j] + wsum) / csum;
+}
 
-				/* update the current cell's temperature	*/	   
-				prev = v[n][i][j];
-				v[n][i][j] = (power->cuboid[n][i][j] + wsum) / csum;
+/* 
+ * update the cells of row i of layer n that are of the given colour.
+ * returns the largest change. an interior cell has all six neighbours
+ * and none of the periphery terms. so, only the edge cells take the 
+ * full form and the rest of the row is a loop without any branches
+ */
+double steady_row_grid(grid_model_t *model, grid_model_vector_t *power,
+					   grid_model_vector_t *temp, int n, int i, int colour)
+{
+	int j, j0 = (n + i + colour) & 1;
+	double t, delta, max = 0;
 
-				/* compute maximum delta	*/
-				delta =  fabs(prev - v[n][i][j]);
+	/* shortcuts	*/
+	layer_t *l = model->layers;
+	int nl = model->n_layers;
+	int nr = model->rows;
+	int nc = model->cols;
+	int hsidx = nl - DEFAULT_PACK_LAYERS + LAYER_SINK;
+	double *v = temp->cuboid[n][i];
+	double *p = power->cuboid[n][i];
+
+	/* conductances of an interior cell	*/
+	double gx = 1.0/l[n].rx, gy = 1.0/l[n].ry;
+	double ga = (n > 0) ? 1.0/l[n-1].rz : 0.0;
+	double gb = (n < nl-1) ? 1.0/l[n].rz : 0.0;
+	/* only the heatsink is connected to the ambient	*/
+	double gamb = (n == hsidx) ? 1.0/l[n].rz : 0.0;
+	double inv_csum = 1.0 / (2.0*gx + 2.0*gy + ga + gb + gamb);
+	double amb = gamb * model->config.ambient;
+	/* 
+	 * rows of the neighbours. the missing ones (on the top 
+	 * and bottom faces) have zero conductance, so any row does
+	 */
+	double *vn, *vs, *va, *vb;
+
+	/* northern and southern edge rows	*/
+	if (i == 0 || i == nr-1 || nc < 3) {
+		for (j = j0; j < nc; j += 2) {
+			t = steady_cell_grid(model, power, temp, n, i, j);
+			delta = fabs(v[j] - t);
+			v[j] = t;
+			if (delta > max)
+				max = delta;
+		}
+		return max;
+	}
+
+	vn = temp->cuboid[n][i-1];
+	vs = temp->cuboid[n][i+1];
+	va = (n > 0) ? temp->cuboid[n-1][i] : v;
+	vb = (n < nl-1) ? temp->cuboid[n+1][i] : v;
+
+	/* western edge	*/
+	if (!j0) {
+		t = steady_cell_grid(model, power, temp, n, i, 0);
+		delta = fabs(v[0] - t);
+		v[0] = t;
+		if (delta > max)
+			max = delta;
+	}
+	/* interior	*/
+	for (j = j0 ? 1 : 2; j < nc-1; j += 2) {
+		t = (p[j] + amb + gy * (vn[j] + vs[j]) + gx * (v[j-1] + v[j+1]) + 
+			 ga * va[j] + gb * vb[j]) * inv_csum;
+		delta = fabs(v[j] - t);
+		v[j] = t;
+		if (delta > max)
+			max = delta;
+	}
+	/* eastern edge	*/
+	if (!((j0 + nc - 1) & 1)) {
+		t = steady_cell_grid(model, power, temp, n, i, nc-1);
+		delta = fabs(v[nc-1] - t);
+		v[nc-1] = t;
+		if (delta > max)
+			max = delta;
+	}
+	return max;
+}
+
+/* 
+ * single steady state iteration of grid solver - silicon part. 
+ * the cells are swept in red-black order. the neighbours of a 
+ * cell are all of the other colour. so, all the cells of one colour 
+ * can be updated at once (in parallel, with openmp) and the sweep 
+ * is still a gauss-seidel one
+ */
+double single_iteration_steady_grid(grid_model_t *model, grid_model_vector_t *power,
+									grid_model_vector_t *temp)
+{
+	int n, i, colour;
+	double max = 0;
+
+	/* shortcuts	*/
+	int nl = model->n_layers;
+	int nr = model->rows;
+
+	for (colour = 0; colour < 2; colour++) {
+		#pragma omp parallel for collapse(2) reduction(max:max) schedule(static)
+		for(n=0; n < nl; n++)
+			for(i=0; i < nr; i++) {
+				double delta = steady_row_grid(model, power, temp, n, i, colour);
 				if (delta > max)
 					max = delta;
 			}
+	}
+
 	/* package part of the iteration	*/
 	return (MAX(max, single_iteration_steady_pack(model, power, temp)));
 }
 
 void steady_state_temp_grid(grid_model_t *model, double *power, double *temp)
 {
-	grid_model_vector_t *p;
+	/* scratch space - no allocation per call	*/
+	grid_model_vector_t *p = model->w_power;
 	double total;
 	double delta;
-	#if VERBOSE > 1
-	unsigned int i = 0;
-	#endif
+	int i, n_nodes = model->n_layers * model->rows * model->cols + EXTRA;
 
 	if (!model->r_ready)
 		fatal("R model not ready\n");
 
-	p = new_grid_model_vector(model);
-
 	/* package nodes' power numbers	*/
 	set_internal_power_grid(model, power);
 	/* total power - package nodes have no power dissipation	*/
@@ -1548,21 +1937,45 @@ void steady_state_temp_grid(grid_model_t *model, double *power, double *temp)
 	 */
 	set_heuristic_temp(model, p, model->last_steady, total);
 
-	/* solve for steady state temperatures iteratively till convergence	*/
-	do {
-		delta = single_iteration_steady_grid(model, p, model->last_steady);
-		#if VERBOSE > 1
-			i++;
-		#endif	
-	} while (!eq(delta, 0));
+	if (model->r_sparse) {
+		/* the heuristic temperatures are the initial guess	*/
+		double *v = model->last_steady->cuboid[0][0];
+		/* right hand side - power plus the heat from the ambient	*/
+		double *rhs = model->w_rhs;
+		for(i=0; i < n_nodes; i++)
+			rhs[i] = p->cuboid[0][0][i] + model->g_amb[i] * model->config.ambient;
+		model->steady_iter = pcgsolve(model->r_sparse, model->r_ic, rhs, v, 
+									  GRID_PCG_TOL, n_nodes, &model->steady_resid, 
+									  model->w_work);
+		if (model->steady_iter < 0)
+			warning("pcg steady state solver did not converge\n");
+	} else {
+		/* solve for steady state temperatures iteratively till convergence	*/
+		model->steady_iter = 0;
+		do {
+			delta = single_iteration_steady_grid(model, p, model->last_steady);
+			model->steady_iter++;
+		} while (!eq(delta, 0));
+		model->steady_resid = delta;
+	}
 	#if VERBOSE > 1
-	fprintf(stdout, "no. of iterations for steady state convergence: %d\n", i);
+	fprintf(stdout, "no. of iterations for steady state convergence: %d, residual: %g\n", 
+			model->steady_iter, model->steady_resid);
 	#endif
 
 	/* map the temperature numbers back	*/
 	xlate_temp_g2b(model, temp, model->last_steady);
+}
 
-	free_grid_model_vector(p);
+/* 
+ * the grid solvers are iterative, with each solution
+ * taking its own no. of iterations
+ */
+void steady_state_temp_grid_batch(grid_model_t *model, double **power, double **temp, int n)
+{
+	int i;
+	for (i = 0; i < n; i++)
+		steady_state_temp_grid(model, power[i], temp[i]);
 }
 
 /* function to access a 1-d array as a 3-d matrix	*/
@@ -1690,13 +2103,14 @@ void slope_fn_pack(grid_model_t *model, double *v, grid_model_vector_t *p, doubl
 /* current(power) from the next cell above. zero if on top face			*/
 # define AP(l,v,n,i,j,nl,nr,nc)		((n > 0) ? ((A3D(v,n-1,i,j,nl,nr,nc)-A3D(v,n,i,j,nl,nr,nc))/l[n-1].rz) : 0.0)
 
-/* compute the slope vector for the grid cells. the transient
- * equation is CdV + sum{(T - Ti)/Ri} = P 
- * so, slope = dV = [P + sum{(Ti-T)/Ri}]/C
+/* 
+ * slope of the grid cell (n, i, j) in full, with the terms for the
+ * spreader and sink peripheries. used for the cells on the edges of
+ * a layer
  */
-void slope_fn_grid(grid_model_t *model, double *v, grid_model_vector_t *p, double *dv)
+double slope_cell_grid(grid_model_t *model, double *v, grid_model_vector_t *p, 
+					   int n, int i, int j)
 {
-	int n, i, j;
 	/* sum of the currents(power values)	*/
 	double psum;
 
@@ -1711,59 +2125,166 @@ void slope_fn_grid(grid_model_t *model, double *v, grid_model_vector_t *p, doubl
 	/* pointer to the starting address of the extra nodes	*/
 	double *x = v + nl*nr*nc;
 
-	/* for each grid cell	*/
+	/* sum the currents(power values) to cells north, south, 
+	 * east, west, above and below
+	 */
+	psum = NP(l,v,n,i,j,nl,nr,nc) + SP(l,v,n,i,j,nl,nr,nc) + 
+		   EP(l,v,n,i,j,nl,nr,nc) + WP(l,v,n,i,j,nl,nr,nc) + 
+		   AP(l,v,n,i,j,nl,nr,nc) + BP(l,v,n,i,j,nl,nr,nc);
+
+	/* spreader core is connected to its periphery	*/
+	if (n == spidx) {
+		/* northern boundary - edge cell has half the ry	*/
+		if (i == 0)
+			psum += (x[SP_N] - A3D(v,n,i,j,nl,nr,nc))/(l[n].ry/2.0 + nc*model->pack.r_sp1_y); 
+		/* southern boundary - edge cell has half the ry	*/
+		if (i == nr-1)
+			psum += (x[SP_S] - A3D(v,n,i,j,nl,nr,nc))/(l[n].ry/2.0 + nc*model->pack.r_sp1_y); 
+		/* eastern boundary	 - edge cell has half the rx	*/
+		if (j == nc-1)
+			psum += (x[SP_E] - A3D(v,n,i,j,nl,nr,nc))/(l[n].rx/2.0 + nr*model->pack.r_sp1_x); 
+		/* western boundary	 - edge cell has half the rx	*/
+		if (j == 0)
+			psum += (x[SP_W] - A3D(v,n,i,j,nl,nr,nc))/(l[n].rx/2.0 + nr*model->pack.r_sp1_x); 
+	/* heatsink core is connected to its inner periphery and ambient	*/
+	} else if (n == hsidx) {
+		/* all nodes are connected to the ambient	*/
+		psum += (c->ambient - A3D(v,n,i,j,nl,nr,nc))/l[n].rz;
+		/* northern boundary - edge cell has half the ry	*/
+		if (i == 0)
+			psum += (x[SINK_C_N] - A3D(v,n,i,j,nl,nr,nc))/(l[n].ry/2.0 + nc*model->pack.r_hs1_y); 
+		/* southern boundary - edge cell has half the ry	*/
+		if (i == nr-1)
+			psum += (x[SINK_C_S] - A3D(v,n,i,j,nl,nr,nc))/(l[n].ry/2.0 + nc*model->pack.r_hs1_y); 
+		/* eastern boundary	 - edge cell has half the rx	*/
+		if (j == nc-1)
+			psum += (x[SINK_C_E] - A3D(v,n,i,j,nl,nr,nc))/(l[n].rx/2.0 + nr*model->pack.r_hs1_x); 
+		/* western boundary	 - edge cell has half the rx	*/
+		if (j == 0)
+			psum += (x[SINK_C_W] - A3D(v,n,i,j,nl,nr,nc))/(l[n].rx/2.0 + nr*model->pack.r_hs1_x); 
+	}
+
+	return (p->cuboid[n][i][j] + psum) / l[n].c;
+}
+
+/* 
+ * slopes of row i of layer n. as in steady_row_grid, only 
+ * the edge cells take the full form
+ */
+void slope_row_grid(grid_model_t *model, double *v, grid_model_vector_t *p, 
+					double *dv, int n, int i)
+{
+	int j;
+
+	/* shortcuts	*/
+	layer_t *l = model->layers;
+	int nl = model->n_layers;
+	int nr = model->rows;
+	int nc = model->cols;
+	int hsidx = nl - DEFAULT_PACK_LAYERS + LAYER_SINK;
+	double *vr = &A3D(v,n,i,0,nl,nr,nc);
+	double *dvr = &A3D(dv,n,i,0,nl,nr,nc);
+	double *pr = p->cuboid[n][i];
+
+	/* conductances of an interior cell	*/
+	double gx = 1.0/l[n].rx, gy = 1.0/l[n].ry;
+	double ga = (n > 0) ? 1.0/l[n-1].rz : 0.0;
+	double gb = (n < nl-1) ? 1.0/l[n].rz : 0.0;
+	/* only the heatsink is connected to the ambient	*/
+	double gamb = (n == hsidx) ? 1.0/l[n].rz : 0.0;
+	double amb = model->config.ambient;
+	double inv_c = 1.0 / l[n].c;
+	/* 
+	 * rows of the neighbours. the missing ones (on the top 
+	 * and bottom faces) have zero conductance, so any row does
+	 */
+	double *vn, *vs, *va, *vb;
+
+	/* northern and southern edge rows	*/
+	if (i == 0 || i == nr-1 || nc < 3) {
+		for (j = 0; j < nc; j++)
+			dvr[j] = slope_cell_grid(model, v, p, n, i, j);
+		return;
+	}
+
+	vn = vr - nc;
+	vs = vr + nc;
+	va = (n > 0) ? vr - nr*nc : vr;
+	vb = (n < nl-1) ? vr + nr*nc : vr;
+
+	dvr[0] = slope_cell_grid(model, v, p, n, i, 0);
+	for (j = 1; j < nc-1; j++)
+		dvr[j] = (pr[j] + gy * (vn[j] + vs[j] - 2.0 * vr[j]) + 
+				  gx * (vr[j-1] + vr[j+1] - 2.0 * vr[j]) + 
+				  ga * (va[j] - vr[j]) + gb * (vb[j] - vr[j]) + 
+				  gamb * (amb - vr[j])) * inv_c;
+	dvr[nc-1] = slope_cell_grid(model, v, p, n, i, nc-1);
+}
+
+/* compute the slope vector for the grid cells. the transient
+ * equation is CdV + sum{(T - Ti)/Ri} = P 
+ * so, slope = dV = [P + sum{(Ti-T)/Ri}]/C. the rows are
+ * independent of each other and are done in parallel
+ */
+void slope_fn_grid(grid_model_t *model, double *v, grid_model_vector_t *p, double *dv)
+{
+	int n, i;
+
+	/* shortcuts	*/
+	int nl = model->n_layers;
+	int nr = model->rows;
+
+	#pragma omp parallel for collapse(2) schedule(static)
 	for(n=0; n < nl; n++)
 		for(i=0; i < nr; i++)
-			for(j=0; j < nc; j++) {
-				/* sum the currents(power values) to cells north, south, 
-				 * east, west, above and below
-				 */
-				psum = NP(l,v,n,i,j,nl,nr,nc) + SP(l,v,n,i,j,nl,nr,nc) + 
-					   EP(l,v,n,i,j,nl,nr,nc) + WP(l,v,n,i,j,nl,nr,nc) + 
-					   AP(l,v,n,i,j,nl,nr,nc) + BP(l,v,n,i,j,nl,nr,nc);
-
-				/* spreader core is connected to its periphery	*/
-				if (n == spidx) {
-					/* northern boundary - edge cell has half the ry	*/
-					if (i == 0)
-						psum += (x[SP_N] - A3D(v,n,i,j,nl,nr,nc))/(l[n].ry/2.0 + nc*model->pack.r_sp1_y); 
-					/* southern boundary - edge cell has half the ry	*/
-					if (i == nr-1)
-						psum += (x[SP_S] - A3D(v,n,i,j,nl,nr,nc))/(l[n].ry/2.0 + nc*model->pack.r_sp1_y); 
-					/* eastern boundary	 - edge cell has half the rx	*/
-					if (j == nc-1)
-						psum += (x[SP_E] - A3D(v,n,i,j,nl,nr,nc))/(l[n].rx/2.0 + nr*model->pack.r_sp1_x); 
-					/* western boundary	 - edge cell has half the rx	*/
-					if (j == 0)
-						psum += (x[SP_W] - A3D(v,n,i,j,nl,nr,nc))/(l[n].rx/2.0 + nr*model->pack.r_sp1_x); 
-				/* heatsink core is connected to its inner periphery and ambient	*/
-				} else if (n == hsidx) {
-					/* all nodes are connected to the ambient	*/
-					psum += (c->ambient - A3D(v,n,i,j,nl,nr,nc))/l[n].rz;
-					/* northern boundary - edge cell has half the ry	*/
-					if (i == 0)
-						psum += (x[SINK_C_N] - A3D(v,n,i,j,nl,nr,nc))/(l[n].ry/2.0 + nc*model->pack.r_hs1_y); 
-					/* southern boundary - edge cell has half the ry	*/
-					if (i == nr-1)
-						psum += (x[SINK_C_S] - A3D(v,n,i,j,nl,nr,nc))/(l[n].ry/2.0 + nc*model->pack.r_hs1_y); 
-					/* eastern boundary	 - edge cell has half the rx	*/
-					if (j == nc-1)
-						psum += (x[SINK_C_E] - A3D(v,n,i,j,nl,nr,nc))/(l[n].rx/2.0 + nr*model->pack.r_hs1_x); 
-					/* western boundary	 - edge cell has half the rx	*/
-					if (j == 0)
-						psum += (x[SINK_C_W] - A3D(v,n,i,j,nl,nr,nc))/(l[n].rx/2.0 + nr*model->pack.r_hs1_x); 
-				}
-
-				/* update the current cell's temperature	*/	   
-				A3D(dv,n,i,j,nl,nr,nc) = (p->cuboid[n][i][j] + psum) / l[n].c;
-			}
+			slope_row_grid(model, v, p, dv, n, i);
 	slope_fn_pack(model, v, p, dv);
 }
 
+/* 
+ * implicit transient solution of the grid temperatures in
+ * last_trans with equal steps of size h, as in implicit_temp_block.
+ * each step is a pcg solve of (C/h + G) T(t+h) = (C/h) T(t) + POWER
+ * plus the heat from the ambient, starting from T(t). the matrix 
+ * and its preconditioner are reused for as long as h stays the same
+ */
+void implicit_temp_grid(grid_model_t *model, grid_model_vector_t *power, double time_elapsed)
+{
+	int i, k, n_steps, iter;
+	int n_nodes = model->n_layers * model->rows * model->cols + EXTRA;
+	int cn = !strcasecmp(model->config.trans_solver, TRANS_SOLVER_CN_STR);
+	double h, *rhs = model->w_rhs, *y = model->w_half;
+	double *v = model->last_trans->cuboid[0][0];
+	double *p = power->cuboid[0][0];
+
+	n_steps = implicit_steps(time_elapsed, model->config.trans_step);
+	/* step of the backward euler solve	*/
+	h = time_elapsed / n_steps;
+	if (cn)
+		h /= 2.0;
+	if (model->trans_h != h)
+		populate_trans_grid(model, h);
+
+	for (k = 0; k < n_steps; k++) {
+		for (i = 0; i < n_nodes; i++) {
+			rhs[i] = model->trans_c[i] / h * v[i] + p[i] + 
+					 model->trans_amb[i] * model->config.ambient;
+			y[i] = v[i];
+		}
+		iter = pcgsolve(model->trans_sparse, model->trans_ic, rhs, y, 
+						GRID_PCG_TOL, n_nodes, NULL, model->w_work);
+		if (iter < 0)
+			warning("pcg transient solver did not converge\n");
+		for (i = 0; i < n_nodes; i++)
+			v[i] = cn ? 2.0 * y[i] - v[i] : y[i];
+	}
+}
+
 void compute_temp_grid(grid_model_t *model, double *power, double *temp, double time_elapsed)
 {
 	double t, h, new_h;
-	grid_model_vector_t *p;
+	/* scratch space - no allocation per call	*/
+	grid_model_vector_t *p = model->w_power;
 	#if VERBOSE > 1
 	unsigned int i = 0;
 	#endif
@@ -1771,8 +2292,6 @@ void compute_temp_grid(grid_model_t *model, double *power, double *temp, double
 	if (!model->r_ready || !model->c_ready)
 		fatal("grid model not ready\n");
 
-	p = new_grid_model_vector(model);
-
 	/* package nodes' power numbers	*/
 	set_internal_power_grid(model, power);
 
@@ -1788,6 +2307,12 @@ void compute_temp_grid(grid_model_t *model, double *power, double *temp, double
 		model->last_temp = temp;
 	}	
 
+	if (strcasecmp(model->config.trans_solver, TRANS_SOLVER_RK4_STR)) {
+		implicit_temp_grid(model, p, time_elapsed);
+		xlate_temp_g2b(model, model->last_temp, model->last_trans);
+		return;
+	}
+
 	/* Obtain temp at time (t+time_elapsed). 
 	 * Instead of getting the temperature at t+time_elapsed directly, we
 	 * do it in multiple steps with the correct step size at each time 
@@ -1803,7 +2328,7 @@ void compute_temp_grid(grid_model_t *model, double *power, double *temp, double
 				 model->rows * model->cols * model->n_layers + EXTRA, h,
 				 model->last_trans->cuboid[0][0], 
 				 /* the slope function callback is typecast accordingly */
-				 (slope_fn_ptr) slope_fn_grid);
+				 (slope_fn_ptr) slope_fn_grid, model->w_work);
 		#if VERBOSE > 1
 			i++;
 		#endif	
@@ -1815,7 +2340,7 @@ void compute_temp_grid(grid_model_t *model, double *power, double *temp, double
 			model->rows * model->cols * model->n_layers + EXTRA,
 			/* the slope function callback is typecast accordingly */
 			time_elapsed - t, model->last_trans->cuboid[0][0], 
-			(slope_fn_ptr) slope_fn_grid);
+			(slope_fn_ptr) slope_fn_grid, model->w_work);
 
 	#if VERBOSE > 1
 	fprintf(stdout, "no. of rk4 calls during compute_temp: %d\n", i+1);
@@ -1823,18 +2348,16 @@ void compute_temp_grid(grid_model_t *model, double *power, double *temp, double
 
 	/* map the temperature numbers back	*/
 	xlate_temp_g2b(model, model->last_temp, model->last_trans);
-
-	free_grid_model_vector(p);
 }
 
 /* debug print	*/
-void debug_print_blist(blist_t *head, flp_t *flp)
+void debug_print_b2gmap(b2gmap_t *map, int cell, flp_t *flp)
 {
-	blist_t *ptr;
-	fprintf(stdout, "printing blist information...\n");
-	for(ptr = head; ptr; ptr = ptr->next) {
-		fprintf(stdout, "unit: %s\n", flp->units[ptr->idx].name);
-		fprintf(stdout, "occupancy: %f\n", ptr->occupancy);
+	int k;
+	fprintf(stdout, "printing b2gmap cell information...\n");
+	for(k = map->start[cell]; k < map->start[cell+1]; k++) {
+		fprintf(stdout, "unit: %s\n", flp->units[map->idx[k]].name);
+		fprintf(stdout, "occupancy: %f\n", map->occupancy[k]);
 	}
 }
 
@@ -1864,7 +2387,7 @@ void debug_print_layer(grid_model_t *model, layer_t *layer)
 	for(i=0; i < model->rows; i++)
 		for(j=0; j < model->cols; j++) {
 			fprintf(stdout, "row: %d, col: %d\n", i, j);
-			debug_print_blist(layer->b2gmap[i][j], layer->flp);
+			debug_print_b2gmap(layer->b2gmap, i * model->cols + j, layer->flp);
 		}
 
 	fprintf(stdout, "printing g2bmap information...\n");
@@ -36,20 +36,33 @@
 #define LAYER_SP			0
 #define LAYER_SINK			1
 
-/* block list: block to grid mapping data structure.
- * list of blocks mapped to a grid cell	
+/* 
+ * the pcg steady state solver stops when the residual 
+ * is this small relative to the right hand side, or 
+ * after as many iterations as there are nodes
  */
-typedef struct blist_t_st
+#define GRID_PCG_TOL		1e-12
+
+/* block-grid map: block to grid mapping data structure.
+ * the blocks mapped to each grid cell, in CSR form. the 
+ * blocks of the cell at row i and column j are idx[k] for
+ * k from start[i*cols+j] to start[i*cols+j+1]-1
+ */
+typedef struct b2gmap_t_st
 {
+	/* no. of grid cells	*/
+	int n_cells;
+	/* first entry of each cell and one past the last cell's	*/
+	int *start;
 	/* index of the mapped block	*/
-	int idx;
+	int *idx;
 	/* ratio of this block's area within the grid cell 
 	 * to the total area of the grid cell
 	 */
-	double occupancy;
-	/* next block mapped to the same cell	*/
-	struct blist_t_st *next;
-}blist_t;
+	double *occupancy;
+	/* no. of entries there is room for in idx and occupancy	*/
+	int size;
+}b2gmap_t;
 
 /* grid list: grid to block mapping data structure.
  * start and end indices of grid cells in a block
@@ -87,8 +100,8 @@ typedef struct layer_t_st
 	double rx, ry, rz;	/* x, y and z resistors	*/
 	double c;			/* capacitance	*/
 
-	/* block-grid map - 2-d array of block lists	*/
-	blist_t ***b2gmap;
+	/* block-grid map	*/
+	b2gmap_t *b2gmap;
 	/* grid-block map - a 1-d array of grid lists	*/
 	glist_t *g2bmap;
 }layer_t;
@@ -144,6 +157,45 @@ typedef struct grid_model_t_st
 	/* block temperatures	*/
 	double *last_temp;
 
+	/* for the pcg solver - the conductance matrix in CSR 
+	 * form with the nodes in the order of grid_model_vector_t,
+	 * its incomplete cholesky factor and the conductance of 
+	 * each node to the ambient
+	 */
+	sparse_matrix_t *r_sparse;
+	sparse_matrix_t *r_ic;
+	double *g_amb;
+	/* 
+	 * for the implicit transient solvers - C/h + G in the same
+	 * form as r_sparse and its incomplete cholesky factor, the
+	 * capacitance of each node, its conductance to the ambient
+	 * and the h the matrix was assembled for (0 if none)
+	 */
+	sparse_matrix_t *trans_sparse;
+	sparse_matrix_t *trans_ic;
+	double *trans_c;
+	double *trans_amb;
+	double trans_h;
+	/* 
+	 * per call scratch space, carved out of one arena when the 
+	 * model is allocated so that the solvers do no heap allocation -
+	 * the block power mapped to the grid, the right hand side of the
+	 * pcg solves, an implicit half step, the work vectors of pcgsolve
+	 * and rk4 and the cumulative power of set_heuristic_temp
+	 */
+	arena_t *arena;
+	grid_model_vector_t *w_power;
+	double *w_rhs;
+	double *w_half;
+	double *w_work;
+	double *w_sum;
+	/* iterations taken by the last steady state solution and
+	 * its residual - the relative residual norm for pcg, the
+	 * largest change in the last sweep (in K) for gauss-seidel
+	 */
+	int steady_iter;
+	double steady_resid;
+
 	/* to allow for resizing	*/
 	int base_n_units;
 }grid_model_t;
@@ -158,7 +210,10 @@ void populate_C_model_grid(grid_model_t *model, flp_t *flp);
 
 /* hotspot main interfaces - temperature.c	*/
 void steady_state_temp_grid(grid_model_t *model, double *power, double *temp);
+void steady_state_temp_grid_batch(grid_model_t *model, double **power, double **temp, int n);
 void compute_temp_grid(grid_model_t *model, double *power, double *temp, double time_elapsed);
+/* backward euler / crank-nicolson part of the above on the grid temperatures	*/
+void implicit_temp_grid(grid_model_t *model, grid_model_vector_t *power, double time_elapsed);
 
 /* differs from 'dvector()' in that memory for internal nodes is also allocated	*/
 double *hotspot_vector_grid(grid_model_t *model);
@@ -184,6 +239,9 @@ double find_avg_temp_grid(grid_model_t *model, double *temp);
 grid_model_vector_t *new_grid_model_vector(grid_model_t *model);
 /* destructor	*/
 void free_grid_model_vector(grid_model_vector_t *v);
+/* same as the constructor but out of an arena, and the space it needs	*/
+grid_model_vector_t *arena_grid_model_vector(grid_model_t *model, arena_t *a);
+size_t grid_model_vector_arena_size(grid_model_t *model);
 /* translate power/temperature between block and grid vectors	*/
 void xlate_vector_b2g(grid_model_t *model, double *b, grid_model_vector_t *g, int type);
 /* translate temperature between grid and block vectors	*/
@@ -191,4 +249,13 @@ void xlate_temp_g2b(grid_model_t *model, double *b, grid_model_vector_t *g);
 /* debug print	*/
 void debug_print_grid(grid_model_t *model);
 
+/* 
+ * the kernels of the solvers. one red-black gauss-seidel sweep over 
+ * all the nodes, returning the largest change, and the slope vector
+ * of the transient equation. both are parallel when built with openmp
+ */
+double single_iteration_steady_grid(grid_model_t *model, grid_model_vector_t *power,
+									grid_model_vector_t *temp);
+void slope_fn_grid(grid_model_t *model, double *v, grid_model_vector_t *p, double *dv);
+
 #endif
@@ -0,0 +1,208 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "trace.h"
+#include "util.h"
+
+int is_binary_trace(char const *file)
+{
+	char magic[TRACE_MAGIC_SIZE];
+	FILE *fp = fopen(file, "rb");
+	int ret;
+
+	if (!fp)
+		return FALSE;
+	ret = (fread(magic, 1, TRACE_MAGIC_SIZE, fp) == TRACE_MAGIC_SIZE &&
+		   !memcmp(magic, TRACE_MAGIC, TRACE_MAGIC_SIZE));
+	fclose(fp);
+	return ret;
+}
+
+/* first value of the block holding 'row' and the no. of rows in it	*/
+static double *trace_block(trace_in_t *t, uint64_t row, uint64_t *rows)
+{
+	uint64_t b = row / t->hdr->block_rows;
+	uint64_t first = b * t->hdr->block_rows;
+
+	*rows = MIN(t->hdr->block_rows, t->hdr->n_rows - first);
+	return t->data + first * t->hdr->n_cols;
+}
+
+/*
+ * ask the kernel to start reading the block after the one holding
+ * 'row', so that its i/o overlaps the work on the current one
+ */
+static void trace_prefetch(trace_in_t *t, uint64_t row)
+{
+	uint64_t rows, next = (row / t->hdr->block_rows + 1) * t->hdr->block_rows;
+	char *start, *end;
+	long page = sysconf(_SC_PAGESIZE);
+
+	if (next >= t->hdr->n_rows)
+		return;
+	start = (char *) trace_block(t, next, &rows);
+	end = start + rows * t->hdr->n_cols * sizeof(double);
+	/* madvise needs a page aligned start	*/
+	start = t->map + ((start - t->map) / page) * page;
+	madvise(start, end - start, MADV_WILLNEED);
+}
+
+trace_in_t *open_trace_in(char const *file)
+{
+	int fd, i;
+	struct stat st;
+	char *name;
+	trace_in_t *t = (trace_in_t *) calloc (1, sizeof(trace_in_t));
+	if (!t)
+		fatal("memory allocation error\n");
+
+	if ((fd = open(file, O_RDONLY)) < 0 || fstat(fd, &st) < 0)
+		fatal("unable to open binary trace file\n");
+	t->size = st.st_size;
+	if (t->size < sizeof(trace_header_t))
+		fatal("binary trace file too short\n");
+	t->map = (char *) mmap(NULL, t->size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (t->map == MAP_FAILED)
+		fatal("unable to map binary trace file\n");
+	/* the mapping outlives the descriptor	*/
+	close(fd);
+	madvise(t->map, t->size, MADV_SEQUENTIAL);
+
+	t->hdr = (trace_header_t *) t->map;
+	if (memcmp(t->hdr->magic, TRACE_MAGIC, TRACE_MAGIC_SIZE))
+		fatal("not a binary trace file\n");
+	if (!t->hdr->n_cols || !t->hdr->block_rows || t->hdr->names_size % sizeof(double) ||
+		t->size != sizeof(trace_header_t) + t->hdr->names_size +
+				   t->hdr->n_rows * t->hdr->n_cols * sizeof(double))
+		fatal("corrupt binary trace file\n");
+	t->data = (double *) (t->map + sizeof(trace_header_t) + t->hdr->names_size);
+
+	/* the names follow the header back to back	*/
+	t->names = (char **) calloc (t->hdr->n_cols, sizeof(char *));
+	if (!t->names)
+		fatal("memory allocation error\n");
+	name = t->map + sizeof(trace_header_t);
+	for (i = 0; i < (int) t->hdr->n_cols; i++) {
+		if (name >= (char *) t->data || !memchr(name, '\0', (char *) t->data - name))
+			fatal("corrupt names in binary trace file\n");
+		t->names[i] = name;
+		name += strlen(name) + 1;
+	}
+
+	t->next = 0;
+	trace_prefetch(t, 0);
+	return t;
+}
+
+void close_trace_in(trace_in_t *t)
+{
+	munmap(t->map, t->size);
+	free(t->names);
+	free(t);
+}
+
+int read_trace_row(trace_in_t *t, double *vals)
+{
+	int i, n = t->hdr->n_cols;
+	uint64_t rows, r;
+	double *block;
+
+	if (t->next >= t->hdr->n_rows)
+		return 0;
+
+	block = trace_block(t, t->next, &rows);
+	r = t->next % t->hdr->block_rows;
+	/* entering a new block - start on the one after it	*/
+	if (!r)
+		trace_prefetch(t, t->next);
+	for (i = 0; i < n; i++)
+		vals[i] = block[i * rows + r];
+	t->next++;
+	return n;
+}
+
+void trace_column_sums(trace_in_t *t, double *sums)
+{
+	int i, n = t->hdr->n_cols;
+	uint64_t row, rows, r;
+	double *block;
+
+	zero_dvector(sums, n);
+	for (row = 0; row < t->hdr->n_rows; row += rows) {
+		block = trace_block(t, row, &rows);
+		trace_prefetch(t, row);
+		for (i = 0; i < n; i++)
+			for (r = 0; r < rows; r++)
+				sums[i] += block[i * rows + r];
+	}
+	t->next = t->hdr->n_rows;
+}
+
+trace_out_t *open_trace_out(char const *file, char **names, int n_cols)
+{
+	int i;
+	size_t len = 0;
+	trace_header_t hdr;
+	trace_out_t *t = (trace_out_t *) calloc (1, sizeof(trace_out_t));
+	if (!t)
+		fatal("memory allocation error\n");
+
+	if (!(t->fp = fopen(file, "wb")))
+		fatal("unable to open binary trace file for output\n");
+	t->n_cols = n_cols;
+	t->block = dvector(TRACE_BLOCK_ROWS * n_cols);
+
+	/* the no. of rows is filled in by close_trace_out	*/
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, TRACE_MAGIC, TRACE_MAGIC_SIZE);
+	hdr.n_cols = n_cols;
+	hdr.block_rows = TRACE_BLOCK_ROWS;
+	for (i = 0; i < n_cols; i++)
+		len += strlen(names[i]) + 1;
+	hdr.names_size = (len + sizeof(double) - 1) / sizeof(double) * sizeof(double);
+	fwrite(&hdr, sizeof(hdr), 1, t->fp);
+	for (i = 0; i < n_cols; i++)
+		fwrite(names[i], strlen(names[i]) + 1, 1, t->fp);
+	for (; len < hdr.names_size; len++)
+		fputc('\0', t->fp);
+	return t;
+}
+
+/* write out the current block - 'filled' rows of each column	*/
+static void flush_trace_out(trace_out_t *t)
+{
+	int i;
+	for (i = 0; i < t->n_cols; i++)
+		if (fwrite(t->block + i * TRACE_BLOCK_ROWS, sizeof(double), t->filled, t->fp)
+			!= (size_t) t->filled)
+			fatal("error writing binary trace file\n");
+	t->filled = 0;
+}
+
+void write_trace_row(trace_out_t *t, double *vals)
+{
+	int i;
+	for (i = 0; i < t->n_cols; i++)
+		t->block[i * TRACE_BLOCK_ROWS + t->filled] = vals[i];
+	t->n_rows++;
+	if (++t->filled == TRACE_BLOCK_ROWS)
+		flush_trace_out(t);
+}
+
+void close_trace_out(trace_out_t *t)
+{
+	if (t->filled)
+		flush_trace_out(t);
+	/* the header's no. of rows	*/
+	fseek(t->fp, offsetof(trace_header_t, n_rows), SEEK_SET);
+	fwrite(&t->n_rows, sizeof(t->n_rows), 1, t->fp);
+	fclose(t->fp);
+	free_dvector(t->block);
+	free(t);
+}
@@ -0,0 +1,85 @@
+#ifndef __TRACE_H_
+#define __TRACE_H_
+
+/*
+ * binary trace format - a columnar alternative to the text power
+ * (.ptrace) and temperature (.ttrace) traces for long traces. the
+ * file is, in this order:
+ *	header	-	a trace_header_t
+ *	names	-	the NUL terminated names of the columns, padded with
+ *				NULs to a multiple of 8 bytes
+ *	data	-	the rows in blocks of 'block_rows' rows (the last block
+ *				may be shorter). a block holds its rows column by column,
+ *				i.e., all its values of the first column, then those of
+ *				the second and so on
+ * the values are doubles in the native byte order - power in W and
+ * temperature in degree C, the units of the text traces. input
+ * traces are memory mapped and read a block at a time.
+ */
+#include <stdio.h>
+#include <stdint.h>
+
+#define TRACE_MAGIC			"HSTRACE1"
+#define TRACE_MAGIC_SIZE	8
+/* rows per block of the traces written	*/
+#define TRACE_BLOCK_ROWS	4096
+
+typedef struct trace_header_t_st
+{
+	char magic[TRACE_MAGIC_SIZE];
+	uint32_t n_cols;
+	uint32_t block_rows;
+	uint64_t n_rows;
+	/* size of the names section in bytes, including the padding	*/
+	uint64_t names_size;
+}trace_header_t;
+
+/* binary trace open for reading	*/
+typedef struct trace_in_t_st
+{
+	/* the mapped file	*/
+	char *map;
+	size_t size;
+	/* shortcuts into the map	*/
+	trace_header_t *hdr;
+	double *data;
+	/* column names - point into the map	*/
+	char **names;
+	/* next row to be read	*/
+	uint64_t next;
+}trace_in_t;
+
+/* binary trace open for writing	*/
+typedef struct trace_out_t_st
+{
+	FILE *fp;
+	int n_cols;
+	uint64_t n_rows;
+	/* the current block, column by column, and its no. of rows	*/
+	double *block;
+	int filled;
+}trace_out_t;
+
+/* does 'file' start with the binary trace magic?	*/
+int is_binary_trace(char const *file);
+
+trace_in_t *open_trace_in(char const *file);
+void close_trace_in(trace_in_t *t);
+/*
+ * next row of values into 'vals'. returns the no. of values,
+ * or 0 when there are no more rows
+ */
+int read_trace_row(trace_in_t *t, double *vals);
+/*
+ * sum of each column over all the rows, added in the order of
+ * the rows - i.e., the same sums as adding up read_trace_row's.
+ * all the rows are consumed
+ */
+void trace_column_sums(trace_in_t *t, double *sums);
+
+trace_out_t *open_trace_out(char const *file, char **names, int n_cols);
+void write_trace_row(trace_out_t *t, double *vals);
+/* writes out the last block and the no. of rows	*/
+void close_trace_out(trace_out_t *t);
+
+#endif
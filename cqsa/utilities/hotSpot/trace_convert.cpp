@@ -0,0 +1,76 @@
+/*
+ * converts a text trace (e.g. gcc.ptrace) into the binary trace
+ * format of trace.h and back. build with 'make trace_convert' and
+ * run as
+ * 	trace_convert <in> <out>
+ * the direction is picked from the input - a binary input is written
+ * out as text and vice versa. the values are copied as they are, with
+ * all their digits when written as text, so a round trip is exact
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hotspot.h"
+#include "trace.h"
+#include "util.h"
+
+void text_to_binary(char const *in, char const *out)
+{
+	int n, num;
+	char **names = alloc_names(MAX_UNITS, STR_SIZE);
+	double *vals = dvector(MAX_UNITS);
+	trace_out_t *t;
+	FILE *fp;
+
+	if (!(fp = fopen(in, "r")))
+		fatal("unable to open trace input file\n");
+	n = read_names(fp, names);
+	t = open_trace_out(out, names, n);
+	while ((num = read_vals(fp, vals)) != 0) {
+		if (num != n)
+			fatal("invalid trace file format\n");
+		write_trace_row(t, vals);
+	}
+	close_trace_out(t);
+
+	fclose(fp);
+	free_dvector(vals);
+	free_names(names);
+}
+
+void binary_to_text(char const *in, char const *out)
+{
+	int i, n;
+	trace_in_t *t = open_trace_in(in);
+	double *vals = dvector(t->hdr->n_cols);
+	FILE *fp;
+
+	if (!(fp = fopen(out, "w")))
+		fatal("unable to open trace output file\n");
+	n = t->hdr->n_cols;
+	for (i = 0; i < n; i++)
+		fprintf(fp, "%s%c", t->names[i], (i < n-1) ? '\t' : '\n');
+	while (read_trace_row(t, vals))
+		for (i = 0; i < n; i++)
+			fprintf(fp, "%.17g%c", vals[i], (i < n-1) ? '\t' : '\n');
+
+	fclose(fp);
+	free_dvector(vals);
+	close_trace_in(t);
+}
+
+int main(int argc, char **argv)
+{
+	if (argc != 3) {
+		fprintf(stdout, "Usage: %s <in> <out>\n", argv[0]);
+		fprintf(stdout, "converts a text trace into a binary one and vice versa\n");
+		return 1;
+	}
+
+	if (is_binary_trace(argv[1]))
+		binary_to_text(argv[1], argv[2]);
+	else
+		text_to_binary(argv[1], argv[2]);
+	return 0;
+}
@@ -22,13 +22,13 @@ int ge(float x, float y)
 	return ((x > y) || eq(x,y));
 }
 
-void fatal(char *s)
+void fatal(const char *s)
 {
 	fprintf(stderr, "error: %s", s);
 	exit(1);
 }
 
-void warning(char *s)
+void warning(const char *s)
 {
 	fprintf(stderr, "warning: %s", s);
 }
@@ -260,6 +260,39 @@ void free_dcuboid(double ***m)
 	free(m);
 }
 
+arena_t *new_arena(size_t size)
+{
+	arena_t *a = (arena_t *) calloc (1, sizeof(arena_t));
+	assert(a != NULL);
+	/* over-allocate so that the base can be aligned	*/
+	a->base = (char *) calloc (size + ARENA_ALIGN, 1);
+	assert(a->base != NULL);
+	a->size = size;
+	a->used = (ARENA_ALIGN - (size_t) a->base % ARENA_ALIGN) % ARENA_ALIGN;
+	a->size += a->used;
+	return a;
+}
+
+void free_arena(arena_t *a)
+{
+	free(a->base);
+	free(a);
+}
+
+void *arena_alloc(arena_t *a, size_t size)
+{
+	void *p = a->base + a->used;
+	if (a->used + ARENA_ROUND(size) > a->size)
+		fatal("arena out of space\n");
+	a->used += ARENA_ROUND(size);
+	return p;
+}
+
+double *arena_dvector(arena_t *a, int n)
+{
+	return (double *) arena_alloc(a, n * sizeof(double));
+}
+
 /* mirror the lower triangle to make 'm' fully symmetric	*/
 void mirror_dmatrix(double **m, int n)
 {
@@ -295,16 +328,35 @@ void init_rand(void)
 	srand(RAND_SEED);
 }
 
+/* 
+ * next number of the random stream with state 'seed' - or
+ * of the global stream when seed is NULL
+ */
+static int next_rand(unsigned int *seed)
+{
+	return seed ? rand_r(seed) : rand();
+}
+
 /* random number within the range [0, max-1]	*/
 int rand_upto(int max)
 {
-	return (int) (max * (double) rand() / (RAND_MAX+1.0));
+	return rand_upto_r(max, NULL);
+}
+
+int rand_upto_r(int max, unsigned int *seed)
+{
+	return (int) (max * (double) next_rand(seed) / (RAND_MAX+1.0));
 }
 
 /* random number in the range [0, 1)	*/
 double rand_fraction(void)
 {
-	return ((double) rand() / (RAND_MAX+1.0));
+	return rand_fraction_r(NULL);
+}
+
+double rand_fraction_r(unsigned int *seed)
+{
+	return ((double) next_rand(seed) / (RAND_MAX+1.0));
 }
 
 /* 
@@ -335,9 +387,11 @@ int read_str_pairs(str_pair *table, int max_entries, char *file)
 		if (!ptr || ptr[0] == '#') 
 			continue;
 
-		strncpy(table[i].name,ptr,strlen(ptr));
+		strncpy(table[i].name,ptr,STR_SIZE-1);
+		table[i].name[STR_SIZE-1] = '\0';
 		ptr = strtok(NULL,"- \r\t\n");
-		strncpy(table[i].value,ptr,strlen(ptr));
+		strncpy(table[i].value,ptr,STR_SIZE-1);
+		table[i].value[STR_SIZE-1] = '\0';
 		
 		/* sscanf doesn't work for this purpose
 		if ((sscanf(copy, "%s%s", name, table[i].value) != 2) || (name[0] != '-'))
@@ -377,7 +431,7 @@ int parse_cmdline(str_pair *table, int max_entries, int argc, char **argv)
 }
 
 /* append the table onto a file	*/
-void dump_str_pairs(str_pair *table, int size, char *file, char *prefix)
+void dump_str_pairs(str_pair *table, int size, char *file, const char *prefix)
 {
 	int i; 
 	char str[STR_SIZE];
@@ -392,7 +446,7 @@ void dump_str_pairs(str_pair *table, int size, char *file, char *prefix)
 }
 
 /* table lookup	for a name */
-int get_str_index(str_pair *table, int size, char *str)
+int get_str_index(str_pair *table, int size, const char *str)
 {
 	int i;
 
@@ -497,7 +551,7 @@ int bsearch_insert_double(double *arr, int n, double ele)
  * population count of an 8-bit integer - using pointers from 
  * http://aggregate.org/MAGIC/
  */
-unsigned int ones8(register unsigned char n)
+unsigned int ones8(unsigned char n)
 {
 	/* group the bits in two and compute the no. of 1's within a group
 	 * this works because 00->00, 01->01, 10->01, 11->10 or 
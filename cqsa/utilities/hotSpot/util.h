@@ -27,8 +27,8 @@
 int eq(float x, float y);
 int le(float x, float y);
 int ge(float x, float y);
-void fatal (char *s);
-void warning (char *s);
+void fatal (const char *s);
+void warning (const char *s);
 void swap_ival (int *a, int *b);
 void swap_dval (double *a, double *b);
 int tolerant_ceil(double val);
@@ -76,12 +76,39 @@ double ***dcuboid_tail(int nr, int nc, int nl, int xtra);
 /* destructor	*/
 void free_dcuboid(double ***m);
 
+/* 
+ * arena - one block of zeroed memory handed out in pieces and 
+ * freed as a whole. for scratch space that lives as long as its 
+ * owner. every piece is aligned to ARENA_ALIGN bytes, so an arena 
+ * for pieces of sizes s1, s2... needs ARENA_ROUND(s1) + 
+ * ARENA_ROUND(s2) + ... bytes
+ */
+#define ARENA_ALIGN		64
+#define ARENA_ROUND(n)	(((size_t)(n) + ARENA_ALIGN - 1) & ~((size_t) ARENA_ALIGN - 1))
+typedef struct arena_t_st
+{
+	char *base;
+	size_t size;
+	size_t used;
+}arena_t;
+arena_t *new_arena(size_t size);
+void free_arena(arena_t *a);
+/* next 'size' bytes of the arena. it is an error to run out	*/
+void *arena_alloc(arena_t *a, size_t size);
+double *arena_dvector(arena_t *a, int n);
+
 /* initialize random number generator	*/
 void init_rand(void);
 /* random number within the range [0, max-1]	*/
 int rand_upto(int max);
 /* random number in the range [0, 1)	*/
 double rand_fraction(void);
+/* 
+ * same as the above two, from a stream of one's own. 'seed'
+ * is its state. NULL means the global stream
+ */
+int rand_upto_r(int max, unsigned int *seed);
+double rand_fraction_r(unsigned int *seed);
 
 /* a table of name value pairs	*/
 typedef struct str_pair_st
@@ -98,9 +125,9 @@ int read_str_pairs(str_pair *table, int max_entries, char *file);
 /* same as above but from command line instead of a file	*/
 int parse_cmdline(str_pair *table, int max_entries, int argc, char **argv);
 /* append the table onto a file	*/
-void dump_str_pairs(str_pair *table, int size, char *file, char *prefix);
+void dump_str_pairs(str_pair *table, int size, char *file, const char *prefix);
 /* table lookup	for a name */
-int get_str_index(str_pair *table, int size, char *str);
+int get_str_index(str_pair *table, int size, const char *str);
 /* 
  * remove duplicate names in the table - the entries later 
  * in the table are discarded. returns the new size of the
@@ -124,7 +151,7 @@ int bsearch_insert_double(double *arr, int n, double ele);
  * population count of an 8-bit integer - using pointers from 
  * http://aggregate.org/MAGIC/
  */
-unsigned int ones8(register unsigned char n);
+unsigned int ones8(unsigned char n);
 /* 
  * find the number of non-empty, non-comment lines
  * in a file open for reading